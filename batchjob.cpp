@@ -0,0 +1,569 @@
+//
+// batchjob.cpp
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "batchjob.h"
+#include "cpmfs.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/select.h>
+#include <sys/stat.h>
+
+static u8 *ReadHostFile (const char *pFileName, unsigned *pSize);
+
+CBatchJob::CBatchJob (void)
+:	m_pFileName (0),
+	m_pText (0),
+	m_pStatement (0),
+	m_nStatements (0),
+	m_pCommands (0),
+	m_nCommandsLength (0),
+	m_nCycleLimit (0),
+	m_pOutputFile (0),
+	m_pDefaultOutputFile (0)
+{
+}
+
+CBatchJob::~CBatchJob (void)
+{
+	delete [] m_pDefaultOutputFile;
+	delete [] m_pCommands;
+	delete [] m_pStatement;
+	delete [] m_pText;
+}
+
+boolean CBatchJob::Load (const char *pFileName)
+{
+	assert (pFileName != 0);
+	m_pFileName = pFileName;
+
+	unsigned nSize;
+	assert (m_pText == 0);
+	m_pText = (char *) ReadHostFile (m_pFileName, &nSize);
+	if (m_pText == 0)
+	{
+		return FALSE;
+	}
+	m_pText[nSize] = '\0';
+
+	// each line holds one statement or command line at most
+	unsigned nLines = 1;
+	for (unsigned i = 0; i < nSize; i++)
+	{
+		if (m_pText[i] == '\n')
+		{
+			nLines++;
+		}
+	}
+
+	m_pStatement = new TStatement[nLines];
+	assert (m_pStatement != 0);
+
+	m_pCommands = new char[nSize + 1];
+	assert (m_pCommands != 0);
+
+	char *pLine = m_pText;
+	for (unsigned nLine = 1; pLine != 0; nLine++)
+	{
+		char *pNext = strchr (pLine, '\n');
+		if (pNext != 0)
+		{
+			*pNext++ = '\0';
+		}
+
+		if (!ParseLine (pLine, nLine))
+		{
+			return FALSE;
+		}
+
+		pLine = pNext;
+	}
+
+	if (m_pOutputFile == 0)
+	{
+		m_pDefaultOutputFile = new char[strlen (m_pFileName) + 5];
+		assert (m_pDefaultOutputFile != 0);
+
+		strcpy (m_pDefaultOutputFile, m_pFileName);
+		strcat (m_pDefaultOutputFile, ".out");
+
+		m_pOutputFile = m_pDefaultOutputFile;
+	}
+
+	return TRUE;
+}
+
+boolean CBatchJob::Prepare (CZ80Computer *pComputer)
+{
+	assert (pComputer != 0);
+
+	// A restored machine has logged in the disks already and its BDOS would
+	// not know the blocks of the files written below. Ctrl-C at the prompt
+	// makes it reboot and log in the disks again.
+	int nInputFile, nOutputFile;
+	if (!OpenConsole (HasPutStatements () && pComputer->IsRestored (),
+			  &nInputFile, &nOutputFile))
+	{
+		return FALSE;
+	}
+
+	pComputer->SetConsoleFiles (nInputFile, nOutputFile);
+	pComputer->SetDiskMapping (DiskMapPrivate);
+	pComputer->SetCycleLimit (m_nCycleLimit);
+
+	if (!pComputer->Initialize ())
+	{
+		return FALSE;
+	}
+
+	return PutFiles (pComputer);
+}
+
+boolean CBatchJob::Attach (CZ80Computer *pComputer)
+{
+	assert (pComputer != 0);
+
+	// the disks have been logged in, see Prepare ()
+	int nInputFile, nOutputFile;
+	if (!OpenConsole (HasPutStatements (), &nInputFile, &nOutputFile))
+	{
+		return FALSE;
+	}
+
+	pComputer->SetConsoleFiles (nInputFile, nOutputFile);
+	pComputer->SetCycleLimit (m_nCycleLimit);
+
+	return PutFiles (pComputer);
+}
+
+int CBatchJob::Complete (CZ80Computer *pComputer)
+{
+	assert (pComputer != 0);
+
+	int nStatus = JOB_STATUS_OK;
+	if (pComputer->IsCycleLimitReached ())
+	{
+		fprintf (stderr, "Cycle limit reached: %s\n", m_pFileName);
+
+		nStatus = JOB_STATUS_CYCLE_LIMIT;
+	}
+
+	// the files are copied even after the cycle limit to help finding the cause
+	for (unsigned i = 0; i < m_nStatements; i++)
+	{
+		const TStatement *pStatement = &m_pStatement[i];
+		if (pStatement->Type != StatementGet)
+		{
+			continue;
+		}
+
+		CCPMFileSystem FileSystem (pComputer->GetRAMDisk (pStatement->nDrive));
+
+		unsigned nSize;
+		u8 *pData = 0;
+		if (   !FileSystem.Mount ()
+		    || (pData = FileSystem.ReadFile (pStatement->pCPMName, &nSize)) == 0)
+		{
+			nStatus = nStatus == JOB_STATUS_OK ? JOB_STATUS_ERROR : nStatus;
+
+			continue;
+		}
+
+		FILE *pFile = fopen (pStatement->pHostName, "w");
+		if (   pFile == 0
+		    || fwrite (pData, 1, nSize, pFile) != nSize)
+		{
+			fprintf (stderr, "Cannot write: %s\n", pStatement->pHostName);
+
+			nStatus = nStatus == JOB_STATUS_OK ? JOB_STATUS_ERROR : nStatus;
+		}
+
+		if (pFile != 0)
+		{
+			fclose (pFile);
+		}
+
+		delete [] pData;
+	}
+
+	return nStatus;
+}
+
+boolean CBatchJob::ParseLine (char *pLine, unsigned nLine)
+{
+	assert (pLine != 0);
+
+	unsigned nLength = strlen (pLine);
+	if (   nLength > 0
+	    && pLine[nLength-1] == '\r')
+	{
+		pLine[--nLength] = '\0';
+	}
+
+	while (*pLine == ' ' || *pLine == '\t')
+	{
+		pLine++;
+	}
+
+	if (   *pLine == '\0'
+	    || *pLine == '#')
+	{
+		return TRUE;
+	}
+
+	char *pKeyword = pLine;
+	while (*pLine != '\0' && *pLine != ' ' && *pLine != '\t')
+	{
+		pLine++;
+	}
+
+	char *pRest = pLine;		// the arguments
+	if (*pRest != '\0')
+	{
+		*pRest++ = '\0';
+	}
+
+	// "type" takes the rest of the line as it is (without the separating blank)
+	if (strcmp (pKeyword, "type") == 0)
+	{
+		nLength = strlen (pRest);
+		memcpy (m_pCommands + m_nCommandsLength, pRest, nLength);
+		m_nCommandsLength += nLength;
+		m_pCommands[m_nCommandsLength++] = '\n';
+
+		return TRUE;
+	}
+
+	char *pArg[2] = {0, 0};
+	unsigned nArgs = 0;
+	for (char *pToken = strtok (pRest, " \t"); pToken != 0; pToken = strtok (0, " \t"))
+	{
+		if (nArgs >= 2)
+		{
+			fprintf (stderr, "%s(%u): Too many arguments\n", m_pFileName, nLine);
+
+			return FALSE;
+		}
+
+		pArg[nArgs++] = pToken;
+	}
+
+	if (nArgs == 0)
+	{
+		fprintf (stderr, "%s(%u): Argument expected\n", m_pFileName, nLine);
+
+		return FALSE;
+	}
+
+	if (strcmp (pKeyword, "put") == 0)
+	{
+		TStatement *pStatement = &m_pStatement[m_nStatements++];
+		pStatement->Type = StatementPut;
+		pStatement->pHostName = pArg[0];
+
+		// the CP/M name defaults to the host file name without path
+		char *pName = pArg[1];
+		if (pName == 0)
+		{
+			pName = strrchr (pArg[0], '/');
+			pName = pName != 0 ? pName+1 : pArg[0];
+		}
+
+		if (!ParseFileName (pName, pStatement))
+		{
+			fprintf (stderr, "%s(%u): Invalid CP/M filename: %s\n", m_pFileName, nLine, pName);
+
+			return FALSE;
+		}
+	}
+	else if (strcmp (pKeyword, "get") == 0)
+	{
+		TStatement *pStatement = &m_pStatement[m_nStatements++];
+		pStatement->Type = StatementGet;
+		pStatement->pHostName = pArg[1];
+
+		if (!ParseFileName (pArg[0], pStatement))
+		{
+			fprintf (stderr, "%s(%u): Invalid CP/M filename: %s\n", m_pFileName, nLine, pArg[0]);
+
+			return FALSE;
+		}
+
+		if (pStatement->pHostName == 0)
+		{
+			pStatement->pHostName = pStatement->pCPMName;
+		}
+	}
+	else if (   strcmp (pKeyword, "cycles") == 0
+		 && nArgs == 1)
+	{
+		char *pEnd;
+		m_nCycleLimit = strtoull (pArg[0], &pEnd, 0);
+		if (   *pEnd != '\0'
+		    || m_nCycleLimit == 0)
+		{
+			fprintf (stderr, "%s(%u): Invalid number: %s\n", m_pFileName, nLine, pArg[0]);
+
+			return FALSE;
+		}
+	}
+	else if (   strcmp (pKeyword, "output") == 0
+		 && nArgs == 1)
+	{
+		m_pOutputFile = pArg[0];
+	}
+	else
+	{
+		fprintf (stderr, "%s(%u): Invalid statement: %s\n", m_pFileName, nLine, pKeyword);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// splits an optional drive prefix ("b:") from pName
+boolean CBatchJob::ParseFileName (char *pName, TStatement *pStatement)
+{
+	assert (pName != 0);
+	assert (pStatement != 0);
+
+	pStatement->nDrive = 0;
+
+	if (   pName[0] != '\0'
+	    && pName[1] == ':')
+	{
+		char chDrive = pName[0];
+		if ('a' <= chDrive && chDrive <= 'z')
+		{
+			chDrive -= 'a'-'A';
+		}
+
+		if (!('A' <= chDrive && chDrive < 'A' + DISK_DRIVES))
+		{
+			return FALSE;
+		}
+
+		pStatement->nDrive = chDrive - 'A';
+		pName += 2;
+	}
+
+	pStatement->pCPMName = pName;
+
+	return *pName != '\0';
+}
+
+// the command lines are the console input, they are written to an unnamed
+// temporary file before the machine runs, which is read like a redirected
+// standard input (a pipe would take only 64 KB without a reader)
+boolean CBatchJob::OpenConsole (boolean bReboot, int *pInputFile, int *pOutputFile) const
+{
+	assert (pInputFile != 0);
+	assert (pOutputFile != 0);
+
+	FILE *pTempFile = tmpfile ();
+	if (pTempFile == 0)
+	{
+		fprintf (stderr, "Cannot create temporary file\n");
+
+		return FALSE;
+	}
+
+	int nInputFile = dup (fileno (pTempFile));
+	fclose (pTempFile);
+	if (nInputFile < 0)
+	{
+		fprintf (stderr, "Cannot create temporary file\n");
+
+		return FALSE;
+	}
+
+	if (!WriteCommands (nInputFile, bReboot))
+	{
+		fprintf (stderr, "Cannot write command lines: %s\n", m_pFileName);
+
+		close (nInputFile);
+
+		return FALSE;
+	}
+
+	int nOutputFile = open (m_pOutputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (nOutputFile < 0)
+	{
+		fprintf (stderr, "Cannot create: %s\n", m_pOutputFile);
+
+		close (nInputFile);
+
+		return FALSE;
+	}
+
+	if (nOutputFile >= FD_SETSIZE)		// the console uses select ()
+	{
+		fprintf (stderr, "Too many jobs\n");
+
+		close (nOutputFile);
+		close (nInputFile);
+
+		return FALSE;
+	}
+
+	*pInputFile = nInputFile;
+	*pOutputFile = nOutputFile;
+
+	return TRUE;
+}
+
+boolean CBatchJob::PutFiles (CZ80Computer *pComputer)
+{
+	assert (pComputer != 0);
+
+	for (unsigned i = 0; i < m_nStatements; i++)
+	{
+		const TStatement *pStatement = &m_pStatement[i];
+		if (pStatement->Type != StatementPut)
+		{
+			continue;
+		}
+
+		unsigned nSize;
+		u8 *pData = ReadHostFile (pStatement->pHostName, &nSize);
+		if (pData == 0)
+		{
+			return FALSE;
+		}
+
+		CCPMFileSystem FileSystem (pComputer->GetRAMDisk (pStatement->nDrive));
+		if (!FileSystem.Mount ())
+		{
+			fprintf (stderr, "Drive %c: not available: %s\n",
+				 'A' + pStatement->nDrive, m_pFileName);
+
+			delete [] pData;
+
+			return FALSE;
+		}
+
+		boolean bOK = FileSystem.WriteFile (pStatement->pCPMName, pData, nSize);
+
+		delete [] pData;
+
+		if (!bOK)
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+boolean CBatchJob::HasPutStatements (void) const
+{
+	for (unsigned i = 0; i < m_nStatements; i++)
+	{
+		if (m_pStatement[i].Type == StatementPut)
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+// writes the command lines and rewinds the file for reading
+boolean CBatchJob::WriteCommands (int nFile, boolean bReboot) const
+{
+	if (   bReboot
+	    && write (nFile, "\x03", 1) != 1)
+	{
+		return FALSE;
+	}
+
+	const char *pFrom = m_pCommands;
+	unsigned nCount = m_nCommandsLength;
+	while (nCount > 0)
+	{
+		ssize_t nResult = write (nFile, pFrom, nCount);
+		if (nResult < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return FALSE;
+		}
+
+		pFrom += nResult;
+		nCount -= nResult;
+	}
+
+	return lseek (nFile, 0, SEEK_SET) == 0;
+}
+
+// returns the file contents with an extra byte at the end, free it with delete []
+u8 *ReadHostFile (const char *pFileName, unsigned *pSize)
+{
+	assert (pFileName != 0);
+	assert (pSize != 0);
+
+	FILE *pFile = fopen (pFileName, "r");
+	if (pFile == 0)
+	{
+		fprintf (stderr, "File not found: %s\n", pFileName);
+
+		return 0;
+	}
+
+	struct stat Stat;
+	if (   fstat (fileno (pFile), &Stat) < 0
+	    || Stat.st_size > 0x7FFFFFFF)
+	{
+		fprintf (stderr, "Cannot read: %s\n", pFileName);
+
+		fclose (pFile);
+
+		return 0;
+	}
+
+	*pSize = (unsigned) Stat.st_size;
+
+	u8 *pBuffer = new u8[*pSize + 1];
+	assert (pBuffer != 0);
+
+	if (fread (pBuffer, 1, *pSize, pFile) != *pSize)
+	{
+		fprintf (stderr, "Cannot read: %s\n", pFileName);
+
+		delete [] pBuffer;
+		fclose (pFile);
+
+		return 0;
+	}
+
+	fclose (pFile);
+
+	return pBuffer;
+}
@@ -0,0 +1,103 @@
+//
+// batchjob.h
+//
+// A CP/M job with input files, command lines and output files (Linux only)
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef _batchjob_h
+#define _batchjob_h
+
+#include "z80computer.h"
+#include "types.h"
+
+// A job description is a text file with one statement per line:
+//
+//	put hostfile [d:]NAME.EXT	copy a file onto a scratch disk (default A:)
+//	type command line		input for the CP/M prompt or a program
+//	get [d:]NAME.EXT [hostfile]	copy a file from the disk after the run
+//	cycles n			quit after n Z80 cycles
+//	output hostfile			console output (default: jobfile.out)
+//
+// Empty lines and lines starting with '#' are ignored. All disks are scratch
+// disks (DiskMapPrivate), so that no image is written.
+
+#define JOB_STATUS_OK		0
+#define JOB_STATUS_ERROR	1		// invalid job or a file was not found
+#define JOB_STATUS_CYCLE_LIMIT	2		// the machine did not quit in time
+
+class CBatchJob
+{
+public:
+	CBatchJob (void);
+	~CBatchJob (void);
+
+	boolean Load (const char *pFileName);		// parses the job description
+
+	// initializes the machine instead of CZ80Computer::Initialize ()
+	boolean Prepare (CZ80Computer *pComputer);
+
+	// takes over a machine, which has stopped at console input (see
+	// CZ80Computer::SetStopAtInput ()), instead of Prepare ()
+	boolean Attach (CZ80Computer *pComputer);
+
+	// call this after the machine has stopped, returns JOB_STATUS_*
+	int Complete (CZ80Computer *pComputer);
+
+private:
+	enum TStatementType
+	{
+		StatementPut,
+		StatementGet
+	};
+
+	struct TStatement
+	{
+		TStatementType	Type;
+		unsigned	nDrive;
+		const char	*pCPMName;
+		const char	*pHostName;
+	};
+
+	boolean ParseLine (char *pLine, unsigned nLine);
+	boolean ParseFileName (char *pName, TStatement *pStatement);
+
+	boolean OpenConsole (boolean bReboot, int *pInputFile, int *pOutputFile) const;
+	boolean PutFiles (CZ80Computer *pComputer);
+	boolean HasPutStatements (void) const;
+
+	boolean WriteCommands (int nFile, boolean bReboot) const;	// with Ctrl-C first
+
+private:
+	const char *m_pFileName;
+	char *m_pText;			// of the job description, holds the strings
+
+	TStatement *m_pStatement;
+	unsigned m_nStatements;
+
+	char *m_pCommands;		// the command lines, terminated with '\n'
+	unsigned m_nCommandsLength;
+
+	u64 m_nCycleLimit;
+	const char *m_pOutputFile;
+	char *m_pDefaultOutputFile;
+};
+
+#endif
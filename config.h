@@ -26,16 +26,24 @@
 // Files
 #define SYSTEM_FILENAME		"system.bin"		// CP/M binary (system)
 #define DISK_A_FILENAME		"cpmdisk.bin"		// CP/M disk image A:
-#define DISK_B_FILENAME		"cpmdisk2.bin"		// CP/M disk image B:
+#define DISK_FILENAME_PREFIX	"cpmdisk"		// B: to P: are "cpmdisk2.bin" to
+#define DISK_FILENAME_SUFFIX	".bin"			//	"cpmdisk16.bin"
 
-// Disk image
+// Disk drives
+#define DISK_DRIVES		16			// A: to P:
+#define DISK_MAX_DATA_SIZE	(8*1024*1024)		// CP/M 2.2 limit (without reserved tracks)
+#define DISK_DELTA_CHUNK	64			// sectors, overlay disks grow by this
+
+// Disk image (default geometry, if the image has no label, see disklabel.h)
 #define SECTOR_SIZE		128			// CP/M sector size
 #define TRACK_COUNT		80			// Number of tracks
 #define SECTORS_PER_TRACK	80			// Total sectors per track
+#define RESERVED_TRACKS		2			// Tracks before the directory
+#define BLOCK_SIZE		2048			// Allocation block size
+#define DIRECTORY_ENTRIES	128			// Number of directory entries
 
-#define TRACK_SIZE		(SECTOR_SIZE * SECTORS_PER_TRACK)
-#define SECTOR_COUNT		(TRACK_COUNT * SECTORS_PER_TRACK)
-#define DISK_SIZE		(SECTOR_SIZE * SECTOR_COUNT)
+// Console
+#define CONSOLE_INPUT_SIZE	4096			// input buffer, power of 2
 
 // System load addresses
 #define MEM_CCP			0xDC00
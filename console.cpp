@@ -28,20 +28,23 @@
 	#include <circle/cputhrottle.h>
 	#include <circle/logger.h>
 	#include <circle/string.h>
+	#include <circle/timer.h>
 	#include <circle/util.h>
 #else
 	#include <stdio.h>
 	#include <string.h>
 	#include <unistd.h>
+	#include <errno.h>
+	#include <time.h>
 	#include <sys/time.h>
 	#include <sys/types.h>
 #endif
 
 #ifdef __circle__
 static const char FromConsole[] = "console";
-#endif
 
 CConsole *CConsole::s_pThis = 0;
+#endif
 
 CConsole::CConsole (void)
 :
@@ -49,11 +52,29 @@ CConsole::CConsole (void)
 	m_pKeyboard (0),
 	m_pScreen (0),
 	m_ucLEDStatus (0xFF),
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_ScreenQueue (CONSOLE_SCREEN_QUEUE),
+	m_bScreenStop (FALSE),
+	m_bScreenStopped (FALSE),
+#endif
+#else
+	m_nInputFile (0),
+	m_nOutputFile (1),
+	m_bBatchMode (FALSE),
+	m_bInputReleased (FALSE),
+	m_bEndOfInput (FALSE),
 #endif
 	m_bInited (FALSE),
-	m_ucCharBuf (0)
+	m_InputBuffer (CONSOLE_INPUT_SIZE),
+#ifndef __circle__
+	m_nLastPollTicks (0),
+#endif
+	m_nOutputCount (0),
+	m_nOutputTicks (0)
 {
+#ifdef __circle__
 	s_pThis = this;
+#endif
 }
 
 CConsole::~CConsole (void)
@@ -61,14 +82,57 @@ CConsole::~CConsole (void)
 #ifndef __circle__
 	if (m_bInited)
 	{
-		ioctl (0, TCSETAF, &m_SaveTTY);
+		Flush ();
+
+		if (!m_bBatchMode)
+		{
+			ioctl (m_nInputFile, TCSETAF, &m_SaveTTY);
+		}
 		m_bInited = FALSE;
 	}
-#endif
 
+	// files set with SetFiles () belong to us
+	if (m_nInputFile != 0)
+	{
+		close (m_nInputFile);
+	}
+	if (m_nOutputFile != 1)
+	{
+		close (m_nOutputFile);
+	}
+#else
 	s_pThis = 0;
+#endif
 }
 
+#ifndef __circle__
+
+void CConsole::SetFiles (int nInputFile, int nOutputFile)
+{
+	if (m_bInited)
+	{
+		assert (m_bBatchMode);
+		assert (m_InputBuffer.IsEmpty ());
+
+		if (m_nInputFile != 0)
+		{
+			close (m_nInputFile);
+		}
+		if (m_nOutputFile != 1)
+		{
+			close (m_nOutputFile);
+		}
+
+		m_bInputReleased = FALSE;
+		m_bEndOfInput = FALSE;
+	}
+
+	m_nInputFile = nInputFile;
+	m_nOutputFile = nOutputFile;
+}
+
+#endif
+
 boolean CConsole::Initialize (void)
 {
 	assert (!m_bInited);
@@ -98,7 +162,16 @@ boolean CConsole::Initialize (void)
 	const char InitString[] = "\x1b[H\x1b[J\x1b[1;24r";
 	m_pScreen->Write (InitString, sizeof InitString-1);
 #else
-	if (ioctl (0, TCGETA, &m_SaveTTY) < 0)
+	if (!isatty (m_nInputFile))
+	{
+		// input comes from a file or pipe, see GetStatus ()
+		m_bBatchMode = TRUE;
+		m_bInited = TRUE;
+
+		return TRUE;
+	}
+
+	if (ioctl (m_nInputFile, TCGETA, &m_SaveTTY) < 0)
 	{
 		fprintf (stderr, "Not a tty\n");
 
@@ -114,7 +187,7 @@ boolean CConsole::Initialize (void)
 	NewTTY.c_cc[VMIN] = 1;
 	NewTTY.c_cc[VTIME] = 0;
 
-	if (ioctl (0, TCSETAF, &NewTTY) < 0)
+	if (ioctl (m_nInputFile, TCSETAF, &NewTTY) < 0)
 	{
 		fprintf (stderr, "Cannot put tty into raw mode\n");
 
@@ -131,12 +204,77 @@ void CConsole::PutChar (u8 ucChar)
 {
 	assert (m_bInited);
 
+	if (m_nOutputCount == 0)
+	{
+		m_nOutputTicks = GetTicks ();
+	}
+
+	assert (m_nOutputCount < CONSOLE_OUTPUT_SIZE);
+	m_OutputBuffer[m_nOutputCount++] = ucChar;
+
+	if (m_nOutputCount == CONSOLE_OUTPUT_SIZE)
+	{
+		Flush ();
+	}
+}
+
+void CConsole::Flush (void)
+{
+	if (m_nOutputCount == 0)
+	{
+		return;
+	}
+
 #ifdef __circle__
+#ifdef ARM_ALLOW_MULTI_CORE
+	// Scrolling the screen is expensive, so it is written on core 2 (see
+	// RunScreen ()). We have to wait here only, if the queue is full.
+	const u8 *pBuffer = m_OutputBuffer;
+	unsigned nCount = m_nOutputCount;
+	while (nCount > 0)
+	{
+		unsigned nBytesPut = m_ScreenQueue.Put (pBuffer, nCount);
+
+		pBuffer += nBytesPut;
+		nCount -= nBytesPut;
+	}
+#else
 	assert (m_pScreen != 0);
-	m_pScreen->Write (&ucChar, sizeof ucChar);
+	m_pScreen->Write (m_OutputBuffer, m_nOutputCount);
+#endif
 #else
-	write (1, &ucChar, sizeof ucChar);
+	const u8 *pBuffer = m_OutputBuffer;
+	unsigned nCount = m_nOutputCount;
+	while (nCount > 0)
+	{
+		ssize_t nBytesWritten = write (m_nOutputFile, pBuffer, nCount);
+		if (nBytesWritten < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			fprintf (stderr, "write returned %d\n", (int) nBytesWritten);
+
+			break;
+		}
+
+		pBuffer += nBytesWritten;
+		nCount -= nBytesWritten;
+	}
 #endif
+
+	m_nOutputCount = 0;
+}
+
+void CConsole::Update (void)
+{
+	if (   m_nOutputCount > 0
+	    && GetTicks () - m_nOutputTicks >= CONSOLE_FLUSH_DELAY)
+	{
+		Flush ();
+	}
 }
 
 boolean CConsole::GetStatus (void)
@@ -144,19 +282,38 @@ boolean CConsole::GetStatus (void)
 	assert (m_bInited);
 
 #ifdef __circle__
-	return m_ucCharBuf == 0 ? FALSE : TRUE;
+	return !m_InputBuffer.IsEmpty ();
 #else
-	if (m_ucCharBuf == 0)
+	if (m_bBatchMode)
+	{
+		// Input from a file is always available. If it would be reported
+		// here, programs, which check for a key to abort (e.g. TYPE),
+		// would take the following commands. Instead it is released, when
+		// the program reads a character or waits for one in a loop
+		// (WaitForInput () is called by the idle detection then).
+		return m_bInputReleased && !m_InputBuffer.IsEmpty ();
+	}
+
+	if (m_InputBuffer.IsEmpty ())
 	{
+		// programs poll the status after each output character (e.g. the
+		// BDOS for Ctrl-S), a system call each time would limit the output
+		unsigned nTicks = GetTicks ();
+		if (nTicks - m_nLastPollTicks < CONSOLE_POLL_INTERVAL)
+		{
+			return FALSE;
+		}
+		m_nLastPollTicks = nTicks;
+
 		fd_set Fds;
 		FD_ZERO (&Fds);
-		FD_SET (0, &Fds);
+		FD_SET (m_nInputFile, &Fds);
 
 		struct timeval Timeout;
 		Timeout.tv_sec = 0;
-		Timeout.tv_usec = 100;
+		Timeout.tv_usec = 0;
 
-		int nResult = select (1, &Fds, 0, 0, &Timeout);
+		int nResult = select (m_nInputFile+1, &Fds, 0, 0, &Timeout);
 		if (nResult < 0)
 		{
 			fprintf (stderr, "select returned %d\n", nResult);
@@ -164,23 +321,11 @@ boolean CConsole::GetStatus (void)
 			return FALSE;
 		}
 
-		if (nResult == 0)		// timeout
+		if (   nResult == 0		// timeout
+		    || !ReadInput ())
 		{
 			return FALSE;
 		}
-
-		u8 ucCharBuf;
-		ssize_t nBytesRead = read (0, &ucCharBuf, sizeof ucCharBuf);
-		if (nBytesRead <= 0)
-		{
-			fprintf (stderr, "read returned %d\n", (int) nBytesRead);
-
-			m_ucCharBuf = 0;
-
-			return FALSE;
-		}
-
-		m_ucCharBuf = ucCharBuf;
 	}
 
 	return TRUE;
@@ -192,51 +337,192 @@ u8 CConsole::GetChar (void)
 	assert (m_bInited);
 
 #ifdef __circle__
-	if (m_ucCharBuf == 0)
+	WaitForInput ();
+#else
+	if (m_InputBuffer.IsEmpty ())
 	{
-		TCPUSpeed PreviousSpeed = CCPUThrottle::Get ()->SetSpeed (CPUSpeedLow);
+		Flush ();
 
-		while (m_ucCharBuf == 0)
+		while (!ReadInput ())
 		{
-			// just wait for key
-
-			SetLEDs ();
+			if (m_bEndOfInput)
+			{
+				return '\x1a';		// CP/M end of file
+			}
 		}
+	}
 
-		if (PreviousSpeed != CPUSpeedUnknown)
-		{
-			CCPUThrottle::Get ()->SetSpeed (PreviousSpeed);
-		}
+	m_bInputReleased = FALSE;
+#endif
+
+	u8 ucResult = m_InputBuffer.Get ();
+
+	if (ucResult == '\n')
+	{
+		ucResult = '\r';
 	}
-#else
-	if (m_ucCharBuf == 0)
+
+	if (ucResult == '\x7f')
 	{
-		ssize_t nBytesRead;
-		u8 ucCharBuf;
-		while ((nBytesRead = read (0, &ucCharBuf, sizeof ucCharBuf)) <= 0)
+		ucResult = '\b';
+	}
+
+	return ucResult;
+}
+
+void CConsole::WaitForInput (void)
+{
+	assert (m_bInited);
+
+#ifndef __circle__
+	if (m_bBatchMode)
+	{
+		if (m_InputBuffer.IsEmpty ())
 		{
-			fprintf (stderr, "read returned %d\n", (int) nBytesRead);
+			Flush ();
+
+			if (!ReadInput ())
+			{
+				return;
+			}
 		}
 
-		m_ucCharBuf = ucCharBuf;
+		m_bInputReleased = TRUE;
+
+		return;
+	}
+#endif
+
+	if (!m_InputBuffer.IsEmpty ())
+	{
+		return;
 	}
 
+	Flush ();
+
+#ifdef __circle__
+	TCPUSpeed PreviousSpeed = CCPUThrottle::Get ()->SetSpeed (CPUSpeedLow);
+
+	while (m_InputBuffer.IsEmpty ())
+	{
+		// just wait for key
+
+		SetLEDs ();
+	}
+
+	if (PreviousSpeed != CPUSpeedUnknown)
+	{
+		CCPUThrottle::Get ()->SetSpeed (PreviousSpeed);
+	}
+#else
+	fd_set Fds;
+	FD_ZERO (&Fds);
+	FD_SET (m_nInputFile, &Fds);
+
+	int nResult = select (m_nInputFile+1, &Fds, 0, 0, 0);
+	if (nResult < 0)
+	{
+		fprintf (stderr, "select returned %d\n", nResult);
+	}
 #endif
+}
 
-	u8 ucResult = m_ucCharBuf;
-	m_ucCharBuf = 0;
+unsigned CConsole::GetInputHighWater (void) const
+{
+	return m_InputBuffer.GetHighWater ();
+}
 
-	if (ucResult == '\n')
+#ifndef __circle__
+
+boolean CConsole::IsBatchMode (void) const
+{
+	return m_bBatchMode;
+}
+
+boolean CConsole::IsEndOfInput (void) const
+{
+	return m_bEndOfInput;
+}
+
+boolean CConsole::IsInputReady (void)
+{
+	assert (m_bInited);
+
+	if (   !m_InputBuffer.IsEmpty ()
+	    || m_bEndOfInput)
 	{
-		ucResult = '\r';
+		return TRUE;
 	}
 
-	if (ucResult == '\x7f')
+	fd_set Fds;
+	FD_ZERO (&Fds);
+	FD_SET (m_nInputFile, &Fds);
+
+	struct timeval Timeout;
+	Timeout.tv_sec = 0;
+	Timeout.tv_usec = 0;
+
+	return select (m_nInputFile+1, &Fds, 0, 0, &Timeout) != 0;	// an error is reported later
+}
+
+int CConsole::GetInputFile (void) const
+{
+	return m_nInputFile;
+}
+
+const u8 *CConsole::GetPendingOutput (unsigned *pCount) const
+{
+	assert (pCount != 0);
+	*pCount = m_nOutputCount;
+
+	return m_OutputBuffer;
+}
+
+// reads all available bytes, which fit into the input buffer (blocks if none)
+boolean CConsole::ReadInput (void)
+{
+	u8 Buffer[CONSOLE_INPUT_SIZE];
+	unsigned nFree = m_InputBuffer.GetFree ();
+	if (nFree == 0)
 	{
-		ucResult = '\b';
+		return TRUE;
 	}
 
-	return ucResult;
+	ssize_t nBytesRead = read (m_nInputFile, Buffer, nFree);
+	if (nBytesRead <= 0)
+	{
+		if (   nBytesRead == 0
+		    && m_bBatchMode)
+		{
+			m_bEndOfInput = TRUE;
+
+			return FALSE;
+		}
+
+		fprintf (stderr, "read returned %d\n", (int) nBytesRead);
+
+		return FALSE;
+	}
+
+	unsigned nBytesPut = m_InputBuffer.Put (Buffer, nBytesRead);
+	assert (nBytesPut == (unsigned) nBytesRead);
+	(void) nBytesPut;
+
+	return TRUE;
+}
+
+#endif
+
+unsigned CConsole::GetTicks (void)
+{
+#ifdef __circle__
+	return CTimer::Get ()->GetClockTicks ();
+#else
+	struct timespec Time;
+	clock_gettime (CLOCK_MONOTONIC, &Time);
+
+	return Time.tv_sec * 1000000 + Time.tv_nsec / 1000;
+#endif
 }
 
 #ifdef __circle__
@@ -255,13 +541,54 @@ void CConsole::SetLEDs (void)
 	}
 }
 
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CConsole::RunScreen (void)
+{
+	assert (m_pScreen != 0);
+
+	// all queued output since the last write is written at once
+	u8 Buffer[CONSOLE_OUTPUT_SIZE];
+	while (   !m_bScreenStop
+	       || !m_ScreenQueue.IsEmpty ())
+	{
+		unsigned nCount = m_ScreenQueue.Get (Buffer, sizeof Buffer);
+		if (nCount > 0)
+		{
+			m_pScreen->Write (Buffer, nCount);
+		}
+		else
+		{
+			CTimer::SimpleusDelay (1000);
+		}
+	}
+
+	m_bScreenStopped = TRUE;
+}
+
+void CConsole::StopScreen (void)
+{
+	Flush ();
+
+	m_bScreenStop = TRUE;
+
+	while (!m_bScreenStopped)
+	{
+		// just wait
+	}
+}
+
+#endif
+
 void CConsole::KeyPressedHandler (const char *pString)
 {
 	assert (s_pThis != 0);
 
-	if (s_pThis->m_ucCharBuf == 0)
+	// keys with escape sequences are only taken completely
+	unsigned nLength = strlen (pString);
+	if (nLength <= s_pThis->m_InputBuffer.GetFree ())
 	{
-		s_pThis->m_ucCharBuf = pString[0];
+		s_pThis->m_InputBuffer.Put ((const u8 *) pString, nLength);
 	}
 }
 
@@ -23,33 +23,84 @@
 #ifndef _console_h
 #define _console_h
 
+#include "ringbuffer.h"
+#include "config.h"
 #include "types.h"
 
 #ifdef __circle__
 	#include <circle/usb/usbkeyboard.h>
 	#include <circle/screen.h>
+	#include <circle/sysconfig.h>
 #else
 	#include <sys/ioctl.h>
 	#include <termios.h>
 #endif
 
+#define CONSOLE_OUTPUT_SIZE	4096		// bytes buffered before output
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+#define CONSOLE_SCREEN_QUEUE	0x10000		// bytes queued for core 2, power of 2
+#define CONSOLE_FLUSH_DELAY	0		// flushing to the queue is cheap
+#else
+#define CONSOLE_FLUSH_DELAY	10000		// max. microseconds output is delayed
+#endif
+#ifndef __circle__
+#define CONSOLE_POLL_INTERVAL	1000		// min. microseconds between polls of stdin
+#endif
+
 class CConsole
 {
 public:
 	CConsole (void);
 	~CConsole (void);
 
+#ifndef __circle__
+	// call this before Initialize (), stdin and stdout are used by default,
+	// the files are closed in the destructor, they must be below FD_SETSIZE.
+	// In batch mode the files can be replaced later, when the input buffer
+	// is empty, the output, which has not been flushed yet, goes to the new file.
+	void SetFiles (int nInputFile, int nOutputFile);
+#endif
+
 	boolean Initialize (void);
 
 	void PutChar (u8 ucChar);
+	void Flush (void);		// writes the buffered output
+	void Update (void);		// call this periodically, flushes output after a delay
 
 	boolean GetStatus (void);	// returns TRUE if character is available
 	u8 GetChar (void);
 
+	void WaitForInput (void);	// returns when a character is available
+
+	unsigned GetInputHighWater (void) const;	// max. bytes in the input buffer
+
+#ifndef __circle__
+	boolean IsBatchMode (void) const;	// stdin is not a tty
+	boolean IsEndOfInput (void) const;	// the program waits for input after EOF
+
+	// WaitForInput () would not block, input or the end of input is there
+	boolean IsInputReady (void);
+	int GetInputFile (void) const;
+
+	// the output, which has not been flushed yet, for a machine snapshot
+	const u8 *GetPendingOutput (unsigned *pCount) const;
+#endif
+
 #ifdef __circle__
 	void SetLEDs (void);
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	void RunScreen (void);		// runs on core 2, returns after StopScreen ()
+	void StopScreen (void);		// returns when all output has been displayed
+#endif
+#endif
+
 private:
+	static unsigned GetTicks (void);	// in microseconds, wraps around
+#ifndef __circle__
+	boolean ReadInput (void);
+#endif
+#ifdef __circle__
 	static void KeyPressedHandler (const char *pString);
 #endif
 
@@ -59,13 +110,35 @@ private:
 	CScreenDevice *m_pScreen;
 
 	u8 m_ucLEDStatus;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	CRingBuffer m_ScreenQueue;		// filled by Flush (), emptied by RunScreen ()
+	volatile boolean m_bScreenStop;
+	volatile boolean m_bScreenStopped;
+#endif
 #else
+	int m_nInputFile;
+	int m_nOutputFile;
+
 	struct termio m_SaveTTY;
+
+	boolean m_bBatchMode;
+	boolean m_bInputReleased;		// the program waits for input
+	boolean m_bEndOfInput;
 #endif
 	boolean m_bInited;
-	volatile u8 m_ucCharBuf;
+	CRingBuffer m_InputBuffer;		// filled by KeyPressedHandler () on Circle
+#ifndef __circle__
+	unsigned m_nLastPollTicks;
+#endif
 
-	static CConsole *s_pThis;
+	u8 m_OutputBuffer[CONSOLE_OUTPUT_SIZE];
+	unsigned m_nOutputCount;
+	unsigned m_nOutputTicks;		// when the first buffered byte was written
+
+#ifdef __circle__
+	static CConsole *s_pThis;		// for KeyPressedHandler (), which has no context
+#endif
 };
 
 #endif
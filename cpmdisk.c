@@ -28,9 +28,13 @@
 #include <unistd.h>
 #include <ctype.h>
 #include <assert.h>
+#include "disklabel.h"
 
 #define SECTOR_SIZE	128		// logical sector size of CP/M
 
+#define MAX_DATA_SIZE	(8*1024*1024)	// CP/M 2.2 limit of a disk (without reserved tracks)
+#define MAX_FILE_SIZE	(8*1024*1024)	// CP/M 2.2 limit of a file
+
 #define FORMAT_BYTE	0xE5
 
 #define PACKED		__attribute__ ((packed))
@@ -52,7 +56,6 @@ static struct
 	unsigned nReservedTracks;
 	unsigned nSectorsPerTrack;	// 128 byte sectors
 	unsigned nBlockSize;		// byte size of an allocation block
-	unsigned nExtendSize;		// byte size of an extend
 	unsigned nDirectoryEntries;	// number of entries
 
 	// calculated
@@ -60,11 +63,13 @@ static struct
 	unsigned nTotalSectors;		// including reserved sectors
 	unsigned nTotalBlocks;		// without reserved sectors
 	unsigned nSectorsPerBlock;
+	unsigned nExtendSize;		// byte size of an extend (directory entry)
+	unsigned nExtentMask;		// logical 16K extends per extend - 1 (EXM)
 	unsigned nSectorsPerExtend;
 	unsigned nBlocksPerExtend;
 	unsigned nDirectoryBlocks;
 }
-DiskParam = {80, 2, 80, 2*1024, 16*1024, 128};
+DiskParam = {80, 2, 80, 2*1024, 128};
 
 // directory entry
 
@@ -79,10 +84,10 @@ typedef struct
 	unsigned char	UserNumber;			// == 0xE5 for free entry
 	unsigned char	FileName[FILENAME_LEN];		// padded with ' '
 	unsigned char	Extension[EXTENSION_LEN];	// padded with ' '
-	unsigned char	Extend;
+	unsigned char	Extend;				// logical extend number % 32
 	unsigned char	Reserved1;			// set to 0
-	unsigned char	Reserved2;			// set to 0, TODO: may be high byte of sector count
-	unsigned char	SectorCount;			// sectors in this extend
+	unsigned char	Module;				// logical extend number / 32
+	unsigned char	SectorCount;			// sectors in the last logical extend
 
 	union
 	{
@@ -109,9 +114,12 @@ static const char Usage[] =
 	"-r reserved_tracks\tNumber of reserved tracks\t\t2\n"
 	"-s sectors_per_track\tNumber of 128-byte sectors per track\t80\n"
 	"-b block_size\t\tSize of an allocation block in Kbyte\t2\n"
-	"-e extend_size\t\tSize of an extend in Kbyte\t\t16\n"
 	"-d directory_entries\tMaximum number of directory entries\t128\n"
 	"-u user\t\t\tCP/M user number\t\t\t0\n"
+	"\n"
+	"The options -t, -r, -s, -b and -d are used by \"init\", which writes them into a\n"
+	"label in the first reserved track. The other commands read them from there.\n"
+	"A disk can hold up to 8 Mbyte (without the reserved tracks).\n"
 };
 
 static unsigned GetOptionNumber (int nArgC, char **ppArgV,
@@ -199,6 +207,54 @@ static int ConvertFileName (const char *pName, char *pCPMName)		// returns 0 on
 	return 1;
 }
 
+// CP/M 2.2 numbers logical extends of 16K (128 sectors). An extend (directory
+// entry) holds nExtentMask+1 of them and has the number of the last one.
+
+static unsigned GetExtend (const TDirectoryEntry *pEntry)
+{
+	unsigned nLogicalExtend = (pEntry->Module & 0x3F) * 32 + (pEntry->Extend & 0x1F);
+
+	return nLogicalExtend / (DiskParam.nExtentMask+1);
+}
+
+static unsigned GetSectorCount (const TDirectoryEntry *pEntry)
+{
+	return (pEntry->Extend & DiskParam.nExtentMask) * 128 + pEntry->SectorCount;
+}
+
+static void SetExtend (TDirectoryEntry *pEntry, unsigned nExtend, unsigned nSectors)
+{
+	assert (0 < nSectors && nSectors <= DiskParam.nSectorsPerExtend);
+	unsigned nLastExtend = (nSectors-1) / 128;		// within this extend
+
+	unsigned nLogicalExtend = nExtend * (DiskParam.nExtentMask+1) + nLastExtend;
+	pEntry->Extend      = (unsigned char) (nLogicalExtend % 32);
+	pEntry->Module      = (unsigned char) (nLogicalExtend / 32);
+	pEntry->SectorCount = (unsigned char) (nSectors - nLastExtend * 128);
+}
+
+static void ReadDiskLabel (void)
+{
+	FILE *pInFile = fopen (ToolParam.pDiskFileName, "r");
+	if (pInFile == NULL)
+	{
+		return;			// reported by the command
+	}
+
+	TDiskLabel Label;
+	if (   fread (&Label, sizeof Label, 1, pInFile) == 1
+	    && memcmp (Label.Magic, DISK_LABEL_MAGIC, sizeof Label.Magic) == 0)
+	{
+		DiskParam.nTracks           = Label.nTracks;
+		DiskParam.nReservedTracks   = Label.nReservedTracks;
+		DiskParam.nSectorsPerTrack  = Label.nSectorsPerTrack;
+		DiskParam.nBlockSize        = Label.nBlockSize;
+		DiskParam.nDirectoryEntries = Label.nDirectoryEntries;
+	}
+
+	fclose (pInFile);
+}
+
 static int DoInit (int nArgC, char **ppArgV, const char *pArg0)
 {
 	if (nArgC > 0)
@@ -228,15 +284,26 @@ static int DoInit (int nArgC, char **ppArgV, const char *pArg0)
 		return 1;
 	}
 
-	// write entire disk file with 0xE5
+	// write entire disk file with 0xE5, the first sector holds the label
 
 	unsigned char SectorBuffer[SECTOR_SIZE];
 	memset (SectorBuffer, FORMAT_BYTE, sizeof SectorBuffer);
 
+	unsigned char LabelBuffer[SECTOR_SIZE];
+	memset (LabelBuffer, FORMAT_BYTE, sizeof LabelBuffer);
+
+	TDiskLabel *pLabel = (TDiskLabel *) LabelBuffer;
+	memcpy (pLabel->Magic, DISK_LABEL_MAGIC, sizeof pLabel->Magic);
+	pLabel->nTracks           = DiskParam.nTracks;
+	pLabel->nSectorsPerTrack  = DiskParam.nSectorsPerTrack;
+	pLabel->nReservedTracks   = DiskParam.nReservedTracks;
+	pLabel->nBlockSize        = DiskParam.nBlockSize;
+	pLabel->nDirectoryEntries = DiskParam.nDirectoryEntries;
+
 	unsigned nSector;
 	for (nSector = 0; nSector < DiskParam.nTotalSectors; nSector++)
 	{
-		if (fwrite (SectorBuffer, sizeof SectorBuffer, 1, pOutFile) != 1)
+		if (fwrite (nSector == 0 ? LabelBuffer : SectorBuffer, SECTOR_SIZE, 1, pOutFile) != 1)
 		{
 			fprintf (stderr, "%s: Write error: %s\n", pArg0, ToolParam.pDiskFileName);
 
@@ -297,7 +364,7 @@ static int DoDir (int nArgC, char **ppArgV, const char *pArg0)
 		}
 
 		if (   Entry.UserNumber != ToolParam.nUserNumber
-		    || Entry.Extend != 0)
+		    || GetExtend (&Entry) != 0)
 		{
 			continue;
 		}
@@ -413,7 +480,7 @@ static int DoRead (int nArgC, char **ppArgV, const char *pArg0)
 		}
 
 		TDirectoryEntry *pEntry = NULL;		// current extend entry in directory
-		unsigned char nExtend = 0;		// current extend number
+		unsigned nExtend = 0;			// current extend number
 		FILE *pOutFile = NULL;			// != NULL if open
 
 		// allocate block buffer
@@ -431,7 +498,7 @@ static int DoRead (int nArgC, char **ppArgV, const char *pArg0)
 				pEntry = pDirectory + nEntry;
 
 				if (   pEntry->UserNumber == ToolParam.nUserNumber
-				    && pEntry->Extend == nExtend
+				    && GetExtend (pEntry) == nExtend
 				    && memcmp (pEntry->FileName, CPMFileName, sizeof CPMFileName) == 0)
 				{
 					break;
@@ -464,10 +531,10 @@ static int DoRead (int nArgC, char **ppArgV, const char *pArg0)
 
 			// calculate sector and block count in this extend
 
-			assert (pEntry->SectorCount > 0);
-			unsigned nSectorsLeft = pEntry->SectorCount;
+			unsigned nSectorsLeft = GetSectorCount (pEntry);
+			assert (nSectorsLeft > 0);
 
-			unsigned nBlockCount =   (pEntry->SectorCount+DiskParam.nSectorsPerBlock-1)
+			unsigned nBlockCount =   (nSectorsLeft+DiskParam.nSectorsPerBlock-1)
 					       / DiskParam.nSectorsPerBlock;
 
 			// loop over all data blocks in this extend
@@ -478,9 +545,8 @@ static int DoRead (int nArgC, char **ppArgV, const char *pArg0)
 				// get block number for current block from directory entry for this extend
 
 				unsigned nBlockNumber;
-				if (DiskParam.nTotalBlocks <= 255)	// TODO: 256 (?)
+				if (DiskParam.nTotalBlocks <= 256)	// DSM < 256
 				{
-					// TODO: has not been tested
 					assert (nBlock < BLOCKCOUNT_BYTE);
 					nBlockNumber = pEntry->BlockNumber.Byte[nBlock];
 				}
@@ -559,7 +625,7 @@ static int DoRead (int nArgC, char **ppArgV, const char *pArg0)
 
 			nExtend++;
 		}
-		while (pEntry->SectorCount == DiskParam.nSectorsPerExtend);
+		while (GetSectorCount (pEntry) == DiskParam.nSectorsPerExtend);
 
 		free (pBlockBuffer);
 
@@ -656,9 +722,8 @@ static int DoWrite (int nArgC, char **ppArgV, const char *pArg0)
 		{
 			// entry is valid extend: mark blocks in this extend as allocated
 
-			if (DiskParam.nTotalBlocks <= 255)	// TODO: 256 (?)
+			if (DiskParam.nTotalBlocks <= 256)	// DSM < 256
 			{
-				// TODO: has not been tested
 				unsigned i;
 				for (i = 0; i < BLOCKCOUNT_BYTE; i++)
 				{
@@ -785,7 +850,7 @@ static int DoWrite (int nArgC, char **ppArgV, const char *pArg0)
 			return 1;
 		}
 
-		if (nExtends > 256)
+		if (Stat.st_size > MAX_FILE_SIZE)
 		{
 			fprintf (stderr, "%s: File too big: %s\n", pArg0, pFileName);
 
@@ -839,12 +904,11 @@ static int DoWrite (int nArgC, char **ppArgV, const char *pArg0)
 
 			pEntry->UserNumber = ToolParam.nUserNumber;
 			memcpy (pEntry->FileName, CPMFileName, sizeof CPMFileName);
-			pEntry->Extend = (unsigned char) nExtend;
 
 			unsigned nSectorsLeft = (nBytesLeft + SECTOR_SIZE-1) / SECTOR_SIZE;
-			pEntry->SectorCount =   nSectorsLeft >= DiskParam.nSectorsPerExtend
-					      ? DiskParam.nSectorsPerExtend
-					      : nSectorsLeft;
+			SetExtend (pEntry, nExtend,   nSectorsLeft >= DiskParam.nSectorsPerExtend
+						    ? DiskParam.nSectorsPerExtend
+						    : nSectorsLeft);
 
 			// calculate number of data blocks in this extend
 
@@ -885,7 +949,7 @@ static int DoWrite (int nArgC, char **ppArgV, const char *pArg0)
 
 				// put block number of this new block into directory entry
 
-				if (DiskParam.nTotalBlocks <= 255)	// TODO: 256 (?)
+				if (DiskParam.nTotalBlocks <= 256)	// DSM < 256
 				{
 					assert (nFreeBlock <= 255);
 					assert (nBlock < BLOCKCOUNT_BYTE);
@@ -1182,27 +1246,23 @@ int main (int nArgC, char **ppArgV)
 			break;
 
 		case 't':
-			DiskParam.nTracks = GetOptionNumber (nArgC--, ppArgV++, 20, 160, pArg0, pOption);
+			DiskParam.nTracks = GetOptionNumber (nArgC--, ppArgV++, 2, 65535, pArg0, pOption);
 			break;
 
 		case 'r':
-			DiskParam.nReservedTracks = GetOptionNumber (nArgC--, ppArgV++, 0, 20, pArg0, pOption);
+			DiskParam.nReservedTracks = GetOptionNumber (nArgC--, ppArgV++, 1, 20, pArg0, pOption);
 			break;
 
 		case 's':
-			DiskParam.nSectorsPerTrack = GetOptionNumber (nArgC--, ppArgV++, 8, 160, pArg0, pOption);
+			DiskParam.nSectorsPerTrack = GetOptionNumber (nArgC--, ppArgV++, 8, 255, pArg0, pOption);
 			break;
 
 		case 'b':
 			DiskParam.nBlockSize = 1024 * GetOptionNumber (nArgC--, ppArgV++, 1, 16, pArg0, pOption);
 			break;
 
-		case 'e':
-			DiskParam.nExtendSize = 1024 * GetOptionNumber (nArgC--, ppArgV++, 8, 256, pArg0, pOption);
-			break;
-
 		case 'd':
-			DiskParam.nDirectoryEntries = GetOptionNumber (nArgC--, ppArgV++, 32, 2048, pArg0, pOption);
+			DiskParam.nDirectoryEntries = GetOptionNumber (nArgC--, ppArgV++, 32, 8192, pArg0, pOption);
 			break;
 
 		case 'u':
@@ -1215,6 +1275,11 @@ int main (int nArgC, char **ppArgV)
 		}
 	}
 
+	if (strcmp (pCmd, "init") != 0)
+	{
+		ReadDiskLabel ();
+	}
+
 	// calculate disk parameters
 
 	DiskParam.nReservedBytes    = DiskParam.nReservedTracks * DiskParam.nSectorsPerTrack * SECTOR_SIZE;
@@ -1227,6 +1292,11 @@ int main (int nArgC, char **ppArgV)
 
 	DiskParam.nSectorsPerBlock  = DiskParam.nBlockSize / SECTOR_SIZE;
 
+	DiskParam.nExtendSize       =   (DiskParam.nTotalBlocks <= 256 ? BLOCKCOUNT_BYTE : BLOCKCOUNT_WORD)
+				      * DiskParam.nBlockSize;
+
+	DiskParam.nExtentMask       = DiskParam.nExtendSize / (16*1024) - 1;
+
 	DiskParam.nSectorsPerExtend = DiskParam.nExtendSize / SECTOR_SIZE;
 
 	DiskParam.nBlocksPerExtend  = DiskParam.nExtendSize / DiskParam.nBlockSize;
@@ -1235,6 +1305,20 @@ int main (int nArgC, char **ppArgV)
 					 + DiskParam.nBlockSize-1)
 				      / DiskParam.nBlockSize;
 
+	// check the limits of CP/M 2.2
+
+	if (   DiskParam.nReservedTracks >= DiskParam.nTracks
+	    || (DiskParam.nBlockSize & (DiskParam.nBlockSize-1)) != 0
+	    || DiskParam.nTotalSectors - DiskParam.nReservedBytes / SECTOR_SIZE > MAX_DATA_SIZE / SECTOR_SIZE
+	    || (DiskParam.nBlockSize == 1024 && DiskParam.nTotalBlocks > 256)
+	    || DiskParam.nDirectoryBlocks > 16
+	    || DiskParam.nDirectoryBlocks >= DiskParam.nTotalBlocks)
+	{
+		fprintf (stderr, "%s: Invalid disk geometry\n", pArg0);
+
+		return 1;
+	}
+
 	// run commands
 
 	int nResult = 0;
@@ -0,0 +1,455 @@
+//
+// cpmfs.cpp
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "cpmfs.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#define FORMAT_BYTE		0xE5
+#define MAX_FILE_SIZE		(8*1024*1024)		// CP/M 2.2 limit
+
+CCPMFileSystem::CCPMFileSystem (CRAMDisk *pDisk)
+:	m_pDisk (pDisk),
+	m_pDirectory (0)
+{
+}
+
+CCPMFileSystem::~CCPMFileSystem (void)
+{
+	delete [] m_pDirectory;
+	m_pDirectory = 0;
+
+	m_pDisk = 0;
+}
+
+boolean CCPMFileSystem::Mount (void)
+{
+	assert (m_pDisk != 0);
+	if (!m_pDisk->IsAvailable ())
+	{
+		return FALSE;
+	}
+
+	// the same parameters as in CZ80Ports::GetParameterBlock ()
+	const TDiskGeometry *pGeometry = m_pDisk->GetGeometry ();
+	assert (pGeometry != 0);
+
+	m_nDirectorySector = pGeometry->nReservedTracks * pGeometry->nSectorsPerTrack;
+	m_nDirectoryEntries = pGeometry->nDirectoryEntries;
+	m_nBlockSize = pGeometry->nBlockSize;
+	m_nSectorsPerBlock = m_nBlockSize / SECTOR_SIZE;
+	m_nBlocks =   (pGeometry->nTracks - pGeometry->nReservedTracks)
+		    * pGeometry->nSectorsPerTrack * SECTOR_SIZE / m_nBlockSize;
+	m_nDirectoryBlocks =   (m_nDirectoryEntries * sizeof (TDirectoryEntry) + m_nBlockSize-1)
+			     / m_nBlockSize;
+
+	unsigned nExtendSize = (m_nBlocks <= 256 ? 16 : 8) * m_nBlockSize;
+	m_nExtentMask = nExtendSize / (16*1024) - 1;
+	m_nSectorsPerExtend = nExtendSize / SECTOR_SIZE;
+	m_nBlocksPerExtend = nExtendSize / m_nBlockSize;
+
+	// the directory is read in whole sectors
+	unsigned nDirectorySectors =   (m_nDirectoryEntries * sizeof (TDirectoryEntry) + SECTOR_SIZE-1)
+				     / SECTOR_SIZE;
+
+	assert (m_pDirectory == 0);
+	m_pDirectory = new TDirectoryEntry[nDirectorySectors * SECTOR_SIZE / sizeof (TDirectoryEntry)];
+	assert (m_pDirectory != 0);
+
+	if (!m_pDisk->Read (m_nDirectorySector, nDirectorySectors, m_pDirectory))
+	{
+		delete [] m_pDirectory;
+		m_pDirectory = 0;
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+boolean CCPMFileSystem::WriteFile (const char *pName, const void *pData, unsigned nSize)
+{
+	assert (m_pDirectory != 0);
+
+	u8 CPMName[11];
+	if (!ConvertFileName (pName, CPMName))
+	{
+		fprintf (stderr, "Invalid filename: %s\n", pName);
+
+		return FALSE;
+	}
+
+	if (nSize > MAX_FILE_SIZE)
+	{
+		fprintf (stderr, "File too big: %s\n", pName);
+
+		return FALSE;
+	}
+
+	DeleteFile (CPMName);
+
+	// a block is used, if an entry refers to it, block numbers 0 are unused
+	u8 *pBlockMap = new u8[m_nBlocks];
+	assert (pBlockMap != 0);
+	memset (pBlockMap, 0, m_nBlocks);
+
+	for (unsigned i = 0; i < m_nDirectoryBlocks; i++)
+	{
+		pBlockMap[i] = 1;
+	}
+
+	for (unsigned nEntry = 0; nEntry < m_nDirectoryEntries; nEntry++)
+	{
+		const TDirectoryEntry *pEntry = &m_pDirectory[nEntry];
+		if (pEntry->UserNumber == FORMAT_BYTE)
+		{
+			continue;
+		}
+
+		for (unsigned i = 0; i < m_nBlocksPerExtend; i++)
+		{
+			unsigned nBlock = GetBlock (pEntry, i);
+			if (nBlock < m_nBlocks)
+			{
+				pBlockMap[nBlock] = 1;
+			}
+		}
+	}
+
+	u8 *pBlockBuffer = new u8[m_nBlockSize];
+	assert (pBlockBuffer != 0);
+
+	const u8 *pFrom = (const u8 *) pData;
+	unsigned nSectorsLeft = (nSize + SECTOR_SIZE-1) / SECTOR_SIZE;
+	unsigned nFreeBlock = 0;
+	boolean bResult = TRUE;
+
+	// an empty file has one extend without blocks
+	for (unsigned nExtend = 0; bResult && (nExtend == 0 || nSectorsLeft > 0); nExtend++)
+	{
+		unsigned nEntry;
+		for (nEntry = 0; nEntry < m_nDirectoryEntries; nEntry++)
+		{
+			if (m_pDirectory[nEntry].UserNumber == FORMAT_BYTE)
+			{
+				break;
+			}
+		}
+
+		if (nEntry >= m_nDirectoryEntries)
+		{
+			fprintf (stderr, "Directory full: %s\n", pName);
+
+			bResult = FALSE;
+
+			break;
+		}
+
+		TDirectoryEntry *pEntry = &m_pDirectory[nEntry];
+		memset (pEntry, 0, sizeof *pEntry);
+		memcpy (pEntry->FileName, CPMName, sizeof CPMName);
+
+		unsigned nSectors =   nSectorsLeft < m_nSectorsPerExtend
+				    ? nSectorsLeft : m_nSectorsPerExtend;
+		SetExtend (pEntry, nExtend, nSectors);
+
+		for (unsigned i = 0; nSectors > 0; i++)
+		{
+			while (   nFreeBlock < m_nBlocks
+			       && pBlockMap[nFreeBlock])
+			{
+				nFreeBlock++;
+			}
+
+			if (nFreeBlock >= m_nBlocks)
+			{
+				fprintf (stderr, "Disk full: %s\n", pName);
+
+				bResult = FALSE;
+
+				break;
+			}
+
+			pBlockMap[nFreeBlock] = 1;
+			SetBlock (pEntry, i, nFreeBlock);
+
+			unsigned nBlockSectors =   nSectors < m_nSectorsPerBlock
+						 ? nSectors : m_nSectorsPerBlock;
+			unsigned nBytes = nBlockSectors * SECTOR_SIZE;
+			if (nBytes > nSize)
+			{
+				nBytes = nSize;
+			}
+
+			memcpy (pBlockBuffer, pFrom, nBytes);
+			memset (pBlockBuffer + nBytes, 0x1A, nBlockSectors * SECTOR_SIZE - nBytes);
+
+			if (!m_pDisk->Write (GetBlockSector (nFreeBlock), nBlockSectors, pBlockBuffer))
+			{
+				bResult = FALSE;
+
+				break;
+			}
+
+			pFrom += nBytes;
+			nSize -= nBytes;
+			nSectors -= nBlockSectors;
+			nSectorsLeft -= nBlockSectors;
+		}
+	}
+
+	delete [] pBlockBuffer;
+	delete [] pBlockMap;
+
+	if (!bResult)
+	{
+		DeleteFile (CPMName);		// do not leave a partial file
+	}
+
+	if (!WriteDirectory ())
+	{
+		bResult = FALSE;
+	}
+
+	return bResult;
+}
+
+u8 *CCPMFileSystem::ReadFile (const char *pName, unsigned *pSize)
+{
+	assert (m_pDirectory != 0);
+	assert (pSize != 0);
+
+	u8 CPMName[11];
+	if (!ConvertFileName (pName, CPMName))
+	{
+		fprintf (stderr, "Invalid filename: %s\n", pName);
+
+		return 0;
+	}
+
+	// the extends are full except the last one
+	unsigned nExtends = 0;
+	unsigned nSectors = 0;
+	const TDirectoryEntry *pEntry;
+	while ((pEntry = FindExtend (CPMName, nExtends)) != 0)
+	{
+		nExtends++;
+		nSectors += GetSectorCount (pEntry);
+
+		if (GetSectorCount (pEntry) < m_nSectorsPerExtend)
+		{
+			break;
+		}
+	}
+
+	if (nExtends == 0)
+	{
+		fprintf (stderr, "File not found: %s\n", pName);
+
+		return 0;
+	}
+
+	u8 *pBuffer = new u8[nSectors * SECTOR_SIZE + 1];	// not empty
+	assert (pBuffer != 0);
+
+	u8 *pTo = pBuffer;
+	for (unsigned nExtend = 0; nExtend < nExtends; nExtend++)
+	{
+		pEntry = FindExtend (CPMName, nExtend);
+		assert (pEntry != 0);
+
+		unsigned nSectorsLeft = GetSectorCount (pEntry);
+		for (unsigned i = 0; nSectorsLeft > 0; i++)
+		{
+			unsigned nBlockSectors =   nSectorsLeft < m_nSectorsPerBlock
+						 ? nSectorsLeft : m_nSectorsPerBlock;
+
+			unsigned nBlock = GetBlock (pEntry, i);
+			if (   nBlock < m_nDirectoryBlocks
+			    || nBlock >= m_nBlocks
+			    || !m_pDisk->Read (GetBlockSector (nBlock), nBlockSectors, pTo))
+			{
+				fprintf (stderr, "Invalid file: %s\n", pName);
+
+				delete [] pBuffer;
+
+				return 0;
+			}
+
+			pTo += nBlockSectors * SECTOR_SIZE;
+			nSectorsLeft -= nBlockSectors;
+		}
+	}
+
+	*pSize = nSectors * SECTOR_SIZE;
+
+	return pBuffer;
+}
+
+boolean CCPMFileSystem::ConvertFileName (const char *pName, u8 *pCPMName)
+{
+	assert (pName != 0);
+	assert (pCPMName != 0);
+
+	memset (pCPMName, ' ', 11);
+
+	unsigned nPos = 0;
+	unsigned nEnd = 8;
+	for (; *pName != '\0'; pName++)
+	{
+		char c = *pName;
+
+		if (   c <= ' '
+		    || strchr ("\"*+,/:;<=>?[\\]|", c) != 0)
+		{
+			return FALSE;
+		}
+
+		if (c == '.')
+		{
+			if (nEnd == 11)		// second dot
+			{
+				return FALSE;
+			}
+
+			nPos = 8;
+			nEnd = 11;
+
+			continue;
+		}
+
+		if ('a' <= c && c <= 'z')
+		{
+			c -= 'a'-'A';
+		}
+
+		if (nPos < nEnd)
+		{
+			pCPMName[nPos++] = c;
+		}
+	}
+
+	return pCPMName[0] != ' ';
+}
+
+CCPMFileSystem::TDirectoryEntry *CCPMFileSystem::FindExtend (const u8 *pCPMName, unsigned nExtend)
+{
+	for (unsigned nEntry = 0; nEntry < m_nDirectoryEntries; nEntry++)
+	{
+		TDirectoryEntry *pEntry = &m_pDirectory[nEntry];
+
+		if (   pEntry->UserNumber == 0
+		    && memcmp (pEntry->FileName, pCPMName, 11) == 0
+		    && GetExtend (pEntry) == nExtend)
+		{
+			return pEntry;
+		}
+	}
+
+	return 0;
+}
+
+boolean CCPMFileSystem::DeleteFile (const u8 *pCPMName)
+{
+	boolean bFound = FALSE;
+
+	for (unsigned nEntry = 0; nEntry < m_nDirectoryEntries; nEntry++)
+	{
+		TDirectoryEntry *pEntry = &m_pDirectory[nEntry];
+
+		if (   pEntry->UserNumber == 0
+		    && memcmp (pEntry->FileName, pCPMName, 11) == 0)
+		{
+			pEntry->UserNumber = FORMAT_BYTE;
+
+			bFound = TRUE;
+		}
+	}
+
+	return bFound;
+}
+
+// CP/M 2.2 numbers logical extends of 16K (128 sectors). An extend (directory
+// entry) holds m_nExtentMask+1 of them and has the number of the last one.
+
+unsigned CCPMFileSystem::GetExtend (const TDirectoryEntry *pEntry) const
+{
+	unsigned nLogicalExtend = (pEntry->Module & 0x3F) * 32 + (pEntry->Extend & 0x1F);
+
+	return nLogicalExtend / (m_nExtentMask+1);
+}
+
+unsigned CCPMFileSystem::GetSectorCount (const TDirectoryEntry *pEntry) const
+{
+	return (pEntry->Extend & m_nExtentMask) * 128 + pEntry->SectorCount;
+}
+
+void CCPMFileSystem::SetExtend (TDirectoryEntry *pEntry, unsigned nExtend, unsigned nSectors) const
+{
+	assert (nSectors <= m_nSectorsPerExtend);
+	unsigned nLastExtend = nSectors > 0 ? (nSectors-1) / 128 : 0;	// within this extend
+
+	unsigned nLogicalExtend = nExtend * (m_nExtentMask+1) + nLastExtend;
+	pEntry->Extend      = (u8) (nLogicalExtend % 32);
+	pEntry->Module      = (u8) (nLogicalExtend / 32);
+	pEntry->SectorCount = (u8) (nSectors - nLastExtend * 128);
+}
+
+unsigned CCPMFileSystem::GetBlock (const TDirectoryEntry *pEntry, unsigned nIndex) const
+{
+	if (m_nBlocks <= 256)		// DSM < 256
+	{
+		assert (nIndex < 16);
+		return pEntry->BlockNumber.Byte[nIndex];
+	}
+
+	assert (nIndex < 8);
+	return pEntry->BlockNumber.Word[nIndex];
+}
+
+void CCPMFileSystem::SetBlock (TDirectoryEntry *pEntry, unsigned nIndex, unsigned nBlock) const
+{
+	if (m_nBlocks <= 256)
+	{
+		assert (nIndex < 16);
+		pEntry->BlockNumber.Byte[nIndex] = (u8) nBlock;
+	}
+	else
+	{
+		assert (nIndex < 8);
+		pEntry->BlockNumber.Word[nIndex] = (u16) nBlock;
+	}
+}
+
+unsigned CCPMFileSystem::GetBlockSector (unsigned nBlock) const
+{
+	return m_nDirectorySector + nBlock * m_nSectorsPerBlock;
+}
+
+boolean CCPMFileSystem::WriteDirectory (void)
+{
+	unsigned nDirectorySectors =   (m_nDirectoryEntries * sizeof (TDirectoryEntry) + SECTOR_SIZE-1)
+				     / SECTOR_SIZE;
+
+	return m_pDisk->Write (m_nDirectorySector, nDirectorySectors, m_pDirectory);
+}
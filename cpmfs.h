@@ -0,0 +1,102 @@
+//
+// cpmfs.h
+//
+// Reads and writes files in the directory of a CP/M disk (Linux only)
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef _cpmfs_h
+#define _cpmfs_h
+
+#include "ramdisk.h"
+#include "types.h"
+
+// The files of user 0 on a CRAMDisk are accessed through its sector
+// interface, so that this works with all disk mappings. This must be done,
+// while the CP/M system does not use the disk (before boot or after quit),
+// because the BDOS keeps the allocation of the blocks in memory.
+
+class CCPMFileSystem
+{
+public:
+	CCPMFileSystem (CRAMDisk *pDisk);
+	~CCPMFileSystem (void);
+
+	boolean Mount (void);			// reads the directory
+
+	// an existing file is replaced, the last sector is padded with ^Z
+	boolean WriteFile (const char *pName, const void *pData, unsigned nSize);
+
+	// returns the file (whole sectors) or 0 if not found, free it with delete []
+	u8 *ReadFile (const char *pName, unsigned *pSize);
+
+private:
+	struct TDirectoryEntry
+	{
+		u8	UserNumber;		// 0xE5 for a free entry
+		u8	FileName[8];		// padded with ' '
+		u8	Extension[3];		// padded with ' '
+		u8	Extend;			// logical extend number % 32
+		u8	Reserved1;
+		u8	Module;			// logical extend number / 32
+		u8	SectorCount;		// sectors in the last logical extend
+
+		union
+		{
+			u8	Byte[16];	// with up to 256 blocks
+			u16	Word[8];
+		}
+		BlockNumber;
+	}
+	__attribute__ ((packed));
+
+	// returns FALSE, if pName is not a valid CP/M file name
+	static boolean ConvertFileName (const char *pName, u8 *pCPMName);
+
+	TDirectoryEntry *FindExtend (const u8 *pCPMName, unsigned nExtend);
+	boolean DeleteFile (const u8 *pCPMName);	// returns FALSE, if not found
+
+	unsigned GetExtend (const TDirectoryEntry *pEntry) const;
+	unsigned GetSectorCount (const TDirectoryEntry *pEntry) const;
+	void SetExtend (TDirectoryEntry *pEntry, unsigned nExtend, unsigned nSectors) const;
+
+	unsigned GetBlock (const TDirectoryEntry *pEntry, unsigned nIndex) const;
+	void SetBlock (TDirectoryEntry *pEntry, unsigned nIndex, unsigned nBlock) const;
+	unsigned GetBlockSector (unsigned nBlock) const;
+
+	boolean WriteDirectory (void);
+
+private:
+	CRAMDisk *m_pDisk;
+
+	unsigned m_nDirectorySector;		// first sector after the reserved tracks
+	unsigned m_nDirectoryEntries;
+	unsigned m_nDirectoryBlocks;
+	unsigned m_nBlockSize;
+	unsigned m_nSectorsPerBlock;
+	unsigned m_nBlocks;
+	unsigned m_nExtentMask;			// logical 16K extends per extend - 1 (EXM)
+	unsigned m_nSectorsPerExtend;
+	unsigned m_nBlocksPerExtend;
+
+	TDirectoryEntry *m_pDirectory;
+};
+
+#endif
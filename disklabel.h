@@ -0,0 +1,46 @@
+//
+// disklabel.h
+//
+// Label with the geometry of a CP/M disk image
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef _disklabel_h
+#define _disklabel_h
+
+// The first sector of a CP/M disk image can hold a label with the geometry of
+// the disk. "cpmdisk init" writes it into the first reserved track, which is
+// not used otherwise. Images without label have the default geometry (see
+// config.h). This file is shared with cpmdisk.c and must stay plain C.
+
+#define DISK_LABEL_MAGIC	"CPMEMU\x1A"		// 7 characters and 0
+
+typedef struct
+{
+	char		Magic[8];
+	unsigned short	nTracks;			// including reserved tracks
+	unsigned short	nSectorsPerTrack;		// 128 byte sectors, max. 255
+	unsigned short	nReservedTracks;		// min. 1 (for this label)
+	unsigned short	nBlockSize;			// byte size of an allocation block
+	unsigned short	nDirectoryEntries;
+}
+__attribute__ ((packed)) TDiskLabel;
+
+#endif
@@ -230,8 +230,23 @@ enum {
 
         /* Special instruction group. */
 
-        ED_UNDEFINED            /* ED_UNDEFINED is used to catch undefined
+        ED_UNDEFINED,           /* ED_UNDEFINED is used to catch undefined
                                  * 0xed prefixed opcodes.
                                  */
+        Z80_ONLY                /* Z80_ONLY stops the 8080 core on opcodes,
+                                 * which the 8080 does not have (see 
+                                 * Z80_8080_ONLY in z80emu.h).
+                                 */
 
 };
+
+/* Unprefixed instructions with register or condition operands (e.g. LD_R_R 
+ * or JP_CC_NN) have a handler of their own for each opcode, so that their 
+ * operands are decoded at compile time. INSTRUCTION_TABLE maps these opcodes
+ * to the following instruction numbers, the list of them is 
+ * SPECIALIZED_INSTRUCTIONS in tables.h. This applies to the first opcodes of
+ * superinstructions (see SUPERINSTRUCTIONS in Makefile.linux) too. The numbers of these instructions in
+ * the enumeration above are only used by maketables.c.
+ */
+
+#define SPECIALIZED(opcode)     (0x100 + (opcode))
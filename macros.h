@@ -15,18 +15,335 @@
 #define SYX_FLAGS       (Z80_S_FLAG | Z80_Y_FLAG | Z80_X_FLAG)
 #define HC_FLAGS        (Z80_H_FLAG | Z80_C_FLAG)
 
-#define A               (state->registers.byte[Z80_A])
-#define F               (state->registers.byte[Z80_F])
-#define B               (state->registers.byte[Z80_B])
-#define C               (state->registers.byte[Z80_C])
+/* The registers are held in local variables of emulate() (see 
+ * LOAD_REGISTERS), one REGISTER_PAIR for each 16-bit register pair. The bytes
+ * of a pair are indexed like in Z80_STATE's registers member.
+ */
+
+#define A               (reg_af.byte[Z80_A & 1])
+#define B               (reg_bc.byte[Z80_B & 1])
+#define C               (reg_bc.byte[Z80_C & 1])
+#define D               (reg_de.byte[Z80_D & 1])
+#define E               (reg_de.byte[Z80_E & 1])
+#define H               (reg_hl.byte[Z80_H & 1])
+#define L               (reg_hl.byte[Z80_L & 1])
+#define IXH             (reg_ix.byte[Z80_IXH & 1])
+#define IXL             (reg_ix.byte[Z80_IXL & 1])
+#define IYH             (reg_iy.byte[Z80_IYH & 1])
+#define IYL             (reg_iy.byte[Z80_IYL & 1])
+
+#define F               (reg_af.byte[Z80_F & 1])
+#define AF              (reg_af.word)
+
+#ifdef Z80_LAZY_FLAGS
+
+/* With Z80_LAZY_FLAGS the 8-bit arithmetic and logic macros below only record
+ * the kind of operation (flags_op), its operands (flags_a and flags_x), and
+ * its result (flags_z) in local variables of emulate(). Every instruction,
+ * which accesses F or AF otherwise, starts with EVALUATE_FLAGS, which computes
+ * F from the recorded operation. The result of each recorded operation keeps
+ * the carry in bit 8 and the 8-bit result in bits 0-7, which is enough for the
+ * carry, sign, and zero flags.
+ */
+
+#define EVALUATE_FLAGS                                                  \
+{                                                                       \
+        if (flags_op != FLAGS_EVALUATED) {                              \
+                                                                        \
+                F = evaluate_flags(flags_op,                            \
+                        flags_a, flags_x, flags_z);                     \
+                flags_op = FLAGS_EVALUATED;                             \
+                                                                        \
+        }                                                               \
+}
+
+#define CARRY_FLAG      (flags_op != FLAGS_EVALUATED                    \
+                                ? (flags_z >> 8) & Z80_C_FLAG           \
+                                : F & Z80_C_FLAG)
 
-#define AF              (state->registers.word[Z80_AF])
-#define BC              (state->registers.word[Z80_BC])
-#define DE              (state->registers.word[Z80_DE])
-#define HL              (state->registers.word[Z80_HL])
-#define SP              (state->registers.word[Z80_SP])
+#define SET_FLAGS(op, a, x, z)                                          \
+{                                                                       \
+        flags_op = (op);                                                \
+        flags_a = (a);                                                  \
+        flags_x = (x);                                                  \
+        flags_z = (z);                                                  \
+}
+
+#else
+
+#define EVALUATE_FLAGS
+
+#define CARRY_FLAG      (F & Z80_C_FLAG)
+
+#endif
+
+#define BC              (reg_bc.word)
+#define DE              (reg_de.word)
+#define HL              (reg_hl.word)
+#define IX              (reg_ix.word)
+#define IY              (reg_iy.word)
+#define SP              (reg_sp)
+
+/* Copy the registers from Z80_STATE into the local variables and back. They 
+ * are saved on return from emulate() and before each input or output, so 
+ * that the state is up to date there.
+ */
+
+#define LOAD_REGISTERS                                                  \
+{                                                                       \
+        AF = state->registers.word[Z80_AF];                             \
+        BC = state->registers.word[Z80_BC];                             \
+        DE = state->registers.word[Z80_DE];                             \
+        HL = state->registers.word[Z80_HL];                             \
+        IX = state->registers.word[Z80_IX];                             \
+        IY = state->registers.word[Z80_IY];                             \
+        SP = state->registers.word[Z80_SP];                             \
+}
+
+#define SAVE_REGISTERS                                                  \
+{                                                                       \
+        state->registers.word[Z80_AF] = AF;                             \
+        state->registers.word[Z80_BC] = BC;                             \
+        state->registers.word[Z80_DE] = DE;                             \
+        state->registers.word[Z80_HL] = HL;                             \
+        state->registers.word[Z80_IX] = IX;                             \
+        state->registers.word[Z80_IY] = IY;                             \
+        state->registers.word[Z80_SP] = SP;                             \
+}
+
+/* hl_ix_iy is Z80_HL, Z80_IX after a 0xdd prefix, or Z80_IY after a 0xfd 
+ * prefix. It selects the register, which replaces HL, H, and L.
+ */
+
+#define HL_IX_IY        (hl_ix_iy == Z80_HL                             \
+                                ? HL                                    \
+                                : hl_ix_iy == Z80_IX ? IX : IY)
+
+#define SET_HL_IX_IY(x)                                                 \
+{                                                                       \
+        if (hl_ix_iy == Z80_HL)                                         \
+                                                                        \
+                HL = (x);                                               \
+                                                                        \
+        else if (hl_ix_iy == Z80_IX)                                    \
+                                                                        \
+                IX = (x);                                               \
+                                                                        \
+        else                                                            \
+                                                                        \
+                IY = (x);                                               \
+}
+
+/* Count an instruction, whose opcode has just been fetched, for the profiler
+ * (see Z80_PROFILER in z80emu.h). The cycles since the last call are added to
+ * the previous instruction.
+ */
+
+#ifdef Z80_PROFILER
+
+#define PROFILE_INSTRUCTION                                             \
+{                                                                       \
+        if (profile != NULL) {                                          \
+                                                                        \
+                profile->cycles[profile_pc]                             \
+                        += elapsed_cycles - profile_cycles;             \
+                profile_pc = (pc - 1) & 0xffff;                         \
+                profile_cycles = elapsed_cycles;                        \
+                profile->instructions[profile_pc]++;                    \
+                                                                        \
+        }                                                               \
+}
+
+#else
+
+#define PROFILE_INSTRUCTION
+
+#endif
+
+/* Instruction dispatch macros. With the default switch dispatch, handlers 
+ * are case labels and leave the switch at their end. With 
+ * Z80_THREADED_DISPATCH, handlers are labels, whose addresses are stored in
+ * dispatch_table, and every handler checks the number of cycles, fetches the
+ * next opcode, and jumps to its handler directly.
+ */
 
-#define HL_IX_IY        *((unsigned short *) registers[6])
+#ifdef Z80_THREADED_DISPATCH
+
+#define DISPATCH(instruction)   goto *dispatch_table[(instruction)];
+
+#define INSTRUCTION(name)       handle_##name:
+
+#define SPECIALIZED_INSTRUCTION(name, opcode)                           \
+        handle_##name##_##opcode:
+
+#define SPECIALIZED_DISPATCH(name, opcode, fused)                       \
+        [SPECIALIZED(opcode)] = &&handle_##name##_##opcode,
+
+#ifdef Z80_DECODE_CACHE
+
+/* With Z80_DECODE_CACHE the next instruction is taken from its record in the
+ * decode cache. pc, r, and elapsed_cycles are advanced like for an unprefixed
+ * opcode here, so that pc does not depend on the record. Prefixed 
+ * instructions and addresses without a valid record are handled by
+ * handle_prefixed and handle_decode.
+ */
+
+#define NEXT_INSTRUCTION                                                \
+{                                                                       \
+        if (elapsed_cycles >= number_cycles)                            \
+                                                                        \
+                goto stop_emulation;                                    \
+                                                                        \
+        decoded = &context->decode_cache[pc & 0xffff];                  \
+        pc++;                                                           \
+                                                                        \
+        opcode = decoded->opcode;                                       \
+        hl_ix_iy = Z80_HL;                                              \
+        instructions++;                                                 \
+                                                                        \
+        elapsed_cycles += 4;                                            \
+        r++;                                                            \
+        goto *decoded->handler;                                         \
+}
+
+#else
+
+#define NEXT_INSTRUCTION                                                \
+{                                                                       \
+        if (elapsed_cycles >= number_cycles)                            \
+                                                                        \
+                goto stop_emulation;                                    \
+                                                                        \
+        Z80_FETCH_BYTE(pc, opcode);                                     \
+        pc++;                                                           \
+                                                                        \
+        hl_ix_iy = Z80_HL;                                              \
+        instructions++;                                                 \
+        PROFILE_INSTRUCTION;                                            \
+        instruction = INSTRUCTION_TABLE[opcode];                        \
+                                                                        \
+        elapsed_cycles += 4;                                            \
+        r++;                                                            \
+        goto *dispatch_table[instruction];                              \
+}
+
+#endif
+
+#else
+
+#define DISPATCH(instruction)   switch (instruction)
+
+#define INSTRUCTION(name)       case name:
+
+#define SPECIALIZED_INSTRUCTION(name, opcode)                           \
+        case SPECIALIZED(opcode):
+
+#define NEXT_INSTRUCTION        break
+
+#endif
+
+/* Handler of a specialized instruction (see SPECIALIZED() in instructions.h)
+ * for one opcode, its body is name##_HANDLER below. The opcode is a constant
+ * in there, so that the operand decoding macros fold to a single register.
+ * If the opcode starts a superinstruction, fused is a list of FUSE() for the
+ * following opcodes, otherwise it is empty.
+ */
+
+#define SPECIALIZED_HANDLER(name, hex, fused)                           \
+        SPECIALIZED_INSTRUCTION(name, hex) {                            \
+                                                                        \
+                {                                                       \
+                        const int       opcode = hex;                   \
+                                                                        \
+                        (void) opcode;                                  \
+                        name##_HANDLER;                                 \
+                                                                        \
+                }                                                       \
+                fused                                                   \
+                NEXT_INSTRUCTION;                                       \
+                                                                        \
+        }
+
+/* Next instruction of a superinstruction (see SUPERINSTRUCTIONS in 
+ * Makefile.linux), which is run inline, if the next opcode is hex. Otherwise
+ * the opcode is dispatched as usual. The number of cycles is checked, and pc,
+ * r, and elapsed_cycles are advanced exactly as by NEXT_INSTRUCTION, so the
+ * fused instructions behave like separate ones. With Z80_DECODE_CACHE the 
+ * next instruction is always taken from the decode cache.
+ */
+
+#ifndef Z80_DECODE_CACHE
+
+#define FUSE(name, hex)                                                 \
+{                                                                       \
+        if (elapsed_cycles >= number_cycles)                            \
+                                                                        \
+                goto stop_emulation;                                    \
+                                                                        \
+        Z80_FETCH_BYTE(pc, opcode);                                     \
+        pc++;                                                           \
+        if (opcode != hex)                                              \
+                                                                        \
+                goto start_emulation;                                   \
+                                                                        \
+        hl_ix_iy = Z80_HL;                                              \
+        instructions++;                                                 \
+        PROFILE_INSTRUCTION;                                            \
+                                                                        \
+        elapsed_cycles += 4;                                            \
+        r++;                                                            \
+        {                                                               \
+                const int       opcode = hex;                           \
+                                                                        \
+                (void) opcode;                                          \
+                name##_HANDLER;                                         \
+                                                                        \
+        }                                                               \
+}
+
+#else
+
+#define FUSE(name, hex)
+
+#endif
+
+/* Handler and dispatch_table entry of an instruction, which the 8080 does not
+ * have. With Z80_8080_ONLY (see z80emu.h) the handler is unreachable and left
+ * out by the compiler, INSTRUCTION_TABLE has Z80_ONLY for these opcodes.
+ */
+
+#ifdef Z80_8080_ONLY
+
+#define Z80_INSTRUCTION(name)   if (0)
+
+#define Z80_DISPATCH(name)
+
+#else
+
+#define Z80_INSTRUCTION(name)   INSTRUCTION(name)
+
+#define Z80_DISPATCH(name)      [name] = &&handle_##name,
+
+#endif
+
+/* Invalidate the records of the decode cache, which may contain the byte at
+ * address, see Z80_DECODE_CACHE in z80emu.h.
+ */
+
+#ifdef Z80_DECODE_CACHE
+
+#define INVALIDATE_DECODED(address)                                     \
+{                                                                       \
+        if (context->code_pages[((address) & 0xffff) >> 8])             \
+                                                                        \
+                invalidate_decoded(context, address);                   \
+}
+
+#else
+
+#define INVALIDATE_DECODED(address)
+
+#endif
 
 /* Opcode decoding macros.  Y() is bits 5-3 of the opcode, Z() is bits 2-0,
  * P() bits 5-4, and Q() bits 4-3.
@@ -37,16 +354,137 @@
 #define P(opcode)       (((opcode) >> 4) & 0x03)
 #define Q(opcode)       (((opcode) >> 3) & 0x03)
 
-/* Registers and conditions are decoded using tables in encodings.h.  S() is
- * for the special cases "LD H/L, (IX/Y + d)" and "LD (IX/Y + d), H/L".
+/* Registers are decoded from the opcode without tables. R() is an 8-bit "R"
+ * register, where H and L are replaced by IXH/IXL or IYH/IYL after a 0xdd or
+ * 0xfd prefix. S() is for the special cases "LD H/L, (IX/Y + d)" and 
+ * "LD (IX/Y + d), H/L". RR() is a "regular" 16-bit register and SS() a 16-bit
+ * register for PUSH and POP (AF instead of SP). They are written with the
+ * SET_ macros. If the encoding is a constant, each of them compiles to the
+ * access of a single local variable.
+ */
+
+#define S(s)            ((s) == 0 ? B                                   \
+                                : (s) == 1 ? C                          \
+                                : (s) == 2 ? D                          \
+                                : (s) == 3 ? E                          \
+                                : (s) == 4 ? H                          \
+                                : (s) == 5 ? L                          \
+                                : A)
+
+#define R(r)            ((r) == 4 && hl_ix_iy != Z80_HL                 \
+                                ? (hl_ix_iy == Z80_IX ? IXH : IYH)      \
+                                : (r) == 5 && hl_ix_iy != Z80_HL        \
+                                ? (hl_ix_iy == Z80_IX ? IXL : IYL)      \
+                                : S(r))
+
+#define RR(rr)          ((rr) == 0 ? BC                                 \
+                                : (rr) == 1 ? DE                        \
+                                : (rr) == 2 ? HL_IX_IY                  \
+                                : SP)
+
+#define SS(ss)          ((ss) == 0 ? BC                                 \
+                                : (ss) == 1 ? DE                        \
+                                : (ss) == 2 ? HL_IX_IY                  \
+                                : AF)
+
+#define SET_S(s, x)                                                     \
+{                                                                       \
+        int     v;                                                      \
+                                                                        \
+        v = (x);                                                        \
+        switch (s) {                                                    \
+                                                                        \
+                case 0: B = v; break;                                   \
+                case 1: C = v; break;                                   \
+                case 2: D = v; break;                                   \
+                case 3: E = v; break;                                   \
+                case 4: H = v; break;                                   \
+                case 5: L = v; break;                                   \
+                default: A = v; break;                                  \
+                                                                        \
+        }                                                               \
+}
+
+#define SET_R(r, x)                                                     \
+{                                                                       \
+        if ((r) == 4 && hl_ix_iy != Z80_HL) {                           \
+                                                                        \
+                if (hl_ix_iy == Z80_IX)                                 \
+                                                                        \
+                        IXH = (x);                                      \
+                                                                        \
+                else                                                    \
+                                                                        \
+                        IYH = (x);                                      \
+                                                                        \
+        } else if ((r) == 5 && hl_ix_iy != Z80_HL) {                    \
+                                                                        \
+                if (hl_ix_iy == Z80_IX)                                 \
+                                                                        \
+                        IXL = (x);                                      \
+                                                                        \
+                else                                                    \
+                                                                        \
+                        IYL = (x);                                      \
+                                                                        \
+        } else                                                          \
+                                                                        \
+                SET_S((r), (x));                                        \
+}
+
+#define SET_RR(rr, x)                                                   \
+{                                                                       \
+        int     v;                                                      \
+                                                                        \
+        v = (x);                                                        \
+        switch (rr) {                                                   \
+                                                                        \
+                case 0: BC = v; break;                                  \
+                case 1: DE = v; break;                                  \
+                case 2: SET_HL_IX_IY(v); break;                         \
+                default: SP = v; break;                                 \
+                                                                        \
+        }                                                               \
+}
+
+#define SET_SS(ss, x)                                                   \
+{                                                                       \
+        int     v;                                                      \
+                                                                        \
+        v = (x);                                                        \
+        switch (ss) {                                                   \
+                                                                        \
+                case 0: BC = v; break;                                  \
+                case 1: DE = v; break;                                  \
+                case 2: SET_HL_IX_IY(v); break;                         \
+                default: AF = v; break;                                 \
+                                                                        \
+        }                                                               \
+}
+
+#ifdef Z80_LAZY_FLAGS
+
+/* Conditions on the sign, zero, or carry flag are tested on the recorded
+ * result, without computing F.
  */
 
-#define R(r)            *((unsigned char *) (registers[(r)]))
-#define S(s)            *((unsigned char *) register_table[(s)])
-#define RR(rr)          *((unsigned short *) registers[(rr) + 8])
-#define SS(ss)          *((unsigned short *) registers[(ss) + 12])
+#define CC(cc)          (((flags_op == FLAGS_EVALUATED                  \
+                                ? F                                     \
+                                : ((cc) & 0x06) == 0x04                 \
+                                ? evaluate_flags(flags_op,              \
+                                        flags_a, flags_x, flags_z)      \
+                                : SZYX_FLAGS_TABLE[flags_z & 0xff]      \
+                                        | ((flags_z >> 8) & Z80_C_FLAG))\
+                          ^ XOR_CONDITION_TABLE[(cc)])                  \
+                                & AND_CONDITION_TABLE[(cc)])
+
+#else
+
 #define CC(cc)          ((F ^ XOR_CONDITION_TABLE[(cc)])                \
                                 & AND_CONDITION_TABLE[(cc)])
+
+#endif
+
 #define DD(dd)          CC(dd)
 
 /* Macros to read constants, displacements, or addresses from code. */
@@ -105,7 +543,7 @@
                                                 
 #define READ_INDIRECT_HL(x)                                             \
 {                                                                       \
-        if (registers == register_table) {                              \
+        if (hl_ix_iy == Z80_HL) {                                       \
                                                                         \
                 READ_BYTE(HL, (x));                                     \
                                                                         \
@@ -124,7 +562,7 @@
 
 #define WRITE_INDIRECT_HL(x)                                            \
 {                                                                       \
-        if (registers == register_table) {                              \
+        if (hl_ix_iy == Z80_HL) {                                       \
                                                                         \
                 WRITE_BYTE(HL, (x));                                    \
                                                                         \
@@ -168,6 +606,116 @@
 
 /* 8-bit arithmetic and logic operations. */
 
+#ifdef Z80_LAZY_FLAGS
+
+/* The flags are computed by evaluate_flags() in z80emu.c, when needed. ADC 
+ * and SBC are recorded like ADD and SUB, their result includes the carry.
+ */
+
+#define ADD(x)                                                          \
+{                                                                       \
+        int     a, y, z;                                                \
+                                                                        \
+        a = A;                                                          \
+        y = (x);                                                        \
+        z = a + y;                                                      \
+                                                                        \
+        A = z;                                                          \
+        SET_FLAGS(FLAGS_ADD, a, y, z);                                  \
+}
+
+#define ADC(x)                                                          \
+{                                                                       \
+        int     a, y, z;                                                \
+                                                                        \
+        a = A;                                                          \
+        y = (x);                                                        \
+        z = a + y + CARRY_FLAG;                                         \
+                                                                        \
+        A = z;                                                          \
+        SET_FLAGS(FLAGS_ADD, a, y, z);                                  \
+}
+
+#define SUB(x)                                                          \
+{                                                                       \
+        int     a, y, z;                                                \
+                                                                        \
+        a = A;                                                          \
+        y = (x);                                                        \
+        z = a - y;                                                      \
+                                                                        \
+        A = z;                                                          \
+        SET_FLAGS(FLAGS_SUB, a, y, z);                                  \
+}
+
+#define SBC(x)                                                          \
+{                                                                       \
+        int     a, y, z;                                                \
+                                                                        \
+        a = A;                                                          \
+        y = (x);                                                        \
+        z = a - y - CARRY_FLAG;                                         \
+                                                                        \
+        A = z;                                                          \
+        SET_FLAGS(FLAGS_SUB, a, y, z);                                  \
+}
+
+#define AND(x)                                                          \
+{                                                                       \
+        A &= (x);                                                       \
+        flags_op = FLAGS_AND;                                           \
+        flags_z = A;                                                    \
+}
+
+#define OR(x)                                                           \
+{                                                                       \
+        A |= (x);                                                       \
+        flags_op = FLAGS_OR_XOR;                                        \
+        flags_z = A;                                                    \
+}
+
+#define XOR(x)                                                          \
+{                                                                       \
+        A ^= (x);                                                       \
+        flags_op = FLAGS_OR_XOR;                                        \
+        flags_z = A;                                                    \
+}
+
+#define CP(x)                                                           \
+{                                                                       \
+        int     a, y;                                                   \
+                                                                        \
+        a = A;                                                          \
+        y = (x);                                                        \
+        SET_FLAGS(FLAGS_CP, a, y, a - y);                               \
+}
+
+/* INC and DEC keep the carry flag, which is stored in bit 8 of the result. */
+
+#define INC(x)                                                          \
+{                                                                       \
+        int     y, z;                                                   \
+                                                                        \
+        y = (x);                                                        \
+        z = ((y + 1) & 0xff) | (CARRY_FLAG << 8);                       \
+                                                                        \
+        (x) = z;                                                        \
+        SET_FLAGS(FLAGS_INC, y, 0, z);                                  \
+}
+
+#define DEC(x)                                                          \
+{                                                                       \
+        int     y, z;                                                   \
+                                                                        \
+        y = (x);                                                        \
+        z = ((y - 1) & 0xff) | (CARRY_FLAG << 8);                       \
+                                                                        \
+        (x) = z;                                                        \
+        SET_FLAGS(FLAGS_DEC, y, 0, z);                                  \
+}
+
+#else
+
 #define ADD(x)                                                          \
 {                                                                       \
         int     a, z, c, f;                                             \
@@ -303,6 +851,8 @@
         F = f;                                                          \
 }
 
+#endif
+
 /* 0xcb prefixed logical operations. */
 
 #define RLC(x)                                                          \
@@ -376,3 +926,330 @@
         (x) >>= 1;                                                      \
         F = SZYXP_FLAGS_TABLE[(x) & 0xff] | c;                          \
 }
+
+/* Flags, which are computed only if Z80_DOCUMENTED_FLAGS_ONLY is not defined,
+ * and fetches of operands, which are done only if Z80_FALSE_CONDITION_FETCH is
+ * defined, for the handlers below.
+ */
+
+#ifndef Z80_DOCUMENTED_FLAGS_ONLY
+
+#define UNDOCUMENTED_FLAGS(f)   (f)
+
+#else
+
+#define UNDOCUMENTED_FLAGS(f)   0
+
+#endif
+
+#ifdef Z80_FALSE_CONDITION_FETCH
+
+#define FALSE_CONDITION_FETCH_BYTE(n)   Z80_FETCH_BYTE(pc, (n))
+#define FALSE_CONDITION_FETCH_WORD(nn)  Z80_FETCH_WORD(pc, (nn))
+
+#else
+
+#define FALSE_CONDITION_FETCH_BYTE(n)
+#define FALSE_CONDITION_FETCH_WORD(nn)
+
+#endif
+
+/* Handlers of the specialized instructions, see SPECIALIZED_HANDLER. */
+
+#define LD_R_R_HANDLER          SET_R(Y(opcode), R(Z(opcode)))
+
+#define LD_R_N_HANDLER                                                  \
+{                                                                       \
+        int     n;                                                      \
+                                                                        \
+        READ_N(n);                                                      \
+        SET_R(Y(opcode), n);                                            \
+}
+
+#define LD_R_INDIRECT_HL_HANDLER                                        \
+{                                                                       \
+        int     x;                                                      \
+                                                                        \
+        if (hl_ix_iy == Z80_HL) {                                       \
+                                                                        \
+                READ_BYTE(HL, x);                                       \
+                                                                        \
+        } else {                                                        \
+                                                                        \
+                int     d;                                              \
+                                                                        \
+                READ_D(d);                                              \
+                d += HL_IX_IY;                                          \
+                READ_BYTE(d, x);                                        \
+                                                                        \
+                elapsed_cycles += 5;                                    \
+                                                                        \
+        }                                                               \
+        SET_S(Y(opcode), x);                                            \
+}
+
+#define LD_INDIRECT_HL_R_HANDLER                                        \
+{                                                                       \
+        if (hl_ix_iy == Z80_HL) {                                       \
+                                                                        \
+                WRITE_BYTE(HL, S(Z(opcode)));                           \
+                                                                        \
+        } else {                                                        \
+                                                                        \
+                int     d;                                              \
+                                                                        \
+                READ_D(d);                                              \
+                d += HL_IX_IY;                                          \
+                WRITE_BYTE(d, S(Z(opcode)));                            \
+                                                                        \
+                elapsed_cycles += 5;                                    \
+                                                                        \
+        }                                                               \
+}
+
+#define LD_RR_NN_HANDLER                                                \
+{                                                                       \
+        int     nn;                                                     \
+                                                                        \
+        READ_NN(nn);                                                    \
+        SET_RR(P(opcode), nn);                                          \
+}
+
+#define PUSH_SS_HANDLER                                                 \
+{                                                                       \
+        EVALUATE_FLAGS;                                                 \
+                                                                        \
+        PUSH(SS(P(opcode)));                                            \
+        elapsed_cycles++;                                               \
+}
+
+#define POP_SS_HANDLER                                                  \
+{                                                                       \
+        int     x;                                                      \
+                                                                        \
+        EVALUATE_FLAGS;                                                 \
+                                                                        \
+        POP(x);                                                         \
+        SET_SS(P(opcode), x);                                           \
+}
+
+#define ADD_R_HANDLER   ADD(R(Z(opcode)))
+#define ADC_R_HANDLER   ADC(R(Z(opcode)))
+#define SUB_R_HANDLER   SUB(R(Z(opcode)))
+#define SBC_R_HANDLER   SBC(R(Z(opcode)))
+#define AND_R_HANDLER   AND(R(Z(opcode)))
+#define XOR_R_HANDLER   XOR(R(Z(opcode)))
+#define OR_R_HANDLER    OR(R(Z(opcode)))
+#define CP_R_HANDLER    CP(R(Z(opcode)))
+
+#define INC_R_HANDLER                                                   \
+{                                                                       \
+        int     x;                                                      \
+                                                                        \
+        x = R(Y(opcode));                                               \
+        INC(x);                                                         \
+        SET_R(Y(opcode), x);                                            \
+}
+
+#define DEC_R_HANDLER                                                   \
+{                                                                       \
+        int     x;                                                      \
+                                                                        \
+        x = R(Y(opcode));                                               \
+        DEC(x);                                                         \
+        SET_R(Y(opcode), x);                                            \
+}
+
+#define ADD_HL_RR_HANDLER                                               \
+{                                                                       \
+        int     x, y, z, f, c;                                          \
+                                                                        \
+        EVALUATE_FLAGS;                                                 \
+                                                                        \
+        x = HL_IX_IY;                                                   \
+        y = RR(P(opcode));                                              \
+        z = x + y;                                                      \
+                                                                        \
+        c = x ^ y ^ z;                                                  \
+        f = F & SZPV_FLAGS;                                             \
+        f |= UNDOCUMENTED_FLAGS(((z >> 8) & YX_FLAGS)                   \
+                | ((c >> 8) & Z80_H_FLAG));                             \
+        f |= c >> (16 - Z80_C_FLAG_SHIFT);                              \
+                                                                        \
+        SET_HL_IX_IY(z);                                                \
+        F = f;                                                          \
+                                                                        \
+        elapsed_cycles += 7;                                            \
+}
+
+#define INC_RR_HANDLER                                                  \
+{                                                                       \
+        SET_RR(P(opcode), RR(P(opcode)) + 1);                           \
+                                                                        \
+        elapsed_cycles += 2;                                            \
+}
+
+#define DEC_RR_HANDLER                                                  \
+{                                                                       \
+        SET_RR(P(opcode), RR(P(opcode)) - 1);                           \
+                                                                        \
+        elapsed_cycles += 2;                                            \
+}
+
+#define JP_CC_NN_HANDLER                                                \
+{                                                                       \
+        int     nn;                                                     \
+                                                                        \
+        if (CC(Y(opcode))) {                                            \
+                                                                        \
+                Z80_FETCH_WORD(pc, nn);                                 \
+                pc = nn;                                                \
+                                                                        \
+        } else {                                                        \
+                                                                        \
+                FALSE_CONDITION_FETCH_WORD(nn);                         \
+                pc += 2;                                                \
+                                                                        \
+        }                                                               \
+                                                                        \
+        elapsed_cycles += 6;                                            \
+}
+
+#define JR_DD_E_HANDLER                                                 \
+{                                                                       \
+        int     e;                                                      \
+                                                                        \
+        if (DD(Q(opcode))) {                                            \
+                                                                        \
+                Z80_FETCH_BYTE(pc, e);                                  \
+                e = (char) e;                                           \
+                pc += e + 1;                                            \
+                                                                        \
+                elapsed_cycles += 8;                                    \
+                                                                        \
+        } else {                                                        \
+                                                                        \
+                FALSE_CONDITION_FETCH_BYTE(e);                          \
+                pc++;                                                   \
+                                                                        \
+                elapsed_cycles += 3;                                    \
+                                                                        \
+        }                                                               \
+}
+
+#define CALL_CC_NN_HANDLER                                              \
+{                                                                       \
+        int     nn;                                                     \
+                                                                        \
+        if (CC(Y(opcode))) {                                            \
+                                                                        \
+                READ_NN(nn);                                            \
+                PUSH(pc);                                               \
+                pc = nn;                                                \
+                                                                        \
+                elapsed_cycles++;                                       \
+                                                                        \
+        } else {                                                        \
+                                                                        \
+                FALSE_CONDITION_FETCH_WORD(nn);                         \
+                pc += 2;                                                \
+                                                                        \
+                elapsed_cycles += 6;                                    \
+                                                                        \
+        }                                                               \
+}
+
+#define RET_CC_HANDLER                                                  \
+{                                                                       \
+        if (CC(Y(opcode))) {                                            \
+                                                                        \
+                POP(pc);                                                \
+                                                                        \
+        }                                                               \
+        elapsed_cycles++;                                               \
+}
+
+/* Handlers of the unprefixed instructions without operands, which may be part
+ * of a superinstruction (see FUSE). Their INSTRUCTION() handlers in z80emu.c
+ * use them too.
+ */
+
+#define LD_A_INDIRECT_BC_HANDLER        READ_BYTE(BC, A)
+#define LD_A_INDIRECT_DE_HANDLER        READ_BYTE(DE, A)
+
+#define LD_A_INDIRECT_NN_HANDLER                                        \
+{                                                                       \
+        int     nn;                                                     \
+                                                                        \
+        READ_NN(nn);                                                    \
+        READ_BYTE(nn, A);                                               \
+}
+
+#define LD_INDIRECT_BC_A_HANDLER        WRITE_BYTE(BC, A)
+#define LD_INDIRECT_DE_A_HANDLER        WRITE_BYTE(DE, A)
+
+#define LD_INDIRECT_NN_A_HANDLER                                        \
+{                                                                       \
+        int     nn;                                                     \
+                                                                        \
+        READ_NN(nn);                                                    \
+        WRITE_BYTE(nn, A);                                              \
+}
+
+#define EX_DE_HL_HANDLER                EXCHANGE(DE, HL)
+
+#define JP_NN_HANDLER                                                   \
+{                                                                       \
+        int     nn;                                                     \
+                                                                        \
+        Z80_FETCH_WORD(pc, nn);                                         \
+        pc = nn;                                                        \
+                                                                        \
+        elapsed_cycles += 6;                                            \
+}
+
+#define JR_E_HANDLER                                                    \
+{                                                                       \
+        int     e;                                                      \
+                                                                        \
+        Z80_FETCH_BYTE(pc, e);                                          \
+        e = (char) e;                                                   \
+        pc += e + 1;                                                    \
+                                                                        \
+        elapsed_cycles += 8;                                            \
+}
+
+#define DJNZ_E_HANDLER                                                  \
+{                                                                       \
+        int     e;                                                      \
+                                                                        \
+        if (--B) {                                                      \
+                                                                        \
+                Z80_FETCH_BYTE(pc, e);                                  \
+                e = (char) e;                                           \
+                pc += e + 1;                                            \
+                                                                        \
+                elapsed_cycles += 9;                                    \
+                                                                        \
+        } else {                                                        \
+                                                                        \
+                FALSE_CONDITION_FETCH_BYTE(e);                          \
+                pc++;                                                   \
+                                                                        \
+                elapsed_cycles += 4;                                    \
+                                                                        \
+        }                                                               \
+}
+
+#define CALL_NN_HANDLER                                                 \
+{                                                                       \
+        int     nn;                                                     \
+                                                                        \
+        READ_NN(nn);                                                    \
+        PUSH(pc);                                                       \
+        pc = nn;                                                        \
+                                                                        \
+        elapsed_cycles++;                                               \
+}
+
+#define RET_HANDLER                     POP(pc)
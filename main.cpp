@@ -25,6 +25,17 @@
 	#include <circle/startup.h>
 #else
 	#include "z80computer.h"
+	#include "scheduler.h"
+	#include "batchjob.h"
+	#include "snapshot.h"
+	#include "zygote.h"
+	#include <stdio.h>
+	#include <stdlib.h>
+	#include <limits.h>
+	#include <fcntl.h>
+	#include <sys/select.h>
+	#include <unistd.h>
+	#include <time.h>
 #endif
 
 #ifdef __circle__
@@ -57,18 +68,402 @@ int main (void)
 
 #else
 
-int main (void)
+static CZ80Computer *CreateComputer (void);
+static CZ80Computer *NewComputer (const char *pInputFile, CBatchJob *pJob);
+static int RunZygote (unsigned nJobs, char **ppJobFile, unsigned nProcesses, boolean bStatistics);
+static void PrintJobRate (unsigned nJobs, const struct timespec *pStartTime);
+
+#ifdef Z80_8080_PROFILE
+static boolean s_b8080 = FALSE;
+#endif
+#ifdef Z80_JIT
+static boolean s_bJIT = FALSE;
+#endif
+#ifdef Z80_PROFILER
+static boolean s_bProfiler = FALSE;
+#endif
+static boolean s_bStatistics = FALSE;
+static TDiskMapping s_DiskMapping = DiskMapNone;
+static const char *s_pSnapshotFile = 0;
+static CSnapshot s_Snapshot;			// the machines are restored from this
+static boolean s_bRestore = FALSE;
+
+int main (int argc, char **argv)
 {
-	CZ80Computer Computer;
+	unsigned nThreads = 0;
+	boolean bJobs = FALSE;
+	boolean bZygote = FALSE;
+
+	const char *pOptions =
+#ifdef Z80_8080_PROFILE
+		"8"
+#endif
+#ifdef Z80_JIT
+		"j"
+#endif
+		"bmo"
+#ifdef Z80_PROFILER
+		"p"
+#endif
+		"r:st:w:xz";
+	const char *pUsage = "Usage: %s"
+#ifdef Z80_8080_PROFILE
+		" [-8]"
+#endif
+#ifdef Z80_JIT
+		" [-j]"
+#endif
+		" [-m] [-o]"
+#ifdef Z80_PROFILER
+		" [-p]"
+#endif
+		" [-r snapshot] [-s] [-t threads] [-w snapshot] [-x] [inputfile ...]\n"
+		"       %s -b [-z] [options] jobfile ...\n";
+
+	int nOption;
+	while ((nOption = getopt (argc, argv, pOptions)) != -1)
+	{
+		switch (nOption)
+		{
+#ifdef Z80_8080_PROFILE
+		case '8':
+			s_b8080 = TRUE;
+			break;
+#endif
+
+#ifdef Z80_JIT
+		case 'j':
+			s_bJIT = TRUE;
+			break;
+#endif
+
+		case 'b':
+			bJobs = TRUE;
+			break;
+
+		case 'm':
+			s_DiskMapping = DiskMapShared;
+			break;
+
+		case 'o':
+			s_DiskMapping = DiskMapOverlay;
+			break;
+
+#ifdef Z80_PROFILER
+		case 'p':
+			s_bProfiler = TRUE;
+			break;
+#endif
+
+		case 'r':
+			if (!s_Snapshot.Open (optarg))
+			{
+				return 1;
+			}
+			s_bRestore = TRUE;
+			break;
+
+		case 's':
+			s_bStatistics = TRUE;
+			break;
+
+		case 't':
+			nThreads = atoi (optarg);
+			if (nThreads == 0)
+			{
+				fprintf (stderr, pUsage, argv[0], argv[0]);
+				return 1;
+			}
+			break;
+
+		case 'w':
+			s_pSnapshotFile = optarg;
+			break;
+
+		case 'x':
+			s_DiskMapping = DiskMapPrivate;
+			break;
+
+		case 'z':
+			bZygote = TRUE;
+			break;
+
+		default:
+			fprintf (stderr, pUsage, argv[0], argv[0]);
+			return 1;
+		}
+	}
+
+	if (   (bJobs && optind >= argc)
+	    || (bZygote && !bJobs))
+	{
+		fprintf (stderr, pUsage, argv[0], argv[0]);
+		return 1;
+	}
+
+	if (optind >= argc)		// one interactive machine
+	{
+		CZ80Computer *pComputer = NewComputer (0, 0);
+		if (pComputer == 0)
+		{
+			return 1;
+		}
+
+		pComputer->Run ();
+
+		int nResult = 0;
+		if (   s_pSnapshotFile != 0
+		    && !pComputer->IsSnapshotWritten ())
+		{
+			nResult = 1;
+		}
+
+		delete pComputer;
 
-	if (!Computer.Initialize ())
+		return nResult;
+	}
+
+	if (s_pSnapshotFile != 0)
+	{
+		fprintf (stderr, "-w cannot be used with input or job files\n");
+		return 1;
+	}
+
+	// One machine per input or job file, all working on a private copy of the
+	// disk images, because they would overwrite each other's changes otherwise.
+	if (   s_DiskMapping == DiskMapShared
+	    || s_DiskMapping == DiskMapOverlay)
 	{
+		fprintf (stderr, "-m and -o cannot be used with input or job files\n");
 		return 1;
 	}
+	s_DiskMapping = DiskMapPrivate;
+
+	boolean bStatistics = s_bStatistics;
+	s_bStatistics = FALSE;			// the scheduler displays them
+
+	if (bZygote)
+	{
+		return RunZygote (argc - optind, argv + optind, nThreads, bStatistics);
+	}
+
+	struct timespec StartTime;
+	clock_gettime (CLOCK_MONOTONIC, &StartTime);
+
+	unsigned nMachines = argc - optind;
+	CZ80Computer **ppComputer = new CZ80Computer *[nMachines];
+	CBatchJob *pJob = bJobs ? new CBatchJob[nMachines] : 0;
+
+	CScheduler Scheduler (nMachines, nThreads);
+
+	int nResult = 0;
+	unsigned nCreated;
+	for (nCreated = 0; nCreated < nMachines; nCreated++)
+	{
+		const char *pFileName = argv[optind + nCreated];
+
+		if (   bJobs
+		    && !pJob[nCreated].Load (pFileName))
+		{
+			nResult = JOB_STATUS_ERROR;
+
+			break;
+		}
+
+		ppComputer[nCreated] = NewComputer (pFileName, bJobs ? &pJob[nCreated] : 0);
+		if (ppComputer[nCreated] == 0)
+		{
+			nResult = 1;
+
+			break;
+		}
+
+		Scheduler.AddMachine (ppComputer[nCreated], pFileName);
+	}
+
+	if (nResult == 0)
+	{
+		Scheduler.Run ();
+
+		// the exit status is the highest of all jobs
+		for (unsigned i = 0; bJobs && i < nMachines; i++)
+		{
+			int nStatus = pJob[i].Complete (ppComputer[i]);
+			if (nStatus > nResult)
+			{
+				nResult = nStatus;
+			}
+		}
+
+		if (bStatistics)
+		{
+			Scheduler.PrintStatistics ();
+
+			if (bJobs)
+			{
+				PrintJobRate (nMachines, &StartTime);
+			}
+		}
+	}
+
+	for (unsigned i = 0; i < nCreated; i++)
+	{
+		delete ppComputer[i];
+	}
+	delete [] ppComputer;
+	delete [] pJob;
+
+	return nResult;
+}
+
+// The machine has the options from the command line, but is not initialized.
+CZ80Computer *CreateComputer (void)
+{
+	CZ80Computer *pComputer = new CZ80Computer;
+
+#ifdef Z80_8080_PROFILE
+	pComputer->Set8080 (s_b8080);
+#endif
+#ifdef Z80_JIT
+	pComputer->SetJIT (s_bJIT);
+#endif
+#ifdef Z80_PROFILER
+	pComputer->SetProfiler (s_bProfiler);
+#endif
+	pComputer->SetStatistics (s_bStatistics);
+	if (s_DiskMapping != DiskMapNone)
+	{
+		pComputer->SetDiskMapping (s_DiskMapping);
+	}
+	if (s_pSnapshotFile != 0)
+	{
+		pComputer->SetSnapshotFile (s_pSnapshotFile);
+	}
+	if (s_bRestore)
+	{
+		pComputer->SetRestoreSnapshot (&s_Snapshot);
+	}
+
+	return pComputer;
+}
+
+// The console of the machine reads pInputFile and writes to pInputFile.out,
+// if it is given, and uses stdin and stdout otherwise. A batch job sets up the
+// console and the disks itself.
+CZ80Computer *NewComputer (const char *pInputFile, CBatchJob *pJob)
+{
+	CZ80Computer *pComputer = CreateComputer ();
+
+	if (pJob != 0)
+	{
+		if (!pJob->Prepare (pComputer))
+		{
+			delete pComputer;
+
+			return 0;
+		}
+
+		return pComputer;
+	}
+
+	if (pInputFile != 0)
+	{
+		int nInputFile = open (pInputFile, O_RDONLY);
+		if (nInputFile < 0)
+		{
+			fprintf (stderr, "Cannot open: %s\n", pInputFile);
+
+			delete pComputer;
+
+			return 0;
+		}
+
+		char OutputFile[PATH_MAX];
+		snprintf (OutputFile, sizeof OutputFile, "%s.out", pInputFile);
+
+		int nOutputFile = open (OutputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (nOutputFile < 0)
+		{
+			fprintf (stderr, "Cannot create: %s\n", OutputFile);
+
+			close (nInputFile);
+			delete pComputer;
+
+			return 0;
+		}
+
+		if (nOutputFile >= FD_SETSIZE)		// the console uses select ()
+		{
+			fprintf (stderr, "Too many input files\n");
+
+			close (nOutputFile);
+			close (nInputFile);
+			delete pComputer;
+
+			return 0;
+		}
+
+		pComputer->SetConsoleFiles (nInputFile, nOutputFile);
+	}
+
+	if (!pComputer->Initialize ())
+	{
+		delete pComputer;
+
+		return 0;
+	}
+
+	return pComputer;
+}
+
+// One machine is booted and a child process is forked from it for each job.
+int RunZygote (unsigned nJobs, char **ppJobFile, unsigned nProcesses, boolean bStatistics)
+{
+	struct timespec StartTime;
+	clock_gettime (CLOCK_MONOTONIC, &StartTime);
+
+	CBatchJob *pJob = new CBatchJob[nJobs];
+	for (unsigned i = 0; i < nJobs; i++)
+	{
+		if (!pJob[i].Load (ppJobFile[i]))
+		{
+			delete [] pJob;
+
+			return JOB_STATUS_ERROR;
+		}
+	}
+
+	CZ80Computer *pComputer = CreateComputer ();
+	CZygote Zygote (nProcesses);
+
+	int nResult = JOB_STATUS_ERROR;
+	if (Zygote.Boot (pComputer))
+	{
+		nResult = Zygote.Run (pJob, nJobs, ppJobFile);
+
+		if (bStatistics)
+		{
+			Zygote.PrintStatistics ();
+			PrintJobRate (nJobs, &StartTime);
+		}
+	}
+
+	delete pComputer;
+	delete [] pJob;
+
+	return nResult;
+}
+
+void PrintJobRate (unsigned nJobs, const struct timespec *pStartTime)
+{
+	struct timespec EndTime;
+	clock_gettime (CLOCK_MONOTONIC, &EndTime);
 
-	Computer.Run ();
+	double fSeconds =   (EndTime.tv_sec - pStartTime->tv_sec)
+			  + (EndTime.tv_nsec - pStartTime->tv_nsec) / 1000000000.0;
 
-	return 0;
+	fprintf (stderr, "Jobs:         %u in %.3f s, %.1f per second\n",
+		 nJobs, fSeconds, nJobs / fSeconds);
 }
 
 #endif
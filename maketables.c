@@ -8,25 +8,70 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "z80emu.h"
 
 /* Encoding for indirect or indexed 8-bit memory operands. */
 
 #define INDIRECT_HL     0x06
 
-static void     make_instruction_table (void);
+/* Maximum number of opcodes in a superinstruction. */
+
+#define MAX_FUSED       8
+
+/* Opcodes of the superinstructions read from the profile, indexed by their
+ * first opcode. fused_length[opcode] is 0, if opcode does not start one.
+ */
+
+static int      fused_opcodes[256][MAX_FUSED];
+static int      fused_length[256];
+
+static void     make_instruction_table (int i8080);
+static void     print_instruction (int i8080, int opcode, char *s, char *t);
+static int      z80_only_opcode (int opcode);
+static char     *specialized_instruction (int opcode);
+static char     *fusable_instruction (int opcode);
+static int      read_superinstructions (const char *filename);
+static int      superinstruction (int i8080, int opcode);
+static void     make_specialized_instructions (int i8080);
 static void     make_cb_instruction_table (void);
 static void     make_ed_instruction_table (void);
 
 static void     make_szyx_flags_table (void);
 static void     make_szyxp_flags_table (void);
 
-int main (void) 
+/* The optional argument is the profile with the superinstructions, see 
+ * read_superinstructions().
+ */
+
+int main (int argc, char *argv[]) 
 {
+        if (argc > 2) {
+
+                fprintf(stderr, "Usage: %s [superinstructions]\n", argv[0]);
+                return EXIT_FAILURE;
+
+        }
+
+        if (argc == 2 && !read_superinstructions(argv[1]))
+
+                return EXIT_FAILURE;
+
         printf("/* Generated file, see maketables.c. */\n\n");
 
-        make_instruction_table();
+        /* Tables of the 8080 core, see Z80_8080_ONLY in z80emu.h. */
+
+        printf("#ifdef Z80_8080_ONLY\n\n");
+        make_instruction_table(!0);
+        putchar('\n');
+        make_specialized_instructions(!0);
+        printf("#else\n\n");
+
+        make_instruction_table(0);
         putchar('\n');
+        make_specialized_instructions(0);
+        printf("#endif\n\n");
+
         make_cb_instruction_table();
         putchar('\n');
         make_ed_instruction_table();
@@ -39,9 +84,11 @@ int main (void)
         return EXIT_SUCCESS;
 }
 
-/* Make single opcodes instruction table. */
+/* Make single opcodes instruction table. If i8080 is not zero, the opcodes,
+ * which the 8080 does not have, are entered as Z80_ONLY.
+ */
 
-static void make_instruction_table (void)
+static void make_instruction_table (int i8080)
 {
         int             i, j, k;
         char            *s, *t;
@@ -58,10 +105,10 @@ static void make_instruction_table (void)
 
                         };
 
-        printf("static const unsigned char INSTRUCTION_TABLE[256] = {\n\n");
+        printf("static const unsigned short INSTRUCTION_TABLE[256] = {\n\n");
         for (k = 0; k < (1 << 6); k++) {
 
-                putchar('\t');
+                t = "";
                 i = k >> 3;
                 j = k & 0x07;
                 switch (j) {
@@ -137,11 +184,11 @@ static void make_instruction_table (void)
 
                                 if (j == 0x04)
 
-                                        printf("INC_");
+                                        t = "INC_";
 
                                 else 
 
-                                        printf("DEC_");
+                                        t = "DEC_";
 
                                 if (i == INDIRECT_HL)
 
@@ -196,10 +243,7 @@ static void make_instruction_table (void)
                         }
                         
                 }
-                printf("%s,\n", s);
-                if (j == 0x07)
-
-                        putchar('\n');
+                print_instruction(i8080, k, t, s);
 
         }
 
@@ -219,7 +263,7 @@ static void make_instruction_table (void)
 
                                 s = "NOP";
 
-                        printf("\t%s,\n", s);
+                        print_instruction(i8080, 0x40 + k, "", s);
 
                 } else {
 
@@ -239,12 +283,9 @@ static void make_instruction_table (void)
 
                                 t = "R";
 
-                        printf("\t%s%s,\n", s, t);
+                        print_instruction(i8080, 0x40 + k, s, t);
 
                 }
-                if (j == 0x07)
-
-                        putchar('\n');
 
         }
 
@@ -255,25 +296,23 @@ static void make_instruction_table (void)
                 s = accumulator_operations[i];
                 for (j = 0; j < (1 << 3); j++) {
 
-                        printf("\t%s_", s);
                         if (j == INDIRECT_HL)
 
-                                t = "INDIRECT_HL";
+                                t = "_INDIRECT_HL";
 
                         else
 
-                                t = "R";
+                                t = "_R";
 
-                        printf("%s,\n", t);
+                        print_instruction(i8080, 0x80 + (i << 3) + j, s, t);
 
                 }
-                putchar('\n');
 
         }
 
         for (k = 0; k < (1 << 6); k++) {
 
-                putchar('\t');
+                t = "";
                 i = k >> 3;
                 j = k & 0x07;
                 switch (j) {
@@ -366,7 +405,7 @@ static void make_instruction_table (void)
 
                         case 0x06: {
 
-                                printf("%s", accumulator_operations[i]);
+                                t = accumulator_operations[i];
                                 s = "_N";
                                 
                                 break;
@@ -379,15 +418,310 @@ static void make_instruction_table (void)
                         default:        s = "RST_P"; break;
 
                 }
-                printf("%s,\n", s);
-                if (j == 0x07)
-
-                        putchar('\n');
+                print_instruction(i8080, 0xc0 + k, t, s);
 
         }
         printf("};\n");
 }
 
+/* Print the entry of an opcode in INSTRUCTION_TABLE, whose instruction name is
+ * the concatenation of s and t. Specialized instructions and the first 
+ * opcodes of superinstructions are entered with their own instruction number.
+ */
+
+static void print_instruction (int i8080, int opcode, char *s, char *t)
+{
+        if (i8080 && z80_only_opcode(opcode))
+
+                printf("\tZ80_ONLY,\n");
+
+        else if (specialized_instruction(opcode) != NULL
+                 || superinstruction(i8080, opcode))
+
+                printf("\tSPECIALIZED(0x%02X),\n", opcode);
+
+        else
+
+                printf("\t%s%s,\n", s, t);
+
+        if ((opcode & 0x07) == 0x07)
+
+                putchar('\n');
+}
+
+/* Return true, if opcode is an unprefixed opcode or a prefix, which the 8080 
+ * does not have (EX AF, AF', DJNZ, JR, EXX, and the prefixes).
+ */
+
+static int z80_only_opcode (int opcode)
+{
+        switch (opcode) {
+
+                case 0x08: case 0x10: case 0x18: case 0x20:
+                case 0x28: case 0x30: case 0x38: case 0xcb:
+                case 0xd9: case 0xdd: case 0xed: case 0xfd:
+
+                        return !0;
+
+                default:
+
+                        return 0;
+
+        }
+}
+
+/* Return the name of the instruction, if opcode is an unprefixed instruction 
+ * with a register or condition operand, which gets a handler of its own (see
+ * SPECIALIZED() in instructions.h), otherwise NULL. 
+ */
+
+static char *specialized_instruction (int opcode)
+{
+        int             y, z;
+        static char     *alu_instructions[8] = {
+
+                                "ADD_R",
+                                "ADC_R",
+                                "SUB_R",
+                                "SBC_R",
+                                "AND_R",
+                                "XOR_R",
+                                "OR_R",
+                                "CP_R",
+
+                        };
+
+        y = (opcode >> 3) & 0x07;
+        z = opcode & 0x07;
+        switch (opcode >> 6) {
+
+                case 0: 
+
+                        switch (z) {
+
+                                case 0: return y >= 4 ? "JR_DD_E" : NULL;
+                                case 1: return y & 1 ? "ADD_HL_RR" : "LD_RR_NN";
+                                case 3: return y & 1 ? "DEC_RR" : "INC_RR";
+                                case 4: return y != INDIRECT_HL ? "INC_R" : NULL;
+                                case 5: return y != INDIRECT_HL ? "DEC_R" : NULL;
+                                case 6: return y != INDIRECT_HL ? "LD_R_N" : NULL;
+                                default: return NULL;
+
+                        }
+
+                case 1: 
+
+                        if (y == z)
+
+                                return NULL;
+
+                        else if (y == INDIRECT_HL)
+
+                                return "LD_INDIRECT_HL_R";
+
+                        else if (z == INDIRECT_HL)
+
+                                return "LD_R_INDIRECT_HL";
+
+                        else
+
+                                return "LD_R_R";
+
+                case 2: 
+
+                        return z != INDIRECT_HL ? alu_instructions[y] : NULL;
+
+                case 3: 
+                default:
+
+                        switch (z) {
+
+                                case 0: return "RET_CC";
+                                case 1: return y & 1 ? NULL : "POP_SS";
+                                case 2: return "JP_CC_NN";
+                                case 4: return "CALL_CC_NN";
+                                case 5: return y & 1 ? NULL : "PUSH_SS";
+                                default: return NULL;
+
+                        }
+
+        }
+}
+
+/* Return the name of the instruction, if opcode is an unprefixed instruction,
+ * which can be part of a superinstruction, otherwise NULL. These are the 
+ * specialized instructions and the instructions without operands, which have
+ * a name##_HANDLER macro in macros.h.
+ */
+
+static char *fusable_instruction (int opcode)
+{
+        switch (opcode) {
+
+                case 0x02: return "LD_INDIRECT_BC_A";
+                case 0x0a: return "LD_A_INDIRECT_BC";
+                case 0x10: return "DJNZ_E";
+                case 0x12: return "LD_INDIRECT_DE_A";
+                case 0x18: return "JR_E";
+                case 0x1a: return "LD_A_INDIRECT_DE";
+                case 0x32: return "LD_INDIRECT_NN_A";
+                case 0x3a: return "LD_A_INDIRECT_NN";
+                case 0xc3: return "JP_NN";
+                case 0xc9: return "RET";
+                case 0xcd: return "CALL_NN";
+                case 0xeb: return "EX_DE_HL";
+                default: return specialized_instruction(opcode);
+
+        }
+}
+
+/* Read the superinstructions from a profile. Each line has the opcodes of one
+ * superinstruction in hexadecimal, in the order of their execution, "#" starts
+ * a comment. Return false and print a message on error.
+ */
+
+static int read_superinstructions (const char *filename)
+{
+        FILE    *file;
+        char    line[256];
+        int     line_number;
+
+        if ((file = fopen(filename, "r")) == NULL) {
+
+                perror(filename);
+                return 0;
+
+        }
+
+        line_number = 0;
+        while (fgets(line, sizeof(line), file) != NULL) {
+
+                int     opcodes[MAX_FUSED], length;
+                char    *p;
+
+                line_number++;
+                if ((p = strchr(line, '#')) != NULL)
+
+                        *p = '\0';
+
+                length = 0;
+                for (p = strtok(line, " \t\r\n"); 
+                     p != NULL; 
+                     p = strtok(NULL, " \t\r\n")) {
+
+                        char    *end;
+                        long    opcode;
+
+                        opcode = strtol(p, &end, 16);
+                        if (*end != '\0' || opcode < 0 || opcode > 0xff
+                            || fusable_instruction(opcode) == NULL) {
+
+                                fprintf(stderr, 
+                                        "%s:%d: opcode \"%s\" cannot be "
+                                        "fused\n", 
+                                        filename, line_number, p);
+                                fclose(file);
+                                return 0;
+
+                        }
+
+                        if (length == MAX_FUSED) {
+
+                                fprintf(stderr, 
+                                        "%s:%d: more than %d opcodes\n",
+                                        filename, line_number, MAX_FUSED);
+                                fclose(file);
+                                return 0;
+
+                        }
+                        opcodes[length++] = opcode;
+
+                }
+
+                if (length == 0)
+
+                        continue;
+
+                if (length == 1 || fused_length[opcodes[0]] != 0) {
+
+                        fprintf(stderr, 
+                                "%s:%d: %s\n", 
+                                filename, line_number,
+                                length == 1
+                                        ? "single opcode"
+                                        : "first opcode already used");
+                        fclose(file);
+                        return 0;
+
+                }
+
+                memcpy(fused_opcodes[opcodes[0]], opcodes, sizeof(opcodes));
+                fused_length[opcodes[0]] = length;
+
+        }
+
+        fclose(file);
+
+        return !0;
+}
+
+/* Return true, if opcode starts a superinstruction. If i8080 is not zero, 
+ * superinstructions with Z80-only opcodes are left out.
+ */
+
+static int superinstruction (int i8080, int opcode)
+{
+        int     i;
+
+        for (i = 0; i < fused_length[opcode]; i++)
+
+                if (i8080 && z80_only_opcode(fused_opcodes[opcode][i]))
+
+                        return 0;
+
+        return fused_length[opcode] != 0;
+}
+
+/* Make the list of specialized instructions, SPECIALIZED_INSTRUCTIONS(X) 
+ * expands to X(name, opcode, fused) for each of them. fused is empty or, if
+ * opcode starts a superinstruction, FUSE(name, opcode) for each following
+ * opcode (see SPECIALIZED_HANDLER in macros.h). If i8080 is not zero, the
+ * Z80-only opcodes are left out.
+ */
+
+static void make_specialized_instructions (int i8080)
+{
+        int     i, j;
+
+        printf("#define SPECIALIZED_INSTRUCTIONS(X)\t\\\n");
+        for (i = 0; i < 256; i++) {
+
+                if (i8080 && z80_only_opcode(i))
+
+                        continue;
+
+                if (superinstruction(i8080, i)) {
+
+                        printf("\tX(%s, 0x%02X,", fusable_instruction(i), i);
+                        for (j = 1; j < fused_length[i]; j++)
+
+                                printf(" FUSE(%s, 0x%02X)", 
+                                        fusable_instruction(
+                                                fused_opcodes[i][j]),
+                                        fused_opcodes[i][j]);
+
+                        printf(")\t\\\n");
+
+                } else if (specialized_instruction(i) != NULL)
+
+                        printf("\tX(%s, 0x%02X, )\t\\\n", 
+                                specialized_instruction(i), i);
+
+        }
+
+        printf("\n");
+}
+
 /* Make 0xcb prefixed opcodes instruction table. */
 
 static void make_cb_instruction_table (void)
@@ -45,15 +45,31 @@ void CMultiCoreEmulation::Run (unsigned nCore)
 	// Core 0 handles the IRQs by default and does not need a special handling here.
 	// 	It is halted automatically when core 1 terminates.
 
-	// Core 2 and 3 are not used and can halt immediately.
+	// Core 2 writes the console output to the screen and core 3 saves the RAM
+	// 	disks in the background, until core 1 terminates.
 
-	if (nCore == 1)
+	switch (nCore)
 	{
+	case 1:
 		assert (m_pComputer != 0);
 		m_pComputer->Run ();
 
 		assert (m_pFileSystem != 0);
 		m_pFileSystem->UnMount ();
+		break;
+
+	case 2:
+		assert (m_pComputer != 0);
+		m_pComputer->RunScreen ();
+		break;
+
+	case 3:
+		assert (m_pComputer != 0);
+		m_pComputer->RunDiskSave ();
+		break;
+
+	default:
+		break;
 	}
 }
 
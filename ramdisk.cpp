@@ -21,6 +21,7 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
 #include "ramdisk.h"
+#include "disklabel.h"
 #include "config.h"
 #include <assert.h>
 
@@ -30,6 +31,11 @@
 #else
 	#include <stdio.h>
 	#include <string.h>
+	#include <stdint.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
 #endif
 
 #ifdef __circle__
@@ -45,44 +51,168 @@ CRAMDisk::CRAMDisk (unsigned nDrive)
 #endif
 	m_nDrive (nDrive),
 	m_bAvailable (FALSE),
+	m_nSectors (0),
+	m_nSize (0),
 	m_bWritten (FALSE),
-	m_pBuffer (0)
+	m_pDirtyMap (0),
+	m_pBuffer (0),
+#ifndef __circle__
+	m_Mapping (DiskMapNone),
+	m_bMapped (FALSE),
+	m_bOverlay (FALSE),
+	m_pDeltaIndex (0),
+	m_ppDeltaChunk (0),
+	m_nDeltaChunks (0),
+	m_nDeltaSectors (0),
+#endif
+	m_bSaveStatus (TRUE)
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+	, m_pSnapshot (0),
+	m_bSnapshotPending (FALSE)
+#endif
 {
+	assert (m_nDrive < DISK_DRIVES);
+
+	// "cpmdisk.bin" for A:, "cpmdisk<n>.bin" for the others
+	if (m_nDrive == 0)
+	{
+		strcpy (m_Filename, DISK_A_FILENAME);
+	}
+	else
+	{
+		char *p = m_Filename;
+		strcpy (p, DISK_FILENAME_PREFIX);
+		p += strlen (p);
+
+		unsigned nNumber = m_nDrive + 1;
+		if (nNumber >= 10)
+		{
+			*p++ = '0' + nNumber / 10;
+		}
+		*p++ = '0' + nNumber % 10;
+
+		strcpy (p, DISK_FILENAME_SUFFIX);
+	}
+	assert (strlen (m_Filename) < sizeof m_Filename);
 }
 
 CRAMDisk::~CRAMDisk (void)
 {
-	delete (m_pBuffer);
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+	delete [] m_pSnapshot;
+	m_pSnapshot = 0;
+#endif
+
+#ifndef __circle__
+	FreeDelta ();
+
+	if (m_bMapped)
+	{
+		munmap (m_pBuffer, m_nSize);
+		m_pBuffer = 0;
+	}
+#endif
+
+	delete [] m_pBuffer;
 	m_pBuffer = 0;
+
+	delete [] m_pDirtyMap;
+	m_pDirtyMap = 0;
 }
 
-boolean CRAMDisk::Initialize (void)
+#ifndef __circle__
+
+void CRAMDisk::SetMapping (TDiskMapping Mapping)
 {
-	assert (m_pBuffer == 0);
-	m_pBuffer = new u8[DISK_SIZE];
-	assert (m_pBuffer != 0);
+	assert (!m_bAvailable);
+	m_Mapping = Mapping;
+}
 
-	assert (m_nDrive <= 1);
-	const char *pFilename = m_nDrive == 0 ? DISK_A_FILENAME : DISK_B_FILENAME;
+#endif
+
+boolean CRAMDisk::Initialize (void)
+{
+	u8 FirstSector[SECTOR_SIZE];
 
 #ifdef __circle__
 	assert (m_pFileSystem != 0);
-	unsigned hFile = m_pFileSystem->FileOpen (pFilename);
+	unsigned hFile = m_pFileSystem->FileOpen (m_Filename);
 	if (hFile == 0)
 	{
 		if (m_nDrive == 0)
 		{
-			CLogger::Get ()->Write (FromRAMDisk, LogError, "File not found: %s", pFilename);
+			CLogger::Get ()->Write (FromRAMDisk, LogError, "File not found: %s", m_Filename);
+		}
+
+		return FALSE;
+	}
+
+	if (   m_pFileSystem->FileRead (hFile, FirstSector, SECTOR_SIZE) != SECTOR_SIZE
+	    || !SetGeometry (FirstSector))
+	{
+		CLogger::Get ()->Write (FromRAMDisk, LogError, "Invalid disk image: %s", m_Filename);
+
+		m_pFileSystem->FileClose (hFile);
+
+		return FALSE;
+	}
+#else
+	FILE *pFile = fopen (m_Filename, "r");
+	if (pFile == 0)
+	{
+		if (m_nDrive == 0)
+		{
+			fprintf (stderr, "File not found: %s\n", m_Filename);
 		}
 
 		return FALSE;
 	}
 
-	u8 *pReadPtr = m_pBuffer;
-	for (unsigned nTrack = 0; nTrack < TRACK_COUNT; nTrack++)
+	if (   fread (FirstSector, SECTOR_SIZE, 1, pFile) != 1
+	    || !SetGeometry (FirstSector))
+	{
+		fprintf (stderr, "Invalid disk image: %s\n", m_Filename);
+
+		fclose (pFile);
+
+		return FALSE;
+	}
+#endif
+
+	assert (m_pDirtyMap == 0);
+	m_pDirtyMap = new u8[(m_nSectors+7) / 8];
+	assert (m_pDirtyMap != 0);
+	ClearDirty ();
+
+#ifndef __circle__
+	if (   m_Mapping != DiskMapNone
+	    && MapImage ())
+	{
+		fclose (pFile);
+
+		m_bAvailable = TRUE;
+
+		return TRUE;
+	}
+#endif
+
+	assert (m_pBuffer == 0);
+	m_pBuffer = new u8[m_nSize];
+	assert (m_pBuffer != 0);
+
+	memcpy (m_pBuffer, FirstSector, SECTOR_SIZE);
+
+#ifdef __circle__
+	unsigned nTrackSize = m_Geometry.nSectorsPerTrack * SECTOR_SIZE;
+
+	u8 *pReadPtr = m_pBuffer + SECTOR_SIZE;
+	unsigned nBytesLeft = m_nSize - SECTOR_SIZE;
+	while (nBytesLeft > 0)
 	{
-		unsigned nResult = m_pFileSystem->FileRead (hFile, pReadPtr, TRACK_SIZE);
-		if (nResult != TRACK_SIZE)
+		unsigned nBytes = nBytesLeft < nTrackSize ? nBytesLeft : nTrackSize;
+
+		unsigned nResult = m_pFileSystem->FileRead (hFile, pReadPtr, nBytes);
+		if (nResult != nBytes)
 		{
 			CLogger::Get ()->Write (FromRAMDisk, LogError, "Error loading RAM disk");
 
@@ -91,7 +221,8 @@ boolean CRAMDisk::Initialize (void)
 			return FALSE;
 		}
 
-		pReadPtr += TRACK_SIZE;
+		pReadPtr += nBytes;
+		nBytesLeft -= nBytes;
 	}
 
 	if (!m_pFileSystem->FileClose (hFile))
@@ -101,18 +232,7 @@ boolean CRAMDisk::Initialize (void)
 		return FALSE;
 	}
 #else
-	FILE *pFile = fopen (pFilename, "r");
-	if (pFile == 0)
-	{
-		if (m_nDrive == 0)
-		{
-			fprintf (stderr, "File not found: %s\n", pFilename);
-		}
-
-		return FALSE;
-	}
-
-	if (fread (m_pBuffer, SECTOR_SIZE, SECTOR_COUNT, pFile) != SECTOR_COUNT)
+	if (fread (m_pBuffer + SECTOR_SIZE, SECTOR_SIZE, m_nSectors-1, pFile) != m_nSectors-1)
 	{
 		fprintf (stderr, "Error loading RAM disk\n");
 
@@ -134,38 +254,106 @@ boolean CRAMDisk::IsAvailable (void) const
 	return m_bAvailable;
 }
 
-boolean CRAMDisk::Read (unsigned nSector, void *pBuffer)
+const TDiskGeometry *CRAMDisk::GetGeometry (void) const
+{
+	assert (m_bAvailable);
+	return &m_Geometry;
+}
+
+unsigned CRAMDisk::GetSectorCount (void) const
 {
 	assert (m_bAvailable);
+	return m_nSectors;
+}
+
+#ifndef __circle__
 
-	unsigned nOffset = nSector * SECTOR_SIZE;
-	if (nOffset + SECTOR_SIZE > DISK_SIZE)
+const char *CRAMDisk::GetFileName (void) const
+{
+	return m_Filename;
+}
+
+#endif
+
+boolean CRAMDisk::Read (unsigned nSector, unsigned nCount, void *pBuffer)
+{
+	assert (m_bAvailable);
+
+	if (   nCount > m_nSectors
+	    || nSector > m_nSectors - nCount)
 	{
 		return FALSE;
 	}
 
 	assert (pBuffer != 0);
 	assert (m_pBuffer != 0);
-	memcpy (pBuffer, m_pBuffer + nOffset, SECTOR_SIZE);
+#ifndef __circle__
+	if (m_pDeltaIndex != 0)
+	{
+		u8 *pTo = (u8 *) pBuffer;
+		for (unsigned i = 0; i < nCount; i++, nSector++, pTo += SECTOR_SIZE)
+		{
+			const u8 *pFrom = GetDeltaSector (nSector, FALSE);
+			if (pFrom == 0)
+			{
+				pFrom = m_pBuffer + nSector * SECTOR_SIZE;
+			}
+
+			memcpy (pTo, pFrom, SECTOR_SIZE);
+		}
+
+		return TRUE;
+	}
+#endif
+	memcpy (pBuffer, m_pBuffer + nSector * SECTOR_SIZE, nCount * SECTOR_SIZE);
+
+	return TRUE;
+}
+
+boolean CRAMDisk::Write (unsigned nSector, unsigned nCount, const void *pBuffer)
+{
+	if (!Load (nSector, nCount, pBuffer))
+	{
+		return FALSE;
+	}
+
+	m_bWritten = TRUE;
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		SetDirty (nSector + i);
+	}
 
 	return TRUE;
 }
 
-boolean CRAMDisk::Write (unsigned nSector, const void *pBuffer)
+boolean CRAMDisk::Load (unsigned nSector, unsigned nCount, const void *pBuffer)
 {
 	assert (m_bAvailable);
 
-	unsigned nOffset = nSector * SECTOR_SIZE;
-	if (nOffset + SECTOR_SIZE > DISK_SIZE)
+	if (   nCount > m_nSectors
+	    || nSector > m_nSectors - nCount)
 	{
 		return FALSE;
 	}
 
 	assert (m_pBuffer != 0);
 	assert (pBuffer != 0);
-	memcpy (m_pBuffer + nOffset, pBuffer, SECTOR_SIZE);
-
-	m_bWritten = TRUE;
+#ifndef __circle__
+	if (m_bOverlay)
+	{
+		const u8 *pFrom = (const u8 *) pBuffer;
+		for (unsigned i = 0; i < nCount; i++, pFrom += SECTOR_SIZE)
+		{
+			u8 *pTo = GetDeltaSector (nSector + i, TRUE);
+			assert (pTo != 0);
+			memcpy (pTo, pFrom, SECTOR_SIZE);
+		}
+	}
+	else
+#endif
+	{
+		memcpy (m_pBuffer + nSector * SECTOR_SIZE, pBuffer, nCount * SECTOR_SIZE);
+	}
 
 	return TRUE;
 }
@@ -179,25 +367,440 @@ boolean CRAMDisk::Save (void)
 		return TRUE;
 	}
 
-	assert (m_nDrive <= 1);
-	const char *pFilename = m_nDrive == 0 ? DISK_A_FILENAME : DISK_B_FILENAME;
+	assert (m_pBuffer != 0);
+
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+	// Writing the image to the SD card takes long. Core 3 does it from a copy,
+	// while the emulation continues and may write the disk again.
+	while (IsSaving ())
+	{
+		// wait for the previous snapshot
+	}
+
+	if (m_pSnapshot == 0)
+	{
+		m_pSnapshot = new u8[m_nSize];
+		assert (m_pSnapshot != 0);
+	}
+
+	memcpy (m_pSnapshot, m_pBuffer, m_nSize);
+	m_bWritten = FALSE;
+	ClearDirty ();
+
+	__atomic_store_n (&m_bSnapshotPending, TRUE, __ATOMIC_RELEASE);
+
+	return TRUE;
+#else
+#ifdef __circle__
+	// CFATFileSystem can only write a file from the beginning
+	m_bSaveStatus = WriteImage (m_pBuffer);
+#else
+	if (m_Mapping == DiskMapPrivate)
+	{
+		m_bSaveStatus = TRUE;		// scratch disk, even if it was not mapped
+	}
+	else if (!m_bMapped)
+	{
+		m_bSaveStatus = WriteDirtySectors ();
+	}
+	else if (m_Mapping == DiskMapShared)
+	{
+		m_bSaveStatus = SyncDirtySectors ();
+	}
+	else
+	{
+		assert (m_Mapping == DiskMapOverlay);
+		m_bSaveStatus = CommitDelta ();
+	}
+#endif
+	if (m_bSaveStatus)
+	{
+		m_bWritten = FALSE;
+		ClearDirty ();
+	}
+
+	return m_bSaveStatus;
+#endif
+}
+
+boolean CRAMDisk::IsSaving (void) const
+{
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+	return __atomic_load_n (&m_bSnapshotPending, __ATOMIC_ACQUIRE);
+#else
+	return FALSE;
+#endif
+}
+
+boolean CRAMDisk::GetSaveStatus (void) const
+{
+	return m_bSaveStatus;
+}
+
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+
+boolean CRAMDisk::WriteSnapshot (void)
+{
+	if (!IsSaving ())
+	{
+		return FALSE;
+	}
+
+	assert (m_pSnapshot != 0);
+	m_bSaveStatus = WriteImage (m_pSnapshot);
+
+	__atomic_store_n (&m_bSnapshotPending, FALSE, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
+
+#endif
+
+#ifndef __circle__
+
+// writes the runs of dirty sectors into the existing image file
+boolean CRAMDisk::WriteDirtySectors (void)
+{
+	FILE *pFile = fopen (m_Filename, "r+");
+	if (pFile == 0)
+	{
+		return WriteImage (m_pBuffer);
+	}
+
+	assert (m_pBuffer != 0);
+	unsigned nSector = 0;
+	while (nSector < m_nSectors)
+	{
+		if (!IsDirty (nSector))
+		{
+			nSector++;
+
+			continue;
+		}
+
+		unsigned nFirstSector = nSector;
+		while (   nSector < m_nSectors
+		       && IsDirty (nSector))
+		{
+			nSector++;
+		}
+
+		unsigned nSectors = nSector - nFirstSector;
+		if (   fseek (pFile, nFirstSector * SECTOR_SIZE, SEEK_SET) != 0
+		    || fwrite (m_pBuffer + nFirstSector * SECTOR_SIZE, SECTOR_SIZE,
+			       nSectors, pFile) != nSectors)
+		{
+			fprintf (stderr, "Error saving RAM disk\n");
+
+			fclose (pFile);
+
+			return FALSE;
+		}
+	}
+
+	if (fclose (pFile) != 0)
+	{
+		fprintf (stderr, "Error saving RAM disk\n");
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// maps the image file, so that its pages are loaded on demand
+boolean CRAMDisk::MapImage (void)
+{
+	assert (!m_bMapped);
+
+	// an overlay disk maps the image read-only, so that its pages are shared
+	// with other instances using the same image
+	boolean bOverlay = m_Mapping != DiskMapShared;
+
+	int nFile = open (m_Filename, bOverlay ? O_RDONLY : O_RDWR);
+	if (nFile < 0)
+	{
+		return FALSE;
+	}
+
+	struct stat Stat;
+	if (   fstat (nFile, &Stat) < 0
+	    || Stat.st_size < m_nSize)
+	{
+		close (nFile);
+
+		return FALSE;
+	}
+
+	void *pMapping = mmap (0, m_nSize, bOverlay ? PROT_READ : PROT_READ | PROT_WRITE,
+			       MAP_SHARED, nFile, 0);
+	close (nFile);				// the mapping stays valid
+	if (pMapping == MAP_FAILED)
+	{
+		return FALSE;
+	}
+
+	m_pBuffer = (u8 *) pMapping;
+	m_bMapped = TRUE;
+	m_bOverlay = bOverlay;
+
+	return TRUE;
+}
+
+// writes the pages with dirty sectors of a shared mapping to the file
+boolean CRAMDisk::SyncDirtySectors (void)
+{
+	assert (m_bMapped);
+	assert (m_pBuffer != 0);
+
+	uintptr_t nPageMask = sysconf (_SC_PAGESIZE) - 1;
+
+	unsigned nSector = 0;
+	while (nSector < m_nSectors)
+	{
+		if (!IsDirty (nSector))
+		{
+			nSector++;
+
+			continue;
+		}
+
+		unsigned nFirstSector = nSector;
+		while (   nSector < m_nSectors
+		       && IsDirty (nSector))
+		{
+			nSector++;
+		}
+
+		uintptr_t nStart = (uintptr_t) (m_pBuffer + nFirstSector * SECTOR_SIZE);
+		uintptr_t nEnd = (uintptr_t) (m_pBuffer + nSector * SECTOR_SIZE);
+		nStart &= ~nPageMask;		// msync() needs a page aligned address
+
+		if (msync ((void *) nStart, nEnd - nStart, MS_SYNC) < 0)
+		{
+			fprintf (stderr, "Error saving RAM disk\n");
+
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
 
+u8 *CRAMDisk::GetDeltaSector (unsigned nSector, boolean bAllocate)
+{
+	assert (m_bOverlay);
+	assert (nSector < m_nSectors);
+
+	if (m_pDeltaIndex == 0)
+	{
+		if (!bAllocate)
+		{
+			return 0;
+		}
+
+		m_pDeltaIndex = new u32[m_nSectors];
+		assert (m_pDeltaIndex != 0);
+		memset (m_pDeltaIndex, 0, m_nSectors * sizeof (u32));
+	}
+
+	unsigned nSlot = m_pDeltaIndex[nSector];
+	if (nSlot == 0)
+	{
+		if (!bAllocate)
+		{
+			return 0;
+		}
+
+		nSlot = m_nDeltaSectors++;
+		unsigned nChunk = nSlot / DISK_DELTA_CHUNK;
+		if (nChunk >= m_nDeltaChunks)
+		{
+			unsigned nChunks = m_nDeltaChunks != 0 ? m_nDeltaChunks * 2 : 16;
+			u8 **ppDeltaChunk = new u8 *[nChunks];
+			assert (ppDeltaChunk != 0);
+
+			for (unsigned i = 0; i < nChunks; i++)
+			{
+				ppDeltaChunk[i] = i < m_nDeltaChunks ? m_ppDeltaChunk[i] : 0;
+			}
+
+			delete [] m_ppDeltaChunk;
+			m_ppDeltaChunk = ppDeltaChunk;
+			m_nDeltaChunks = nChunks;
+		}
+
+		if (m_ppDeltaChunk[nChunk] == 0)
+		{
+			m_ppDeltaChunk[nChunk] = new u8[DISK_DELTA_CHUNK * SECTOR_SIZE];
+			assert (m_ppDeltaChunk[nChunk] != 0);
+		}
+
+		m_pDeltaIndex[nSector] = ++nSlot;
+	}
+
+	nSlot--;
+	assert (m_ppDeltaChunk != 0);
+	return m_ppDeltaChunk[nSlot / DISK_DELTA_CHUNK] + nSlot % DISK_DELTA_CHUNK * SECTOR_SIZE;
+}
+
+// writes the dirty sectors of the delta layer into the image file, which
+// contains them afterwards, so that the delta can be dropped
+boolean CRAMDisk::CommitDelta (void)
+{
+	int nFile = open (m_Filename, O_WRONLY);
+	if (nFile < 0)
+	{
+		fprintf (stderr, "Cannot open: %s\n", m_Filename);
+
+		return FALSE;
+	}
+
+	for (unsigned nSector = 0; nSector < m_nSectors; nSector++)
+	{
+		if (!IsDirty (nSector))
+		{
+			continue;
+		}
+
+		const u8 *pSector = GetDeltaSector (nSector, FALSE);
+		assert (pSector != 0);
+		if (pwrite (nFile, pSector, SECTOR_SIZE, nSector * SECTOR_SIZE) != SECTOR_SIZE)
+		{
+			fprintf (stderr, "Error saving RAM disk\n");
+
+			close (nFile);
+
+			return FALSE;
+		}
+	}
+
+	if (close (nFile) < 0)
+	{
+		fprintf (stderr, "Error saving RAM disk\n");
+
+		return FALSE;
+	}
+
+	// the shared mapping shows the written sectors now
+	FreeDelta ();
+
+	return TRUE;
+}
+
+void CRAMDisk::FreeDelta (void)
+{
+	for (unsigned i = 0; i < m_nDeltaChunks; i++)
+	{
+		delete [] m_ppDeltaChunk[i];
+	}
+
+	delete [] m_ppDeltaChunk;
+	m_ppDeltaChunk = 0;
+	m_nDeltaChunks = 0;
+	m_nDeltaSectors = 0;
+
+	delete [] m_pDeltaIndex;
+	m_pDeltaIndex = 0;
+}
+
+#endif
+
+void CRAMDisk::SetDirty (unsigned nSector)
+{
+	assert (nSector < m_nSectors);
+	assert (m_pDirtyMap != 0);
+	m_pDirtyMap[nSector / 8] |= 1 << (nSector % 8);
+}
+
+boolean CRAMDisk::IsDirty (unsigned nSector) const
+{
+	assert (nSector < m_nSectors);
+	assert (m_pDirtyMap != 0);
+	return m_pDirtyMap[nSector / 8] & (1 << (nSector % 8)) ? TRUE : FALSE;
+}
+
+void CRAMDisk::ClearDirty (void)
+{
+	assert (m_pDirtyMap != 0);
+	memset (m_pDirtyMap, 0, (m_nSectors+7) / 8);
+}
+
+boolean CRAMDisk::SetGeometry (const u8 *pFirstSector)
+{
+	assert (pFirstSector != 0);
+	const TDiskLabel *pLabel = (const TDiskLabel *) pFirstSector;
+
+	if (memcmp (pLabel->Magic, DISK_LABEL_MAGIC, sizeof pLabel->Magic) == 0)
+	{
+		m_Geometry.nTracks           = pLabel->nTracks;
+		m_Geometry.nSectorsPerTrack  = pLabel->nSectorsPerTrack;
+		m_Geometry.nReservedTracks   = pLabel->nReservedTracks;
+		m_Geometry.nBlockSize        = pLabel->nBlockSize;
+		m_Geometry.nDirectoryEntries = pLabel->nDirectoryEntries;
+	}
+	else
+	{
+		m_Geometry.nTracks           = TRACK_COUNT;
+		m_Geometry.nSectorsPerTrack  = SECTORS_PER_TRACK;
+		m_Geometry.nReservedTracks   = RESERVED_TRACKS;
+		m_Geometry.nBlockSize        = BLOCK_SIZE;
+		m_Geometry.nDirectoryEntries = DIRECTORY_ENTRIES;
+	}
+
+	// the limits of the CP/M 2.2 disk parameter block and of the disk ports
+	if (   m_Geometry.nSectorsPerTrack == 0
+	    || m_Geometry.nSectorsPerTrack > 255
+	    || m_Geometry.nReservedTracks == 0
+	    || m_Geometry.nReservedTracks >= m_Geometry.nTracks
+	    || m_Geometry.nBlockSize < 1024
+	    || m_Geometry.nBlockSize > 16384
+	    || (m_Geometry.nBlockSize & (m_Geometry.nBlockSize-1)) != 0
+	    || m_Geometry.nDirectoryEntries == 0)
+	{
+		return FALSE;
+	}
+
+	unsigned nDataSize =   (m_Geometry.nTracks - m_Geometry.nReservedTracks)
+			     * m_Geometry.nSectorsPerTrack * SECTOR_SIZE;
+	unsigned nBlocks = nDataSize / m_Geometry.nBlockSize;
+	unsigned nDirectoryBlocks =   (m_Geometry.nDirectoryEntries * 32 + m_Geometry.nBlockSize-1)
+				    / m_Geometry.nBlockSize;
+
+	if (   nDataSize > DISK_MAX_DATA_SIZE
+	    || (m_Geometry.nBlockSize == 1024 && nBlocks > 256)
+	    || nDirectoryBlocks > 16
+	    || nDirectoryBlocks >= nBlocks)
+	{
+		return FALSE;
+	}
+
+	m_nSectors = m_Geometry.nTracks * m_Geometry.nSectorsPerTrack;
+	m_nSize = m_nSectors * SECTOR_SIZE;
+
+	return TRUE;
+}
+
+boolean CRAMDisk::WriteImage (const u8 *pBuffer)
+{
 #ifdef __circle__
 	assert (m_pFileSystem != 0);
-	unsigned hFile = m_pFileSystem->FileCreate (pFilename);
+	unsigned hFile = m_pFileSystem->FileCreate (m_Filename);
 	if (hFile == 0)
 	{
-		CLogger::Get ()->Write (FromRAMDisk, LogError, "Cannot create file: %s", pFilename);
+		CLogger::Get ()->Write (FromRAMDisk, LogError, "Cannot create file: %s", m_Filename);
 
 		return FALSE;
 	}
 
-	assert (m_pBuffer != 0);
-	u8 *pWritePtr = m_pBuffer;
-	for (unsigned nTrack = 0; nTrack < TRACK_COUNT; nTrack++)
+	unsigned nTrackSize = m_Geometry.nSectorsPerTrack * SECTOR_SIZE;
+
+	assert (pBuffer != 0);
+	const u8 *pWritePtr = pBuffer;
+	for (unsigned nTrack = 0; nTrack < m_Geometry.nTracks; nTrack++)
 	{
-		unsigned nResult = m_pFileSystem->FileWrite (hFile, pWritePtr, TRACK_SIZE);
-		if (nResult != TRACK_SIZE)
+		unsigned nResult = m_pFileSystem->FileWrite (hFile, pWritePtr, nTrackSize);
+		if (nResult != nTrackSize)
 		{
 			CLogger::Get ()->Write (FromRAMDisk, LogError, "Error saving RAM disk");
 
@@ -206,7 +809,7 @@ boolean CRAMDisk::Save (void)
 			return FALSE;
 		}
 
-		pWritePtr += TRACK_SIZE;
+		pWritePtr += nTrackSize;
 	}
 
 	if (!m_pFileSystem->FileClose (hFile))
@@ -216,16 +819,16 @@ boolean CRAMDisk::Save (void)
 		return FALSE;
 	}
 #else
-	FILE *pFile = fopen (pFilename, "w");
+	FILE *pFile = fopen (m_Filename, "w");
 	if (pFile == 0)
 	{
-		fprintf (stderr, "Cannot create: %s\n", pFilename);
+		fprintf (stderr, "Cannot create: %s\n", m_Filename);
 
 		return FALSE;
 	}
 
-	assert (m_pBuffer != 0);
-	if (fwrite (m_pBuffer, SECTOR_SIZE, SECTOR_COUNT, pFile) != SECTOR_COUNT)
+	assert (pBuffer != 0);
+	if (fwrite (pBuffer, SECTOR_SIZE, m_nSectors, pFile) != m_nSectors)
 	{
 		fprintf (stderr, "Error saving RAM disk\n");
 
@@ -23,10 +23,32 @@
 #ifndef _ramdisk_h
 #define _ramdisk_h
 
+#include "config.h"
 #include "types.h"
 
 #ifdef __circle__
 	#include <circle/fs/fat/fatfs.h>
+	#include <circle/sysconfig.h>
+#endif
+
+struct TDiskGeometry
+{
+	unsigned nTracks;		// including reserved tracks
+	unsigned nSectorsPerTrack;
+	unsigned nReservedTracks;
+	unsigned nBlockSize;		// byte size of an allocation block
+	unsigned nDirectoryEntries;
+};
+
+#ifndef __circle__
+enum TDiskMapping
+{
+	DiskMapNone,		// the image is read into the heap
+	DiskMapShared,		// the image is mapped, changes go to the file
+	DiskMapOverlay,		// the image is mapped read-only, changes are kept in
+				// a delta layer and written back by Save ()
+	DiskMapPrivate		// like DiskMapOverlay, but changes are discarded (scratch disk)
+};
 #endif
 
 class CRAMDisk
@@ -39,25 +61,98 @@ public:
 #endif
 	~CRAMDisk (void);
 
+#ifndef __circle__
+	void SetMapping (TDiskMapping Mapping);	// call this before Initialize ()
+#endif
+
 	boolean Initialize (void);
 
 	boolean IsAvailable (void) const;
 
-	boolean Read (unsigned nSector, void *pBuffer);
-	boolean Write (unsigned nSector, const void *pBuffer);
+	const TDiskGeometry *GetGeometry (void) const;
+	unsigned GetSectorCount (void) const;
+
+	// transfer nCount consecutive sectors
+	boolean Read (unsigned nSector, unsigned nCount, void *pBuffer);
+	boolean Write (unsigned nSector, unsigned nCount, const void *pBuffer);
 
+	// like Write (), but the sectors are not marked as written (e.g. to
+	// restore a snapshot, which has been taken from the saved images)
+	boolean Load (unsigned nSector, unsigned nCount, const void *pBuffer);
+
+	// with multi-core support only a snapshot is taken, see WriteSnapshot ()
 	boolean Save (void);
 
+	boolean IsSaving (void) const;		// a snapshot is written in the background
+	boolean GetSaveStatus (void) const;	// FALSE if the last save failed
+
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+	boolean WriteSnapshot (void);		// on core 3, returns TRUE if one was written
+#endif
+
+#ifndef __circle__
+	const char *GetFileName (void) const;	// of the disk image
+
+	// the sector has been written since Initialize () or the last Save ()
+	boolean IsDirty (unsigned nSector) const;
+#endif
+
+private:
+	boolean SetGeometry (const u8 *pFirstSector);	// from the disk label, if any
+
+	boolean WriteImage (const u8 *pBuffer);
+#ifndef __circle__
+	boolean WriteDirtySectors (void);
+
+	boolean MapImage (void);
+	boolean SyncDirtySectors (void);
+
+	u8 *GetDeltaSector (unsigned nSector, boolean bAllocate);	// 0 if not in delta
+	boolean CommitDelta (void);
+	void FreeDelta (void);
+#endif
+
+	void SetDirty (unsigned nSector);
+#ifdef __circle__
+	boolean IsDirty (unsigned nSector) const;
+#endif
+	void ClearDirty (void);
+
 private:
 #ifdef __circle__
 	CFATFileSystem *m_pFileSystem;
 #endif
-	unsigned m_nDrive;	// 0 or 1
+	unsigned m_nDrive;	// 0 (A:) to DISK_DRIVES-1
+	char m_Filename[20];
 	boolean m_bAvailable;
 
+	TDiskGeometry m_Geometry;
+	unsigned m_nSectors;	// total number of sectors
+	unsigned m_nSize;	// in bytes
+
 	boolean m_bWritten;
+	u8 *m_pDirtyMap;	// one bit per sector written since the last save
+
+	u8 *m_pBuffer;		// the mapped image with DiskMapShared/Private
+#ifndef __circle__
+	TDiskMapping m_Mapping;
+	boolean m_bMapped;	// FALSE if mapping failed
+	boolean m_bOverlay;	// the mapping is read-only, writes go to the delta
 
-	u8 *m_pBuffer;
+	// The delta layer holds the written sectors of an overlay disk. It is
+	// allocated on the first write and grows in chunks of DISK_DELTA_CHUNK
+	// sectors, so that the base image can be shared by many instances.
+	u32 *m_pDeltaIndex;	// slot+1 of each sector in the delta, 0 if unchanged
+	u8 **m_ppDeltaChunk;
+	unsigned m_nDeltaChunks;	// size of m_ppDeltaChunk
+	unsigned m_nDeltaSectors;	// used slots
+#endif
+
+	volatile boolean m_bSaveStatus;
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+	u8 *m_pSnapshot;
+	volatile boolean m_bSnapshotPending;	// set by core 1, cleared by core 3
+#endif
 };
 
 #endif
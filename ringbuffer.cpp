@@ -0,0 +1,132 @@
+//
+// ringbuffer.cpp
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "ringbuffer.h"
+#include <assert.h>
+
+// The indices are accessed with acquire/release semantics, so that the data
+// is visible to the other side, before the updated index is.
+#define LOAD_INDEX(index)		__atomic_load_n (&(index), __ATOMIC_ACQUIRE)
+#define STORE_INDEX(index, value)	__atomic_store_n (&(index), (value), __ATOMIC_RELEASE)
+
+CRingBuffer::CRingBuffer (unsigned nSize)
+:	m_pBuffer (new u8[nSize]),
+	m_nMask (nSize-1),
+	m_nIn (0),
+	m_nOut (0),
+	m_nHighWater (0)
+{
+	assert (nSize >= 2);
+	assert ((nSize & (nSize-1)) == 0);
+	assert (m_pBuffer != 0);
+}
+
+CRingBuffer::~CRingBuffer (void)
+{
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+unsigned CRingBuffer::GetFree (void) const
+{
+	return (LOAD_INDEX (m_nOut) - m_nIn - 1) & m_nMask;
+}
+
+boolean CRingBuffer::Put (u8 ucByte)
+{
+	return Put (&ucByte, 1) == 1 ? TRUE : FALSE;
+}
+
+unsigned CRingBuffer::Put (const u8 *pBuffer, unsigned nCount)
+{
+	assert (pBuffer != 0);
+
+	unsigned nFree = GetFree ();
+	if (nCount > nFree)
+	{
+		nCount = nFree;
+	}
+
+	unsigned nIn = m_nIn;
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		m_pBuffer[nIn] = pBuffer[i];
+		nIn = (nIn+1) & m_nMask;
+	}
+
+	STORE_INDEX (m_nIn, nIn);
+
+	unsigned nUsed = m_nMask - nFree + nCount;
+	if (nUsed > m_nHighWater)
+	{
+		m_nHighWater = nUsed;
+	}
+
+	return nCount;
+}
+
+boolean CRingBuffer::IsEmpty (void) const
+{
+	return LOAD_INDEX (m_nIn) == m_nOut ? TRUE : FALSE;
+}
+
+unsigned CRingBuffer::GetCount (void) const
+{
+	return (LOAD_INDEX (m_nIn) - m_nOut) & m_nMask;
+}
+
+u8 CRingBuffer::Get (void)
+{
+	assert (!IsEmpty ());
+
+	u8 ucByte = m_pBuffer[m_nOut];
+	STORE_INDEX (m_nOut, (m_nOut+1) & m_nMask);
+
+	return ucByte;
+}
+
+unsigned CRingBuffer::Get (u8 *pBuffer, unsigned nCount)
+{
+	assert (pBuffer != 0);
+
+	unsigned nAvail = GetCount ();
+	if (nCount > nAvail)
+	{
+		nCount = nAvail;
+	}
+
+	unsigned nOut = m_nOut;
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		pBuffer[i] = m_pBuffer[nOut];
+		nOut = (nOut+1) & m_nMask;
+	}
+
+	STORE_INDEX (m_nOut, nOut);
+
+	return nCount;
+}
+
+unsigned CRingBuffer::GetHighWater (void) const
+{
+	return m_nHighWater;
+}
@@ -0,0 +1,64 @@
+//
+// ringbuffer.h
+//
+// Lock-free single producer / single consumer byte buffer
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef _ringbuffer_h
+#define _ringbuffer_h
+
+#include "types.h"
+
+// One producer (e.g. an interrupt handler) may put bytes into the buffer, while
+// one consumer gets them concurrently on another core without any lock. Each
+// side writes only its own index. The size must be a power of 2, the buffer can
+// hold size-1 bytes.
+
+class CRingBuffer
+{
+public:
+	CRingBuffer (unsigned nSize);
+	~CRingBuffer (void);
+
+	// producer
+	unsigned GetFree (void) const;
+	boolean Put (u8 ucByte);			// returns FALSE if full
+	unsigned Put (const u8 *pBuffer, unsigned nCount);	// returns bytes put
+
+	// consumer
+	boolean IsEmpty (void) const;
+	unsigned GetCount (void) const;
+	u8 Get (void);					// buffer must not be empty
+	unsigned Get (u8 *pBuffer, unsigned nCount);	// returns bytes got
+
+	unsigned GetHighWater (void) const;		// max. count seen by the producer
+
+private:
+	u8 *m_pBuffer;
+	unsigned m_nMask;
+
+	volatile unsigned m_nIn;			// written by the producer only
+	volatile unsigned m_nOut;			// written by the consumer only
+
+	unsigned m_nHighWater;
+};
+
+#endif
@@ -0,0 +1,433 @@
+//
+// scheduler.cpp
+//
+// Runs several CP/M machines on a pool of worker threads (Linux only)
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "scheduler.h"
+#include <assert.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+CScheduler::CScheduler (unsigned nMaxMachines, unsigned nWorkers)
+:	m_nMaxMachines (nMaxMachines),
+	m_nMachines (0),
+	m_nWorkers (nWorkers),
+	m_nRunning (0),
+	m_nParked (0),
+	m_nIdleWorkers (0),
+	m_nRunTime (0)
+{
+	assert (m_nMaxMachines > 0);
+
+	if (m_nWorkers == 0)
+	{
+		long nCPUs = sysconf (_SC_NPROCESSORS_ONLN);
+		m_nWorkers = nCPUs > 0 ? (unsigned) nCPUs : 1;
+	}
+
+	if (m_nWorkers > m_nMaxMachines)		// more would have nothing to do
+	{
+		m_nWorkers = m_nMaxMachines;
+	}
+
+	m_pMachine = new TMachine[m_nMaxMachines];
+	m_pParked = new unsigned[m_nMaxMachines];
+	m_pPollFD = new struct pollfd[m_nMaxMachines];
+	m_pPollMachine = new unsigned[m_nMaxMachines];
+
+	m_pWorker = new TWorker[m_nWorkers];
+	for (unsigned i = 0; i < m_nWorkers; i++)
+	{
+		m_pWorker[i].pThis = this;
+		m_pWorker[i].nIndex = i;
+		pthread_mutex_init (&m_pWorker[i].Lock, 0);
+		m_pWorker[i].pQueue = new unsigned[m_nMaxMachines];
+		m_pWorker[i].nHead = 0;
+		m_pWorker[i].nCount = 0;
+	}
+
+	pthread_mutex_init (&m_ParkLock, 0);
+	pthread_mutex_init (&m_PollLock, 0);
+	pthread_mutex_init (&m_IdleLock, 0);
+	pthread_cond_init (&m_WorkAvailable, 0);
+}
+
+CScheduler::~CScheduler (void)
+{
+	pthread_cond_destroy (&m_WorkAvailable);
+	pthread_mutex_destroy (&m_IdleLock);
+	pthread_mutex_destroy (&m_PollLock);
+	pthread_mutex_destroy (&m_ParkLock);
+
+	for (unsigned i = 0; i < m_nWorkers; i++)
+	{
+		delete [] m_pWorker[i].pQueue;
+		pthread_mutex_destroy (&m_pWorker[i].Lock);
+	}
+	delete [] m_pWorker;
+
+	delete [] m_pPollMachine;
+	delete [] m_pPollFD;
+	delete [] m_pParked;
+	delete [] m_pMachine;
+}
+
+void CScheduler::AddMachine (CZ80Computer *pComputer, const char *pName)
+{
+	assert (m_nMachines < m_nMaxMachines);
+	assert (pComputer != 0);
+
+	m_pMachine[m_nMachines].pComputer = pComputer;
+	m_pMachine[m_nMachines].pName = pName;
+	m_pMachine[m_nMachines].nRunTime = 0;
+
+	m_nMachines++;
+}
+
+void CScheduler::Run (void)
+{
+	u64 nStartTime = GetTime ();
+
+	m_nRunning = m_nMachines;
+
+	// the machines are distributed evenly at start, stealing balances the load later
+	for (unsigned i = 0; i < m_nMachines; i++)
+	{
+		m_pMachine[i].pComputer->Start ();
+
+		Enqueue (&m_pWorker[i % m_nWorkers], i);
+	}
+
+	unsigned nThreads;
+	for (nThreads = 0; nThreads < m_nWorkers; nThreads++)
+	{
+		if (pthread_create (&m_pWorker[nThreads].Thread, 0, WorkerThread,
+				    &m_pWorker[nThreads]) != 0)
+		{
+			break;
+		}
+	}
+
+	if (nThreads < m_nWorkers)
+	{
+		// the calling thread takes this worker, the others are stolen from
+		fprintf (stderr, "Cannot create worker thread %u\n", nThreads);
+
+		Worker (&m_pWorker[nThreads]);
+	}
+
+	for (unsigned i = 0; i < nThreads; i++)
+	{
+		pthread_join (m_pWorker[i].Thread, 0);
+	}
+
+	m_nRunTime = GetTime () - nStartTime;
+}
+
+unsigned CScheduler::GetMachineCount (void) const
+{
+	return m_nMachines;
+}
+
+unsigned CScheduler::GetWorkerCount (void) const
+{
+	return m_nWorkers;
+}
+
+double CScheduler::GetMIPS (unsigned nMachine) const
+{
+	assert (nMachine < m_nMachines);
+	const TMachine *pMachine = &m_pMachine[nMachine];
+
+	if (pMachine->nRunTime == 0)
+	{
+		return 0.0;
+	}
+
+	return pMachine->pComputer->GetInstructions () * 1000.0 / pMachine->nRunTime;
+}
+
+double CScheduler::GetAggregateMIPS (void) const
+{
+	if (m_nRunTime == 0)
+	{
+		return 0.0;
+	}
+
+	u64 nInstructions = 0;
+	for (unsigned i = 0; i < m_nMachines; i++)
+	{
+		nInstructions += m_pMachine[i].pComputer->GetInstructions ();
+	}
+
+	return nInstructions * 1000.0 / m_nRunTime;
+}
+
+void CScheduler::PrintStatistics (void) const
+{
+	for (unsigned i = 0; i < m_nMachines; i++)
+	{
+		fprintf (stderr, "%-20s %12llu instructions, %8.3f s, %8.2f MIPS\n",
+			 m_pMachine[i].pName, m_pMachine[i].pComputer->GetInstructions (),
+			 m_pMachine[i].nRunTime / 1000000000.0, GetMIPS (i));
+	}
+
+	fprintf (stderr, "Machines:     %u on %u threads\n", m_nMachines, m_nWorkers);
+	fprintf (stderr, "Run time:     %.3f s\n", m_nRunTime / 1000000000.0);
+	fprintf (stderr, "Speed:        %.2f MIPS (aggregate)\n", GetAggregateMIPS ());
+}
+
+void *CScheduler::WorkerThread (void *pParam)
+{
+	TWorker *pWorker = (TWorker *) pParam;
+	assert (pWorker != 0);
+
+	pWorker->pThis->Worker (pWorker);
+
+	return 0;
+}
+
+void CScheduler::Worker (TWorker *pWorker)
+{
+	while (m_nRunning > 0)
+	{
+		unsigned nMachine;
+		boolean bFound = Dequeue (pWorker, &nMachine);
+		for (unsigned i = 1; !bFound && i < m_nWorkers; i++)
+		{
+			bFound = Steal (&m_pWorker[(pWorker->nIndex + i) % m_nWorkers], &nMachine);
+		}
+
+		if (!bFound)
+		{
+			if (!PollParked (pWorker))
+			{
+				WaitForWork ();
+			}
+
+			continue;
+		}
+
+		// only one worker at a time owns a machine, so its data needs no lock
+		TMachine *pMachine = &m_pMachine[nMachine];
+
+		u64 nStartTime = GetTime ();
+		TRunStatus Status = pMachine->pComputer->RunSlice (FALSE);
+		pMachine->nRunTime += GetTime () - nStartTime;
+
+		switch (Status)
+		{
+		case RunStatusRunning:
+			Enqueue (pWorker, nMachine);
+			break;
+
+		case RunStatusWaiting:
+			Park (nMachine);
+			break;
+
+		case RunStatusStopped:
+			pMachine->pComputer->Finish ();
+
+			if (__sync_sub_and_fetch (&m_nRunning, 1) == 0)
+			{
+				pthread_mutex_lock (&m_IdleLock);
+				pthread_cond_broadcast (&m_WorkAvailable);
+				pthread_mutex_unlock (&m_IdleLock);
+			}
+			break;
+		}
+	}
+}
+
+void CScheduler::Enqueue (TWorker *pWorker, unsigned nMachine)
+{
+	pthread_mutex_lock (&pWorker->Lock);
+
+	assert (pWorker->nCount < m_nMaxMachines);
+	pWorker->pQueue[(pWorker->nHead + pWorker->nCount) % m_nMaxMachines] = nMachine;
+	__atomic_store_n (&pWorker->nCount, pWorker->nCount + 1, __ATOMIC_RELAXED);
+
+	pthread_mutex_unlock (&pWorker->Lock);
+
+	// another worker can steal it
+	if (__atomic_load_n (&m_nIdleWorkers, __ATOMIC_RELAXED) > 0)
+	{
+		pthread_mutex_lock (&m_IdleLock);
+		pthread_cond_signal (&m_WorkAvailable);
+		pthread_mutex_unlock (&m_IdleLock);
+	}
+}
+
+boolean CScheduler::Dequeue (TWorker *pWorker, unsigned *pMachine)
+{
+	pthread_mutex_lock (&pWorker->Lock);
+
+	if (pWorker->nCount == 0)
+	{
+		pthread_mutex_unlock (&pWorker->Lock);
+
+		return FALSE;
+	}
+
+	*pMachine = pWorker->pQueue[pWorker->nHead];
+	pWorker->nHead = (pWorker->nHead + 1) % m_nMaxMachines;
+	__atomic_store_n (&pWorker->nCount, pWorker->nCount - 1, __ATOMIC_RELAXED);
+
+	pthread_mutex_unlock (&pWorker->Lock);
+
+	return TRUE;
+}
+
+boolean CScheduler::Steal (TWorker *pVictim, unsigned *pMachine)
+{
+	// unlocked peek, checked again below
+	if (__atomic_load_n (&pVictim->nCount, __ATOMIC_RELAXED) == 0)
+	{
+		return FALSE;
+	}
+
+	pthread_mutex_lock (&pVictim->Lock);
+
+	if (pVictim->nCount == 0)
+	{
+		pthread_mutex_unlock (&pVictim->Lock);
+
+		return FALSE;
+	}
+
+	__atomic_store_n (&pVictim->nCount, pVictim->nCount - 1, __ATOMIC_RELAXED);
+	*pMachine = pVictim->pQueue[(pVictim->nHead + pVictim->nCount) % m_nMaxMachines];
+
+	pthread_mutex_unlock (&pVictim->Lock);
+
+	return TRUE;
+}
+
+void CScheduler::Park (unsigned nMachine)
+{
+	pthread_mutex_lock (&m_ParkLock);
+
+	assert (m_nParked < m_nMaxMachines);
+	m_pParked[m_nParked++] = nMachine;
+
+	pthread_mutex_unlock (&m_ParkLock);
+}
+
+// Only one worker polls the input files of the parked machines, the others
+// wait in WaitForWork () meanwhile. Machines, which are parked while polling,
+// are included in the next round, which starts at the latest after
+// SCHEDULER_POLL_TIMEOUT.
+boolean CScheduler::PollParked (TWorker *pWorker)
+{
+	if (pthread_mutex_trylock (&m_PollLock) != 0)
+	{
+		return FALSE;
+	}
+
+	pthread_mutex_lock (&m_ParkLock);
+
+	unsigned nPoll = m_nParked;
+	for (unsigned i = 0; i < nPoll; i++)
+	{
+		m_pPollMachine[i] = m_pParked[i];
+		m_pPollFD[i].fd = m_pMachine[m_pParked[i]].pComputer->GetInputFile ();
+		m_pPollFD[i].events = POLLIN;
+		m_pPollFD[i].revents = 0;
+	}
+
+	pthread_mutex_unlock (&m_ParkLock);
+
+	if (nPoll == 0)
+	{
+		pthread_mutex_unlock (&m_PollLock);
+
+		return FALSE;
+	}
+
+	if (poll (m_pPollFD, nPoll, SCHEDULER_POLL_TIMEOUT) > 0)
+	{
+		pthread_mutex_lock (&m_ParkLock);
+
+		for (unsigned i = 0; i < nPoll; i++)
+		{
+			if (m_pPollFD[i].revents == 0)
+			{
+				continue;
+			}
+
+			// only the poller removes machines, so it is still there
+			for (unsigned j = 0; j < m_nParked; j++)
+			{
+				if (m_pParked[j] == m_pPollMachine[i])
+				{
+					m_pParked[j] = m_pParked[--m_nParked];
+
+					break;
+				}
+			}
+
+			// POLLHUP and POLLERR are handled by the console, when it reads
+			Enqueue (pWorker, m_pPollMachine[i]);
+		}
+
+		pthread_mutex_unlock (&m_ParkLock);
+	}
+
+	pthread_mutex_unlock (&m_PollLock);
+
+	return TRUE;
+}
+
+// The timeout limits the delay, if a signal is missed, because m_nIdleWorkers
+// is tested without lock in Enqueue (), and lets a waiting worker take over
+// polling the parked machines.
+void CScheduler::WaitForWork (void)
+{
+	struct timespec Timeout;
+	clock_gettime (CLOCK_REALTIME, &Timeout);
+	Timeout.tv_nsec += SCHEDULER_POLL_TIMEOUT * 1000000L;
+	if (Timeout.tv_nsec >= 1000000000L)
+	{
+		Timeout.tv_sec++;
+		Timeout.tv_nsec -= 1000000000L;
+	}
+
+	pthread_mutex_lock (&m_IdleLock);
+
+	if (m_nRunning > 0)
+	{
+		__atomic_store_n (&m_nIdleWorkers, m_nIdleWorkers + 1, __ATOMIC_RELAXED);
+		pthread_cond_timedwait (&m_WorkAvailable, &m_IdleLock, &Timeout);
+		__atomic_store_n (&m_nIdleWorkers, m_nIdleWorkers - 1, __ATOMIC_RELAXED);
+	}
+
+	pthread_mutex_unlock (&m_IdleLock);
+}
+
+u64 CScheduler::GetTime (void)
+{
+	struct timespec Time;
+	clock_gettime (CLOCK_MONOTONIC, &Time);
+
+	return (u64) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
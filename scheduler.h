@@ -0,0 +1,117 @@
+//
+// scheduler.h
+//
+// Runs several CP/M machines on a pool of worker threads (Linux only)
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef _scheduler_h
+#define _scheduler_h
+
+#include "z80computer.h"
+#include "types.h"
+#include <pthread.h>
+#include <poll.h>
+
+#define SCHEDULER_POLL_TIMEOUT	10		// ms, max. delay until parked machines are woken
+
+// Each worker thread has a queue of runnable machines. It runs one slice
+// (CZ80Computer::RunSlice ()) of the machine at the head and appends it to the
+// tail again. A worker with an empty queue steals a machine from the tail of
+// another one. Machines, which wait for console input, are parked and one
+// otherwise idle worker polls their input files to wake them up.
+
+class CScheduler
+{
+public:
+	CScheduler (unsigned nMaxMachines, unsigned nWorkers);	// nWorkers = 0: one per CPU
+	~CScheduler (void);
+
+	// the machine has been initialized, pName is used in the statistics
+	void AddMachine (CZ80Computer *pComputer, const char *pName);
+
+	void Run (void);		// returns when all machines have stopped
+
+	unsigned GetMachineCount (void) const;
+	unsigned GetWorkerCount (void) const;
+
+	double GetMIPS (unsigned nMachine) const;	// over the time in its slices
+	double GetAggregateMIPS (void) const;		// all machines over the run time
+
+	void PrintStatistics (void) const;
+
+private:
+	struct TMachine
+	{
+		CZ80Computer *pComputer;
+		const char *pName;
+		u64 nRunTime;			// ns spent in slices
+	};
+
+	struct TWorker
+	{
+		pthread_t Thread;
+		CScheduler *pThis;
+		unsigned nIndex;
+
+		pthread_mutex_t Lock;		// protects the queue
+		unsigned *pQueue;		// ring buffer of machine indices
+		unsigned nHead;
+		unsigned nCount;		// also read without lock in Steal ()
+	};
+
+	static void *WorkerThread (void *pParam);
+	void Worker (TWorker *pWorker);
+
+	void Enqueue (TWorker *pWorker, unsigned nMachine);
+	boolean Dequeue (TWorker *pWorker, unsigned *pMachine);		// from the head
+	boolean Steal (TWorker *pVictim, unsigned *pMachine);		// from the tail
+
+	void Park (unsigned nMachine);
+	boolean PollParked (TWorker *pWorker);		// returns FALSE, if not polled
+	void WaitForWork (void);
+
+	static u64 GetTime (void);			// ns
+
+private:
+	TMachine *m_pMachine;
+	unsigned  m_nMaxMachines;
+	unsigned  m_nMachines;
+
+	TWorker  *m_pWorker;
+	unsigned  m_nWorkers;
+
+	volatile unsigned m_nRunning;		// machines not stopped yet
+
+	pthread_mutex_t m_ParkLock;		// protects the parked machines
+	unsigned *m_pParked;
+	unsigned  m_nParked;
+	pthread_mutex_t m_PollLock;		// held by the worker, which polls the parked machines
+	struct pollfd *m_pPollFD;
+	unsigned *m_pPollMachine;
+
+	pthread_mutex_t m_IdleLock;		// idle workers wait for m_WorkAvailable
+	pthread_cond_t  m_WorkAvailable;
+	unsigned m_nIdleWorkers;		// also read without lock in Enqueue ()
+
+	u64 m_nRunTime;				// ns of Run ()
+};
+
+#endif
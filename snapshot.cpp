@@ -0,0 +1,353 @@
+//
+// snapshot.cpp
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "snapshot.h"
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+CSnapshot::CSnapshot (void)
+:	m_pFileName (0),
+	m_pFile (0),
+	m_nFileSize (0),
+	m_pHeader (0),
+	m_pMemory (0),
+	m_pOutput (0)
+{
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+		m_pSector[nDrive] = 0;
+	}
+}
+
+CSnapshot::~CSnapshot (void)
+{
+	if (m_pFile != 0)
+	{
+		munmap (m_pFile, m_nFileSize);
+		m_pFile = 0;
+	}
+
+	m_pHeader = 0;
+	m_pMemory = 0;
+	m_pOutput = 0;
+}
+
+boolean CSnapshot::Write (const char *pFileName, const Z80_STATE *pCPU,
+			  const CZ80Memory *pMemory, const CZ80Ports *pPorts,
+			  const CConsole *pConsole, CRAMDisk **ppRAMDisk)
+{
+	assert (pFileName != 0);
+	assert (pCPU != 0);
+	assert (pMemory != 0);
+	assert (pPorts != 0);
+	assert (pConsole != 0);
+	assert (ppRAMDisk != 0);
+
+	TSnapshotHeader Header;
+	memset (&Header, 0, sizeof Header);
+
+	memcpy (Header.Magic, SNAPSHOT_MAGIC, sizeof Header.Magic);
+	Header.nVersion = SNAPSHOT_VERSION;
+	Header.nByteOrder = SNAPSHOT_BYTE_ORDER;
+	Header.nHeaderSize = sizeof Header;
+
+	const u8 *pOutput = pConsole->GetPendingOutput (&Header.nOutputCount);
+
+	memcpy (Header.CPU.Registers, pCPU->registers.byte, sizeof Header.CPU.Registers);
+	memcpy (Header.CPU.Alternates, pCPU->alternates, sizeof Header.CPU.Alternates);
+	Header.CPU.nStatus = pCPU->status;
+	Header.CPU.nI	   = pCPU->i;
+	Header.CPU.nR	   = pCPU->r;
+	Header.CPU.nPC	   = pCPU->pc;
+	Header.CPU.nIFF1   = pCPU->iff1;
+	Header.CPU.nIFF2   = pCPU->iff2;
+	Header.CPU.nIM	   = pCPU->im;
+
+	pPorts->GetState (&Header.Ports);
+
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+		const CRAMDisk *pRAMDisk = ppRAMDisk[nDrive];
+		assert (pRAMDisk != 0);
+		if (!pRAMDisk->IsAvailable ())
+		{
+			continue;
+		}
+
+		TSnapshotDisk *pDisk = &Header.Disk[nDrive];
+		pDisk->bAvailable = 1;
+		pDisk->nSectors = pRAMDisk->GetSectorCount ();
+
+		if (!GetImageStatus (pRAMDisk, &pDisk->nImageSize, &pDisk->nImageTime))
+		{
+			return FALSE;
+		}
+
+		for (unsigned nSector = 0; nSector < pDisk->nSectors; nSector++)
+		{
+			if (pRAMDisk->IsDirty (nSector))
+			{
+				pDisk->nWrittenSectors++;
+			}
+		}
+	}
+
+	FILE *pFile = fopen (pFileName, "w");
+	if (pFile == 0)
+	{
+		fprintf (stderr, "Cannot create: %s\n", pFileName);
+
+		return FALSE;
+	}
+
+	static const u8 Padding[SNAPSHOT_ALIGN] = {0};
+	unsigned nPadding = GetPadding (Header.nOutputCount);
+
+	boolean bOK =    fwrite (&Header, sizeof Header, 1, pFile) == 1
+		      && fwrite (pMemory->GetImage (), Z80_RAM_SIZE, 1, pFile) == 1
+		      && fwrite (pOutput, 1, Header.nOutputCount, pFile) == Header.nOutputCount
+		      && fwrite (Padding, 1, nPadding, pFile) == nPadding;
+
+	for (unsigned nDrive = 0; bOK && nDrive < DISK_DRIVES; nDrive++)
+	{
+		CRAMDisk *pRAMDisk = ppRAMDisk[nDrive];
+		for (unsigned nSector = 0; bOK && nSector < Header.Disk[nDrive].nSectors; nSector++)
+		{
+			if (!pRAMDisk->IsDirty (nSector))
+			{
+				continue;
+			}
+
+			TSnapshotSector Sector;
+			Sector.nSector = nSector;
+
+			bOK =    pRAMDisk->Read (nSector, 1, Sector.Data)
+			      && fwrite (&Sector, sizeof Sector, 1, pFile) == 1;
+		}
+	}
+
+	if (fclose (pFile) != 0)
+	{
+		bOK = FALSE;
+	}
+
+	if (!bOK)
+	{
+		fprintf (stderr, "Cannot write: %s\n", pFileName);
+
+		unlink (pFileName);
+	}
+
+	return bOK;
+}
+
+boolean CSnapshot::Open (const char *pFileName)
+{
+	assert (pFileName != 0);
+	m_pFileName = pFileName;
+
+	int nFile = open (m_pFileName, O_RDONLY);
+	if (nFile < 0)
+	{
+		fprintf (stderr, "File not found: %s\n", m_pFileName);
+
+		return FALSE;
+	}
+
+	struct stat Stat;
+	if (   fstat (nFile, &Stat) < 0
+	    || Stat.st_size < (off_t) (sizeof (TSnapshotHeader) + Z80_RAM_SIZE)
+	    || Stat.st_size > 0x7FFFFFFF)
+	{
+		fprintf (stderr, "Invalid snapshot: %s\n", m_pFileName);
+
+		close (nFile);
+
+		return FALSE;
+	}
+	m_nFileSize = (unsigned) Stat.st_size;
+
+	void *pMap = mmap (0, m_nFileSize, PROT_READ, MAP_PRIVATE, nFile, 0);
+	close (nFile);
+	if (pMap == MAP_FAILED)
+	{
+		fprintf (stderr, "Cannot map: %s\n", m_pFileName);
+
+		return FALSE;
+	}
+	m_pFile = (u8 *) pMap;
+
+	m_pHeader = (const TSnapshotHeader *) m_pFile;
+	if (   memcmp (m_pHeader->Magic, SNAPSHOT_MAGIC, sizeof m_pHeader->Magic) != 0
+	    || m_pHeader->nVersion != SNAPSHOT_VERSION
+	    || m_pHeader->nByteOrder != SNAPSHOT_BYTE_ORDER
+	    || m_pHeader->nHeaderSize != sizeof (TSnapshotHeader))
+	{
+		fprintf (stderr, "Invalid snapshot or version: %s\n", m_pFileName);
+
+		return FALSE;
+	}
+
+	unsigned nOffset = sizeof (TSnapshotHeader);
+	m_pMemory = m_pFile + nOffset;
+	nOffset += Z80_RAM_SIZE;
+
+	m_pOutput = m_pFile + nOffset;
+	if (m_pHeader->nOutputCount > CONSOLE_OUTPUT_SIZE)
+	{
+		fprintf (stderr, "Invalid snapshot: %s\n", m_pFileName);
+
+		return FALSE;
+	}
+	nOffset += m_pHeader->nOutputCount + GetPadding (m_pHeader->nOutputCount);
+
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+		const TSnapshotDisk *pDisk = &m_pHeader->Disk[nDrive];
+
+		m_pSector[nDrive] = (const TSnapshotSector *) (m_pFile + nOffset);
+		if (pDisk->nWrittenSectors > (m_nFileSize - nOffset) / sizeof (TSnapshotSector))
+		{
+			fprintf (stderr, "Invalid snapshot: %s\n", m_pFileName);
+
+			return FALSE;
+		}
+		nOffset += pDisk->nWrittenSectors * sizeof (TSnapshotSector);
+
+		if (!pDisk->bAvailable)
+		{
+			continue;
+		}
+
+		// the BDOS has the allocation of the disk in memory, which must match
+		CRAMDisk RAMDisk (nDrive);
+		u64 nSize, nTime;
+		if (   !GetImageStatus (&RAMDisk, &nSize, &nTime)
+		    || nSize != pDisk->nImageSize
+		    || nTime != pDisk->nImageTime)
+		{
+			fprintf (stderr, "Disk image has changed since the snapshot: %s\n",
+				 RAMDisk.GetFileName ());
+
+			return FALSE;
+		}
+	}
+
+	if (nOffset != m_nFileSize)
+	{
+		fprintf (stderr, "Invalid snapshot: %s\n", m_pFileName);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+boolean CSnapshot::Restore (Z80_STATE *pCPU, CZ80Memory *pMemory, CZ80Ports *pPorts,
+			    CConsole *pConsole, CRAMDisk **ppRAMDisk) const
+{
+	assert (m_pHeader != 0);
+	assert (pCPU != 0);
+	assert (pMemory != 0);
+	assert (pPorts != 0);
+	assert (pConsole != 0);
+	assert (ppRAMDisk != 0);
+
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+		const TSnapshotDisk *pDisk = &m_pHeader->Disk[nDrive];
+
+		CRAMDisk *pRAMDisk = ppRAMDisk[nDrive];
+		assert (pRAMDisk != 0);
+		if (   (pDisk->bAvailable ? TRUE : FALSE) != pRAMDisk->IsAvailable ()
+		    || (   pDisk->bAvailable
+			&& pDisk->nSectors != pRAMDisk->GetSectorCount ()))
+		{
+			fprintf (stderr, "Disk image does not match the snapshot: %s\n",
+				 pRAMDisk->GetFileName ());
+
+			return FALSE;
+		}
+
+		const TSnapshotSector *pSector = m_pSector[nDrive];
+		for (unsigned i = 0; i < pDisk->nWrittenSectors; i++, pSector++)
+		{
+			if (!pRAMDisk->Load (pSector->nSector, 1, pSector->Data))
+			{
+				fprintf (stderr, "Invalid snapshot: %s\n", m_pFileName);
+
+				return FALSE;
+			}
+		}
+	}
+
+	pMemory->Restore (m_pMemory);
+
+	memcpy (pCPU->registers.byte, m_pHeader->CPU.Registers, sizeof m_pHeader->CPU.Registers);
+	memcpy (pCPU->alternates, m_pHeader->CPU.Alternates, sizeof m_pHeader->CPU.Alternates);
+	pCPU->status = m_pHeader->CPU.nStatus;
+	pCPU->i	     = m_pHeader->CPU.nI;
+	pCPU->r	     = m_pHeader->CPU.nR;
+	pCPU->pc     = m_pHeader->CPU.nPC;
+	pCPU->iff1   = m_pHeader->CPU.nIFF1;
+	pCPU->iff2   = m_pHeader->CPU.nIFF2;
+	pCPU->im     = m_pHeader->CPU.nIM;
+
+	pPorts->SetState (&m_pHeader->Ports);
+
+	for (unsigned i = 0; i < m_pHeader->nOutputCount; i++)
+	{
+		pConsole->PutChar (m_pOutput[i]);
+	}
+
+	return TRUE;
+}
+
+unsigned CSnapshot::GetPadding (unsigned nOutputCount)
+{
+	return (SNAPSHOT_ALIGN - nOutputCount % SNAPSHOT_ALIGN) % SNAPSHOT_ALIGN;
+}
+
+boolean CSnapshot::GetImageStatus (const CRAMDisk *pRAMDisk, u64 *pSize, u64 *pTime)
+{
+	assert (pRAMDisk != 0);
+	assert (pSize != 0);
+	assert (pTime != 0);
+
+	struct stat Stat;
+	if (stat (pRAMDisk->GetFileName (), &Stat) < 0)
+	{
+		fprintf (stderr, "File not found: %s\n", pRAMDisk->GetFileName ());
+
+		return FALSE;
+	}
+
+	*pSize = Stat.st_size;
+	*pTime = Stat.st_mtim.tv_sec * 1000000000ULL + Stat.st_mtim.tv_nsec;
+
+	return TRUE;
+}
@@ -0,0 +1,125 @@
+//
+// snapshot.h
+//
+// Saves and restores the state of a CP/M machine (Linux only)
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef _snapshot_h
+#define _snapshot_h
+
+#include "z80emu.h"
+#include "z80memory.h"
+#include "z80ports.h"
+#include "console.h"
+#include "ramdisk.h"
+#include "config.h"
+#include "types.h"
+
+#define SNAPSHOT_MAGIC		"CPMSNAP"
+#define SNAPSHOT_VERSION	3
+#define SNAPSHOT_BYTE_ORDER	0x01020304		// written in host byte order
+#define SNAPSHOT_ALIGN		4			// of the sectors in the file
+
+// A snapshot file holds the complete state of a machine, which waits for
+// console input. It is written in host byte order and starts with the
+// TSnapshotHeader, followed by the Z80 memory (Z80_RAM_SIZE bytes), the
+// console output, which has not been flushed yet (padded to SNAPSHOT_ALIGN
+// bytes), and the sectors written to each drive (TSnapshotSector), which
+// overlay the disk images. The images are only referenced by their size and
+// modification time, so the snapshot is invalid after they have changed. The
+// file is mapped into memory and can be used to start many machines.
+
+class CSnapshot
+{
+public:
+	CSnapshot (void);
+	~CSnapshot (void);
+
+	// writes the state of a machine, which has been stopped before an IN instruction
+	static boolean Write (const char *pFileName, const Z80_STATE *pCPU,
+			      const CZ80Memory *pMemory, const CZ80Ports *pPorts,
+			      const CConsole *pConsole, CRAMDisk **ppRAMDisk);	// DISK_DRIVES entries
+
+	boolean Open (const char *pFileName);	// maps the file and checks it and the images
+
+	// the memory, the console and the disks must have been initialized,
+	// the memory is loaded here instead, can be called from several threads
+	boolean Restore (Z80_STATE *pCPU, CZ80Memory *pMemory, CZ80Ports *pPorts,
+			 CConsole *pConsole, CRAMDisk **ppRAMDisk) const;
+
+private:
+	struct TSnapshotCPU
+	{
+		u8	Registers[14];
+		u16	Alternates[4];
+		s32	nStatus;
+		s32	nI;
+		s32	nR;
+		s32	nPC;
+		s32	nIFF1;
+		s32	nIFF2;
+		s32	nIM;
+	};
+
+	struct TSnapshotDisk
+	{
+		u32	bAvailable;
+		u32	nSectors;
+		u64	nImageSize;
+		u64	nImageTime;		// modification time in ns
+		u32	nWrittenSectors;	// TSnapshotSector entries of this drive
+		u32	Reserved;
+	};
+
+	struct TSnapshotHeader
+	{
+		char		Magic[8];
+		u32		nVersion;
+		u32		nByteOrder;
+		u32		nHeaderSize;	// sizeof (TSnapshotHeader)
+		u32		nOutputCount;	// bytes of console output
+		TSnapshotCPU	CPU;
+		TPortsState	Ports;
+		TSnapshotDisk	Disk[DISK_DRIVES];
+	};
+
+	struct TSnapshotSector
+	{
+		u32	nSector;
+		u8	Data[SECTOR_SIZE];
+	};
+
+	static unsigned GetPadding (unsigned nOutputCount);	// after the console output
+	static boolean GetImageStatus (const CRAMDisk *pRAMDisk, u64 *pSize, u64 *pTime);
+
+private:
+	const char *m_pFileName;
+
+	u8	 *m_pFile;		// mapped
+	unsigned  m_nFileSize;
+
+	const TSnapshotHeader *m_pHeader;
+	const u8	      *m_pMemory;
+	const u8	      *m_pOutput;
+	const TSnapshotSector *m_pSector[DISK_DRIVES];
+};
+
+#endif
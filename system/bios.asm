@@ -16,6 +16,9 @@ bios	equ	0f200h
 prtconstat	equ	0	; In,  console status
 prtconin	equ	1	; In,  console input
 prtconout	equ	2	; Out, console output
+prtconadrl	equ	3	; Out, console string address low
+prtconadrh	equ	4	; Out, console string address high
+prtconstr	equ	5	; Out, console string output
 
 prtdsktrk	equ	10h	; Out, disk track
 prtdsksec	equ	11h	; Out, disk sector
@@ -25,6 +28,7 @@ prtdskop	equ	14h	; Out, disk operation
 prtdskstat	equ	15h	; In,  disk status
 prtdskcount	equ	16h	; In,  disk count
 prtdskdrv	equ	17h	; Out, disk drive
+prtdsktrkh	equ	19h	; Out, disk track high
 
 	org	bios
 
@@ -47,38 +51,7 @@ wboote:	jmp	wboot
 	jmp	write
 	jmp	lstst
 	jmp	trans
-
-;	Disk parameter header
-
-dph0:	dw	0		; no translation
-	dw	0
-	dw	0
-	dw	0
-	dw	dirbuf
-	dw	dpb0
-	dw	0		; fixed disk
-	dw	map0
-
-dph1:	dw	0		; no translation
-	dw	0
-	dw	0
-	dw	0
-	dw	dirbuf
-	dw	dpb0
-	dw	0		; fixed disk
-	dw	map1
-
-;	Disk parameter block
-
-dpb0:	dw	80		; sectors per track
-	db	4		; block shift, 2K blocks
-	db	15		; block mask, 2K blocks
-	db	0		; extend mask
-	dw	389		; total number of blocks-1
-	dw	127		; total number of directory entries-1
-	dw	0c0h		; directory block mask
-	dw	0		; fixed disk
-	dw	2		; reserved tracks
+	jmp	constr		; CPMemu: display string at DE up to '$'
 
 ;	Cold boot entry
 
@@ -92,14 +65,12 @@ boot:	lxi	sp,buffer
 	lxi	d,ccp2
 	lxi	b,bdos-ccp
 	ldir
-	lxi	h,msg		; display start message
-nxtchr:	mov	a,m
-	ora	a
-	jrz	wboot
-	mov	c,a
-	call	conout
-	inx	h
-	jr	nxtchr
+	lxi	b,dskprm	; let the emulator generate the disk tables
+	call	setdma
+	mvi	a,3
+	out	prtdskop
+	lxi	d,msg		; display start message
+	call	constr
 
 ;	Warm boot entry
 
@@ -108,6 +79,8 @@ wboot:	lxi	sp,buffer
 	lxi	d,0
 	lxi	b,zerolen
 	ldir
+	lhld	bdosent		; may be lowered for the disk tables
+	shld	6
 	lxi	h,ccp2		; restore CCP
 	lxi	d,ccp
 	lxi	b,bdos-ccp
@@ -139,6 +112,14 @@ conout:	mov	a,c
 	out	prtconout
 	ret
 
+constr:	mov	a,e
+	out	prtconadrl
+	mov	a,d
+	out	prtconadrh
+	xra	a		; terminated with '$'
+	out	prtconstr
+	ret
+
 ;	Printer
 
 lstst:	mvi	a,0ffh
@@ -153,29 +134,63 @@ punch:	ret
 
 ;	RAM disk
 
-seldsk:	in	prtdskcount
-	cmp	c
-	lxi	h,0
-	rc
-	rz
+seldsk:	lxi	h,0
+	mov	a,c
+	cpi	16
+	rnc
+	mov	l,c
+	dad	h
+	lxi	d,dphtab
+	dad	d
+	mov	a,m
+	inx	h
+	mov	h,m
+	mov	l,a
+	ora	h
+	rz			; no such drive (HL = 0)
 	mov	a,c
 	out	prtdskdrv
-	ora	a
-	lxi	h,dph0
-	rz
-	lxi	h,dph1
 	ret
 
-reset:	mvi	c,0
-settrk:	mov	a,c
+;	The disk registers of the emulator keep their values and the sector is
+;	incremented after each transfer, so they are only written, if they change.
+
+reset:	lxi	b,0
+settrk:	lhld	curtrk
+	mov	a,l
+	cmp	c
+	jnz	newtrk
+	mov	a,h
+	cmp	b
+	rz
+newtrk:	mov	h,b
+	mov	l,c
+	shld	curtrk
+	mov	a,c
 	out	prtdsktrk
+	mov	a,b
+	out	prtdsktrkh
 	ret
 
-setsec:	mov	a,c
+setsec:	lxi	h,cursec
+	mov	a,c
+	cmp	m
+	rz
+	mov	m,a
 	out	prtdsksec
 	ret
 
-setdma:	mov	a,c
+setdma:	lhld	curdma
+	mov	a,l
+	cmp	c
+	jnz	newdma
+	mov	a,h
+	cmp	b
+	rz
+newdma:	mov	h,b
+	mov	l,c
+	shld	curdma
+	mov	a,c
 	out	prtdskdmal
 	mov	a,b
 	out	prtdskdmah
@@ -187,8 +202,11 @@ write:	mvi	a,2
 disk:	out	prtdskop
 	in	prtdskstat
 	ora	a
-	rz
 	mvi	a,1
+	rnz
+	lxi	h,cursec	; like the sector of the emulator
+	inr	m
+	xra	a
 	ret
 
 trans:	mov	h,b
@@ -197,11 +215,16 @@ trans:	mov	h,b
 
 ;	Data
 
-msg:	db	'CP/M 2.2',0dh,0ah,0
+msg:	db	'CP/M 2.2',0dh,0ah,'$'
+
+curtrk:	dw	0ffffh		; disk registers of the emulator (0ffffh: unknown)
+cursec:	db	0ffh
+curdma:	dw	0ffffh
+
+dskprm:	dw	ccp2+bdos-ccp	; first free byte above the BIOS
+bdosent: dw	bdos+6		; BDOS entry for page 0
+dphtab:	ds	2*16		; DPH addresses of A: to P: (set by the emulator)
 
-map0:	ds	(389+8)/8		; one bit per disk block
-map1:	ds	(389+8)/8
-dirbuf:	ds	128
 ccp2	equ	$
 
 	end
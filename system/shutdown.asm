@@ -7,6 +7,7 @@ bdos	equ	5
 tpa	equ	100h
 
 port	equ	0e0h		; control port
+status	equ	0e1h		; control status port
 
 	org	tpa
 
@@ -15,8 +16,19 @@ start:	lxi	d,savemsg
 	call	bdos
 	mvi	a,'S'
 	out	port		; trigger saving RAM disk
+wait:	in	status		; wait while saving in the background
+	cpi	0ffh		; no status port (older CPMemu)
+	jz	saved
+	rrc
+	jc	wait
+	rrc			; save failed?
+	jnc	saved
+	lxi	d,errmsg
+	mvi	c,9
+	call	bdos
+	jmp	reboot		; stay in CP/M, so that it can be retried
 
-	lxi	d,downmsg
+saved:	lxi	d,downmsg
 	mvi	c,9
 	call	bdos
 	mvi	a,'Q'
@@ -26,5 +38,6 @@ start:	lxi	d,savemsg
 
 savemsg: db	'Saving RAM disk to persistent storage.',0dh,0ah,'$'
 downmsg: db	'CP/M emulator will shutdown now.',0dh,0ah,'$'
+errmsg:	db	'Error saving RAM disk.',0dh,0ah,'$'
 
 	end	start
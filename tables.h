@@ -0,0 +1,1624 @@
+/* Generated file, see maketables.c. */
+
+#ifdef Z80_8080_ONLY
+
+static const unsigned short INSTRUCTION_TABLE[256] = {
+
+	NOP,
+	SPECIALIZED(0x01),
+	LD_INDIRECT_BC_A,
+	SPECIALIZED(0x03),
+	SPECIALIZED(0x04),
+	SPECIALIZED(0x05),
+	SPECIALIZED(0x06),
+	RLCA,
+
+	Z80_ONLY,
+	SPECIALIZED(0x09),
+	LD_A_INDIRECT_BC,
+	SPECIALIZED(0x0B),
+	SPECIALIZED(0x0C),
+	SPECIALIZED(0x0D),
+	SPECIALIZED(0x0E),
+	RRCA,
+
+	Z80_ONLY,
+	SPECIALIZED(0x11),
+	SPECIALIZED(0x12),
+	SPECIALIZED(0x13),
+	SPECIALIZED(0x14),
+	SPECIALIZED(0x15),
+	SPECIALIZED(0x16),
+	RLA,
+
+	Z80_ONLY,
+	SPECIALIZED(0x19),
+	SPECIALIZED(0x1A),
+	SPECIALIZED(0x1B),
+	SPECIALIZED(0x1C),
+	SPECIALIZED(0x1D),
+	SPECIALIZED(0x1E),
+	RRA,
+
+	Z80_ONLY,
+	SPECIALIZED(0x21),
+	LD_INDIRECT_NN_HL,
+	SPECIALIZED(0x23),
+	SPECIALIZED(0x24),
+	SPECIALIZED(0x25),
+	SPECIALIZED(0x26),
+	DAA,
+
+	Z80_ONLY,
+	SPECIALIZED(0x29),
+	LD_HL_INDIRECT_NN,
+	SPECIALIZED(0x2B),
+	SPECIALIZED(0x2C),
+	SPECIALIZED(0x2D),
+	SPECIALIZED(0x2E),
+	CPL,
+
+	Z80_ONLY,
+	SPECIALIZED(0x31),
+	LD_INDIRECT_NN_A,
+	SPECIALIZED(0x33),
+	INC_INDIRECT_HL,
+	DEC_INDIRECT_HL,
+	LD_INDIRECT_HL_N,
+	SCF,
+
+	Z80_ONLY,
+	SPECIALIZED(0x39),
+	LD_A_INDIRECT_NN,
+	SPECIALIZED(0x3B),
+	SPECIALIZED(0x3C),
+	SPECIALIZED(0x3D),
+	SPECIALIZED(0x3E),
+	CCF,
+
+	NOP,
+	SPECIALIZED(0x41),
+	SPECIALIZED(0x42),
+	SPECIALIZED(0x43),
+	SPECIALIZED(0x44),
+	SPECIALIZED(0x45),
+	SPECIALIZED(0x46),
+	SPECIALIZED(0x47),
+
+	SPECIALIZED(0x48),
+	NOP,
+	SPECIALIZED(0x4A),
+	SPECIALIZED(0x4B),
+	SPECIALIZED(0x4C),
+	SPECIALIZED(0x4D),
+	SPECIALIZED(0x4E),
+	SPECIALIZED(0x4F),
+
+	SPECIALIZED(0x50),
+	SPECIALIZED(0x51),
+	NOP,
+	SPECIALIZED(0x53),
+	SPECIALIZED(0x54),
+	SPECIALIZED(0x55),
+	SPECIALIZED(0x56),
+	SPECIALIZED(0x57),
+
+	SPECIALIZED(0x58),
+	SPECIALIZED(0x59),
+	SPECIALIZED(0x5A),
+	NOP,
+	SPECIALIZED(0x5C),
+	SPECIALIZED(0x5D),
+	SPECIALIZED(0x5E),
+	SPECIALIZED(0x5F),
+
+	SPECIALIZED(0x60),
+	SPECIALIZED(0x61),
+	SPECIALIZED(0x62),
+	SPECIALIZED(0x63),
+	NOP,
+	SPECIALIZED(0x65),
+	SPECIALIZED(0x66),
+	SPECIALIZED(0x67),
+
+	SPECIALIZED(0x68),
+	SPECIALIZED(0x69),
+	SPECIALIZED(0x6A),
+	SPECIALIZED(0x6B),
+	SPECIALIZED(0x6C),
+	NOP,
+	SPECIALIZED(0x6E),
+	SPECIALIZED(0x6F),
+
+	SPECIALIZED(0x70),
+	SPECIALIZED(0x71),
+	SPECIALIZED(0x72),
+	SPECIALIZED(0x73),
+	SPECIALIZED(0x74),
+	SPECIALIZED(0x75),
+	HALT,
+	SPECIALIZED(0x77),
+
+	SPECIALIZED(0x78),
+	SPECIALIZED(0x79),
+	SPECIALIZED(0x7A),
+	SPECIALIZED(0x7B),
+	SPECIALIZED(0x7C),
+	SPECIALIZED(0x7D),
+	SPECIALIZED(0x7E),
+	NOP,
+
+	SPECIALIZED(0x80),
+	SPECIALIZED(0x81),
+	SPECIALIZED(0x82),
+	SPECIALIZED(0x83),
+	SPECIALIZED(0x84),
+	SPECIALIZED(0x85),
+	ADD_INDIRECT_HL,
+	SPECIALIZED(0x87),
+
+	SPECIALIZED(0x88),
+	SPECIALIZED(0x89),
+	SPECIALIZED(0x8A),
+	SPECIALIZED(0x8B),
+	SPECIALIZED(0x8C),
+	SPECIALIZED(0x8D),
+	ADC_INDIRECT_HL,
+	SPECIALIZED(0x8F),
+
+	SPECIALIZED(0x90),
+	SPECIALIZED(0x91),
+	SPECIALIZED(0x92),
+	SPECIALIZED(0x93),
+	SPECIALIZED(0x94),
+	SPECIALIZED(0x95),
+	SUB_INDIRECT_HL,
+	SPECIALIZED(0x97),
+
+	SPECIALIZED(0x98),
+	SPECIALIZED(0x99),
+	SPECIALIZED(0x9A),
+	SPECIALIZED(0x9B),
+	SPECIALIZED(0x9C),
+	SPECIALIZED(0x9D),
+	SBC_INDIRECT_HL,
+	SPECIALIZED(0x9F),
+
+	SPECIALIZED(0xA0),
+	SPECIALIZED(0xA1),
+	SPECIALIZED(0xA2),
+	SPECIALIZED(0xA3),
+	SPECIALIZED(0xA4),
+	SPECIALIZED(0xA5),
+	AND_INDIRECT_HL,
+	SPECIALIZED(0xA7),
+
+	SPECIALIZED(0xA8),
+	SPECIALIZED(0xA9),
+	SPECIALIZED(0xAA),
+	SPECIALIZED(0xAB),
+	SPECIALIZED(0xAC),
+	SPECIALIZED(0xAD),
+	XOR_INDIRECT_HL,
+	SPECIALIZED(0xAF),
+
+	SPECIALIZED(0xB0),
+	SPECIALIZED(0xB1),
+	SPECIALIZED(0xB2),
+	SPECIALIZED(0xB3),
+	SPECIALIZED(0xB4),
+	SPECIALIZED(0xB5),
+	OR_INDIRECT_HL,
+	SPECIALIZED(0xB7),
+
+	SPECIALIZED(0xB8),
+	SPECIALIZED(0xB9),
+	SPECIALIZED(0xBA),
+	SPECIALIZED(0xBB),
+	SPECIALIZED(0xBC),
+	SPECIALIZED(0xBD),
+	CP_INDIRECT_HL,
+	SPECIALIZED(0xBF),
+
+	SPECIALIZED(0xC0),
+	SPECIALIZED(0xC1),
+	SPECIALIZED(0xC2),
+	JP_NN,
+	SPECIALIZED(0xC4),
+	SPECIALIZED(0xC5),
+	ADD_N,
+	RST_P,
+
+	SPECIALIZED(0xC8),
+	RET,
+	SPECIALIZED(0xCA),
+	Z80_ONLY,
+	SPECIALIZED(0xCC),
+	CALL_NN,
+	ADC_N,
+	RST_P,
+
+	SPECIALIZED(0xD0),
+	SPECIALIZED(0xD1),
+	SPECIALIZED(0xD2),
+	OUT_N_A,
+	SPECIALIZED(0xD4),
+	SPECIALIZED(0xD5),
+	SUB_N,
+	RST_P,
+
+	SPECIALIZED(0xD8),
+	Z80_ONLY,
+	SPECIALIZED(0xDA),
+	IN_A_N,
+	SPECIALIZED(0xDC),
+	Z80_ONLY,
+	SBC_N,
+	RST_P,
+
+	SPECIALIZED(0xE0),
+	SPECIALIZED(0xE1),
+	SPECIALIZED(0xE2),
+	EX_INDIRECT_SP_HL,
+	SPECIALIZED(0xE4),
+	SPECIALIZED(0xE5),
+	AND_N,
+	RST_P,
+
+	SPECIALIZED(0xE8),
+	JP_HL,
+	SPECIALIZED(0xEA),
+	EX_DE_HL,
+	SPECIALIZED(0xEC),
+	Z80_ONLY,
+	XOR_N,
+	RST_P,
+
+	SPECIALIZED(0xF0),
+	SPECIALIZED(0xF1),
+	SPECIALIZED(0xF2),
+	DI,
+	SPECIALIZED(0xF4),
+	SPECIALIZED(0xF5),
+	OR_N,
+	RST_P,
+
+	SPECIALIZED(0xF8),
+	LD_SP_HL,
+	SPECIALIZED(0xFA),
+	EI,
+	SPECIALIZED(0xFC),
+	Z80_ONLY,
+	CP_N,
+	RST_P,
+
+};
+
+#define SPECIALIZED_INSTRUCTIONS(X)	\
+	X(LD_RR_NN, 0x01, )	\
+	X(INC_RR, 0x03, )	\
+	X(INC_R, 0x04, )	\
+	X(DEC_R, 0x05, )	\
+	X(LD_R_N, 0x06, )	\
+	X(ADD_HL_RR, 0x09, )	\
+	X(DEC_RR, 0x0B, FUSE(LD_R_R, 0x78) FUSE(OR_R, 0xB1) FUSE(JP_CC_NN, 0xC2))	\
+	X(INC_R, 0x0C, )	\
+	X(DEC_R, 0x0D, )	\
+	X(LD_R_N, 0x0E, )	\
+	X(LD_RR_NN, 0x11, )	\
+	X(LD_INDIRECT_DE_A, 0x12, FUSE(INC_RR, 0x13))	\
+	X(INC_RR, 0x13, )	\
+	X(INC_R, 0x14, )	\
+	X(DEC_R, 0x15, )	\
+	X(LD_R_N, 0x16, )	\
+	X(ADD_HL_RR, 0x19, )	\
+	X(LD_A_INDIRECT_DE, 0x1A, FUSE(LD_INDIRECT_HL_R, 0x77) FUSE(INC_RR, 0x23) FUSE(INC_RR, 0x13))	\
+	X(DEC_RR, 0x1B, )	\
+	X(INC_R, 0x1C, )	\
+	X(DEC_R, 0x1D, )	\
+	X(LD_R_N, 0x1E, )	\
+	X(LD_RR_NN, 0x21, )	\
+	X(INC_RR, 0x23, )	\
+	X(INC_R, 0x24, )	\
+	X(DEC_R, 0x25, )	\
+	X(LD_R_N, 0x26, )	\
+	X(ADD_HL_RR, 0x29, )	\
+	X(DEC_RR, 0x2B, )	\
+	X(INC_R, 0x2C, )	\
+	X(DEC_R, 0x2D, )	\
+	X(LD_R_N, 0x2E, )	\
+	X(LD_RR_NN, 0x31, )	\
+	X(INC_RR, 0x33, )	\
+	X(ADD_HL_RR, 0x39, )	\
+	X(DEC_RR, 0x3B, )	\
+	X(INC_R, 0x3C, )	\
+	X(DEC_R, 0x3D, )	\
+	X(LD_R_N, 0x3E, )	\
+	X(LD_R_R, 0x41, )	\
+	X(LD_R_R, 0x42, )	\
+	X(LD_R_R, 0x43, )	\
+	X(LD_R_R, 0x44, )	\
+	X(LD_R_R, 0x45, )	\
+	X(LD_R_INDIRECT_HL, 0x46, )	\
+	X(LD_R_R, 0x47, )	\
+	X(LD_R_R, 0x48, )	\
+	X(LD_R_R, 0x4A, )	\
+	X(LD_R_R, 0x4B, )	\
+	X(LD_R_R, 0x4C, )	\
+	X(LD_R_R, 0x4D, )	\
+	X(LD_R_INDIRECT_HL, 0x4E, )	\
+	X(LD_R_R, 0x4F, )	\
+	X(LD_R_R, 0x50, )	\
+	X(LD_R_R, 0x51, )	\
+	X(LD_R_R, 0x53, )	\
+	X(LD_R_R, 0x54, )	\
+	X(LD_R_R, 0x55, )	\
+	X(LD_R_INDIRECT_HL, 0x56, )	\
+	X(LD_R_R, 0x57, )	\
+	X(LD_R_R, 0x58, )	\
+	X(LD_R_R, 0x59, )	\
+	X(LD_R_R, 0x5A, )	\
+	X(LD_R_R, 0x5C, )	\
+	X(LD_R_R, 0x5D, )	\
+	X(LD_R_INDIRECT_HL, 0x5E, )	\
+	X(LD_R_R, 0x5F, )	\
+	X(LD_R_R, 0x60, )	\
+	X(LD_R_R, 0x61, )	\
+	X(LD_R_R, 0x62, )	\
+	X(LD_R_R, 0x63, )	\
+	X(LD_R_R, 0x65, )	\
+	X(LD_R_INDIRECT_HL, 0x66, )	\
+	X(LD_R_R, 0x67, )	\
+	X(LD_R_R, 0x68, )	\
+	X(LD_R_R, 0x69, )	\
+	X(LD_R_R, 0x6A, )	\
+	X(LD_R_R, 0x6B, )	\
+	X(LD_R_R, 0x6C, )	\
+	X(LD_R_INDIRECT_HL, 0x6E, )	\
+	X(LD_R_R, 0x6F, )	\
+	X(LD_INDIRECT_HL_R, 0x70, )	\
+	X(LD_INDIRECT_HL_R, 0x71, )	\
+	X(LD_INDIRECT_HL_R, 0x72, )	\
+	X(LD_INDIRECT_HL_R, 0x73, )	\
+	X(LD_INDIRECT_HL_R, 0x74, )	\
+	X(LD_INDIRECT_HL_R, 0x75, )	\
+	X(LD_INDIRECT_HL_R, 0x77, )	\
+	X(LD_R_R, 0x78, )	\
+	X(LD_R_R, 0x79, )	\
+	X(LD_R_R, 0x7A, )	\
+	X(LD_R_R, 0x7B, )	\
+	X(LD_R_R, 0x7C, )	\
+	X(LD_R_R, 0x7D, )	\
+	X(LD_R_INDIRECT_HL, 0x7E, FUSE(INC_RR, 0x23))	\
+	X(ADD_R, 0x80, )	\
+	X(ADD_R, 0x81, )	\
+	X(ADD_R, 0x82, )	\
+	X(ADD_R, 0x83, )	\
+	X(ADD_R, 0x84, )	\
+	X(ADD_R, 0x85, )	\
+	X(ADD_R, 0x87, )	\
+	X(ADC_R, 0x88, )	\
+	X(ADC_R, 0x89, )	\
+	X(ADC_R, 0x8A, )	\
+	X(ADC_R, 0x8B, )	\
+	X(ADC_R, 0x8C, )	\
+	X(ADC_R, 0x8D, )	\
+	X(ADC_R, 0x8F, )	\
+	X(SUB_R, 0x90, )	\
+	X(SUB_R, 0x91, )	\
+	X(SUB_R, 0x92, )	\
+	X(SUB_R, 0x93, )	\
+	X(SUB_R, 0x94, )	\
+	X(SUB_R, 0x95, )	\
+	X(SUB_R, 0x97, )	\
+	X(SBC_R, 0x98, )	\
+	X(SBC_R, 0x99, )	\
+	X(SBC_R, 0x9A, )	\
+	X(SBC_R, 0x9B, )	\
+	X(SBC_R, 0x9C, )	\
+	X(SBC_R, 0x9D, )	\
+	X(SBC_R, 0x9F, )	\
+	X(AND_R, 0xA0, )	\
+	X(AND_R, 0xA1, )	\
+	X(AND_R, 0xA2, )	\
+	X(AND_R, 0xA3, )	\
+	X(AND_R, 0xA4, )	\
+	X(AND_R, 0xA5, )	\
+	X(AND_R, 0xA7, )	\
+	X(XOR_R, 0xA8, )	\
+	X(XOR_R, 0xA9, )	\
+	X(XOR_R, 0xAA, )	\
+	X(XOR_R, 0xAB, )	\
+	X(XOR_R, 0xAC, )	\
+	X(XOR_R, 0xAD, )	\
+	X(XOR_R, 0xAF, )	\
+	X(OR_R, 0xB0, )	\
+	X(OR_R, 0xB1, )	\
+	X(OR_R, 0xB2, )	\
+	X(OR_R, 0xB3, )	\
+	X(OR_R, 0xB4, )	\
+	X(OR_R, 0xB5, )	\
+	X(OR_R, 0xB7, )	\
+	X(CP_R, 0xB8, )	\
+	X(CP_R, 0xB9, )	\
+	X(CP_R, 0xBA, )	\
+	X(CP_R, 0xBB, )	\
+	X(CP_R, 0xBC, )	\
+	X(CP_R, 0xBD, )	\
+	X(CP_R, 0xBF, )	\
+	X(RET_CC, 0xC0, )	\
+	X(POP_SS, 0xC1, )	\
+	X(JP_CC_NN, 0xC2, )	\
+	X(CALL_CC_NN, 0xC4, )	\
+	X(PUSH_SS, 0xC5, )	\
+	X(RET_CC, 0xC8, )	\
+	X(JP_CC_NN, 0xCA, )	\
+	X(CALL_CC_NN, 0xCC, )	\
+	X(RET_CC, 0xD0, )	\
+	X(POP_SS, 0xD1, )	\
+	X(JP_CC_NN, 0xD2, )	\
+	X(CALL_CC_NN, 0xD4, )	\
+	X(PUSH_SS, 0xD5, )	\
+	X(RET_CC, 0xD8, )	\
+	X(JP_CC_NN, 0xDA, )	\
+	X(CALL_CC_NN, 0xDC, )	\
+	X(RET_CC, 0xE0, )	\
+	X(POP_SS, 0xE1, )	\
+	X(JP_CC_NN, 0xE2, )	\
+	X(CALL_CC_NN, 0xE4, )	\
+	X(PUSH_SS, 0xE5, )	\
+	X(RET_CC, 0xE8, )	\
+	X(JP_CC_NN, 0xEA, )	\
+	X(CALL_CC_NN, 0xEC, )	\
+	X(RET_CC, 0xF0, )	\
+	X(POP_SS, 0xF1, )	\
+	X(JP_CC_NN, 0xF2, )	\
+	X(CALL_CC_NN, 0xF4, )	\
+	X(PUSH_SS, 0xF5, )	\
+	X(RET_CC, 0xF8, )	\
+	X(JP_CC_NN, 0xFA, )	\
+	X(CALL_CC_NN, 0xFC, )	\
+
+#else
+
+static const unsigned short INSTRUCTION_TABLE[256] = {
+
+	NOP,
+	SPECIALIZED(0x01),
+	LD_INDIRECT_BC_A,
+	SPECIALIZED(0x03),
+	SPECIALIZED(0x04),
+	SPECIALIZED(0x05),
+	SPECIALIZED(0x06),
+	RLCA,
+
+	EX_AF_AF_PRIME,
+	SPECIALIZED(0x09),
+	LD_A_INDIRECT_BC,
+	SPECIALIZED(0x0B),
+	SPECIALIZED(0x0C),
+	SPECIALIZED(0x0D),
+	SPECIALIZED(0x0E),
+	RRCA,
+
+	SPECIALIZED(0x10),
+	SPECIALIZED(0x11),
+	SPECIALIZED(0x12),
+	SPECIALIZED(0x13),
+	SPECIALIZED(0x14),
+	SPECIALIZED(0x15),
+	SPECIALIZED(0x16),
+	RLA,
+
+	JR_E,
+	SPECIALIZED(0x19),
+	SPECIALIZED(0x1A),
+	SPECIALIZED(0x1B),
+	SPECIALIZED(0x1C),
+	SPECIALIZED(0x1D),
+	SPECIALIZED(0x1E),
+	RRA,
+
+	SPECIALIZED(0x20),
+	SPECIALIZED(0x21),
+	LD_INDIRECT_NN_HL,
+	SPECIALIZED(0x23),
+	SPECIALIZED(0x24),
+	SPECIALIZED(0x25),
+	SPECIALIZED(0x26),
+	DAA,
+
+	SPECIALIZED(0x28),
+	SPECIALIZED(0x29),
+	LD_HL_INDIRECT_NN,
+	SPECIALIZED(0x2B),
+	SPECIALIZED(0x2C),
+	SPECIALIZED(0x2D),
+	SPECIALIZED(0x2E),
+	CPL,
+
+	SPECIALIZED(0x30),
+	SPECIALIZED(0x31),
+	LD_INDIRECT_NN_A,
+	SPECIALIZED(0x33),
+	INC_INDIRECT_HL,
+	DEC_INDIRECT_HL,
+	LD_INDIRECT_HL_N,
+	SCF,
+
+	SPECIALIZED(0x38),
+	SPECIALIZED(0x39),
+	LD_A_INDIRECT_NN,
+	SPECIALIZED(0x3B),
+	SPECIALIZED(0x3C),
+	SPECIALIZED(0x3D),
+	SPECIALIZED(0x3E),
+	CCF,
+
+	NOP,
+	SPECIALIZED(0x41),
+	SPECIALIZED(0x42),
+	SPECIALIZED(0x43),
+	SPECIALIZED(0x44),
+	SPECIALIZED(0x45),
+	SPECIALIZED(0x46),
+	SPECIALIZED(0x47),
+
+	SPECIALIZED(0x48),
+	NOP,
+	SPECIALIZED(0x4A),
+	SPECIALIZED(0x4B),
+	SPECIALIZED(0x4C),
+	SPECIALIZED(0x4D),
+	SPECIALIZED(0x4E),
+	SPECIALIZED(0x4F),
+
+	SPECIALIZED(0x50),
+	SPECIALIZED(0x51),
+	NOP,
+	SPECIALIZED(0x53),
+	SPECIALIZED(0x54),
+	SPECIALIZED(0x55),
+	SPECIALIZED(0x56),
+	SPECIALIZED(0x57),
+
+	SPECIALIZED(0x58),
+	SPECIALIZED(0x59),
+	SPECIALIZED(0x5A),
+	NOP,
+	SPECIALIZED(0x5C),
+	SPECIALIZED(0x5D),
+	SPECIALIZED(0x5E),
+	SPECIALIZED(0x5F),
+
+	SPECIALIZED(0x60),
+	SPECIALIZED(0x61),
+	SPECIALIZED(0x62),
+	SPECIALIZED(0x63),
+	NOP,
+	SPECIALIZED(0x65),
+	SPECIALIZED(0x66),
+	SPECIALIZED(0x67),
+
+	SPECIALIZED(0x68),
+	SPECIALIZED(0x69),
+	SPECIALIZED(0x6A),
+	SPECIALIZED(0x6B),
+	SPECIALIZED(0x6C),
+	NOP,
+	SPECIALIZED(0x6E),
+	SPECIALIZED(0x6F),
+
+	SPECIALIZED(0x70),
+	SPECIALIZED(0x71),
+	SPECIALIZED(0x72),
+	SPECIALIZED(0x73),
+	SPECIALIZED(0x74),
+	SPECIALIZED(0x75),
+	HALT,
+	SPECIALIZED(0x77),
+
+	SPECIALIZED(0x78),
+	SPECIALIZED(0x79),
+	SPECIALIZED(0x7A),
+	SPECIALIZED(0x7B),
+	SPECIALIZED(0x7C),
+	SPECIALIZED(0x7D),
+	SPECIALIZED(0x7E),
+	NOP,
+
+	SPECIALIZED(0x80),
+	SPECIALIZED(0x81),
+	SPECIALIZED(0x82),
+	SPECIALIZED(0x83),
+	SPECIALIZED(0x84),
+	SPECIALIZED(0x85),
+	ADD_INDIRECT_HL,
+	SPECIALIZED(0x87),
+
+	SPECIALIZED(0x88),
+	SPECIALIZED(0x89),
+	SPECIALIZED(0x8A),
+	SPECIALIZED(0x8B),
+	SPECIALIZED(0x8C),
+	SPECIALIZED(0x8D),
+	ADC_INDIRECT_HL,
+	SPECIALIZED(0x8F),
+
+	SPECIALIZED(0x90),
+	SPECIALIZED(0x91),
+	SPECIALIZED(0x92),
+	SPECIALIZED(0x93),
+	SPECIALIZED(0x94),
+	SPECIALIZED(0x95),
+	SUB_INDIRECT_HL,
+	SPECIALIZED(0x97),
+
+	SPECIALIZED(0x98),
+	SPECIALIZED(0x99),
+	SPECIALIZED(0x9A),
+	SPECIALIZED(0x9B),
+	SPECIALIZED(0x9C),
+	SPECIALIZED(0x9D),
+	SBC_INDIRECT_HL,
+	SPECIALIZED(0x9F),
+
+	SPECIALIZED(0xA0),
+	SPECIALIZED(0xA1),
+	SPECIALIZED(0xA2),
+	SPECIALIZED(0xA3),
+	SPECIALIZED(0xA4),
+	SPECIALIZED(0xA5),
+	AND_INDIRECT_HL,
+	SPECIALIZED(0xA7),
+
+	SPECIALIZED(0xA8),
+	SPECIALIZED(0xA9),
+	SPECIALIZED(0xAA),
+	SPECIALIZED(0xAB),
+	SPECIALIZED(0xAC),
+	SPECIALIZED(0xAD),
+	XOR_INDIRECT_HL,
+	SPECIALIZED(0xAF),
+
+	SPECIALIZED(0xB0),
+	SPECIALIZED(0xB1),
+	SPECIALIZED(0xB2),
+	SPECIALIZED(0xB3),
+	SPECIALIZED(0xB4),
+	SPECIALIZED(0xB5),
+	OR_INDIRECT_HL,
+	SPECIALIZED(0xB7),
+
+	SPECIALIZED(0xB8),
+	SPECIALIZED(0xB9),
+	SPECIALIZED(0xBA),
+	SPECIALIZED(0xBB),
+	SPECIALIZED(0xBC),
+	SPECIALIZED(0xBD),
+	CP_INDIRECT_HL,
+	SPECIALIZED(0xBF),
+
+	SPECIALIZED(0xC0),
+	SPECIALIZED(0xC1),
+	SPECIALIZED(0xC2),
+	JP_NN,
+	SPECIALIZED(0xC4),
+	SPECIALIZED(0xC5),
+	ADD_N,
+	RST_P,
+
+	SPECIALIZED(0xC8),
+	RET,
+	SPECIALIZED(0xCA),
+	CB_PREFIX,
+	SPECIALIZED(0xCC),
+	CALL_NN,
+	ADC_N,
+	RST_P,
+
+	SPECIALIZED(0xD0),
+	SPECIALIZED(0xD1),
+	SPECIALIZED(0xD2),
+	OUT_N_A,
+	SPECIALIZED(0xD4),
+	SPECIALIZED(0xD5),
+	SUB_N,
+	RST_P,
+
+	SPECIALIZED(0xD8),
+	EXX,
+	SPECIALIZED(0xDA),
+	IN_A_N,
+	SPECIALIZED(0xDC),
+	DD_PREFIX,
+	SBC_N,
+	RST_P,
+
+	SPECIALIZED(0xE0),
+	SPECIALIZED(0xE1),
+	SPECIALIZED(0xE2),
+	EX_INDIRECT_SP_HL,
+	SPECIALIZED(0xE4),
+	SPECIALIZED(0xE5),
+	AND_N,
+	RST_P,
+
+	SPECIALIZED(0xE8),
+	JP_HL,
+	SPECIALIZED(0xEA),
+	EX_DE_HL,
+	SPECIALIZED(0xEC),
+	ED_PREFIX,
+	XOR_N,
+	RST_P,
+
+	SPECIALIZED(0xF0),
+	SPECIALIZED(0xF1),
+	SPECIALIZED(0xF2),
+	DI,
+	SPECIALIZED(0xF4),
+	SPECIALIZED(0xF5),
+	OR_N,
+	RST_P,
+
+	SPECIALIZED(0xF8),
+	LD_SP_HL,
+	SPECIALIZED(0xFA),
+	EI,
+	SPECIALIZED(0xFC),
+	FD_PREFIX,
+	CP_N,
+	RST_P,
+
+};
+
+#define SPECIALIZED_INSTRUCTIONS(X)	\
+	X(LD_RR_NN, 0x01, )	\
+	X(INC_RR, 0x03, )	\
+	X(INC_R, 0x04, )	\
+	X(DEC_R, 0x05, )	\
+	X(LD_R_N, 0x06, )	\
+	X(ADD_HL_RR, 0x09, )	\
+	X(DEC_RR, 0x0B, FUSE(LD_R_R, 0x78) FUSE(OR_R, 0xB1) FUSE(JP_CC_NN, 0xC2))	\
+	X(INC_R, 0x0C, )	\
+	X(DEC_R, 0x0D, )	\
+	X(LD_R_N, 0x0E, )	\
+	X(DJNZ_E, 0x10, FUSE(DJNZ_E, 0x10))	\
+	X(LD_RR_NN, 0x11, )	\
+	X(LD_INDIRECT_DE_A, 0x12, FUSE(INC_RR, 0x13))	\
+	X(INC_RR, 0x13, )	\
+	X(INC_R, 0x14, )	\
+	X(DEC_R, 0x15, )	\
+	X(LD_R_N, 0x16, )	\
+	X(ADD_HL_RR, 0x19, )	\
+	X(LD_A_INDIRECT_DE, 0x1A, FUSE(LD_INDIRECT_HL_R, 0x77) FUSE(INC_RR, 0x23) FUSE(INC_RR, 0x13))	\
+	X(DEC_RR, 0x1B, )	\
+	X(INC_R, 0x1C, )	\
+	X(DEC_R, 0x1D, )	\
+	X(LD_R_N, 0x1E, )	\
+	X(JR_DD_E, 0x20, )	\
+	X(LD_RR_NN, 0x21, )	\
+	X(INC_RR, 0x23, )	\
+	X(INC_R, 0x24, )	\
+	X(DEC_R, 0x25, )	\
+	X(LD_R_N, 0x26, )	\
+	X(JR_DD_E, 0x28, )	\
+	X(ADD_HL_RR, 0x29, )	\
+	X(DEC_RR, 0x2B, )	\
+	X(INC_R, 0x2C, )	\
+	X(DEC_R, 0x2D, )	\
+	X(LD_R_N, 0x2E, )	\
+	X(JR_DD_E, 0x30, )	\
+	X(LD_RR_NN, 0x31, )	\
+	X(INC_RR, 0x33, )	\
+	X(JR_DD_E, 0x38, )	\
+	X(ADD_HL_RR, 0x39, )	\
+	X(DEC_RR, 0x3B, )	\
+	X(INC_R, 0x3C, )	\
+	X(DEC_R, 0x3D, )	\
+	X(LD_R_N, 0x3E, )	\
+	X(LD_R_R, 0x41, )	\
+	X(LD_R_R, 0x42, )	\
+	X(LD_R_R, 0x43, )	\
+	X(LD_R_R, 0x44, )	\
+	X(LD_R_R, 0x45, )	\
+	X(LD_R_INDIRECT_HL, 0x46, )	\
+	X(LD_R_R, 0x47, )	\
+	X(LD_R_R, 0x48, )	\
+	X(LD_R_R, 0x4A, )	\
+	X(LD_R_R, 0x4B, )	\
+	X(LD_R_R, 0x4C, )	\
+	X(LD_R_R, 0x4D, )	\
+	X(LD_R_INDIRECT_HL, 0x4E, )	\
+	X(LD_R_R, 0x4F, )	\
+	X(LD_R_R, 0x50, )	\
+	X(LD_R_R, 0x51, )	\
+	X(LD_R_R, 0x53, )	\
+	X(LD_R_R, 0x54, )	\
+	X(LD_R_R, 0x55, )	\
+	X(LD_R_INDIRECT_HL, 0x56, )	\
+	X(LD_R_R, 0x57, )	\
+	X(LD_R_R, 0x58, )	\
+	X(LD_R_R, 0x59, )	\
+	X(LD_R_R, 0x5A, )	\
+	X(LD_R_R, 0x5C, )	\
+	X(LD_R_R, 0x5D, )	\
+	X(LD_R_INDIRECT_HL, 0x5E, )	\
+	X(LD_R_R, 0x5F, )	\
+	X(LD_R_R, 0x60, )	\
+	X(LD_R_R, 0x61, )	\
+	X(LD_R_R, 0x62, )	\
+	X(LD_R_R, 0x63, )	\
+	X(LD_R_R, 0x65, )	\
+	X(LD_R_INDIRECT_HL, 0x66, )	\
+	X(LD_R_R, 0x67, )	\
+	X(LD_R_R, 0x68, )	\
+	X(LD_R_R, 0x69, )	\
+	X(LD_R_R, 0x6A, )	\
+	X(LD_R_R, 0x6B, )	\
+	X(LD_R_R, 0x6C, )	\
+	X(LD_R_INDIRECT_HL, 0x6E, )	\
+	X(LD_R_R, 0x6F, )	\
+	X(LD_INDIRECT_HL_R, 0x70, )	\
+	X(LD_INDIRECT_HL_R, 0x71, )	\
+	X(LD_INDIRECT_HL_R, 0x72, )	\
+	X(LD_INDIRECT_HL_R, 0x73, )	\
+	X(LD_INDIRECT_HL_R, 0x74, )	\
+	X(LD_INDIRECT_HL_R, 0x75, )	\
+	X(LD_INDIRECT_HL_R, 0x77, )	\
+	X(LD_R_R, 0x78, )	\
+	X(LD_R_R, 0x79, )	\
+	X(LD_R_R, 0x7A, )	\
+	X(LD_R_R, 0x7B, )	\
+	X(LD_R_R, 0x7C, )	\
+	X(LD_R_R, 0x7D, )	\
+	X(LD_R_INDIRECT_HL, 0x7E, FUSE(INC_RR, 0x23))	\
+	X(ADD_R, 0x80, )	\
+	X(ADD_R, 0x81, )	\
+	X(ADD_R, 0x82, )	\
+	X(ADD_R, 0x83, )	\
+	X(ADD_R, 0x84, )	\
+	X(ADD_R, 0x85, )	\
+	X(ADD_R, 0x87, )	\
+	X(ADC_R, 0x88, )	\
+	X(ADC_R, 0x89, )	\
+	X(ADC_R, 0x8A, )	\
+	X(ADC_R, 0x8B, )	\
+	X(ADC_R, 0x8C, )	\
+	X(ADC_R, 0x8D, )	\
+	X(ADC_R, 0x8F, )	\
+	X(SUB_R, 0x90, )	\
+	X(SUB_R, 0x91, )	\
+	X(SUB_R, 0x92, )	\
+	X(SUB_R, 0x93, )	\
+	X(SUB_R, 0x94, )	\
+	X(SUB_R, 0x95, )	\
+	X(SUB_R, 0x97, )	\
+	X(SBC_R, 0x98, )	\
+	X(SBC_R, 0x99, )	\
+	X(SBC_R, 0x9A, )	\
+	X(SBC_R, 0x9B, )	\
+	X(SBC_R, 0x9C, )	\
+	X(SBC_R, 0x9D, )	\
+	X(SBC_R, 0x9F, )	\
+	X(AND_R, 0xA0, )	\
+	X(AND_R, 0xA1, )	\
+	X(AND_R, 0xA2, )	\
+	X(AND_R, 0xA3, )	\
+	X(AND_R, 0xA4, )	\
+	X(AND_R, 0xA5, )	\
+	X(AND_R, 0xA7, )	\
+	X(XOR_R, 0xA8, )	\
+	X(XOR_R, 0xA9, )	\
+	X(XOR_R, 0xAA, )	\
+	X(XOR_R, 0xAB, )	\
+	X(XOR_R, 0xAC, )	\
+	X(XOR_R, 0xAD, )	\
+	X(XOR_R, 0xAF, )	\
+	X(OR_R, 0xB0, )	\
+	X(OR_R, 0xB1, )	\
+	X(OR_R, 0xB2, )	\
+	X(OR_R, 0xB3, )	\
+	X(OR_R, 0xB4, )	\
+	X(OR_R, 0xB5, )	\
+	X(OR_R, 0xB7, )	\
+	X(CP_R, 0xB8, )	\
+	X(CP_R, 0xB9, )	\
+	X(CP_R, 0xBA, )	\
+	X(CP_R, 0xBB, )	\
+	X(CP_R, 0xBC, )	\
+	X(CP_R, 0xBD, )	\
+	X(CP_R, 0xBF, )	\
+	X(RET_CC, 0xC0, )	\
+	X(POP_SS, 0xC1, )	\
+	X(JP_CC_NN, 0xC2, )	\
+	X(CALL_CC_NN, 0xC4, )	\
+	X(PUSH_SS, 0xC5, )	\
+	X(RET_CC, 0xC8, )	\
+	X(JP_CC_NN, 0xCA, )	\
+	X(CALL_CC_NN, 0xCC, )	\
+	X(RET_CC, 0xD0, )	\
+	X(POP_SS, 0xD1, )	\
+	X(JP_CC_NN, 0xD2, )	\
+	X(CALL_CC_NN, 0xD4, )	\
+	X(PUSH_SS, 0xD5, )	\
+	X(RET_CC, 0xD8, )	\
+	X(JP_CC_NN, 0xDA, )	\
+	X(CALL_CC_NN, 0xDC, )	\
+	X(RET_CC, 0xE0, )	\
+	X(POP_SS, 0xE1, )	\
+	X(JP_CC_NN, 0xE2, )	\
+	X(CALL_CC_NN, 0xE4, )	\
+	X(PUSH_SS, 0xE5, )	\
+	X(RET_CC, 0xE8, )	\
+	X(JP_CC_NN, 0xEA, )	\
+	X(CALL_CC_NN, 0xEC, )	\
+	X(RET_CC, 0xF0, )	\
+	X(POP_SS, 0xF1, )	\
+	X(JP_CC_NN, 0xF2, )	\
+	X(CALL_CC_NN, 0xF4, )	\
+	X(PUSH_SS, 0xF5, )	\
+	X(RET_CC, 0xF8, )	\
+	X(JP_CC_NN, 0xFA, )	\
+	X(CALL_CC_NN, 0xFC, )	\
+
+#endif
+
+static const unsigned char CB_INSTRUCTION_TABLE[256] = {
+
+	RLC_R,
+	RLC_R,
+	RLC_R,
+	RLC_R,
+	RLC_R,
+	RLC_R,
+	RLC_INDIRECT_HL,
+	RLC_R,
+
+	RRC_R,
+	RRC_R,
+	RRC_R,
+	RRC_R,
+	RRC_R,
+	RRC_R,
+	RRC_INDIRECT_HL,
+	RRC_R,
+
+	RL_R,
+	RL_R,
+	RL_R,
+	RL_R,
+	RL_R,
+	RL_R,
+	RL_INDIRECT_HL,
+	RL_R,
+
+	RR_R,
+	RR_R,
+	RR_R,
+	RR_R,
+	RR_R,
+	RR_R,
+	RR_INDIRECT_HL,
+	RR_R,
+
+	SLA_R,
+	SLA_R,
+	SLA_R,
+	SLA_R,
+	SLA_R,
+	SLA_R,
+	SLA_INDIRECT_HL,
+	SLA_R,
+
+	SRA_R,
+	SRA_R,
+	SRA_R,
+	SRA_R,
+	SRA_R,
+	SRA_R,
+	SRA_INDIRECT_HL,
+	SRA_R,
+
+	SLL_R,
+	SLL_R,
+	SLL_R,
+	SLL_R,
+	SLL_R,
+	SLL_R,
+	SLL_INDIRECT_HL,
+	SLL_R,
+
+	SRL_R,
+	SRL_R,
+	SRL_R,
+	SRL_R,
+	SRL_R,
+	SRL_R,
+	SRL_INDIRECT_HL,
+	SRL_R,
+
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_INDIRECT_HL,
+	BIT_B_R,
+
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_INDIRECT_HL,
+	BIT_B_R,
+
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_INDIRECT_HL,
+	BIT_B_R,
+
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_INDIRECT_HL,
+	BIT_B_R,
+
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_INDIRECT_HL,
+	BIT_B_R,
+
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_INDIRECT_HL,
+	BIT_B_R,
+
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_INDIRECT_HL,
+	BIT_B_R,
+
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_R,
+	BIT_B_INDIRECT_HL,
+	BIT_B_R,
+
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_INDIRECT_HL,
+	RES_B_R,
+
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_INDIRECT_HL,
+	RES_B_R,
+
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_INDIRECT_HL,
+	RES_B_R,
+
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_INDIRECT_HL,
+	RES_B_R,
+
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_INDIRECT_HL,
+	RES_B_R,
+
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_INDIRECT_HL,
+	RES_B_R,
+
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_INDIRECT_HL,
+	RES_B_R,
+
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_R,
+	RES_B_INDIRECT_HL,
+	RES_B_R,
+
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_INDIRECT_HL,
+	SET_B_R,
+
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_INDIRECT_HL,
+	SET_B_R,
+
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_INDIRECT_HL,
+	SET_B_R,
+
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_INDIRECT_HL,
+	SET_B_R,
+
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_INDIRECT_HL,
+	SET_B_R,
+
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_INDIRECT_HL,
+	SET_B_R,
+
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_INDIRECT_HL,
+	SET_B_R,
+
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_R,
+	SET_B_INDIRECT_HL,
+	SET_B_R,
+
+};
+
+static const unsigned char ED_INSTRUCTION_TABLE[256] = {
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	IN_R_C,
+	OUT_C_R,
+	SBC_HL_RR,
+	LD_INDIRECT_NN_RR,
+	NEG,
+	RETI_RETN,
+	IM_N,
+	LD_I_A_LD_R_A,
+
+	IN_R_C,
+	OUT_C_R,
+	ADC_HL_RR,
+	LD_RR_INDIRECT_NN,
+	NEG,
+	RETI_RETN,
+	IM_N,
+	LD_I_A_LD_R_A,
+
+	IN_R_C,
+	OUT_C_R,
+	SBC_HL_RR,
+	LD_INDIRECT_NN_RR,
+	NEG,
+	RETI_RETN,
+	IM_N,
+	LD_A_I_LD_A_R,
+
+	IN_R_C,
+	OUT_C_R,
+	ADC_HL_RR,
+	LD_RR_INDIRECT_NN,
+	NEG,
+	RETI_RETN,
+	IM_N,
+	LD_A_I_LD_A_R,
+
+	IN_R_C,
+	OUT_C_R,
+	SBC_HL_RR,
+	LD_INDIRECT_NN_RR,
+	NEG,
+	RETI_RETN,
+	IM_N,
+	RLD_RRD,
+
+	IN_R_C,
+	OUT_C_R,
+	ADC_HL_RR,
+	LD_RR_INDIRECT_NN,
+	NEG,
+	RETI_RETN,
+	IM_N,
+	RLD_RRD,
+
+	IN_R_C,
+	OUT_C_R,
+	SBC_HL_RR,
+	LD_INDIRECT_NN_RR,
+	NEG,
+	RETI_RETN,
+	IM_N,
+	ED_UNDEFINED,
+
+	IN_R_C,
+	OUT_C_R,
+	ADC_HL_RR,
+	LD_RR_INDIRECT_NN,
+	NEG,
+	RETI_RETN,
+	IM_N,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+
+	LDI_LDD, 
+	CPI_CPD, 
+	INI_IND, 
+	OUTI_OUTD, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+
+	LDI_LDD, 
+	CPI_CPD, 
+	INI_IND, 
+	OUTI_OUTD, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+
+	LDIR_LDDR, 
+	CPIR_CPDR, 
+	INIR_INDR, 
+	OTIR_OTDR, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+
+	LDIR_LDDR, 
+	CPIR_CPDR, 
+	INIR_INDR, 
+	OTIR_OTDR, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+	ED_UNDEFINED, 
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+	ED_UNDEFINED,
+
+};
+
+static const unsigned char SZYX_FLAGS_TABLE[256] = {
+
+	0x40, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+	0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+	0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 
+	0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 
+	0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 
+	0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 
+	0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+	0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 
+	0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 
+	0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 
+	0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 
+	0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 
+	0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 0x28, 
+	0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 
+	0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 
+	0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 
+	0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 
+	0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 
+	0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 
+	0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 
+	0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 
+	0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 
+	0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 
+	0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 
+	0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 0x88, 
+	0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 
+	0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 
+	0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 0xa0, 
+	0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 0xa8, 
+
+};
+
+static const unsigned char SZYXP_FLAGS_TABLE[256] = {
+
+	0x44, 0x00, 0x00, 0x04, 0x00, 0x04, 0x04, 0x00, 
+	0x08, 0x0c, 0x0c, 0x08, 0x0c, 0x08, 0x08, 0x0c, 
+	0x00, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00, 0x04, 
+	0x0c, 0x08, 0x08, 0x0c, 0x08, 0x0c, 0x0c, 0x08, 
+	0x20, 0x24, 0x24, 0x20, 0x24, 0x20, 0x20, 0x24, 
+	0x2c, 0x28, 0x28, 0x2c, 0x28, 0x2c, 0x2c, 0x28, 
+	0x24, 0x20, 0x20, 0x24, 0x20, 0x24, 0x24, 0x20, 
+	0x28, 0x2c, 0x2c, 0x28, 0x2c, 0x28, 0x28, 0x2c, 
+	0x00, 0x04, 0x04, 0x00, 0x04, 0x00, 0x00, 0x04, 
+	0x0c, 0x08, 0x08, 0x0c, 0x08, 0x0c, 0x0c, 0x08, 
+	0x04, 0x00, 0x00, 0x04, 0x00, 0x04, 0x04, 0x00, 
+	0x08, 0x0c, 0x0c, 0x08, 0x0c, 0x08, 0x08, 0x0c, 
+	0x24, 0x20, 0x20, 0x24, 0x20, 0x24, 0x24, 0x20, 
+	0x28, 0x2c, 0x2c, 0x28, 0x2c, 0x28, 0x28, 0x2c, 
+	0x20, 0x24, 0x24, 0x20, 0x24, 0x20, 0x20, 0x24, 
+	0x2c, 0x28, 0x28, 0x2c, 0x28, 0x2c, 0x2c, 0x28, 
+	0x80, 0x84, 0x84, 0x80, 0x84, 0x80, 0x80, 0x84, 
+	0x8c, 0x88, 0x88, 0x8c, 0x88, 0x8c, 0x8c, 0x88, 
+	0x84, 0x80, 0x80, 0x84, 0x80, 0x84, 0x84, 0x80, 
+	0x88, 0x8c, 0x8c, 0x88, 0x8c, 0x88, 0x88, 0x8c, 
+	0xa4, 0xa0, 0xa0, 0xa4, 0xa0, 0xa4, 0xa4, 0xa0, 
+	0xa8, 0xac, 0xac, 0xa8, 0xac, 0xa8, 0xa8, 0xac, 
+	0xa0, 0xa4, 0xa4, 0xa0, 0xa4, 0xa0, 0xa0, 0xa4, 
+	0xac, 0xa8, 0xa8, 0xac, 0xa8, 0xac, 0xac, 0xa8, 
+	0x84, 0x80, 0x80, 0x84, 0x80, 0x84, 0x84, 0x80, 
+	0x88, 0x8c, 0x8c, 0x88, 0x8c, 0x88, 0x88, 0x8c, 
+	0x80, 0x84, 0x84, 0x80, 0x84, 0x80, 0x80, 0x84, 
+	0x8c, 0x88, 0x88, 0x8c, 0x88, 0x8c, 0x8c, 0x88, 
+	0xa0, 0xa4, 0xa4, 0xa0, 0xa4, 0xa0, 0xa0, 0xa4, 
+	0xac, 0xa8, 0xa8, 0xac, 0xa8, 0xac, 0xac, 0xa8, 
+	0xa4, 0xa0, 0xa0, 0xa4, 0xa0, 0xa4, 0xa4, 0xa0, 
+	0xa8, 0xac, 0xac, 0xa8, 0xac, 0xa8, 0xa8, 0xac, 
+
+};
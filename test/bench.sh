@@ -0,0 +1,160 @@
+#!/bin/bash
+#
+# bench.sh
+#
+# Benchmarks of CPMemu: CPU-bound guest programs and pasting console input
+#
+# Run it from the CPMemu root directory after building the CP/M system (see
+# INSTALL.linux), e.g. with "make -f Makefile.linux bench". To compare builds
+# (e.g. DISPATCH=switch and threaded) run it after each build. The programs are
+# run with the default engine, the 8080 profile ("-8") and the dynamic binary
+# translator ("-j").
+#
+# "cpmemu -s" is started in a temporary directory with a new disk image on a
+# pseudo terminal (with "script"), where the command is typed. The guest
+# program quits the emulator at its end. A run of QUIT.COM is subtracted, so
+# that the start of CP/M and typing the command are not measured. PASTE.COM
+# reads PASTE_BYTES pasted bytes, the run with no bytes is subtracted.
+#
+
+PASTE_BYTES=${PASTE_BYTES:-100000}
+
+for file in cpmemu cpmdisk system.bin
+do
+	if [ ! -f $file ]
+	then
+		echo "$file not found" >&2
+		exit 1
+	fi
+done
+
+dir=$(mktemp -d) || exit 1
+trap "rm -rf $dir" EXIT
+
+cp cpmemu cpmdisk system.bin $dir/ || exit 1
+cd $dir
+
+./cpmdisk init > /dev/null || exit 1
+
+# QUIT.COM: quit the emulator
+#
+#	0100	LD   A,'Q'
+#	0102	OUT  (0E0h),A
+printf '\x3e\x51\xd3\xe0' > quit.com
+
+# CPU.COM: 65536 times read, add, xor and write 256 bytes, then quit
+#
+#	0100	LD   DE,0
+#	0103	LD   HL,2000h	; outer
+#	0106	LD   B,0
+#	0108	LD   A,(HL)	; inner
+#	0109	ADD  A,C
+#	010A	LD   C,A
+#	010B	XOR  B
+#	010C	LD   (HL),A
+#	010D	INC  HL
+#	010E	DJNZ inner
+#	0110	DEC  DE
+#	0111	LD   A,D
+#	0112	OR   E
+#	0113	JP   NZ,outer
+#	0116	LD   A,'Q'
+#	0118	OUT  (0E0h),A
+printf '\x11\x00\x00\x21\x00\x20\x06\x00\x7e\x81\x4f\xa8\x77\x23\x10\xf8'\
+'\x1b\x7a\xb3\xc2\x03\x01\x3e\x51\xd3\xe0' > cpu.com
+
+# INDEX.COM: 65536 times add 256 pairs of bytes with IX (all instructions of the
+# inner loop except DJNZ are prefixed), then quit
+#
+#	0100	LD   DE,0
+#	0103	LD   IX,2000h	; outer
+#	0107	LD   B,0
+#	0109	LD   A,(IX+0)	; inner
+#	010C	ADD  A,(IX+1)
+#	010F	LD   (IX+2),A
+#	0112	INC  IX
+#	0114	DJNZ inner
+#	0116	DEC  DE
+#	0117	LD   A,D
+#	0118	OR   E
+#	0119	JP   NZ,outer
+#	011C	LD   A,'Q'
+#	011E	OUT  (0E0h),A
+printf '\x11\x00\x00\xdd\x21\x00\x20\x06\x00\xdd\x7e\x00\xdd\x86\x01\xdd\x77\x02'\
+'\xdd\x23\x10\xf3\x1b\x7a\xb3\xc2\x03\x01\x3e\x51\xd3\xe0' > index.com
+
+# PASTE.COM: read console input (BDOS function 1) until Ctrl-Z, then quit
+#
+#	0100	LD   C,1	; loop
+#	0102	CALL 5
+#	0105	CP   1Ah
+#	0107	JP   NZ,loop
+#	010A	LD   A,'Q'
+#	010C	OUT  (0E0h),A
+printf '\x0e\x01\xcd\x05\x00\xfe\x1a\xc2\x00\x01\x3e\x51\xd3\xe0' > paste.com
+
+./cpmdisk write quit.com cpu.com index.com paste.com > /dev/null || exit 1
+
+mkfifo input || exit 1
+
+# run "cpmemu -s" with the given options, type the file $1 and print the run
+# time, the number of instructions and the maximum and size of the input buffer
+run ()
+{
+	local file=$1
+	shift
+
+	(sleep 0.2; cat $file; exec sleep 60) > input &
+	local pid=$!
+
+	script -qfec "./cpmemu -s $*" /dev/null < input | tr -d '\r' \
+		| awk '/Run time/ { time = $3 } /Instructions/ { count = $2 }
+		       /Input buffer/ { used = $4; size = $6 }
+		       END { if (time != "") print time, count, used, size }'
+
+	kill $pid 2> /dev/null
+}
+
+# print the speed of the program typed from $2, the run of QUIT.COM is
+# subtracted
+speed ()
+{
+	local label=$1
+	local file=$2
+	shift 2
+
+	local base=$(run quit.txt "$@")
+	local result=$(run $file "$@")
+
+	if [ -n "$base" -a -n "$result" ]
+	then
+		echo "$base $result" | awk -v label="$label" \
+			'{ printf "%s %.2f MIPS\n", label, ($6 - $2) / ($5 - $1) / 1000000 }'
+	fi
+}
+
+echo quit > quit.txt
+echo cpu > cpu.txt
+echo index > index.txt
+
+# the options are skipped, if they are not built in
+for option in "" -8 -j
+do
+	speed "CPU-bound guest program ${option:-(default)}:" cpu.txt $option
+	speed "CPU-bound guest program with IX ${option:-(default)}:" index.txt $option
+done
+
+# the same text is typed as fast as possible
+(echo paste; printf '\x1a') > empty.txt
+(echo paste; yes abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789 \
+	| head -c $PASTE_BYTES; printf '\x1a') > paste.txt
+
+base=$(run empty.txt)
+result=$(run paste.txt)
+
+if [ -n "$base" -a -n "$result" ]
+then
+	echo "$base $result" | awk -v bytes=$PASTE_BYTES \
+		'{ printf "Pasting %d bytes: %.0f bytes/s, input buffer max. %d of %d bytes used\n",
+			  bytes, bytes / ($5 - $1), $7, $8 }'
+fi
@@ -0,0 +1,100 @@
+//
+// corecheck.cpp
+//
+// Differential test of another build of the Z80 core against the default one
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// The Makefile links z80emu.c a second time as the other core (the 8080 profile,
+// the core without superinstructions or the one with the decode cache), whose
+// entry is renamed to Z80EmulateOther (), and gives its name in OTHER_CORE. The
+// 8080 profile continues with the Z80Emulate () of the default core, when it
+// meets a Z80-only opcode. Every second test runs 8080 code, where only a few
+// Z80-only opcodes are left, so that this fallback is taken in the middle of a
+// slice too. With the decode cache the test is compiled with Z80_DECODE_CACHE,
+// so that the contexts have room for it. The default core does not use it.
+//
+#include "randommachine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TESTS		2000
+
+extern "C" int Z80EmulateOther (Z80_STATE *state, int number_cycles);
+
+class CCoreCheck : public CRandomMachine
+{
+public:
+	CCoreCheck (void)
+	:	CRandomMachine (OTHER_CORE, "default")
+	{
+	}
+
+private:
+	int Emulate (unsigned nEngine, Z80_STATE *pState, int nCycles)
+	{
+		return nEngine == 0 ? Z80EmulateOther (pState, nCycles) : Z80Emulate (pState, nCycles);
+	}
+};
+
+// EX AF,AF', DJNZ, JR, EXX and the prefixes, one is kept per 256 bytes
+static void MakeI8080Code (u8 *pMemory)
+{
+	for (unsigned i = 0; i < Z80_RAM_SIZE; i++)
+	{
+		u8 ucOpcode = pMemory[i];
+		if (   (   ((ucOpcode & 0xC7) == 0x00 && ucOpcode >= 0x08)
+			|| ucOpcode == 0xCB || ucOpcode == 0xD9
+			|| ucOpcode == 0xDD || ucOpcode == 0xED || ucOpcode == 0xFD)
+		    && (i & 0xFF) != 0)
+		{
+			pMemory[i] = 0x00;
+		}
+	}
+}
+
+int main (int argc, char **argv)
+{
+	unsigned nTests = argc > 1 ? strtoul (argv[1], 0, 0) : TESTS;
+
+	CCoreCheck Check;
+	unsigned nFailed = 0;
+
+	for (unsigned nTest = 1; nTest <= nTests; nTest++)
+	{
+		Check.Randomize (nTest * 0x9E3779B9U);
+
+		if (nTest % 2 == 0)
+		{
+			MakeI8080Code (Check.GetMemory ());
+		}
+
+		char Name[20];
+		snprintf (Name, sizeof Name, "Test %u", nTest);
+		if (!Check.Run (Name))
+		{
+			nFailed++;
+		}
+	}
+
+	printf ("%s: %u of %u tests failed\n", OTHER_CORE, nFailed, nTests);
+
+	return nFailed == 0 ? 0 : 1;
+}
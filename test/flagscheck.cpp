@@ -0,0 +1,64 @@
+//
+// flagscheck.cpp
+//
+// Differential test of the lazy flags against the eager ones
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// z80emu.c is linked twice, without and with Z80_LAZY_FLAGS. The functions of
+// the second core are renamed by the Makefile (e.g. Z80EmulateLazy ()). Both
+// must agree on the complete state after each slice, including the undocumented
+// X and Y flags. The Makefile builds this test a second time with
+// Z80_DOCUMENTED_FLAGS_ONLY for both cores.
+//
+#include "randommachine.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TESTS		2000
+
+extern "C" int Z80EmulateLazy (Z80_STATE *state, int number_cycles);
+
+class CFlagsCheck : public CRandomMachine
+{
+public:
+	CFlagsCheck (void)
+	:	CRandomMachine ("eager", "lazy")
+	{
+	}
+
+private:
+	int Emulate (unsigned nEngine, Z80_STATE *pState, int nCycles)
+	{
+		return nEngine == 0 ? Z80Emulate (pState, nCycles) : Z80EmulateLazy (pState, nCycles);
+	}
+};
+
+int main (int argc, char **argv)
+{
+	unsigned nTests = argc > 1 ? strtoul (argv[1], 0, 0) : TESTS;
+
+	CFlagsCheck Check;
+	unsigned nFailed = Check.RunTests (nTests);
+
+	printf ("%u of %u tests failed\n", nFailed, nTests);
+
+	return nFailed == 0 ? 0 : 1;
+}
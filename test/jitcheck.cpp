@@ -0,0 +1,120 @@
+//
+// jitcheck.cpp
+//
+// Differential test of the dynamic binary translator against the interpreter
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+// Both engines must agree on the complete state after each slice, including the
+// instruction counter, which counts a repeated block instruction only once (see
+// z80emu.h). Besides random machines it runs repeated block instructions, which
+// overwrite their own prefix and opcode.
+//
+#include "randommachine.h"
+#include "z80jit.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TESTS		2000
+
+class CJITCheck : public CRandomMachine
+{
+public:
+	CJITCheck (void)
+	:	CRandomMachine ("JIT", "interpreter"),
+		m_pJIT (0),
+		m_nTranslatedBlocks (0)
+	{
+	}
+
+	unsigned GetTranslatedBlocks (void) const
+	{
+		return m_nTranslatedBlocks;
+	}
+
+private:
+	void Start (void)
+	{
+		m_pJIT = new CZ80JIT (GetContext (0));
+		if (!m_pJIT->Initialize ())
+		{
+			fprintf (stderr, "Cannot initialize JIT\n");
+
+			exit (2);
+		}
+	}
+
+	int Emulate (unsigned nEngine, Z80_STATE *pState, int nCycles)
+	{
+		return nEngine == 0 ? m_pJIT->Emulate (pState, nCycles) : Z80Emulate (pState, nCycles);
+	}
+
+	void Stop (void)
+	{
+		m_nTranslatedBlocks += m_pJIT->GetTranslatedBlocks ();
+
+		delete m_pJIT;
+		m_pJIT = 0;
+	}
+
+private:
+	CZ80JIT *m_pJIT;
+	unsigned m_nTranslatedBlocks;
+};
+
+int main (int argc, char **argv)
+{
+	unsigned nTests = argc > 1 ? strtoul (argv[1], 0, 0) : TESTS;
+
+	CJITCheck Check;
+	unsigned nFailed = 0;
+
+	// LDDR overwriting its opcode and prefix in the 19th and 20th iteration
+	Check.Randomize (1);
+	Check.GetMemory ()[0x6240] = 0xED;
+	Check.GetMemory ()[0x6241] = 0xB8;
+	Check.GetState ()->registers.word[Z80_BC] = 0x83ED;
+	Check.GetState ()->registers.word[Z80_DE] = 0x6253;
+	Check.GetState ()->registers.word[Z80_HL] = 0xB362;
+	Check.GetState ()->pc = 0x6240;
+	if (!Check.Run ("LDDR"))
+	{
+		nFailed++;
+	}
+
+	// INDR overwriting its opcode and prefix
+	Check.Randomize (2);
+	Check.GetMemory ()[0x1000] = 0xED;
+	Check.GetMemory ()[0x1001] = 0xBA;
+	Check.GetState ()->registers.word[Z80_BC] = 0x4012;
+	Check.GetState ()->registers.word[Z80_HL] = 0x1010;
+	Check.GetState ()->pc = 0x1000;
+	if (!Check.Run ("INDR"))
+	{
+		nFailed++;
+	}
+
+	nFailed += Check.RunTests (nTests);
+
+	printf ("%u of %u tests failed, %u blocks translated\n", nFailed, nTests+2,
+		Check.GetTranslatedBlocks ());
+
+	return nFailed == 0 ? 0 : 1;
+}
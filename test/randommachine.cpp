@@ -0,0 +1,271 @@
+//
+// randommachine.cpp
+//
+// Runs two Z80 engines on random code and compares them
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "randommachine.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_ROUNDS	100		// catch-up calls per slice
+
+// deterministic port input, which does not depend on the engine
+unsigned char PortInput (Z80_CONTEXT *pContext, unsigned short usPort)
+{
+	return (u8) (usPort * 0x9D + 0x5B);
+}
+
+void PortOutput (Z80_CONTEXT *pContext, unsigned short usPort, unsigned char ucValue)
+{
+}
+
+CRandomMachine::CRandomMachine (const char *pEngine0, const char *pEngine1)
+:	m_pMemory (new u8[Z80_RAM_SIZE]),
+	m_nSeed (1)
+{
+	m_pEngine[0] = pEngine0;
+	m_pEngine[1] = pEngine1;
+
+	m_pContext[0] = new Z80_CONTEXT;
+	m_pContext[1] = new Z80_CONTEXT;
+
+	memset (&m_State, 0, sizeof m_State);
+}
+
+CRandomMachine::~CRandomMachine (void)
+{
+	delete m_pContext[1];
+	delete m_pContext[0];
+	delete [] m_pMemory;
+}
+
+void CRandomMachine::Randomize (u32 nSeed)
+{
+	m_nSeed = nSeed != 0 ? nSeed : 1;
+
+	for (unsigned i = 0; i < Z80_RAM_SIZE; i++)
+	{
+		u8 ucByte = (u8) Random ();
+		m_pMemory[i] = ucByte != 0x76 ? ucByte : 0x00;		// no HALT
+	}
+
+	memset (&m_State, 0, sizeof m_State);
+	Z80Reset (&m_State);
+
+	for (unsigned i = 0; i < 7; i++)
+	{
+		m_State.registers.word[i] = (u16) Random ();
+	}
+
+	for (unsigned i = 0; i < 4; i++)
+	{
+		m_State.alternates[i] = (u16) Random ();
+	}
+
+	m_State.i = (u8) Random ();
+	m_State.r = (u8) Random ();
+	m_State.pc = (u16) Random ();
+}
+
+Z80_STATE *CRandomMachine::GetState (void)
+{
+	return &m_State;
+}
+
+u8 *CRandomMachine::GetMemory (void)
+{
+	return m_pMemory;
+}
+
+Z80_CONTEXT *CRandomMachine::GetContext (unsigned nEngine)
+{
+	return m_pContext[nEngine];
+}
+
+boolean CRandomMachine::Run (const char *pName)
+{
+	for (unsigned nEngine = 0; nEngine < 2; nEngine++)
+	{
+		memset (m_pContext[nEngine], 0, sizeof (Z80_CONTEXT));
+		memcpy (m_pContext[nEngine]->memory, m_pMemory, Z80_RAM_SIZE);
+
+		m_Engine[nEngine] = m_State;
+		m_Engine[nEngine].context = m_pContext[nEngine];
+	}
+
+	Start ();
+
+	boolean bResult = TRUE;
+
+	for (unsigned nSlice = 0; nSlice < RANDOM_SLICES && bResult; nSlice++)
+	{
+		u16 usPC = m_Engine[0].pc;
+
+		int nCycles[2];
+		int nInstructions[2];
+		for (unsigned nEngine = 0; nEngine < 2; nEngine++)
+		{
+			nCycles[nEngine] = Emulate (nEngine, &m_Engine[nEngine], RANDOM_SLICE_CYCLES);
+			nInstructions[nEngine] = m_Engine[nEngine].instructions;
+		}
+
+		// Let the engine, which is behind, catch up, until both have stopped
+		// at the same instruction.
+		for (unsigned nRound = 0; nCycles[0] != nCycles[1] && nRound < MAX_ROUNDS; nRound++)
+		{
+			unsigned nEngine = nCycles[0] < nCycles[1] ? 0 : 1;
+
+			nCycles[nEngine] += Emulate (nEngine, &m_Engine[nEngine],
+						     nCycles[!nEngine] - nCycles[nEngine]);
+			nInstructions[nEngine] += m_Engine[nEngine].instructions;
+		}
+
+		for (unsigned nEngine = 0; nEngine < 2; nEngine++)
+		{
+			m_Engine[nEngine].instructions = nInstructions[nEngine];
+		}
+
+		if (nCycles[0] != nCycles[1])
+		{
+			fprintf (stderr, "Cycles: %d (%s) %d (%s)\n", nCycles[0], m_pEngine[0],
+				 nCycles[1], m_pEngine[1]);
+
+			bResult = FALSE;
+		}
+
+		if (!Compare ())
+		{
+			bResult = FALSE;
+		}
+
+		if (!bResult)
+		{
+			fprintf (stderr, "%s: Slice %u from PC %04X differs\n", pName, nSlice,
+				 (unsigned) usPC);
+		}
+	}
+
+	Stop ();
+
+	return bResult;
+}
+
+unsigned CRandomMachine::RunTests (unsigned nTests)
+{
+	unsigned nFailed = 0;
+
+	for (unsigned nTest = 1; nTest <= nTests; nTest++)
+	{
+		Randomize (nTest * 0x9E3779B9U);
+
+		char Name[20];
+		snprintf (Name, sizeof Name, "Test %u", nTest);
+		if (!Run (Name))
+		{
+			nFailed++;
+		}
+	}
+
+	return nFailed;
+}
+
+boolean CRandomMachine::Compare (void)
+{
+	const Z80_STATE *pState0 = &m_Engine[0];
+	const Z80_STATE *pState = &m_Engine[1];
+	boolean bResult = TRUE;
+
+	static const char *Register[] = {"BC", "DE", "HL", "AF", "IX", "IY", "SP"};
+	for (unsigned i = 0; i < 7; i++)
+	{
+		if (pState0->registers.word[i] != pState->registers.word[i])
+		{
+			fprintf (stderr, "%s: %04X (%s) %04X (%s)\n", Register[i],
+				 (unsigned) pState0->registers.word[i], m_pEngine[0],
+				 (unsigned) pState->registers.word[i], m_pEngine[1]);
+
+			bResult = FALSE;
+		}
+	}
+
+	for (unsigned i = 0; i < 4; i++)
+	{
+		if (pState0->alternates[i] != pState->alternates[i])
+		{
+			fprintf (stderr, "%s': %04X (%s) %04X (%s)\n", Register[i],
+				 (unsigned) pState0->alternates[i], m_pEngine[0],
+				 (unsigned) pState->alternates[i], m_pEngine[1]);
+
+			bResult = FALSE;
+		}
+	}
+
+	if (   pState0->status != pState->status
+	    || pState0->pc != pState->pc
+	    || pState0->i != pState->i
+	    || pState0->r != pState->r
+	    || pState0->iff1 != pState->iff1
+	    || pState0->iff2 != pState->iff2
+	    || pState0->im != pState->im
+	    || pState0->instructions != pState->instructions)
+	{
+		const Z80_STATE *pStates[2] = {pState0, pState};
+		for (unsigned i = 0; i < 2; i++)
+		{
+			fprintf (stderr, "PC %04X I %02X R %02X IFF %d%d IM %d STATUS %X INSTR %d (%s)\n",
+				 (unsigned) pStates[i]->pc, (unsigned) pStates[i]->i,
+				 (unsigned) pStates[i]->r, pStates[i]->iff1, pStates[i]->iff2,
+				 pStates[i]->im, pStates[i]->status, pStates[i]->instructions,
+				 m_pEngine[i]);
+		}
+
+		bResult = FALSE;
+	}
+
+	const u8 *pMemory0 = m_pContext[0]->memory;
+	const u8 *pMemory = m_pContext[1]->memory;
+	for (unsigned i = 0; i < Z80_RAM_SIZE; i++)
+	{
+		if (pMemory0[i] != pMemory[i])
+		{
+			fprintf (stderr, "Memory %04X: %02X (%s) %02X (%s)\n", i,
+				 (unsigned) pMemory0[i], m_pEngine[0],
+				 (unsigned) pMemory[i], m_pEngine[1]);
+
+			bResult = FALSE;
+
+			break;
+		}
+	}
+
+	return bResult;
+}
+
+u32 CRandomMachine::Random (void)
+{
+	// xorshift32
+	m_nSeed ^= m_nSeed << 13;
+	m_nSeed ^= m_nSeed >> 17;
+	m_nSeed ^= m_nSeed << 5;
+
+	return m_nSeed;
+}
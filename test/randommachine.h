@@ -0,0 +1,85 @@
+//
+// randommachine.h
+//
+// Runs two Z80 engines on random code and compares them
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef _randommachine_h
+#define _randommachine_h
+
+#include "z80emu.h"
+#include "z80stub.h"
+#include "types.h"
+
+#define RANDOM_SLICES		50
+#define RANDOM_SLICE_CYCLES	2000
+
+// Both engines start with the same random memory image (without HALT, which
+// would only wait) and random registers and run in slices of the same budget.
+// They may run past it differently (e.g. with translated blocks), so that the
+// engine, which is behind, catches up, until both have stopped at the same
+// instruction. Then the complete state (including the instructions counted in
+// the slice) and the memory are compared. Each engine has its own Z80_CONTEXT
+// (see z80stub.h), which is cleared before each test.
+class CRandomMachine
+{
+public:
+	CRandomMachine (const char *pEngine0, const char *pEngine1);
+	virtual ~CRandomMachine (void);
+
+	// random memory and registers, can be modified with GetState () and
+	// GetMemory () before Run ()
+	void Randomize (u32 nSeed);
+
+	Z80_STATE *GetState (void);
+	u8 *GetMemory (void);
+
+	// compares both engines from the prepared machine
+	boolean Run (const char *pName);
+
+	// runs random machines, returns the number of failed tests
+	unsigned RunTests (unsigned nTests);
+
+protected:
+	Z80_CONTEXT *GetContext (unsigned nEngine);
+
+	virtual void Start (void) {}
+	virtual int Emulate (unsigned nEngine, Z80_STATE *pState, int nCycles) = 0;
+	virtual void Stop (void) {}
+
+private:
+	boolean Compare (void);
+
+	u32 Random (void);
+
+private:
+	const char *m_pEngine[2];
+
+	Z80_STATE m_State;
+	u8 *m_pMemory;
+
+	Z80_STATE m_Engine[2];
+	Z80_CONTEXT *m_pContext[2];
+
+	u32 m_nSeed;
+};
+
+#endif
@@ -21,38 +21,100 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
 #include "z80computer.h"
+#include <assert.h>
 
 #ifdef __circle__
 	#include <circle/timer.h>
 	#include <circle/cputhrottle.h>
+#else
+	#include <stdio.h>
+	#include <sys/time.h>
 #endif
 
 #define CYCLES_PER_STEP		10000
 
+#define IDLE_MIN_POLLS		64	// polls with the same CPU state before checking the memory
+#define IDLE_MAX_POLLS		4096
+
 #ifdef __circle__
 CZ80Computer::CZ80Computer (CFATFileSystem *pFileSystem)
-:	m_Memory (pFileSystem),
-	m_RAMDisk0 (pFileSystem, 0),
-	m_RAMDisk1 (pFileSystem, 1),
+:	m_pContext (new Z80_CONTEXT ()),
+	m_Memory (pFileSystem, m_pContext),
 #else
 CZ80Computer::CZ80Computer (void)
-:	m_RAMDisk0 (0),
-	m_RAMDisk1 (1),
+:	m_pContext (new Z80_CONTEXT ()),
+	m_Memory (m_pContext),
+#endif
+	m_Ports (this, m_pContext, &m_Memory, &m_Console, m_pRAMDisk),
+	m_bContinue (TRUE),
+	m_bInputWait (FALSE),
+	m_nCycles (0),
+	m_nInstructions (0),
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+	m_bDiskSaveStop (FALSE),
+#endif
+	m_nIdleAccessCount (0),
+	m_nIdlePolls (0),
+	m_nIdleInterval (IDLE_MIN_POLLS),
+	m_bIdleChecksumValid (FALSE),
+	m_nIdleChecksum (0)
+#ifndef __circle__
+	, m_bStatistics (FALSE),
+	m_nCycleLimit (0),
+	m_bCycleLimitReached (FALSE),
+	m_bStopAtInput (FALSE),
+	m_bStoppedAtInput (FALSE),
+	m_pSnapshotFile (0),
+	m_bSnapshotWritten (FALSE),
+	m_pRestoreSnapshot (0)
+#endif
+#ifdef Z80_JIT
+	, m_JIT (m_pContext),
+	m_bJIT (FALSE)
+#endif
+#ifdef Z80_8080_PROFILE
+	, m_b8080 (FALSE)
+#endif
+#ifdef Z80_PROFILER
+	, m_bProfiler (FALSE)
 #endif
-	m_Ports (this, &m_Memory, &m_Console, &m_RAMDisk0, &m_RAMDisk1),
-	m_bContinue (TRUE)
 {
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+#ifdef __circle__
+		m_pRAMDisk[nDrive] = new CRAMDisk (pFileSystem, nDrive);
+#else
+		m_pRAMDisk[nDrive] = new CRAMDisk (nDrive);
+#endif
+		assert (m_pRAMDisk[nDrive] != 0);
+	}
+
+	m_CPU.context = m_pContext;
 }
 
 CZ80Computer::~CZ80Computer (void)
 {
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+		delete m_pRAMDisk[nDrive];
+		m_pRAMDisk[nDrive] = 0;
+	}
+
+	// m_Memory, m_Ports and m_JIT are destroyed after this, but do not use the context then
+	delete m_pContext;
+	m_pContext = 0;
 }
 
 boolean CZ80Computer::Initialize (void)
 {
-	if (!m_Memory.Initialize ())
+#ifndef __circle__
+	if (m_pRestoreSnapshot == 0)		// the snapshot has the memory
+#endif
 	{
-		return FALSE;
+		if (!m_Memory.Initialize ())
+		{
+			return FALSE;
+		}
 	}
 
 	if (!m_Console.Initialize ())
@@ -60,33 +122,60 @@ boolean CZ80Computer::Initialize (void)
 		return FALSE;
 	}
 
-	if (!m_RAMDisk0.Initialize ())
+	if (!m_pRAMDisk[0]->Initialize ())		// A: is required
 	{
 		return FALSE;
 	}
 
-	m_RAMDisk1.Initialize ();
+	for (unsigned nDrive = 1; nDrive < DISK_DRIVES; nDrive++)
+	{
+		m_pRAMDisk[nDrive]->Initialize ();
+	}
 
 	if (!m_Ports.Initialize ())
 	{
 		return FALSE;
 	}
 
+#ifndef __circle__
+	if (   m_pRestoreSnapshot != 0
+	    && !m_pRestoreSnapshot->Restore (&m_CPU, &m_Memory, &m_Ports, &m_Console, m_pRAMDisk))
+	{
+		return FALSE;
+	}
+
+	m_Ports.SetStopAtInput (m_bStopAtInput);
+#endif
+
+#ifdef Z80_JIT
+	if (   m_bJIT
+	    && !m_JIT.Initialize ())
+	{
+		return FALSE;
+	}
+#endif
+
+#ifdef Z80_PROFILER
+	if (   m_bProfiler
+	    && !m_Profiler.Initialize ())
+	{
+		return FALSE;
+	}
+#endif
+
 	return TRUE;
 }
 
 void CZ80Computer::Run (void)
 {
-	Z80Reset (&m_CPU);
+	Start ();
 
 #ifdef __circle__
 	unsigned nLastTicks = CTimer::Get ()->GetClockTicks ();
 #endif
 
-	while (m_bContinue)
+	while (RunSlice (TRUE) != RunStatusStopped)
 	{
-		Z80Emulate (&m_CPU, CYCLES_PER_STEP);
-
 #ifdef __circle__
 		unsigned nTicks = CTimer::Get ()->GetClockTicks ();
 		if (nTicks - nLastTicks >= 4*CLOCKHZ)			// call this every 4 seconds
@@ -99,9 +188,432 @@ void CZ80Computer::Run (void)
 		m_Console.SetLEDs ();
 #endif
 	}
+
+	Finish ();
+}
+
+void CZ80Computer::Start (void)
+{
+#ifndef __circle__
+	if (m_pRestoreSnapshot == 0)		// m_CPU has been restored otherwise
+#endif
+	{
+		Z80Reset (&m_CPU);
+	}
+	m_IdleState = m_CPU;
+
+#ifdef Z80_PROFILER
+	m_CPU.profile = 0;
+	if (m_bProfiler)
+	{
+		m_Profiler.Attach (&m_CPU);
+	}
+#endif
+
+#ifndef __circle__
+	gettimeofday (&m_StartTime, 0);
+#endif
+}
+
+TRunStatus CZ80Computer::RunSlice (boolean bWaitForInput)
+{
+	if (m_bInputWait)
+	{
+		m_Console.WaitForInput ();		// input is there now
+
+		m_bInputWait = FALSE;
+	}
+
+#ifndef __circle__
+	m_Ports.SetBlockingInput (bWaitForInput);
+#endif
+
+#ifdef Z80_JIT
+	if (m_bJIT)
+	{
+		m_nCycles += m_JIT.Emulate (&m_CPU, CYCLES_PER_STEP);
+	}
+	else
+#endif
+#ifdef Z80_8080_PROFILE
+	if (m_b8080)
+	{
+		m_nCycles += Z80Emulate8080 (&m_CPU, CYCLES_PER_STEP);
+	}
+	else
+#endif
+	{
+		m_nCycles += Z80Emulate (&m_CPU, CYCLES_PER_STEP);
+	}
+	m_nInstructions += m_CPU.instructions;
+
+	m_pContext->port_stop_request = 0;
+
+#ifndef __circle__
+	if (m_Ports.IsInputRetry ())
+	{
+		// the emulation stopped after the IN instruction, which read the
+		// console input port (2 bytes long), it is executed again later and
+		// must not count now, so that R and the cycles do not depend on
+		// when the input arrives
+		m_CPU.pc = (m_CPU.pc - 2) & 0xFFFF;
+
+		boolean bPrefixed = m_Memory.ReadByte (m_CPU.pc) == 0xED;	// IN r,(C)
+		m_CPU.r = (m_CPU.r & 0x80) | ((m_CPU.r - (bPrefixed ? 2 : 1)) & 0x7F);
+		m_nCycles -= bPrefixed ? 12 : 11;				// IN A,(n) otherwise
+		m_nInstructions--;
+
+		if (m_bStopAtInput)
+		{
+			m_bStopAtInput = FALSE;
+			m_bStoppedAtInput = TRUE;
+			m_Ports.SetStopAtInput (FALSE);
+
+			if (m_pSnapshotFile != 0)
+			{
+				m_bSnapshotWritten = CSnapshot::Write (m_pSnapshotFile, &m_CPU, &m_Memory,
+								       &m_Ports, &m_Console, m_pRAMDisk);
+				m_Ports.Quit ();
+			}
+
+			return RunStatusStopped;
+		}
+
+		m_Console.Flush ();
+
+		m_bInputWait = TRUE;
+
+		return RunStatusWaiting;
+	}
+#endif
+
+	if (   m_Ports.IsConsolePolled ()
+	    && CheckIdle ())
+	{
+#ifndef __circle__
+		if (   !bWaitForInput
+		    && !m_Console.IsInputReady ())
+		{
+			m_Console.Flush ();
+
+			m_bInputWait = TRUE;
+
+			return RunStatusWaiting;
+		}
+#endif
+
+		m_Console.WaitForInput ();
+	}
+
+	m_Console.Update ();
+
+#ifndef __circle__
+	if (m_Console.IsEndOfInput ())		// in batch mode
+	{
+		m_Ports.Quit ();
+	}
+	else if (   m_bContinue
+		 && m_nCycleLimit != 0
+		 && m_nCycles >= m_nCycleLimit)
+	{
+		m_bCycleLimitReached = TRUE;
+
+		m_Ports.Quit ();
+	}
+#endif
+
+	return m_bContinue ? RunStatusRunning : RunStatusStopped;
+}
+
+void CZ80Computer::Finish (void)
+{
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+	// the file system must not be unmounted, while core 3 is writing
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+		while (m_pRAMDisk[nDrive]->IsSaving ())
+		{
+			// just wait
+		}
+	}
+	m_bDiskSaveStop = TRUE;
+
+	m_Console.StopScreen ();
+#else
+	m_Console.Flush ();
+#endif
+
+#ifndef __circle__
+	if (m_bStatistics)
+	{
+		struct timeval EndTime;
+		gettimeofday (&EndTime, 0);
+
+		PrintStatistics (  (EndTime.tv_sec - m_StartTime.tv_sec)
+				 + (EndTime.tv_usec - m_StartTime.tv_usec) / 1000000.0);
+	}
+#endif
 }
 
 void CZ80Computer::Shutdown (void)
 {
 	m_bContinue = FALSE;
 }
+
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+
+void CZ80Computer::RunScreen (void)
+{
+	m_Console.RunScreen ();
+}
+
+void CZ80Computer::RunDiskSave (void)
+{
+	while (!m_bDiskSaveStop)
+	{
+		boolean bWritten = FALSE;
+		for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+		{
+			bWritten |= m_pRAMDisk[nDrive]->WriteSnapshot ();
+		}
+
+		if (!bWritten)
+		{
+			CTimer::SimpleMsDelay (10);
+		}
+	}
+}
+
+#endif
+
+// Programs, which wait for input, poll the console status in a loop. The Z80
+// core returns after each empty status poll. If the CPU state (without R) and
+// the memory are the same as at a previous poll and no other port has been
+// accessed since, the program will run the same loop until input arrives and
+// we can wait for it without changing the emulated behaviour (the caller does
+// this, if TRUE is returned). The checksum of the memory is only computed after
+// m_nIdleInterval polls with the same CPU state and this interval grows, while
+// the memory is changing.
+boolean CZ80Computer::CheckIdle (void)
+{
+	if (   m_Ports.GetAccessCount () != m_nIdleAccessCount
+	    || !IsSameState (&m_CPU, &m_IdleState))
+	{
+		m_IdleState = m_CPU;
+		m_nIdleAccessCount = m_Ports.GetAccessCount ();
+		m_nIdlePolls = 0;
+		m_nIdleInterval = IDLE_MIN_POLLS;
+		m_bIdleChecksumValid = FALSE;
+
+		return FALSE;
+	}
+
+	if (++m_nIdlePolls < m_nIdleInterval)
+	{
+		return FALSE;
+	}
+	m_nIdlePolls = 0;
+
+	u64 nChecksum = m_Memory.GetChecksum ();
+	if (m_bIdleChecksumValid)
+	{
+		if (nChecksum == m_nIdleChecksum)
+		{
+			m_nIdleInterval = IDLE_MIN_POLLS;
+			m_bIdleChecksumValid = FALSE;
+
+			return TRUE;
+		}
+
+		if (m_nIdleInterval < IDLE_MAX_POLLS)
+		{
+			m_nIdleInterval *= 2;
+		}
+	}
+
+	m_nIdleChecksum = nChecksum;
+	m_bIdleChecksumValid = TRUE;
+
+	return FALSE;
+}
+
+boolean CZ80Computer::IsSameState (const Z80_STATE *pState1, const Z80_STATE *pState2)
+{
+	for (unsigned i = 0; i < 7; i++)
+	{
+		if (pState1->registers.word[i] != pState2->registers.word[i])
+		{
+			return FALSE;
+		}
+	}
+
+	for (unsigned i = 0; i < 4; i++)
+	{
+		if (pState1->alternates[i] != pState2->alternates[i])
+		{
+			return FALSE;
+		}
+	}
+
+	return    pState1->pc == pState2->pc
+	       && pState1->i == pState2->i
+	       && pState1->iff1 == pState2->iff1
+	       && pState1->iff2 == pState2->iff2
+	       && pState1->im == pState2->im;
+}
+
+#ifndef __circle__
+
+void CZ80Computer::SetStatistics (boolean bEnable)
+{
+	m_bStatistics = bEnable;
+}
+
+void CZ80Computer::SetDiskMapping (TDiskMapping Mapping)
+{
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+		m_pRAMDisk[nDrive]->SetMapping (Mapping);
+	}
+}
+
+void CZ80Computer::SetConsoleFiles (int nInputFile, int nOutputFile)
+{
+	m_Console.SetFiles (nInputFile, nOutputFile);
+}
+
+int CZ80Computer::GetInputFile (void) const
+{
+	return m_Console.GetInputFile ();
+}
+
+u64 CZ80Computer::GetInstructions (void) const
+{
+	return m_nInstructions;
+}
+
+void CZ80Computer::SetCycleLimit (u64 nCycles)
+{
+	m_nCycleLimit = nCycles != 0 ? m_nCycles + nCycles : 0;
+}
+
+boolean CZ80Computer::IsCycleLimitReached (void) const
+{
+	return m_bCycleLimitReached;
+}
+
+CRAMDisk *CZ80Computer::GetRAMDisk (unsigned nDrive)
+{
+	assert (nDrive < DISK_DRIVES);
+	return m_pRAMDisk[nDrive];
+}
+
+void CZ80Computer::SetStopAtInput (boolean bStop)
+{
+	m_bStopAtInput = bStop;
+}
+
+boolean CZ80Computer::IsStoppedAtInput (void) const
+{
+	return m_bStoppedAtInput;
+}
+
+void CZ80Computer::SetSnapshotFile (const char *pFileName)
+{
+	m_pSnapshotFile = pFileName;
+	m_bStopAtInput = pFileName != 0;
+}
+
+boolean CZ80Computer::IsSnapshotWritten (void) const
+{
+	return m_bSnapshotWritten;
+}
+
+void CZ80Computer::SetRestoreSnapshot (const CSnapshot *pSnapshot)
+{
+	m_pRestoreSnapshot = pSnapshot;
+}
+
+boolean CZ80Computer::IsRestored (void) const
+{
+	return m_pRestoreSnapshot != 0;
+}
+
+#ifdef Z80_JIT
+
+void CZ80Computer::SetJIT (boolean bEnable)
+{
+	m_bJIT = bEnable;
+}
+
+#endif
+
+#ifdef Z80_8080_PROFILE
+
+void CZ80Computer::Set8080 (boolean bEnable)
+{
+	m_b8080 = bEnable;
+}
+
+#endif
+
+#ifdef Z80_PROFILER
+
+void CZ80Computer::SetProfiler (boolean bEnable)
+{
+	m_bProfiler = bEnable;
+}
+
+void CZ80Computer::PrintProfile (void) const
+{
+	if (m_bProfiler)
+	{
+		m_Profiler.PrintReport (TRUE);
+	}
+}
+
+#endif
+
+void CZ80Computer::PrintStatistics (double fSeconds) const
+{
+#ifdef Z80_THREADED_DISPATCH
+	const char *pEngine = "threaded";
+#else
+	const char *pEngine = "switch";
+#endif
+#ifdef Z80_DECODE_CACHE
+	const char *pCache = ", decode cache";
+#else
+	const char *pCache = "";
+#endif
+#ifdef Z80_8080_PROFILE
+	const char *pProfile = m_b8080 ? ", 8080 profile" : "";
+#else
+	const char *pProfile = "";
+#endif
+
+	fprintf (stderr, "Z80 core:     %s dispatch%s%s\n", pEngine, pCache, pProfile);
+#ifdef Z80_JIT
+	if (m_bJIT)
+	{
+		fprintf (stderr, "JIT:          %u blocks translated, %u invalidated, %u flushes\n",
+			 m_JIT.GetTranslatedBlocks (), m_JIT.GetInvalidatedBlocks (),
+			 m_JIT.GetFlushes ());
+	}
+#endif
+	fprintf (stderr, "Run time:     %.3f s\n", fSeconds);
+	fprintf (stderr, "Instructions: %llu\n", m_nInstructions);
+	fprintf (stderr, "Cycles:       %llu\n", m_nCycles);
+
+	if (fSeconds > 0.0)
+	{
+		fprintf (stderr, "Speed:        %.2f MIPS, %.2f MHz\n",
+			 m_nInstructions / fSeconds / 1000000.0,
+			 m_nCycles / fSeconds / 1000000.0);
+	}
+
+	fprintf (stderr, "Input buffer: max. %u of %u bytes used\n",
+		 m_Console.GetInputHighWater (), CONSOLE_INPUT_SIZE-1);
+}
+
+#endif
@@ -24,16 +24,35 @@
 #define _z80computer_h
 
 #include "z80emu.h"
+#include "z80stub.h"
 #include "z80memory.h"
 #include "console.h"
 #include "ramdisk.h"
 #include "z80ports.h"
 #include "types.h"
 
+#ifdef Z80_JIT
+	#include "z80jit.h"
+#endif
+
+#ifdef Z80_PROFILER
+	#include "z80profiler.h"
+#endif
+
 #ifdef __circle__
 	#include <circle/fs/fat/fatfs.h>
+#else
+	#include "snapshot.h"
+	#include <sys/time.h>
 #endif
 
+enum TRunStatus
+{
+	RunStatusRunning,
+	RunStatusWaiting,		// for console input, see RunSlice ()
+	RunStatusStopped
+};
+
 class CZ80Computer
 {
 public:
@@ -46,19 +65,119 @@ public:
 
 	boolean Initialize (void);
 
-	void Run (void);
+	void Run (void);			// until shutdown
+
+	// Run () consists of these steps, a scheduler can interleave the slices
+	// of several machines. With bWaitForInput == FALSE RunSlice () returns
+	// RunStatusWaiting instead of waiting for console input (not on Circle),
+	// the next call continues, when the input file is readable.
+	void Start (void);
+	TRunStatus RunSlice (boolean bWaitForInput);	// runs CYCLES_PER_STEP cycles
+	void Finish (void);
 
 	void Shutdown (void);
 
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+	void RunScreen (void);			// writes the console output on core 2
+	void RunDiskSave (void);		// writes RAM disk snapshots on core 3
+#endif
+
+#ifndef __circle__
+	void SetStatistics (boolean bEnable);	// display statistics on exit
+	void SetDiskMapping (TDiskMapping Mapping);	// map the disk images into memory
+	void SetConsoleFiles (int nInputFile, int nOutputFile);	// instead of stdin/stdout,
+								// see CConsole::SetFiles ()
+
+	int GetInputFile (void) const;
+	u64 GetInstructions (void) const;
+
+	// quit like at the end of the input after nCycles more (0 for no limit),
+	// checked after each slice of CYCLES_PER_STEP cycles
+	void SetCycleLimit (u64 nCycles);
+	boolean IsCycleLimitReached (void) const;
+
+	CRAMDisk *GetRAMDisk (unsigned nDrive);		// 0 (A:) to DISK_DRIVES-1
+
+	// RunSlice () returns RunStatusStopped before the machine reads console
+	// input for the first time. Calling RunSlice () again continues it (e.g.
+	// in a child process after fork ()). Call this before Initialize ().
+	void SetStopAtInput (boolean bStop);
+	boolean IsStoppedAtInput (void) const;
+
+	// call these before Initialize (): write a snapshot of the machine, when
+	// it reads console input for the first time, and quit there, or start
+	// in the state of a snapshot instead of booting the system
+	void SetSnapshotFile (const char *pFileName);
+	boolean IsSnapshotWritten (void) const;
+	void SetRestoreSnapshot (const CSnapshot *pSnapshot);	// opened already
+	boolean IsRestored (void) const;	// a snapshot has been set
+#endif
+#ifdef Z80_JIT
+	void SetJIT (boolean bEnable);		// use the dynamic binary translator
+#endif
+#ifdef Z80_8080_PROFILE
+	void Set8080 (boolean bEnable);		// use the 8080 profile of the Z80 core
+#endif
+#ifdef Z80_PROFILER
+	void SetProfiler (boolean bEnable);	// count instructions per address
+	void PrintProfile (void) const;		// print the hot spots, if enabled
+#endif
+
+private:
+	boolean CheckIdle (void);		// returns TRUE, if waiting for input
+	static boolean IsSameState (const Z80_STATE *pState1, const Z80_STATE *pState2);
+
+#ifndef __circle__
+	void PrintStatistics (double fSeconds) const;
+#endif
+
 private:
-	Z80_STATE  m_CPU;
-	CZ80Memory m_Memory;
+	Z80_STATE    m_CPU;
+	Z80_CONTEXT *m_pContext;	// memory and I/O of this machine (on the heap, it is big)
+	CZ80Memory   m_Memory;
 	CConsole   m_Console;
-	CRAMDisk   m_RAMDisk0;		// drive A:
-	CRAMDisk   m_RAMDisk1;		// drive B:
+	CRAMDisk  *m_pRAMDisk[DISK_DRIVES];	// drives A: to P:
 	CZ80Ports  m_Ports;
 
 	boolean m_bContinue;
+	boolean m_bInputWait;			// WaitForInput () on the next slice
+
+	u64 m_nCycles;
+	u64 m_nInstructions;
+
+#if defined (__circle__) && defined (ARM_ALLOW_MULTI_CORE)
+	volatile boolean m_bDiskSaveStop;
+#endif
+
+	// idle detection, see CheckIdle ()
+	Z80_STATE m_IdleState;
+	unsigned  m_nIdleAccessCount;
+	unsigned  m_nIdlePolls;
+	unsigned  m_nIdleInterval;
+	boolean   m_bIdleChecksumValid;
+	u64       m_nIdleChecksum;
+#ifndef __circle__
+	boolean m_bStatistics;
+	struct timeval m_StartTime;
+	u64 m_nCycleLimit;
+	boolean m_bCycleLimitReached;
+	boolean m_bStopAtInput;
+	boolean m_bStoppedAtInput;
+	const char *m_pSnapshotFile;
+	boolean m_bSnapshotWritten;
+	const CSnapshot *m_pRestoreSnapshot;
+#endif
+#ifdef Z80_JIT
+	CZ80JIT m_JIT;
+	boolean m_bJIT;
+#endif
+#ifdef Z80_8080_PROFILE
+	boolean m_b8080;
+#endif
+#ifdef Z80_PROFILER
+	CZ80Profiler m_Profiler;
+	boolean m_bProfiler;
+#endif
 };
 
 #endif
@@ -12,12 +12,29 @@
 #include "macros.h"
 #include "tables.h"
 
+#ifdef __circle__
+#include <circle/util.h>
+#else
+#include <string.h>
+#endif
+
 /* Indirect (HL) or prefixed indexed (IX + d) and (IY + d) memory operands are
  * encoded using the 3 bits "110" (0x06).
  */
 
 #define INDIRECT_HL     0x06
 
+/* Register pair, held in a local variable of emulate(). The bytes are indexed
+ * like in Z80_STATE's registers member (e.g. Z80_B & 1 and Z80_C & 1).
+ */
+
+typedef union {
+
+        unsigned char   byte[2];
+        unsigned short  word;
+
+} REGISTER_PAIR;
+
 /* Condition codes are encoded using 2 or 3 bits.  The xor table is needed for
  * negated conditions, it is used along with the and table.
  */
@@ -76,15 +93,110 @@ static const int        OVERFLOW_TABLE[4] = {
 
                         };
 
+#ifdef Z80_LAZY_FLAGS
+
+/* Kinds of 8-bit operations recorded instead of computing F, see 
+ * Z80_LAZY_FLAGS in macros.h. 
+ */
+
+enum {
+
+        FLAGS_EVALUATED,
+        FLAGS_ADD,
+        FLAGS_SUB,
+        FLAGS_CP,
+        FLAGS_AND,
+        FLAGS_OR_XOR,
+        FLAGS_INC,
+        FLAGS_DEC
+
+};
+
+static int      evaluate_flags (int op, int a, int x, int z);
+
+#endif
+
+#ifdef Z80_DECODE_CACHE
+
+#ifndef Z80_THREADED_DISPATCH
+#error Z80_DECODE_CACHE requires Z80_THREADED_DISPATCH
+#endif
+
+#ifdef Z80_8080_ONLY
+#error Z80_DECODE_CACHE cannot be combined with Z80_8080_ONLY
+#endif
+
+#ifdef Z80_PROFILER
+#error Z80_DECODE_CACHE cannot be combined with Z80_PROFILER
+#endif
+
+/* Decode cache, see Z80_DECODE_CACHE in z80emu.h. Each address, at which an
+ * instruction has been executed, has a record with the handler of the generic
+ * instruction and its opcode. The record of a prefixed instruction points to 
+ * handle_prefixed instead, which selects HL, IX, or IY and accounts the 
+ * additional opcode bytes (which is also the increment of the R register) and
+ * cycles, before it jumps to the handler of instruction. A record takes 16 
+ * bytes on 64-bit hosts. Operands (n, nn, d) are not part of the record, the
+ * handlers fetch them from memory as usual. A "DD" or "FD" prefix followed by
+ * another prefix, except "CB", gets a record of its own and is handled as 
+ * usual.
+ */
+
+typedef Z80_DECODED_INSTRUCTION DECODED_INSTRUCTION;
+
+/* The records are held in the decode_cache[] of the context (see z80stub.h).
+ * Its decode_handler and prefixed_handler are the addresses of handle_decode
+ * and handle_prefixed in emulate(), set on the first call. Its code_pages[] 
+ * mark the pages of 256 bytes, which contain opcode bytes of a record. Writes
+ * to other pages do not need to be checked.
+ */
+
+static void     decode_instruction (Z80_CONTEXT *context, int pc, 
+                        const void * const *dispatch_table);
+static void     invalidate_decoded (Z80_CONTEXT *context, int address);
+
+#endif
+
+static int      block_iterations (int bc, 
+                        int elapsed_cycles, int number_cycles);
+#ifndef Z80_HANDLE_SELF_MODIFYING_CODE
+static void     block_copy (Z80_CONTEXT *context, int hl, int de, int n, 
+                        int d);
+#endif
+static int      block_search (Z80_CONTEXT *context, int a, int hl, int n, 
+                        int d);
+
 static int      emulate (Z80_STATE * state, int number_cycles, int opcode);
+
+#ifdef Z80_8080_ONLY
+
+/* Status flag of the 8080 core, it has stopped before a Z80-only opcode. */
+
+#define STATUS_FLAG_Z80_ONLY    (1 << 7)
+
+#endif
+
+#ifndef Z80_8080_ONLY
                                         
+/* Push the PC register on accepting an interrupt. */
+
+#define PUSH_PC                                                         \
+{                                                                       \
+        Z80_CONTEXT     *context = state->context;                      \
+        int             sp;                                             \
+                                                                        \
+        sp = (state->registers.word[Z80_SP] - 2) & 0xffff;              \
+        state->registers.word[Z80_SP] = sp;                             \
+        Z80_WRITE_WORD(sp, state->pc);                                  \
+}
+
 /* Reset processor's state to power-on default and reset status. */
 
 void Z80Reset (Z80_STATE *state)
 {
         state->status = 0;
-        AF = 0xffff;
-        SP = 0xffff;
+        state->registers.word[Z80_AF] = 0xffff;
+        state->registers.word[Z80_SP] = 0xffff;
         state->i = state->pc = state->iff1 = state->iff2 = 0;
         state->im = Z80_INTERRUPT_MODE_0;
 }
@@ -117,8 +229,7 @@ int Z80Interrupt (Z80_STATE *state, int data_on_bus)
 
                         case Z80_INTERRUPT_MODE_1: {
 
-                                SP -= 2;
-                                Z80_WRITE_WORD(SP, state->pc);          
+                                PUSH_PC;
                                 state->pc = 0x0038;
                                 return 13;
 
@@ -127,8 +238,7 @@ int Z80Interrupt (Z80_STATE *state, int data_on_bus)
                         case Z80_INTERRUPT_MODE_2:
                         default: {
 
-                                SP -= 2;
-                                Z80_WRITE_WORD(SP, state->pc);
+                                PUSH_PC;
                                 state->pc = 
                                         (state->i << 8 | data_on_bus) 
                                         & 0xfffe;
@@ -156,8 +266,7 @@ int Z80NonMaskableInterrupt (Z80_STATE *state)
         state->iff1 = 0;
         state->r = (state->r & 0x80) | ((state->r + 1) & 0x7f);
 
-        SP -= 2;
-        Z80_WRITE_WORD(SP, state->pc);
+        PUSH_PC;
         state->pc = 0x0066;
         
         return 11;
@@ -168,185 +277,733 @@ int Z80NonMaskableInterrupt (Z80_STATE *state)
  * to number_cycles or be slightly greater (most probable case). It will be
  * less if the emulation has been interrupted. Z80_STATE's status member is
  * reset at the start of the emulation. If the emulation is interrupted, it may
- * indicate the reason why.
+ * indicate the reason why. Z80_STATE's instructions member is reset too and
+ * counts the instructions emulated by this call.
  */
 
 int Z80Emulate (Z80_STATE *state, int number_cycles)
 {
-        int     opcode;
+        Z80_CONTEXT     *context = state->context;
+        int             opcode;
 
         Z80_FETCH_BYTE(state->pc, opcode);
         state->pc++;
 
         state->status = 0;
+        state->instructions = 0;
 
         return emulate(state, number_cycles, opcode);
 }
 
-/* Actual emulation function. opcode is the first opcode to emulate, this is 
- * needed by Z80Interrupt() for interrupt mode 0.
+
+/* Announce that size bytes of memory starting at address have been modified
+ * outside of the emulator (e.g. by disk DMA). This is only needed if
+ * Z80_DECODE_CACHE or Z80_JIT is defined.
  */
 
-static int emulate (Z80_STATE * state, int number_cycles, int opcode)
+void Z80InvalidateCode (Z80_CONTEXT *context, int address, int size)
+{
+        while (size-- > 0) {
+
+                INVALIDATE_DECODED(address);
+                INVALIDATE_TRANSLATED(address);
+                address++;
 
+        }
+}
+
+#else
+
+/* Same as Z80Emulate(), but with the 8080 core (see Z80_8080_ONLY in 
+ * z80emu.h). If it meets an opcode, which the 8080 does not have, the rest of
+ * number_cycles is emulated with Z80Emulate(), starting at this opcode.
+ */
+
+int Z80Emulate8080 (Z80_STATE *state, int number_cycles)
 {
-        int     elapsed_cycles, 
-                pc, r, 
-                i;
-        void    *register_table[16], 
-                *dd_register_table[16], 
-                *fd_register_table[16];
+        Z80_CONTEXT     *context = state->context;
+        int             opcode, elapsed_cycles, instructions;
 
-        elapsed_cycles = 0;
+        Z80_FETCH_BYTE(state->pc, opcode);
+        state->pc++;
 
-        pc = state->pc;
-        r = state->r & 0x7f;
+        state->status = 0;
+        state->instructions = 0;
 
-        /* Build register decoding tables for both 3-bit encoded 8-bit
-         * registers and 2-bit encoded 16-bit registers. When an opcode is 
-         * prefixed by 0xdd, HL is replaced by IX. When 0xfd prefixed, HL is
-         * replaced by IY.
-         */
+        elapsed_cycles = emulate(state, number_cycles, opcode);
+        if (state->status & STATUS_FLAG_Z80_ONLY) {
 
-        /* 8-bit "R" registers. */
+                instructions = state->instructions;
+                elapsed_cycles += Z80Emulate(state, 
+                        number_cycles - elapsed_cycles);
+                state->instructions += instructions;
 
-        register_table[0] = &state->registers.byte[Z80_B];
-        register_table[1] = &state->registers.byte[Z80_C];
-        register_table[2] = &state->registers.byte[Z80_D];
-        register_table[3] = &state->registers.byte[Z80_E];
-        register_table[4] = &state->registers.byte[Z80_H];
-        register_table[5] = &state->registers.byte[Z80_L];
+        }
 
-        /* Encoding 0x06 is used for indexed memory operands and direct HL or
-         * IX/IY register access.
-         */
+        return elapsed_cycles;
+}
 
-        register_table[6] = &state->registers.word[Z80_HL];
-        register_table[7] = &state->registers.byte[Z80_A];
-               
-        /* "Regular" 16-bit "RR" registers. */
+#endif
 
-        register_table[8] = &state->registers.word[Z80_BC];
-        register_table[9] = &state->registers.word[Z80_DE];
-        register_table[10] = &state->registers.word[Z80_HL];
-        register_table[11] = &state->registers.word[Z80_SP];
-        
-        /* 16-bit "SS" registers for PUSH and POP instructions (note that SP is
-         * replaced by AF). 
-         */
+/* LDIR, LDDR, CPIR, and CPDR are not executed byte by byte, but as many 
+ * iterations as possible at once on the memory, using the host's memset(), 
+ * memcpy(), memmove(), and memchr(). The number of iterations of LDIR and LDDR
+ * is reduced, so that they stop after overwriting their prefix or opcode like
+ * INIR and INDR do. LDIR and LDDR are still executed byte by byte, if 
+ * Z80_HANDLE_SELF_MODIFYING_CODE is defined.
+ *
+ * Return the number of iterations of a repeated block instruction, which are
+ * executed in one step: until BC is zero (BC = 0 means 65536 iterations) or 
+ * number_cycles is reached, but at least one. Each iteration takes 21 
+ * cycles, the last one only 16. The 8 cycles of the prefix and the opcode,
+ * which are included there, must have been subtracted from elapsed_cycles.
+ */
 
-        register_table[12] = &state->registers.word[Z80_BC];
-        register_table[13] = &state->registers.word[Z80_DE];
-        register_table[14] = &state->registers.word[Z80_HL];
-        register_table[15] = &state->registers.word[Z80_AF];
+static int block_iterations (int bc, int elapsed_cycles, int number_cycles)
+{
+        int     n, remaining;
 
-        /* 0xdd and 0xfd prefixed register decoding tables. */
+        n = bc ? bc : 0x10000;
+        remaining = number_cycles - elapsed_cycles;
+        if (remaining < 21 * n)
 
-        for (i = 0; i < 16; i++)
+                n = remaining > 21 ? (remaining + 20) / 21 : 1;
 
-                dd_register_table[i] 
-                        = fd_register_table[i] 
-                        = register_table[i];
+        return n;
+}
 
-        dd_register_table[4] = &state->registers.byte[Z80_IXH];
-        dd_register_table[5] = &state->registers.byte[Z80_IXL];
-        dd_register_table[6] = &state->registers.word[Z80_IX];
-        dd_register_table[10] = &state->registers.word[Z80_IX];
-        dd_register_table[14] = &state->registers.word[Z80_IX];
+#ifndef Z80_HANDLE_SELF_MODIFYING_CODE
 
-        fd_register_table[4] = &state->registers.byte[Z80_IYH];
-        fd_register_table[5] = &state->registers.byte[Z80_IYL];
-        fd_register_table[6] = &state->registers.word[Z80_IY];
-        fd_register_table[10] = &state->registers.word[Z80_IY];
-        fd_register_table[14] = &state->registers.word[Z80_IY];
+/* Copy n bytes from hl to de like n iterations of LDI (d = +1) or LDD 
+ * (d = -1) do it. The copy is split at the end of the 64 KB memory. If the
+ * destination overlaps the source in the direction of the copy, the bytes, 
+ * which have already been copied, are repeated like the Z80 does it, 
+ * otherwise memmove() gives the same result.
+ */
 
-        goto start_emulation;
+static void block_copy (Z80_CONTEXT *context, int hl, int de, int n, int d)
+{
+        unsigned char   *memory = context->memory;
 
-        for ( ; ; ) {   
+        while (n > 0) {
 
-                void    **registers; 
-                int     instruction;
+                int     length, source, destination, distance, done, c;
 
-                Z80_FETCH_BYTE(pc, opcode);
-                pc++;
+                hl &= 0xffff;
+                de &= 0xffff;
 
-start_emulation:                
+                length = n;
+                if (d > 0) {
 
-                registers = register_table;
+                        if (length > 0x10000 - hl)
 
-emulate_next_opcode:
+                                length = 0x10000 - hl;
 
-                instruction = INSTRUCTION_TABLE[opcode];
+                        if (length > 0x10000 - de)
 
-emulate_next_instruction:
+                                length = 0x10000 - de;
 
-                elapsed_cycles += 4;
-                r++;
-                switch (instruction) {
+                        source = hl;
+                        destination = de;
 
-                        /* 8-bit load group. */
+                } else {
 
-                        case LD_R_R: {
+                        if (length > hl + 1)
 
-                                R(Y(opcode)) = R(Z(opcode));
-                                break;
+                                length = hl + 1;
 
-                        }
+                        if (length > de + 1)
 
-                        case LD_R_N: {
+                                length = de + 1;
 
-                                READ_N(R(Y(opcode)));
-                                break;
+                        source = hl - length + 1;
+                        destination = de - length + 1;
 
-                        }
+                }
 
-                        case LD_R_INDIRECT_HL: {
+                distance = (destination - source) * d;
+                if (distance > 0 && distance < length) {
 
-                                if (registers == register_table) {
+                        if (distance == 1) 
 
-                                        READ_BYTE(HL, R(Y(opcode)));
+                                memset(&memory[destination], 
+                                        memory[hl], length);
 
-                                } else {
+                        else if (d > 0)
 
-                                        int     d;
+                                for (done = 0; done < length; done += c) {
 
-                                        READ_D(d);
-                                        d += HL_IX_IY;
-                                        READ_BYTE(d, S(Y(opcode)));
+                                        c = length - done;
+                                        if (c > distance)
 
-                                        elapsed_cycles += 5;
+                                                c = distance;
+
+                                        memcpy(&memory[destination + done],
+                                                &memory[source + done], c);
 
                                 }
+
+                        else 
+
+                                for (done = length; done > 0; done -= c) {
+
+                                        c = done;
+                                        if (c > distance)
+
+                                                c = distance;
+
+                                        memcpy(&memory[destination + done - c],
+                                                &memory[source + done - c], 
+                                                c);
+
+                                }
+
+                } else if (distance != 0)
+
+                        memmove(&memory[destination], &memory[source], 
+                                length);
+
+                Z80InvalidateCode(context, destination, length);
+
+                hl += length * d;
+                de += length * d;
+                n -= length;
+
+        }
+}
+
+#endif
+
+/* Return the number of bytes, which up to n iterations of CPI (d = +1) or CPD
+ * (d = -1) compare with a, until a byte equal to a has been found at hl. 
+ * Return n, if there is none.
+ */
+
+static int block_search (Z80_CONTEXT *context, int a, int hl, int n, int d)
+{
+        const unsigned char     *memory = context->memory;
+        int                     done, length;
+
+        for (done = 0; done < n; done += length) {
+
+                hl &= 0xffff;
+
+                length = n - done;
+                if (d > 0) {
+
+                        const unsigned char     *p;
+
+                        if (length > 0x10000 - hl)
+
+                                length = 0x10000 - hl;
+
+#ifdef __circle__
+
+                        for (p = &memory[hl]; p < &memory[hl + length]; p++)
+
+                                if (*p == a)
+
+                                        return done + (p - &memory[hl]) + 1;
+
+#else
+
+                        p = memchr(&memory[hl], a, length);
+                        if (p != 0)
+
+                                return done + (p - &memory[hl]) + 1;
+
+#endif
+
+                } else {
+
+                        int     i;
+
+                        if (length > hl + 1)
+
+                                length = hl + 1;
+
+                        for (i = 0; i < length; i++)
+
+                                if (memory[hl - i] == a)
+
+                                        return done + i + 1;
+
+                }
+
+                hl += length * d;
+
+        }
+
+        return n;
+}
+
+#ifdef Z80_LAZY_FLAGS
+
+/* Return F for the last recorded operation, computed exactly like the macros
+ * in macros.h without Z80_LAZY_FLAGS do.
+ */
+
+static int evaluate_flags (int op, int a, int x, int z)
+{
+        int     c, f, y;
+
+        switch (op) {
+
+                case FLAGS_ADD: 
+
+                        c = a ^ x ^ z;
+                        f = c & Z80_H_FLAG;
+                        f |= SZYX_FLAGS_TABLE[z & 0xff];
+                        f |= OVERFLOW_TABLE[c >> 7];
+                        f |= z >> (8 - Z80_C_FLAG_SHIFT);
+                        break;
+
+                case FLAGS_SUB: 
+
+                        c = a ^ x ^ z;
+                        f = Z80_N_FLAG | (c & Z80_H_FLAG);
+                        f |= SZYX_FLAGS_TABLE[z & 0xff];
+                        c &= 0x0180;
+                        f |= OVERFLOW_TABLE[c >> 7];
+                        f |= c >> (8 - Z80_C_FLAG_SHIFT);
+                        break;
+
+                case FLAGS_CP: 
+
+                        c = a ^ x ^ z;
+                        f = Z80_N_FLAG | (c & Z80_H_FLAG);
+                        f |= SZYX_FLAGS_TABLE[z & 0xff] & SZ_FLAGS;
+                        f |= x & YX_FLAGS;
+                        c &= 0x0180;
+                        f |= OVERFLOW_TABLE[c >> 7];
+                        f |= c >> (8 - Z80_C_FLAG_SHIFT);
+                        break;
+
+                case FLAGS_AND: 
+
+                        f = SZYXP_FLAGS_TABLE[z] | Z80_H_FLAG;
+                        break;
+
+                case FLAGS_OR_XOR: 
+
+                        f = SZYXP_FLAGS_TABLE[z];
+                        break;
+
+                case FLAGS_INC: 
+
+                        y = a + 1;
+                        c = a ^ y;
+                        f = (z >> 8) & Z80_C_FLAG;
+                        f |= c & Z80_H_FLAG;
+                        f |= SZYX_FLAGS_TABLE[y & 0xff];
+                        f |= OVERFLOW_TABLE[(c >> 7) & 0x03];
+                        break;
+
+                case FLAGS_DEC: 
+                default:
+
+                        y = a - 1;
+                        c = a ^ y;
+                        f = Z80_N_FLAG | ((z >> 8) & Z80_C_FLAG);
+                        f |= c & Z80_H_FLAG;
+                        f |= SZYX_FLAGS_TABLE[y & 0xff];
+                        f |= OVERFLOW_TABLE[(c >> 7) & 0x03];
+                        break;
+
+        }
+
+        return f;
+}
+
+#endif
+
+#ifdef Z80_DECODE_CACHE
+
+/* Decode the instruction at pc and store its record in the decode cache. */
+
+static void decode_instruction (Z80_CONTEXT *context, int pc, 
+        const void * const *dispatch_table)
+{
+        DECODED_INSTRUCTION     *decoded;
+        int                     opcode, instruction, hl_ix_iy, length,
+                                cycles, last;
+
+        pc &= 0xffff;
+
+        Z80_FETCH_BYTE(pc, opcode);
+        instruction = INSTRUCTION_TABLE[opcode];
+        hl_ix_iy = Z80_HL;
+        length = 1;
+        cycles = 4;
+        last = pc;
+
+        switch (instruction) {
+
+#ifndef Z80_PREFIX_FAILSAFE
+
+                case DD_PREFIX:
+                case FD_PREFIX: {
+
+                        int     next, next_instruction;
+
+                        Z80_FETCH_BYTE(pc + 1, next);
+                        next_instruction = INSTRUCTION_TABLE[next];
+                        if (next_instruction == DD_PREFIX
+                            || next_instruction == FD_PREFIX
+                            || next_instruction == ED_PREFIX)
+
                                 break;
 
+                        hl_ix_iy = instruction == DD_PREFIX
+                                ? Z80_IX
+                                : Z80_IY;
+                        length = 2;
+
+                        if (next_instruction == CB_PREFIX) {
+
+                                /* The handler fetches the displacement
+                                 * between "CB" and the opcode.
+                                 */
+
+                                Z80_FETCH_BYTE(pc + 3, opcode);
+                                instruction = CB_INSTRUCTION_TABLE[opcode];
+                                cycles = 12;
+                                last = pc + 3;
+
+                        } else {
+
+                                opcode = next;
+                                instruction = next_instruction;
+                                cycles = 8;
+                                last = pc + 1;
+
                         }
+                        break;
+
+                }
+
+#endif
+
+                case CB_PREFIX:
+                case ED_PREFIX: {
+
+                        Z80_FETCH_BYTE(pc + 1, opcode);
+                        instruction = instruction == CB_PREFIX
+                                ? CB_INSTRUCTION_TABLE[opcode]
+                                : ED_INSTRUCTION_TABLE[opcode];
+                        length = 2;
+                        cycles = 8;
+                        last = pc + 1;
+                        break;
+
+                }
+
+                default:
+
+                        break;
+
+        }
+
+        decoded = &context->decode_cache[pc];
+        decoded->handler = length == 1 
+                ? dispatch_table[instruction]
+                : context->prefixed_handler;
+        decoded->instruction = instruction;
+        decoded->opcode = opcode;
+        decoded->hl_ix_iy = hl_ix_iy;
+        decoded->length = length;
+        decoded->cycles = cycles;
+
+        context->code_pages[pc >> 8] 
+                = context->code_pages[(last & 0xffff) >> 8] = 1;
+}
+
+/* Invalidate the records, whose opcode bytes may include address. */
+
+static void invalidate_decoded (Z80_CONTEXT *context, int address)
+{
+        int     i;
+
+        for (i = 0; i < 4; i++) {
+
+                DECODED_INSTRUCTION     *decoded;
+
+                decoded = &context->decode_cache[(address - i) & 0xffff];
+                decoded->handler = context->decode_handler;
+
+        }
+}
+
+#endif
+
+/* Actual emulation function. opcode is the first opcode to emulate, this is 
+ * needed by Z80Interrupt() for interrupt mode 0.
+ */
+
+static int emulate (Z80_STATE * state, int number_cycles, int opcode)
+
+{
+        Z80_CONTEXT     *context;
+        int     elapsed_cycles, 
+                pc, r, 
+                instructions,
+                hl_ix_iy;
+#ifdef Z80_LAZY_FLAGS
+        int     flags_op, flags_a, flags_x, flags_z;
+#endif
+        REGISTER_PAIR   reg_af, reg_bc, reg_de, reg_hl, reg_ix, reg_iy;
+        unsigned short  reg_sp;
+#ifdef Z80_PROFILER
+        Z80_PROFILE     *profile;
+        int             profile_pc, profile_cycles;
+#endif
+
+#ifdef Z80_DECODE_CACHE
+
+        const DECODED_INSTRUCTION       *decoded;
+        int                             i;
+
+#endif
+
+#ifdef Z80_THREADED_DISPATCH
+
+        /* Handler addresses of the generic instructions, see DISPATCH() in
+         * macros.h.
+         */
+
+        static const void * const dispatch_table[] = {
+
+                /* Specialized instructions. */
+
+                SPECIALIZED_INSTRUCTIONS(SPECIALIZED_DISPATCH)
+
+                /* 8-bit load group. */
+
+                [LD_INDIRECT_HL_N] = &&handle_LD_INDIRECT_HL_N,
+                [LD_A_INDIRECT_BC] = &&handle_LD_A_INDIRECT_BC,
+                [LD_A_INDIRECT_DE] = &&handle_LD_A_INDIRECT_DE,
+                [LD_A_INDIRECT_NN] = &&handle_LD_A_INDIRECT_NN,
+                [LD_INDIRECT_BC_A] = &&handle_LD_INDIRECT_BC_A,
+                [LD_INDIRECT_DE_A] = &&handle_LD_INDIRECT_DE_A,
+                [LD_INDIRECT_NN_A] = &&handle_LD_INDIRECT_NN_A,
+                Z80_DISPATCH(LD_A_I_LD_A_R)
+                Z80_DISPATCH(LD_I_A_LD_R_A)
+
+                /* 16-bit load group. */
+
+                [LD_HL_INDIRECT_NN] = &&handle_LD_HL_INDIRECT_NN,
+                Z80_DISPATCH(LD_RR_INDIRECT_NN)
+                [LD_INDIRECT_NN_HL] = &&handle_LD_INDIRECT_NN_HL,
+                Z80_DISPATCH(LD_INDIRECT_NN_RR)
+                [LD_SP_HL] = &&handle_LD_SP_HL,
+
+                /* Exchange, block transfer, and search group. */
+
+                [EX_DE_HL] = &&handle_EX_DE_HL,
+                Z80_DISPATCH(EX_AF_AF_PRIME)
+                Z80_DISPATCH(EXX)
+                [EX_INDIRECT_SP_HL] = &&handle_EX_INDIRECT_SP_HL,
+                Z80_DISPATCH(LDI_LDD)
+                Z80_DISPATCH(LDIR_LDDR)
+                Z80_DISPATCH(CPI_CPD)
+                Z80_DISPATCH(CPIR_CPDR)
+
+                /* 8-bit arithmetic and logical group. */
+
+                [ADD_N] = &&handle_ADD_N,
+                [ADD_INDIRECT_HL] = &&handle_ADD_INDIRECT_HL,
+                [ADC_N] = &&handle_ADC_N,
+                [ADC_INDIRECT_HL] = &&handle_ADC_INDIRECT_HL,
+                [SUB_N] = &&handle_SUB_N,
+                [SUB_INDIRECT_HL] = &&handle_SUB_INDIRECT_HL,
+                [SBC_N] = &&handle_SBC_N,
+                [SBC_INDIRECT_HL] = &&handle_SBC_INDIRECT_HL,
+                [AND_N] = &&handle_AND_N,
+                [AND_INDIRECT_HL] = &&handle_AND_INDIRECT_HL,
+                [XOR_N] = &&handle_XOR_N,
+                [XOR_INDIRECT_HL] = &&handle_XOR_INDIRECT_HL,
+                [OR_N] = &&handle_OR_N,
+                [OR_INDIRECT_HL] = &&handle_OR_INDIRECT_HL,
+                [CP_N] = &&handle_CP_N,
+                [CP_INDIRECT_HL] = &&handle_CP_INDIRECT_HL,
+                [INC_INDIRECT_HL] = &&handle_INC_INDIRECT_HL,
+                [DEC_INDIRECT_HL] = &&handle_DEC_INDIRECT_HL,
+
+                /* 16-bit arithmetic group. */
+
+                Z80_DISPATCH(ADC_HL_RR)
+                Z80_DISPATCH(SBC_HL_RR)
+
+                /* General-purpose arithmetic and CPU control group. */
+
+                [DAA] = &&handle_DAA,
+                [CPL] = &&handle_CPL,
+                Z80_DISPATCH(NEG)
+                [CCF] = &&handle_CCF,
+                [SCF] = &&handle_SCF,
+                [NOP] = &&handle_NOP,
+                [HALT] = &&handle_HALT,
+                [DI] = &&handle_DI,
+                [EI] = &&handle_EI,
+                Z80_DISPATCH(IM_N)
+
+                /* Rotate and shift group. */
+
+                [RLCA] = &&handle_RLCA,
+                [RLA] = &&handle_RLA,
+                [RRCA] = &&handle_RRCA,
+                [RRA] = &&handle_RRA,
+                Z80_DISPATCH(RLC_R)
+                Z80_DISPATCH(RLC_INDIRECT_HL)
+                Z80_DISPATCH(RL_R)
+                Z80_DISPATCH(RL_INDIRECT_HL)
+                Z80_DISPATCH(RRC_R)
+                Z80_DISPATCH(RRC_INDIRECT_HL)
+                Z80_DISPATCH(RR_R)
+                Z80_DISPATCH(RR_INDIRECT_HL)
+                Z80_DISPATCH(SLA_R)
+                Z80_DISPATCH(SLA_INDIRECT_HL)
+                Z80_DISPATCH(SLL_R)
+                Z80_DISPATCH(SLL_INDIRECT_HL)
+                Z80_DISPATCH(SRA_R)
+                Z80_DISPATCH(SRA_INDIRECT_HL)
+                Z80_DISPATCH(SRL_R)
+                Z80_DISPATCH(SRL_INDIRECT_HL)
+                Z80_DISPATCH(RLD_RRD)
+
+                /* Bit set, reset, and test group. */
+
+                Z80_DISPATCH(BIT_B_R)
+                Z80_DISPATCH(BIT_B_INDIRECT_HL)
+                Z80_DISPATCH(SET_B_R)
+                Z80_DISPATCH(SET_B_INDIRECT_HL)
+                Z80_DISPATCH(RES_B_R)
+                Z80_DISPATCH(RES_B_INDIRECT_HL)
+
+                /* Jump group. */
+
+                [JP_NN] = &&handle_JP_NN,
+                Z80_DISPATCH(JR_E)
+                [JP_HL] = &&handle_JP_HL,
+                Z80_DISPATCH(DJNZ_E)
+
+                /* Call and return group. */
+
+                [CALL_NN] = &&handle_CALL_NN,
+                [RET] = &&handle_RET,
+                Z80_DISPATCH(RETI_RETN)
+                [RST_P] = &&handle_RST_P,
+
+                /* Input and output group. */
+
+                [IN_A_N] = &&handle_IN_A_N,
+                Z80_DISPATCH(IN_R_C)
+                Z80_DISPATCH(INI_IND)
+                Z80_DISPATCH(INIR_INDR)
+                [OUT_N_A] = &&handle_OUT_N_A,
+                Z80_DISPATCH(OUT_C_R)
+                Z80_DISPATCH(OUTI_OUTD)
+                Z80_DISPATCH(OTIR_OTDR)
+
+                /* Prefix group. */
+
+                Z80_DISPATCH(CB_PREFIX)
+                Z80_DISPATCH(DD_PREFIX)
+                Z80_DISPATCH(FD_PREFIX)
+                Z80_DISPATCH(ED_PREFIX)
+
+                /* Special instruction group. */
+
+                Z80_DISPATCH(ED_UNDEFINED)
+#ifdef Z80_8080_ONLY
+                [Z80_ONLY] = &&handle_Z80_ONLY,
+#endif
+
+        };
+
+#endif
+
+        elapsed_cycles = 0;
+        instructions = 0;
+
+#ifdef Z80_LAZY_FLAGS
+
+        flags_op = FLAGS_EVALUATED;
+        flags_a = flags_x = flags_z = 0;
+
+#endif
+
+        context = state->context;
+        pc = state->pc;
+        r = state->r & 0x7f;
+
+        LOAD_REGISTERS;
+
+#ifdef Z80_PROFILER
+
+        profile = state->profile;
+        profile_pc = pc & 0xffff;
+        profile_cycles = 0;
+
+#endif
+
+#ifdef Z80_DECODE_CACHE
+
+        decoded = context->decode_cache;
+
+        if (context->decode_handler == 0) {
+
+                context->decode_handler = &&handle_decode;
+                context->prefixed_handler = &&handle_prefixed;
+                for (i = 0; i < 0x10000; i++)
+
+                        context->decode_cache[i].handler = 
+                                context->decode_handler;
+
+        }
+
+#endif
+
+        goto start_emulation;
+
+        for ( ; ; ) {   
+
+                int     instruction;
+
+                Z80_FETCH_BYTE(pc, opcode);
+                pc++;
 
-                        case LD_INDIRECT_HL_R: {
+start_emulation:                
 
-                                if (registers == register_table) {
+                hl_ix_iy = Z80_HL;
+                instructions++;
+                PROFILE_INSTRUCTION;
 
-                                        WRITE_BYTE(HL, R(Z(opcode)));
+emulate_next_opcode:
 
-                                } else {
+                instruction = INSTRUCTION_TABLE[opcode];
 
-                                        int     d;
+emulate_next_instruction:
 
-                                        READ_D(d);
-                                        d += HL_IX_IY;
-                                        WRITE_BYTE(d, S(Z(opcode)));
+                elapsed_cycles += 4;
+                r++;
+                DISPATCH(instruction) {
 
-                                        elapsed_cycles += 5;
+                        /* Instructions with register or condition operands
+                         * and the first opcodes of superinstructions, which
+                         * have a handler for each opcode (see 
+                         * SPECIALIZED_HANDLER in macros.h).
+                         */
 
-                                }
-                                break;
+                        SPECIALIZED_INSTRUCTIONS(SPECIALIZED_HANDLER)
 
-                        }
+                        /* 8-bit load group. */
 
-                        case LD_INDIRECT_HL_N: {
+                        INSTRUCTION(LD_INDIRECT_HL_N) {
 
                                 int     n;
 
-                                if (registers == register_table) {
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_N(n);
                                         WRITE_BYTE(HL, n);
@@ -364,64 +1021,58 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_A_INDIRECT_BC: {
+                        INSTRUCTION(LD_A_INDIRECT_BC) {
 
-                                READ_BYTE(BC, A);
-                                break;
+                                LD_A_INDIRECT_BC_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_A_INDIRECT_DE: {
+                        INSTRUCTION(LD_A_INDIRECT_DE) {
 
-                                READ_BYTE(DE, A);
-                                break;
+                                LD_A_INDIRECT_DE_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_A_INDIRECT_NN: {
-
-                                int     nn;
-
-                                READ_NN(nn);
-                                READ_BYTE(nn, A);
+                        INSTRUCTION(LD_A_INDIRECT_NN) {
 
-                                break;
+                                LD_A_INDIRECT_NN_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_INDIRECT_BC_A: {
+                        INSTRUCTION(LD_INDIRECT_BC_A) {
 
-                                WRITE_BYTE(BC, A);
-                                break;
+                                LD_INDIRECT_BC_A_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_INDIRECT_DE_A: {
+                        INSTRUCTION(LD_INDIRECT_DE_A) {
 
-                                WRITE_BYTE(DE, A);
-                                break;
+                                LD_INDIRECT_DE_A_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_INDIRECT_NN_A: {
-
-                                int     nn;
-
-                                READ_NN(nn);
-                                WRITE_BYTE(nn, A);
+                        INSTRUCTION(LD_INDIRECT_NN_A) {
 
-                                break;
+                                LD_INDIRECT_NN_A_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_A_I_LD_A_R: {
+                        Z80_INSTRUCTION(LD_A_I_LD_A_R) {
 
                                 int     a, f;
 
+                                EVALUATE_FLAGS;
+
                                 a = opcode == OPCODE_LD_A_I 
                                         ? state->i 
                                         : (state->r & 0x80) | (r & 0x7f);
@@ -440,11 +1091,11 @@ emulate_next_instruction:
 
                                 elapsed_cycles++;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_I_A_LD_R_A: {
+                        Z80_INSTRUCTION(LD_I_A_LD_R_A) {
 
                                 if (opcode == OPCODE_LD_I_A)
 
@@ -459,128 +1110,112 @@ emulate_next_instruction:
 
                                 elapsed_cycles++;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
                         /* 16-bit load group. */
 
-                        case LD_RR_NN: {
-
-                                READ_NN(RR(P(opcode)));
-                                break;
-
-                        }
-
-                        case LD_HL_INDIRECT_NN: {
+                        INSTRUCTION(LD_HL_INDIRECT_NN) {
 
-                                int     nn;
+                                int     nn, x;
 
                                 READ_NN(nn);
-                                READ_WORD(nn, HL_IX_IY);
+                                READ_WORD(nn, x);
+                                SET_HL_IX_IY(x);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_RR_INDIRECT_NN: {
+                        Z80_INSTRUCTION(LD_RR_INDIRECT_NN) {
 
-                                int     nn;
+                                int     nn, x;
 
                                 READ_NN(nn);
-                                READ_WORD(nn, RR(P(opcode)));
+                                READ_WORD(nn, x);
+                                SET_RR(P(opcode), x);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_INDIRECT_NN_HL: {
+                        INSTRUCTION(LD_INDIRECT_NN_HL) {
 
                                 int     nn;
 
                                 READ_NN(nn);
                                 WRITE_WORD(nn, HL_IX_IY);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_INDIRECT_NN_RR: {
+                        Z80_INSTRUCTION(LD_INDIRECT_NN_RR) {
 
                                 int     nn;
 
                                 READ_NN(nn);
                                 WRITE_WORD(nn, RR(P(opcode)));
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LD_SP_HL: {
+                        INSTRUCTION(LD_SP_HL) {
 
                                 SP = HL_IX_IY;
                                 elapsed_cycles += 2;
-                                break;
-
-                        }
-
-                        case PUSH_SS: {
-
-                                PUSH(SS(P(opcode)));
-                                elapsed_cycles++;
-                                break;
-
-                        }
-
-                        case POP_SS: {
-
-                                POP(SS(P(opcode)));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
                         /* Exchange, block transfer and search group. */
 
-                        case EX_DE_HL: {
+                        INSTRUCTION(EX_DE_HL) {
 
-                                EXCHANGE(DE, HL);
-                                break;                          
+                                EX_DE_HL_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case EX_AF_AF_PRIME: {
+                        Z80_INSTRUCTION(EX_AF_AF_PRIME) {
+
+                                EVALUATE_FLAGS;
 
                                 EXCHANGE(AF, state->alternates[Z80_AF]);
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case EXX: {
+                        Z80_INSTRUCTION(EXX) {
 
                                 EXCHANGE(BC, state->alternates[Z80_BC]);
                                 EXCHANGE(DE, state->alternates[Z80_DE]);
                                 EXCHANGE(HL, state->alternates[Z80_HL]);
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }                                               
 
-                        case EX_INDIRECT_SP_HL: {
+                        INSTRUCTION(EX_INDIRECT_SP_HL) {
 
                                 int     t;
 
                                 READ_WORD(SP, t);
                                 WRITE_WORD(SP, HL_IX_IY);
-                                HL_IX_IY = t;
+                                SET_HL_IX_IY(t);
 
                                 elapsed_cycles += 3;
 
-                                break;                                               
+                                NEXT_INSTRUCTION;                                               
                         }
 
-                        case LDI_LDD: {
+                        Z80_INSTRUCTION(LDI_LDD) {
 
                                 int     n, f, d;
 
+                                EVALUATE_FLAGS;
+
                                 READ_BYTE(HL, n);
                                 WRITE_BYTE(DE, n);
 
@@ -604,23 +1239,23 @@ emulate_next_instruction:
 
                                 elapsed_cycles += 2;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case LDIR_LDDR: {
+                        Z80_INSTRUCTION(LDIR_LDDR) {
 
-                                int     d, f, bc, de, hl, n;
-                                
-#ifdef Z80_HANDLE_SELF_MODIFYING_CODE
+                                int     d, f, bc, de, hl, n, p, q;
 
-                                int     p, q;
+#ifdef Z80_HANDLE_SELF_MODIFYING_CODE
 
                                 p = (pc - 2) & 0xffff;
                                 q = (pc - 1) & 0xffff;
 
 #endif                          
 
+                                EVALUATE_FLAGS;
+
                                 d = opcode == OPCODE_LDIR ? +1 : -1;
 
                                 f = F & SZC_FLAGS;
@@ -630,6 +1265,50 @@ emulate_next_instruction:
 
                                 r -= 2;
                                 elapsed_cycles -= 8;
+
+#ifndef Z80_HANDLE_SELF_MODIFYING_CODE
+
+                                n = block_iterations(bc, 
+                                        elapsed_cycles, number_cycles);
+
+                                /* Stop after the iteration, which overwrites
+                                 * the prefix or the opcode, so that the new
+                                 * instruction is fetched then.
+                                 */
+
+                                p = ((pc - 2 - de) * d) & 0xffff;
+                                q = ((pc - 1 - de) * d) & 0xffff;
+                                if (q < p)
+
+                                        p = q;
+
+                                if (p < n)
+
+                                        n = p + 1;
+
+                                block_copy(context, hl, de, n, d);
+
+                                r += 2 * n;
+                                hl += n * d;
+                                de += n * d;
+                                bc = (bc - n) & 0xffff;
+                                if (bc) {
+
+                                        elapsed_cycles += 21 * n;
+                                        f |= Z80_P_FLAG;
+                                        pc -= 2;
+                                        if (n <= p)
+
+                                                instructions--;
+
+                                } else 
+
+                                        elapsed_cycles += 21 * n - 5;
+
+                                n = context->memory[(de - d) & 0xffff];
+
+#else
+
                                 for ( ; ; ) {
 
                                         r += 2;
@@ -651,8 +1330,6 @@ emulate_next_instruction:
 
                                         } 
 
-#ifdef Z80_HANDLE_SELF_MODIFYING_CODE
-
                                         if (((de - d) & 0xffff) == p 
                                         || ((de - d) & 0xffff) == q) { 
 
@@ -662,8 +1339,6 @@ emulate_next_instruction:
 
                                         }
 
-#endif                                  
-
                                         if (elapsed_cycles < number_cycles) 
 
                                                 continue;
@@ -672,12 +1347,15 @@ emulate_next_instruction:
         
                                                 f |= Z80_P_FLAG;
                                                 pc -= 2;
+                                                instructions--;
                                                 break;
 
                                         }
 
                                 } 
 
+#endif
+
                                 HL = hl;
                                 DE = de;
                                 BC = bc;
@@ -693,14 +1371,16 @@ emulate_next_instruction:
 
                                 F = f;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case CPI_CPD: {
+                        Z80_INSTRUCTION(CPI_CPD) {
 
                                 int     a, n, z, f;
 
+                                EVALUATE_FLAGS;
+
                                 a = A;
                                 READ_BYTE(HL, n);
                                 z = a - n;
@@ -724,13 +1404,15 @@ emulate_next_instruction:
 
                                 elapsed_cycles += 5;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case CPIR_CPDR: {
+                        Z80_INSTRUCTION(CPIR_CPDR) {
                                         
-                                int     d, a, bc, hl, n, z, f;
+                                int     d, a, bc, hl, i, n, z, f;
+
+                                EVALUATE_FLAGS;
 
                                 d = opcode == OPCODE_CPIR ? +1 : -1;
 
@@ -738,39 +1420,25 @@ emulate_next_instruction:
                                 bc = BC;
                                 hl = HL;
 
-                                r -= 2;
-                                elapsed_cycles -= 8;
-                                for ( ; ; ) {
-
-                                        r += 2;
-
-                                        Z80_READ_BYTE(hl, n);
-                                        z = a - n;
-
-                                        hl += d;
-                                        if (--bc && z) 
-
-                                                elapsed_cycles += 21;
-
-                                        else {
-
-                                                elapsed_cycles += 16;
-                                                break;
-
-                                        } 
+                                i = block_iterations(bc, 
+                                        elapsed_cycles - 8, number_cycles);
+                                i = block_search(context, a, hl, i, d);
 
-                                        if (elapsed_cycles < number_cycles) 
+                                r += 2 * i - 2;
+                                hl += i * d;
+                                bc = (bc - i) & 0xffff;
 
-                                                continue;
+                                n = context->memory[(hl - d) & 0xffff];
+                                z = a - n;
+                                if (bc && z) {
 
-                                        else {
-        
-                                                pc -= 2;
-                                                break;
+                                        elapsed_cycles += 21 * i - 8;
+                                        pc -= 2;
+                                        instructions--;
 
-                                        }
+                                } else
 
-                                } 
+                                        elapsed_cycles += 21 * i - 13;
 
                                 HL = hl;
                                 BC = bc;
@@ -790,257 +1458,194 @@ emulate_next_instruction:
                                 f |= bc ? Z80_P_FLAG : 0;
                                 F = f | Z80_N_FLAG | (F & Z80_C_FLAG);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
 
                         }                               
 
                         /* 8-bit arithmetic and logical group. */
 
-                        case ADD_R: {
-
-                                ADD(R(Z(opcode)));
-                                break;
-
-                        }
-
-                        case ADD_N: {
+                        INSTRUCTION(ADD_N) {
 
                                 int     n;
 
                                 READ_N(n);
                                 ADD(n);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case ADD_INDIRECT_HL: {
+                        INSTRUCTION(ADD_INDIRECT_HL) {
 
                                 int     x;
 
                                 READ_INDIRECT_HL(x);
                                 ADD(x);
 
-                                break;
-
-                        }
-
-                        case ADC_R: {
-
-                                ADC(R(Z(opcode)));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case ADC_N: {
+                        INSTRUCTION(ADC_N) {
 
                                 int     n;
 
                                 READ_N(n);
                                 ADC(n);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case ADC_INDIRECT_HL: {
+                        INSTRUCTION(ADC_INDIRECT_HL) {
 
                                 int     x;
 
                                 READ_INDIRECT_HL(x);
                                 ADC(x);
 
-                                break;
-
-                        }
-
-                        case SUB_R: {
-
-                                SUB(R(Z(opcode)));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SUB_N: {
+                        INSTRUCTION(SUB_N) {
 
                                 int     n;
 
                                 READ_N(n);
                                 SUB(n);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SUB_INDIRECT_HL: {
+                        INSTRUCTION(SUB_INDIRECT_HL) {
 
                                 int     x;
 
                                 READ_INDIRECT_HL(x);
                                 SUB(x);
 
-                                break;
-
-                        }
-
-                        case SBC_R: {
-
-                                SBC(R(Z(opcode)));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SBC_N: {
+                        INSTRUCTION(SBC_N) {
 
                                 int     n;
 
                                 READ_N(n);
                                 SBC(n);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SBC_INDIRECT_HL: {
+                        INSTRUCTION(SBC_INDIRECT_HL) {
 
                                 int     x;
 
                                 READ_INDIRECT_HL(x);
                                 SBC(x);
 
-                                break;
-
-                        }
-
-                        case AND_R: {
-
-                                AND(R(Z(opcode)));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case AND_N: {
+                        INSTRUCTION(AND_N) {
 
                                 int     n;
 
                                 READ_N(n);
                                 AND(n);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case AND_INDIRECT_HL: {
+                        INSTRUCTION(AND_INDIRECT_HL) {
 
                                 int     x;
 
                                 READ_INDIRECT_HL(x);
                                 AND(x);
 
-                                break;
-
-                        }
-
-                        case OR_R: {
-
-                                OR(R(Z(opcode)));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case OR_N: {
+                        INSTRUCTION(OR_N) {
 
                                 int     n;
 
                                 READ_N(n);
                                 OR(n);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case OR_INDIRECT_HL: {
+                        INSTRUCTION(OR_INDIRECT_HL) {
 
                                 int     x;
 
                                 READ_INDIRECT_HL(x);
                                 OR(x);
 
-                                break;
-
-                        }
-
-                        case XOR_R: {
-
-                                XOR(R(Z(opcode)));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case XOR_N: {
+                        INSTRUCTION(XOR_N) {
 
                                 int     n;
 
                                 READ_N(n);
                                 XOR(n);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case XOR_INDIRECT_HL: {
+                        INSTRUCTION(XOR_INDIRECT_HL) {
 
                                 int     x;
 
                                 READ_INDIRECT_HL(x);
                                 XOR(x);
 
-                                break;
-
-                        }
-
-                        case CP_R: {
-
-                                CP(R(Z(opcode)));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case CP_N: {
+                        INSTRUCTION(CP_N) {
 
                                 int     n;
 
                                 READ_N(n);
                                 CP(n);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case CP_INDIRECT_HL: {
+                        INSTRUCTION(CP_INDIRECT_HL) {
 
                                 int     x;
 
                                 READ_INDIRECT_HL(x);
                                 CP(x);
 
-                                break;
-
-                        }
-
-                        case INC_R: {
-
-                                INC(R(Y(opcode)));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case INC_INDIRECT_HL: {
+                        INSTRUCTION(INC_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         INC(x);
@@ -1062,22 +1667,15 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
-
-                        }
-
-                        case DEC_R: {
-
-                                DEC(R(Y(opcode)));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case DEC_INDIRECT_HL: {
+                        INSTRUCTION(DEC_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         DEC(x);
@@ -1099,16 +1697,18 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
                         /* General-purpose arithmetic and CPU control group. */
 
-                        case DAA: {
+                        INSTRUCTION(DAA) {
                         
                                 int     a, c, d;
 
+                                EVALUATE_FLAGS;
+
                                 /* The following algorithm is from
                                  * comp.sys.sinclair's FAQ. 
                                  */
@@ -1133,11 +1733,13 @@ emulate_next_instruction:
                                         | (F & Z80_N_FLAG)
                                         | c;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case CPL: {
+                        INSTRUCTION(CPL) {
+
+                                EVALUATE_FLAGS;
 
                                 A = ~A;
 
@@ -1151,14 +1753,16 @@ emulate_next_instruction:
 
                                         | Z80_H_FLAG | Z80_N_FLAG;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case NEG: {
+                        Z80_INSTRUCTION(NEG) {
 
                                 int     a, f, z, c;
 
+                                EVALUATE_FLAGS;
+
                                 a = A;
                                 z = -a;
 
@@ -1172,14 +1776,16 @@ emulate_next_instruction:
                                 A = z;
                                 F = f;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case CCF: {
+                        INSTRUCTION(CCF) {
 
                                 int     c;
 
+                                EVALUATE_FLAGS;
+
                                 c = F & Z80_C_FLAG;
                                 F = (F & SZPV_FLAGS)
                                         | (c << Z80_H_FLAG_SHIFT)
@@ -1192,11 +1798,13 @@ emulate_next_instruction:
 
                                         | (c ^ Z80_C_FLAG);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SCF: {
+                        INSTRUCTION(SCF) {
+
+                                EVALUATE_FLAGS;
 
                                 F = (F & SZPV_FLAGS) 
 
@@ -1208,17 +1816,17 @@ emulate_next_instruction:
 
                                         | Z80_C_FLAG;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case NOP: {
+                        INSTRUCTION(NOP) {
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case HALT: {
+                        INSTRUCTION(HALT) {
 
 #ifdef Z80_CATCH_HALT
 
@@ -1228,13 +1836,13 @@ emulate_next_instruction:
 #else
 
                                 pc--;
-                                break;
+                                NEXT_INSTRUCTION;
 
 #endif
 
                         }
 
-                        case DI: {
+                        INSTRUCTION(DI) {
 
                                 state->iff1 = state->iff2 = 0;
 
@@ -1258,13 +1866,13 @@ emulate_next_instruction:
 
                                 number_cycles += 4;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
 #endif                  
 
                         }
 
-                        case EI: {
+                        INSTRUCTION(EI) {
 
                                 state->iff1 = state->iff2 = 1;
 
@@ -1279,13 +1887,13 @@ emulate_next_instruction:
 
                                 number_cycles += 4;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
 #endif
 
                         }
 
-                        case IM_N: {
+                        Z80_INSTRUCTION(IM_N) {
 
                                 /* "IM 0/1" (0xed prefixed opcodes 0x4e and
                                  * 0x6e) is treated like a "IM 0".
@@ -1303,44 +1911,17 @@ emulate_next_instruction:
 
                                         state->im = Z80_INTERRUPT_MODE_2;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
                         /* 16-bit arithmetic group. */
 
-                        case ADD_HL_RR: {
+                        Z80_INSTRUCTION(ADC_HL_RR) {
 
                                 int     x, y, z, f, c;
 
-                                x = HL_IX_IY;
-                                y = RR(P(opcode));
-                                z = x + y;
-
-                                c = x ^ y ^ z;
-                                f = F & SZPV_FLAGS;
-
-#ifndef Z80_DOCUMENTED_FLAGS_ONLY
-
-                                f |= (z >> 8) & YX_FLAGS;
-                                f |= (c >> 8) & Z80_H_FLAG;
-
-#endif
-
-                                f |= c >> (16 - Z80_C_FLAG_SHIFT);
-
-                                HL_IX_IY = z;
-                                F = f;
-
-                                elapsed_cycles += 7;
-
-                                break;
-
-                        }
-
-                        case ADC_HL_RR: {
-
-                                int     x, y, z, f, c;
+                                EVALUATE_FLAGS;
                         
                                 x = HL;
                                 y = RR(P(opcode));
@@ -1365,13 +1946,15 @@ emulate_next_instruction:
 
                                 elapsed_cycles += 7;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SBC_HL_RR: {
+                        Z80_INSTRUCTION(SBC_HL_RR) {
 
                                 int     x, y, z, f, c;
+
+                                EVALUATE_FLAGS;
                         
                                 x = HL;
                                 y = RR(P(opcode));
@@ -1381,70 +1964,46 @@ emulate_next_instruction:
                                 f = Z80_N_FLAG;
                                 f |= z & 0xffff
                                         ? (z >> 8) & SYX_FLAGS 
-                                        : Z80_Z_FLAG;
-
-#ifndef Z80_DOCUMENTED_FLAGS_ONLY
-
-                                f |= (c >> 8) & Z80_H_FLAG;
-
-#endif
-
-                                c &= 0x018000;
-                                f |= OVERFLOW_TABLE[c >> 15];
-                                f |= c >> (16 - Z80_C_FLAG_SHIFT);
-
-                                HL = z;
-                                F = f;  
-
-                                elapsed_cycles += 7;
-
-                                break;
-
-                        }
-
-                        case INC_RR: {
-
-                                int     x;
-
-                                x = RR(P(opcode));
-                                x++;
-                                RR(P(opcode)) = x;
-
-                                elapsed_cycles += 2;
+                                        : Z80_Z_FLAG;
 
-                                break;
+#ifndef Z80_DOCUMENTED_FLAGS_ONLY
 
-                        }
+                                f |= (c >> 8) & Z80_H_FLAG;
 
-                        case DEC_RR: {
+#endif
 
-                                int     x;
+                                c &= 0x018000;
+                                f |= OVERFLOW_TABLE[c >> 15];
+                                f |= c >> (16 - Z80_C_FLAG_SHIFT);
 
-                                x = RR(P(opcode));
-                                x--;
-                                RR(P(opcode)) = x;
+                                HL = z;
+                                F = f;  
 
-                                elapsed_cycles += 2;
+                                elapsed_cycles += 7;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
                         /* Rotate and shift group. */
 
-                        case RLCA: {
+                        INSTRUCTION(RLCA) {
                         
+                                EVALUATE_FLAGS;
+
                                 A = (A << 1) | (A >> 7);
                                 F = (F & SZPV_FLAGS)
                                         | (A & (YX_FLAGS | Z80_C_FLAG));
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RLA: {
+                        INSTRUCTION(RLA) {
 
                                 int     a, f;
 
+                                EVALUATE_FLAGS;
+
                                 a = A << 1;
                                 f = (F & SZPV_FLAGS)
 
@@ -1458,14 +2017,16 @@ emulate_next_instruction:
                                 A = a | (F & Z80_C_FLAG); 
                                 F = f;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RRCA: {
+                        INSTRUCTION(RRCA) {
 
                                 int     c;
 
+                                EVALUATE_FLAGS;
+
                                 c = A & 0x01;
                                 A = (A >> 1) | (A << 7);
                                 F = (F & SZPV_FLAGS)
@@ -1478,14 +2039,16 @@ emulate_next_instruction:
 
                                         | c;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RRA: {
+                        INSTRUCTION(RRA) {
 
                                 int     c;
 
+                                EVALUATE_FLAGS;
+
                                 c = A & 0x01;
                                 A = (A >> 1) | ((F & Z80_C_FLAG) << 7);
                                 F = (F & SZPV_FLAGS)
@@ -1498,22 +2061,31 @@ emulate_next_instruction:
 
                                         | c;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RLC_R: {
+                        Z80_INSTRUCTION(RLC_R) {
 
-                                RLC(R(Z(opcode)));
-                                break;
+                                int     x;
+
+                                EVALUATE_FLAGS;
+
+                                x = R(Z(opcode));
+                                RLC(x);
+                                SET_R(Z(opcode), x);
+
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RLC_INDIRECT_HL: {
+                        Z80_INSTRUCTION(RLC_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                EVALUATE_FLAGS;
+
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         RLC(x);
@@ -1534,7 +2106,7 @@ emulate_next_instruction:
 
                                         if (Z(opcode) != INDIRECT_HL)
 
-                                                R(Z(opcode)) = x;
+                                                SET_R(Z(opcode), x);
 
                                         pc += 2;
 
@@ -1542,22 +2114,31 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RL_R: {
+                        Z80_INSTRUCTION(RL_R) {
 
-                                RL(R(Z(opcode)));
-                                break;
+                                int     x;
+
+                                EVALUATE_FLAGS;
+
+                                x = R(Z(opcode));
+                                RL(x);
+                                SET_R(Z(opcode), x);
+
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RL_INDIRECT_HL: {
+                        Z80_INSTRUCTION(RL_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                EVALUATE_FLAGS;
+
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         RL(x);
@@ -1578,7 +2159,7 @@ emulate_next_instruction:
 
                                         if (Z(opcode) != INDIRECT_HL)
 
-                                                R(Z(opcode)) = x;
+                                                SET_R(Z(opcode), x);
 
                                         pc += 2;
 
@@ -1586,22 +2167,31 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RRC_R: {
+                        Z80_INSTRUCTION(RRC_R) {
 
-                                RRC(R(Z(opcode)));
-                                break;
+                                int     x;
+
+                                EVALUATE_FLAGS;
+
+                                x = R(Z(opcode));
+                                RRC(x);
+                                SET_R(Z(opcode), x);
+
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RRC_INDIRECT_HL: {
+                        Z80_INSTRUCTION(RRC_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                EVALUATE_FLAGS;
+
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         RRC(x);
@@ -1622,7 +2212,7 @@ emulate_next_instruction:
 
                                         if (Z(opcode) != INDIRECT_HL)
 
-                                                R(Z(opcode)) = x;
+                                                SET_R(Z(opcode), x);
 
                                         pc += 2;
 
@@ -1630,22 +2220,31 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RR_R: {
+                        Z80_INSTRUCTION(RR_R) {
 
-                                RR_INSTRUCTION(R(Z(opcode)));
-                                break;
+                                int     x;
+
+                                EVALUATE_FLAGS;
+
+                                x = R(Z(opcode));
+                                RR_INSTRUCTION(x);
+                                SET_R(Z(opcode), x);
+
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RR_INDIRECT_HL: {
+                        Z80_INSTRUCTION(RR_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                EVALUATE_FLAGS;
+
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         RR_INSTRUCTION(x);
@@ -1666,7 +2265,7 @@ emulate_next_instruction:
 
                                         if (Z(opcode) != INDIRECT_HL)
 
-                                                R(Z(opcode)) = x;
+                                                SET_R(Z(opcode), x);
 
                                         pc += 2;
 
@@ -1674,22 +2273,31 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SLA_R: {
+                        Z80_INSTRUCTION(SLA_R) {
 
-                                SLA(R(Z(opcode)));
-                                break;
+                                int     x;
+
+                                EVALUATE_FLAGS;
+
+                                x = R(Z(opcode));
+                                SLA(x);
+                                SET_R(Z(opcode), x);
+
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SLA_INDIRECT_HL: {
+                        Z80_INSTRUCTION(SLA_INDIRECT_HL) {
 
                                 int     x;      
 
-                                if (registers == register_table) {
+                                EVALUATE_FLAGS;
+
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         SLA(x);
@@ -1710,7 +2318,7 @@ emulate_next_instruction:
 
                                         if (Z(opcode) != INDIRECT_HL)
 
-                                                R(Z(opcode)) = x;
+                                                SET_R(Z(opcode), x);
 
                                         pc += 2;
 
@@ -1718,22 +2326,31 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SLL_R: {
+                        Z80_INSTRUCTION(SLL_R) {
 
-                                SLL(R(Z(opcode)));
-                                break;
+                                int     x;
+
+                                EVALUATE_FLAGS;
+
+                                x = R(Z(opcode));
+                                SLL(x);
+                                SET_R(Z(opcode), x);
+
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SLL_INDIRECT_HL: {
+                        Z80_INSTRUCTION(SLL_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                EVALUATE_FLAGS;
+
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         SLL(x);
@@ -1754,7 +2371,7 @@ emulate_next_instruction:
 
                                         if (Z(opcode) != INDIRECT_HL)
 
-                                                R(Z(opcode)) = x;
+                                                SET_R(Z(opcode), x);
 
                                         pc += 2;
 
@@ -1762,22 +2379,31 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SRA_R: {
+                        Z80_INSTRUCTION(SRA_R) {
 
-                                SRA(R(Z(opcode)));
-                                break;
+                                int     x;
+
+                                EVALUATE_FLAGS;
+
+                                x = R(Z(opcode));
+                                SRA(x);
+                                SET_R(Z(opcode), x);
+
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SRA_INDIRECT_HL: {
+                        Z80_INSTRUCTION(SRA_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                EVALUATE_FLAGS;
+
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         SRA(x);
@@ -1798,7 +2424,7 @@ emulate_next_instruction:
 
                                         if (Z(opcode) != INDIRECT_HL)
 
-                                                R(Z(opcode)) = x;
+                                                SET_R(Z(opcode), x);
 
                                         pc += 2;
 
@@ -1806,22 +2432,31 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SRL_R: {
+                        Z80_INSTRUCTION(SRL_R) {
 
-                                SRL(R(Z(opcode)));
-                                break;
+                                int     x;
+
+                                EVALUATE_FLAGS;
+
+                                x = R(Z(opcode));
+                                SRL(x);
+                                SET_R(Z(opcode), x);
+
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SRL_INDIRECT_HL: {
+                        Z80_INSTRUCTION(SRL_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                EVALUATE_FLAGS;
+
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         SRL(x);
@@ -1842,7 +2477,7 @@ emulate_next_instruction:
 
                                         if (Z(opcode) != INDIRECT_HL)
 
-                                                R(Z(opcode)) = x;
+                                                SET_R(Z(opcode), x);
 
                                         pc += 2;
 
@@ -1850,14 +2485,16 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RLD_RRD: {
+                        Z80_INSTRUCTION(RLD_RRD) {
 
                                 int     x, y;
 
+                                EVALUATE_FLAGS;
+
                                 READ_BYTE(HL, x);
                                 y = (A & 0xf0) << 8;
                                 y |= opcode == OPCODE_RLD
@@ -1873,16 +2510,18 @@ emulate_next_instruction:
 
                                 elapsed_cycles += 4;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
                         /* Bit set, reset, and test group. */
 
-                        case BIT_B_R: {
+                        Z80_INSTRUCTION(BIT_B_R) {
 
                                 int     x;
 
+                                EVALUATE_FLAGS;
+
                                 x = R(Z(opcode)) & (1 << Y(opcode));
                                 F = (x ? 0 : Z80_Z_FLAG | Z80_P_FLAG)
 
@@ -1896,15 +2535,17 @@ emulate_next_instruction:
                                         | Z80_H_FLAG
                                         | (F & Z80_C_FLAG);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }                               
 
-                        case BIT_B_INDIRECT_HL: {
+                        Z80_INSTRUCTION(BIT_B_INDIRECT_HL) {
 
                                 int     d, x;
+
+                                EVALUATE_FLAGS;
                                         
-                                if (registers == register_table) {
+                                if (hl_ix_iy == Z80_HL) {
 
                                         d = HL;
 
@@ -1935,22 +2576,22 @@ emulate_next_instruction:
                                         | Z80_H_FLAG
                                         | (F & Z80_C_FLAG);
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SET_B_R: {
+                        Z80_INSTRUCTION(SET_B_R) {
 
-                                R(Z(opcode)) |= 1 << Y(opcode);
-                                break;
+                                SET_R(Z(opcode), R(Z(opcode)) | 1 << Y(opcode));
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case SET_B_INDIRECT_HL: {
+                        Z80_INSTRUCTION(SET_B_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         x |= 1 << Y(opcode);
@@ -1971,7 +2612,7 @@ emulate_next_instruction:
 
                                         if (Z(opcode) != INDIRECT_HL)
 
-                                                R(Z(opcode)) = x;
+                                                SET_R(Z(opcode), x);
 
                                         pc += 2;
 
@@ -1979,22 +2620,22 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RES_B_R: {
+                        Z80_INSTRUCTION(RES_B_R) {
 
-                                R(Z(opcode)) &= ~(1 << Y(opcode));
-                                break;
+                                SET_R(Z(opcode), R(Z(opcode)) & ~(1 << Y(opcode)));
+                                NEXT_INSTRUCTION;
 
                         }       
 
-                        case RES_B_INDIRECT_HL: {
+                        Z80_INSTRUCTION(RES_B_INDIRECT_HL) {
 
                                 int     x;
 
-                                if (registers == register_table) {
+                                if (hl_ix_iy == Z80_HL) {
 
                                         READ_BYTE(HL, x);
                                         x &= ~(1 << Y(opcode));
@@ -2015,7 +2656,7 @@ emulate_next_instruction:
 
                                         if (Z(opcode) != INDIRECT_HL)
 
-                                                R(Z(opcode)) = x;
+                                                SET_R(Z(opcode), x);
 
                                         pc += 2;
 
@@ -2023,197 +2664,57 @@ emulate_next_instruction:
 
                                 }
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
                         /* Jump group. */
 
-                        case JP_NN: {
-
-                                int     nn;
-
-                                Z80_FETCH_WORD(pc, nn);
-                                pc = nn;
+                        INSTRUCTION(JP_NN) {
 
-                                elapsed_cycles += 6;
-
-                                break;
+                                JP_NN_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case JP_CC_NN: {
-
-                                int     nn;
-
-                                if (CC(Y(opcode))) {
-
-                                        Z80_FETCH_WORD(pc, nn);
-                                        pc = nn;
-
-                                } else {
-
-#ifdef Z80_FALSE_CONDITION_FETCH
-
-                                        Z80_FETCH_WORD(pc, nn);
-
-#endif          
-
-                                        pc += 2;
-
-                                }
-
-                                elapsed_cycles += 6;
-
-                                break;
-                        }                               
-
-                        case JR_E: {
+                        Z80_INSTRUCTION(JR_E) {
 
-                                int     e;
-                                
-                                Z80_FETCH_BYTE(pc, e);
-                                e = (char) e;
-                                pc += e + 1;
-
-                                elapsed_cycles += 8;
-
-                                break;
+                                JR_E_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case JR_DD_E: {
-
-                                int     e;
-
-                                if (DD(Q(opcode))) {
-                                
-                                        Z80_FETCH_BYTE(pc, e);
-                                        e = (char) e;
-                                        pc += e + 1;
-
-                                        elapsed_cycles += 8;
-
-                                } else {
-
-#ifdef Z80_FALSE_CONDITION_FETCH
-
-                                        Z80_FETCH_BYTE(pc, e);
-
-#endif
-
-                                        pc++;
-
-                                        elapsed_cycles += 3;
-
-                                }
-                                break;  
-
-                        }                                            
-
-                        case JP_HL: {
+                        INSTRUCTION(JP_HL) {
 
                                 pc = HL_IX_IY;
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }                       
 
-                        case DJNZ_E: {
-
-                                int     e;
-                                
-                                if (--B) {
-                                
-                                        Z80_FETCH_BYTE(pc, e);
-                                        e = (char) e;
-                                        pc += e + 1;
-
-                                        elapsed_cycles += 9;
-
-                                } else {
-
-#ifdef Z80_FALSE_CONDITION_FETCH
-
-                                        Z80_FETCH_BYTE(pc, e);
-
-#endif
-
-                                        pc++;
-
-                                        elapsed_cycles += 4;
-
-                                }
+                        Z80_INSTRUCTION(DJNZ_E) {
 
-                                break;
+                                DJNZ_E_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
                         /* Call and return group. */
 
-                        case CALL_NN: {
-
-                                int     nn;
-
-                                READ_NN(nn);
-                                PUSH(pc);
-                                pc = nn;
-
-                                elapsed_cycles++;
-
-                                break;
-
-                        }
-
-                        case CALL_CC_NN: {
-
-                                int     nn;
-
-                                if (CC(Y(opcode))) {
-
-                                        READ_NN(nn);
-                                        PUSH(pc);
-                                        pc = nn;
-
-                                        elapsed_cycles++;
-
-                                } else {
-
-#ifdef Z80_FALSE_CONDITION_FETCH
-
-                                        Z80_FETCH_WORD(pc, nn);
-
-#endif
-
-                                        pc += 2;
+                        INSTRUCTION(CALL_NN) {
 
-                                        elapsed_cycles += 6;
-
-                                }
-
-                                break;
+                                CALL_NN_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case RET: {
+                        INSTRUCTION(RET) {
 
-                                POP(pc);
-                                break;
+                                RET_HANDLER;
+                                NEXT_INSTRUCTION;
 
                         }
                                                   
-                        case RET_CC: {
-
-                                if (CC(Y(opcode))) {
-
-                                        POP(pc);
-
-                                }
-                                elapsed_cycles++;
-                                break;
-
-                        }
-
-                        case RETI_RETN: {
+                        Z80_INSTRUCTION(RETI_RETN) {
 
                                 state->iff1 = state->iff2;
                                 POP(pc);        
@@ -2237,24 +2738,24 @@ emulate_next_instruction:
 
 #else
 
-                                break;
+                                NEXT_INSTRUCTION;
 
 #endif
 
                         }
 
-                        case RST_P: {
+                        INSTRUCTION(RST_P) {
 
                                 PUSH(pc);
                                 pc = RST_TABLE[Y(opcode)];
                                 elapsed_cycles++;
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
                         /* Input and output group. */
 
-                        case IN_A_N: {
+                        INSTRUCTION(IN_A_N) {
 
                                 int     n;
 
@@ -2263,23 +2764,25 @@ emulate_next_instruction:
 
                                 elapsed_cycles += 4;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }       
 
-                        case IN_R_C: {
+                        Z80_INSTRUCTION(IN_R_C) {
 
                                 int     x;                                           
+
+                                EVALUATE_FLAGS;
                                 Z80_INPUT_BYTE(C, x);
                                 if (Y(opcode) != INDIRECT_HL) 
 
-                                        R(Y(opcode)) = x;
+                                        SET_R(Y(opcode), x);
 
                                 F = SZYXP_FLAGS_TABLE[x] | (F & Z80_C_FLAG);
 
                                 elapsed_cycles += 4;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
@@ -2290,10 +2793,12 @@ emulate_next_instruction:
                          * Undocumented Z80 Documented Version 0.91". 
                          */
 
-                        case INI_IND: {
+                        Z80_INSTRUCTION(INI_IND) {
 
                                 int     x, f;
 
+                                EVALUATE_FLAGS;
+
                                 Z80_INPUT_BYTE(C, x);
                                 WRITE_BYTE(HL, x);
 
@@ -2317,22 +2822,18 @@ emulate_next_instruction:
 
                                 elapsed_cycles += 5;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case INIR_INDR: {
-
-                                int     d, b, hl, x, f;
-
-#ifdef Z80_HANDLE_SELF_MODIFYING_CODE
+                        Z80_INSTRUCTION(INIR_INDR) {
 
-                                int     p, q;
+                                int     d, b, hl, x, f, p, q;
 
                                 p = (pc - 2) & 0xffff;
                                 q = (pc - 1) & 0xffff;
 
-#endif                          
+                                EVALUATE_FLAGS;
 
                                 d = opcode == OPCODE_INIR ? +1 : -1;
 
@@ -2350,7 +2851,8 @@ emulate_next_instruction:
 
                                         hl += d;
 
-                                        if (--b) 
+                                        b = (b - 1) & 0xff;
+                                        if (b) 
 
                                                 elapsed_cycles += 21;
 
@@ -2362,8 +2864,6 @@ emulate_next_instruction:
 
                                         } 
 
-#ifdef Z80_HANDLE_SELF_MODIFYING_CODE
-
                                         if (((hl - d) & 0xffff) == p 
                                         || ((hl - d) & 0xffff) == q) { 
 
@@ -2373,8 +2873,6 @@ emulate_next_instruction:
 
                                         }
 
-#endif                                  
-
                                         if (elapsed_cycles < number_cycles) 
 
                                                 continue;
@@ -2383,6 +2881,7 @@ emulate_next_instruction:
 
                                                 f = SZYX_FLAGS_TABLE[b];
                                                 pc -= 2;
+                                                instructions--;
                                                 break;
 
                                         }
@@ -2399,11 +2898,11 @@ emulate_next_instruction:
                                         & Z80_P_FLAG;
                                 F = f;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case OUT_N_A: {
+                        INSTRUCTION(OUT_N_A) {
 
                                 int     n;
 
@@ -2412,11 +2911,11 @@ emulate_next_instruction:
 
                                 elapsed_cycles += 4;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }       
 
-                        case OUT_C_R: {
+                        Z80_INSTRUCTION(OUT_C_R) {
 
                                 int     x;
 
@@ -2427,14 +2926,16 @@ emulate_next_instruction:
 
                                 elapsed_cycles += 4;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case OUTI_OUTD: {
+                        Z80_INSTRUCTION(OUTI_OUTD) {
 
                                 int     x, f;
 
+                                EVALUATE_FLAGS;
+
                                 READ_BYTE(HL, x);
                                 Z80_OUTPUT_BYTE(C, x);
 
@@ -2448,14 +2949,16 @@ emulate_next_instruction:
                                         & Z80_P_FLAG;
                                 F = f;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
-                        case OTIR_OTDR: {
+                        Z80_INSTRUCTION(OTIR_OTDR) {
 
                                 int     d, b, hl, x, f;
 
+                                EVALUATE_FLAGS;
+
                                 d = opcode == OPCODE_OTIR ? +1 : -1;
 
                                 b = B;
@@ -2471,7 +2974,8 @@ emulate_next_instruction:
                                         Z80_OUTPUT_BYTE(C, x);
 
                                         hl += d;
-                                        if (--b) 
+                                        b = (b - 1) & 0xff;
+                                        if (b) 
 
                                                 elapsed_cycles += 21;
 
@@ -2491,6 +2995,7 @@ emulate_next_instruction:
 
                                                 f = SZYX_FLAGS_TABLE[b];
                                                 pc -= 2;
+                                                instructions--;
                                                 break;
 
                                         }
@@ -2507,19 +3012,19 @@ emulate_next_instruction:
                                         & Z80_P_FLAG;
                                 F = f;
 
-                                break;
+                                NEXT_INSTRUCTION;
 
                         }
 
                         /* Prefix group. */
 
-                        case CB_PREFIX: {
+                        Z80_INSTRUCTION(CB_PREFIX) {
 
                                 /* Special handling if the 0xcb prefix is 
                                  * prefixed by a 0xdd or 0xfd prefix.
                                  */
 
-                                if (registers != register_table) {
+                                if (hl_ix_iy != Z80_HL) {
 
                                         r--;
 
@@ -2541,9 +3046,9 @@ emulate_next_instruction:
 
                         }
 
-                        case DD_PREFIX: {
+                        Z80_INSTRUCTION(DD_PREFIX) {
 
-                                registers = dd_register_table;
+                                hl_ix_iy = Z80_IX;
 
 #ifdef Z80_PREFIX_FAILSAFE
 
@@ -2575,9 +3080,9 @@ emulate_next_instruction:
 
                         }
 
-                        case FD_PREFIX: {
+                        Z80_INSTRUCTION(FD_PREFIX) {
 
-                                registers = fd_register_table;
+                                hl_ix_iy = Z80_IY;
 
 #ifdef Z80_PREFIX_FAILSAFE
 
@@ -2605,9 +3110,9 @@ emulate_next_instruction:
 
                         }
 
-                        case ED_PREFIX: {
+                        Z80_INSTRUCTION(ED_PREFIX) {
 
-                                registers = register_table;
+                                hl_ix_iy = Z80_HL;
                                 Z80_FETCH_BYTE(pc, opcode);
                                 pc++;
                                 instruction = ED_INSTRUCTION_TABLE[opcode];
@@ -2618,7 +3123,7 @@ emulate_next_instruction:
 
                         /* Special/pseudo instruction group. */
 
-                        case ED_UNDEFINED: {
+                        Z80_INSTRUCTION(ED_UNDEFINED) {
 
 #ifdef Z80_CATCH_ED_UNDEFINED
 
@@ -2630,12 +3135,73 @@ emulate_next_instruction:
 
 #else
 
-                                break;
+                                NEXT_INSTRUCTION;
+
+#endif
+
+                        }
+
+#ifdef Z80_8080_ONLY
+
+                        /* Stop before an opcode, which the 8080 does not 
+                         * have, Z80Emulate8080() continues with Z80Emulate().
+                         */
+
+                        INSTRUCTION(Z80_ONLY) {
+
+                                pc--;
+                                r--;
+                                elapsed_cycles -= 4;
+                                instructions--;
+
+#ifdef Z80_PROFILER
+
+                                if (profile != NULL)
+
+                                        profile->instructions[profile_pc]--;
+
+#endif
+
+                                state->status |= STATUS_FLAG_Z80_ONLY;
+                                goto stop_emulation;
+
+                        }
 
 #endif
 
+#ifdef Z80_DECODE_CACHE
+
+                        /* Pseudo instructions for prefixed instructions and
+                         * for addresses without a valid record in the decode 
+                         * cache. NEXT_INSTRUCTION has already accounted one 
+                         * opcode byte.
+                         */
+
+                        handle_prefixed: {
+
+                                hl_ix_iy = decoded->hl_ix_iy;
+                                pc += decoded->length - 1;
+                                r += decoded->length - 1;
+                                elapsed_cycles += decoded->cycles - 4;
+                                goto *dispatch_table[decoded->instruction];
+
+                        }
+
+                        handle_decode: {
+
+                                pc--;
+                                r--;
+                                elapsed_cycles -= 4;
+                                instructions--;
+
+                                decode_instruction(context, pc, 
+                                        dispatch_table);
+                                NEXT_INSTRUCTION;
+
                         }
 
+#endif
+
                 }
 
                 if (elapsed_cycles >= number_cycles)
@@ -2646,8 +3212,25 @@ emulate_next_instruction:
 
 stop_emulation:
 
+#ifdef Z80_LAZY_FLAGS
+
+        EVALUATE_FLAGS;
+
+#endif
+
+#ifdef Z80_PROFILER
+
+        if (profile != NULL)
+
+                profile->cycles[profile_pc] += elapsed_cycles - profile_cycles;
+
+#endif
+
+        SAVE_REGISTERS;
+
         state->r = (state->r & 0x80) | (r & 0x7f);
         state->pc = pc & 0xffff;
+        state->instructions += instructions;
 
         return elapsed_cycles;
 }
@@ -70,12 +70,73 @@ extern "C" {
 /* #define Z80_FALSE_CONDITION_FETCH */
 
 /* It may be possible to overwrite the opcode of the currently executing LDIR, 
- * LDDR, INIR, or OTDR instruction. Define this macro, if you need to handle 
- * those pathological cases.
+ * LDDR, INIR, or INDR instruction. These instructions always stop after such 
+ * an iteration and the new instruction is fetched then, like the Z80 does it.
+ * If this macro is defined, LDIR and LDDR are executed byte by byte instead of
+ * using the host's memcpy() and memmove().
  */
 
 /* #define Z80_HANDLE_SELF_MODIFYING_CODE */
 
+/* By default each instruction is decoded by a switch statement in the main
+ * loop of the emulator, which means a bounds check and a single shared 
+ * indirect branch for all instructions. If Z80_THREADED_DISPATCH is defined,
+ * the instruction handlers are reached through a table of label addresses
+ * instead and each handler fetches and dispatches the next instruction on its
+ * own. This gives the branch predictor of the host processor one dispatch
+ * point per instruction. It requires the "labels as values" extension of GCC
+ * and Clang. This macro is normally set from the Makefile.
+ */
+
+/* #define Z80_THREADED_DISPATCH */
+
+/* If Z80_DECODE_CACHE is defined, the decoded form of each executed 
+ * instruction (handler, opcode, and HL, IX, or IY after all prefixes) is kept
+ * in a cache indexed by its address, so that opcodes and prefixes are not 
+ * fetched and decoded again, when the instruction is executed the next time.
+ * The write macros below must call INVALIDATE_DECODED() for every written
+ * address and memory, which is modified outside of the emulator, must be 
+ * announced with Z80InvalidateCode(). This requires Z80_THREADED_DISPATCH and
+ * is normally set from the Makefile.
+ */
+
+/* #define Z80_DECODE_CACHE */
+
+/* If Z80_LAZY_FLAGS is defined, the 8-bit arithmetic and logic instructions 
+ * (ADD, ADC, SUB, SBC, AND, OR, XOR, CP, INC, and DEC) do not compute the F
+ * register. Their operands and result are recorded instead and F is computed
+ * from them, when an instruction needs it (e.g. PUSH AF or a condition on the
+ * parity/overflow flag) or when Z80Emulate() returns. The sign, zero, and 
+ * carry conditions are tested on the recorded result directly. The flags are 
+ * the same as without this macro. This macro is normally set from the 
+ * Makefile.
+ */
+
+/* #define Z80_LAZY_FLAGS */
+
+/* If Z80_8080_ONLY is defined, z80emu.c is compiled into a core for the 8080
+ * subset of the Z80 instruction set, which is entered with Z80Emulate8080()
+ * instead of Z80Emulate(). The prefixes and the other opcodes, which the 8080
+ * does not have (EX AF, AF', EXX, DJNZ, and JR), are left out. This gives 
+ * smaller dispatch tables and handlers, which never check for IX or IY. The
+ * flags are still those of the Z80. When the core meets a Z80-only opcode, 
+ * Z80Emulate8080() emulates the rest of number_cycles with Z80Emulate(), so 
+ * z80emu.c must be linked a second time without this macro. This cannot be 
+ * combined with Z80_DECODE_CACHE. CPMemu builds both cores, if 
+ * Z80_8080_PROFILE is set from the Makefile.
+ */
+
+/* #define Z80_8080_ONLY */
+
+/* If Z80_PROFILER is defined and Z80_STATE's profile member is not NULL, the
+ * executions and cycles of the instructions are counted per address (of the
+ * first opcode byte) in the Z80_PROFILE it points to. The cycles of a repeated
+ * block instruction are counted at its address. This cannot be combined with
+ * Z80_DECODE_CACHE and is normally set from the Makefile.
+ */
+
+/* #define Z80_PROFILER */
+
 /* Flags for Z80_STATE's status member. If the emulation is interrupted, status
  * can indicate why. You may add additionnal flags for your own use as needed.
  */
@@ -189,8 +250,58 @@ typedef struct {
 
         int             i, r, pc, iff1, iff2, im;
 
+        /* Number of instructions emulated by the last Z80Emulate() call. A
+         * prefixed opcode counts as one instruction. A repeated block
+         * instruction, which is interrupted at the end of a call, is counted
+         * by the call, which continues it.
+         */
+
+        int             instructions;
+
+        /* Memory and I/O of the machine, which the macros below work on (see
+         * z80stub.h). 
+         */
+
+        struct Z80_CONTEXT      *context;
+
+#ifdef Z80_PROFILER
+
+        struct Z80_PROFILE      *profile;
+
+#endif
+
 } Z80_STATE;
 
+#ifdef Z80_PROFILER
+
+/* Counters per address, see Z80_PROFILER above. */
+
+typedef struct Z80_PROFILE {
+
+        unsigned long long      instructions[0x10000];
+        unsigned long long      cycles[0x10000];
+
+} Z80_PROFILE;
+
+#endif
+
+#ifdef Z80_DECODE_CACHE
+
+/* Record of an instruction in the decode cache, see Z80_DECODE_CACHE above.
+ * The records belong to the memory they have been decoded from and are kept
+ * in the context of the machine.
+ */
+
+typedef struct Z80_DECODED_INSTRUCTION {
+
+        const void      *handler;
+        unsigned short  instruction;
+        unsigned char   opcode, hl_ix_iy, length, cycles;
+
+} Z80_DECODED_INSTRUCTION;
+
+#endif
+
 /* Write the following macros for memory access and input/output on the Z80. 
  *
  * Z80_FETCH_BYTE() and Z80_FETCH_WORD() are used by the emulator to read the
@@ -202,7 +313,9 @@ typedef struct {
  * Z80_READ_BYTE(), Z80_WRITE_BYTE(), Z80_READ_WORD(), and Z80_WRITE_WORD()
  * are used for general memory access. They obey the same rule as the code 
  * reading macros. The upper bits of the value x to write may be non-zero.
- * 
+ * LDIR, LDDR, CPIR, and CPDR bypass these macros and access the memory 
+ * directly (see block_copy() and block_search() in z80emu.c).
+ *
  * Z80_INPUT_BYTE() and Z80_OUTPUT_BYTE() are for input and output. The upper
  * bits of the port number to read or write are always zero. The input byte x 
  * must be an unsigned 8-bit value. The value x to write is an unsigned 8-bit 
@@ -214,6 +327,10 @@ typedef struct {
  *                      most likely not up to date because the current 
  *                      executing instruction is working on it.
  *
+ *      context         state->context, held in a variable of its own, so
+ *                      that it needs not to be loaded again after each 
+ *                      write to the memory.
+ *
  *      pc              Current PC register (upper bits are undefined). It
  *                      points on the displacement or constant to read for
  *                      Z80_FETCH_BYTE() and Z80_FETCH_WORD(), or on the next
@@ -229,63 +346,95 @@ typedef struct {
  *      instruction     Type of the currently executing instruction, see
  *                      instructions.h for a list.
  *
- *      registers       Current register decoding table, it points on 
- *                      dd_register_table for 0xdd prefixed instructions, 
- *                      fd_register_table for 0xfd ones, or register_table
- *                      otherwise.
+ *      hl_ix_iy        Z80_IX for 0xdd prefixed instructions, Z80_IY for 
+ *                      0xfd ones, or Z80_HL otherwise.
  *
  *      opcode          Opcode of the currently executing instruction, check
- *                      register_table for 0xdd or 0xfd prefixes.
+ *                      hl_ix_iy for 0xdd or 0xfd prefixes.
  */
 
 /* Here are macros for CPMemu. Read/write memory macros have been
- * written for a linear 64k RAM. Input/output port macros are
- * handled by the CZ80Ports class.
+ * written for a linear 64k RAM in the Z80_CONTEXT of the machine. 
+ * Input/output port macros are handled by its CZ80Ports class.
  */
 
 #include "z80stub.h"
 
+/* If CPMemu is built with its dynamic binary translator (Z80_JIT, see 
+ * z80jit.h), the code_map[] of the context marks the bytes of translated code
+ * and writing such a byte must be reported with CodeWritten().
+ */
+
+#ifdef Z80_JIT
+
+#define INVALIDATE_TRANSLATED(address)                                  \
+{                                                                       \
+        if (context->code_map[(address) & 0xffff])                      \
+                                                                        \
+                CodeWritten(context, (address) & 0xffff);               \
+}
+
+#else
+
+#define INVALIDATE_TRANSLATED(address)
+
+#endif
+
 #define Z80_FETCH_BYTE(address, x)                                      \
 {                                                                       \
-        (x) = memory[(address) & 0xffff];                               \
+        (x) = context->memory[(address) & 0xffff];                      \
 }
 
 #define Z80_FETCH_WORD(address, x)                                      \
 {                                                                       \
-        (x) = memory[(address) & 0xffff]                                \
-                | (memory[((address) + 1) & 0xffff] << 8);              \
+        (x) = context->memory[(address) & 0xffff]                       \
+                | (context->memory[((address) + 1) & 0xffff] << 8);     \
 }
 
 #define Z80_READ_BYTE(address, x)                                       \
 {                                                                       \
-        (x) = memory[(address) & 0xffff];                               \
+        (x) = context->memory[(address) & 0xffff];                      \
 }
 
 #define Z80_WRITE_BYTE(address, x)                                      \
 {                                                                       \
-        memory[(address) & 0xffff] = (x);                               \
+        context->memory[(address) & 0xffff] = (x);                      \
+        INVALIDATE_DECODED(address);                                    \
+        INVALIDATE_TRANSLATED(address);                                 \
 }
 
 #define Z80_READ_WORD(address, x)                                       \
 {                                                                       \
-        (x) = memory[(address) & 0xffff]                                \
-                | (memory[((address) + 1) & 0xffff] << 8);              \
+        (x) = context->memory[(address) & 0xffff]                       \
+                | (context->memory[((address) + 1) & 0xffff] << 8);     \
 }
 
 #define Z80_WRITE_WORD(address, x)                                      \
 {                                                                       \
-        memory[(address) & 0xffff] = x;                                 \
-        memory[((address) + 1) & 0xffff] = x >> 8;                      \
+        context->memory[(address) & 0xffff] = x;                        \
+        context->memory[((address) + 1) & 0xffff] = x >> 8;             \
+        INVALIDATE_DECODED(address);                                    \
+        INVALIDATE_DECODED((address) + 1);                              \
+        INVALIDATE_TRANSLATED(address);                                 \
+        INVALIDATE_TRANSLATED((address) + 1);                           \
 }
 
+/* PortInput() sets the port_stop_request of the context to return to 
+ * CZ80Computer::Run() after the current instruction, which resets it (see 
+ * CZ80Computer::CheckIdle()).
+ */
+
 #define Z80_INPUT_BYTE(port, x)                                         \
 {                                                                       \
-	(x) = PortInput (port);                                         \
+	(x) = PortInput (context, port);                                \
+	if (context->port_stop_request)                                 \
+                                                                        \
+		number_cycles = 0;                                      \
 }
 
 #define Z80_OUTPUT_BYTE(port, x)                                        \
 {                                                                       \
-	PortOutput (port, x);                                           \
+	PortOutput (context, port, x);                                  \
 }
 
 /* See comments in z80emu.c for a description of each functions. */
@@ -296,6 +445,10 @@ extern int      Z80Interrupt (Z80_STATE *state, int data_on_bus);
 extern int      Z80NonMaskableInterrupt (Z80_STATE *state);
  
 extern int      Z80Emulate (Z80_STATE *state, int number_cycles);
+extern int      Z80Emulate8080 (Z80_STATE *state, int number_cycles);
+
+extern void     Z80InvalidateCode (struct Z80_CONTEXT *context, 
+                        int address, int size);
 
 #ifdef __cplusplus
 }
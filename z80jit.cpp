@@ -0,0 +1,2130 @@
+//
+// z80jit.cpp
+//
+// Dynamic binary translator for the Z80 (x86-64 hosts only)
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "z80jit.h"
+#include <sys/mman.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <assert.h>
+
+#if !defined (__x86_64__)
+	#error The dynamic binary translator requires an x86-64 host
+#endif
+
+#ifdef Z80_DOCUMENTED_FLAGS_ONLY
+	#error The dynamic binary translator always emulates the undocumented flags
+#endif
+
+#ifdef Z80_DECODE_CACHE
+	#error The dynamic binary translator cannot be used with Z80_DECODE_CACHE
+#endif
+
+#define CODE_SIZE		(16*1024*1024)	// executable memory for translated code
+#define CODE_RESERVE		(64*1024)	// must be free before translating a block
+#define MAX_BLOCKS		16384
+#define MAX_BLOCK_INSTRUCTIONS	64
+#define MAX_STUBS		(MAX_BLOCK_INSTRUCTIONS*4 + 4)
+
+#define HOT_THRESHOLD		8		// executions before an address is translated
+#define MAX_INVALIDATIONS	16		// afterwards an address is not translated any more
+
+
+// Data used by the generated code, addressed relative to RBP
+struct TJITContext
+{
+	u8		SZYXFlags[256];
+	u8		SZYXPFlags[256];
+	u8		Overflow[4];
+	u8		bCodeWritten;		// set by WriteHit ()
+	u8		Padding[3];
+	u16		DAAResult[2048];	// AF after DAA for A, C, H and N
+	Z80_STATE	*pState;
+	u8		*pMemory;
+	u8		*pCodeMap;
+	u8		**ppEntry;
+	int		nElapsed;
+	int		nBudget;
+	u32		nInstructions;		// each has one M1 cycle (R increment)
+	u32		nExitPC;
+	u8		*pExitSite;		// rel32 of an exit, which can be chained
+	CZ80JIT		*pThis;
+};
+
+struct TJITBlock
+{
+	u16		usStart;
+	unsigned	nEnd;			// address behind the last instruction
+	u8		*pEntry;
+	u8		*pBudgetStub;		// leaves the block with PC = usStart
+	boolean		bValid;
+	unsigned	nNext[2];		// list link for the first and last page (index + 1)
+};
+
+struct TJITInstruction
+{
+	u16		usPC;
+	u8		ucOpcode;
+	u8		ucLength;
+	u16		usOperand;		// n or nn
+	u8		ucCycles;		// condition false for conditional branches
+	u8		ucCyclesTaken;
+	u8		ucFlagsWritten;		// if flags are computed
+	u8		ucFlagsRead;
+	boolean		bFlagsOptional;		// flags need not be computed, if dead
+	boolean		bWritesMemory;
+	boolean		bEndsBlock;
+	boolean		bFlags;			// compute flags (result of liveness analysis)
+};
+
+enum TStubType
+{
+	StubExit,
+	StubBudget,
+	StubWriteHit,
+	StubCodeWritten,
+	StubStopRequest
+};
+
+// x86-64 registers
+enum
+{
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8,  R9,  R10, R11, R12, R13, R14, R15,
+	NOREG
+};
+
+// register usage of the generated code
+#define REG_A		RAX		// zero-extended, as all Z80 registers
+#define REG_F		R9
+#define REG_BC		RBX
+#define REG_DE		RDX
+#define REG_HL		RCX
+#define REG_SP		R10
+#define REG_MEMORY	RSI		// &memory[0]
+#define REG_CONTEXT	RBP		// TJITContext *
+#define REG_CODEMAP	R12		// &m_pCodeMap[0]
+#define REG_ELAPSED	R13
+#define REG_BUDGET	R14
+#define T0		RDI		// temporaries
+#define T1		R8
+#define T2		R11
+#define T3		R15
+
+// x86-64 opcodes
+#define OP_ADD		0x01		// r/m32, r32
+#define OP_OR		0x09
+#define OP_AND		0x21
+#define OP_SUB		0x29
+#define OP_XOR		0x31
+#define OP_CMP		0x39
+#define OP_MOV		0x89
+#define OP_TEST		0x85
+
+#define EXT_ADD		0		// group 1 extensions
+#define EXT_OR		1
+#define EXT_AND		4
+#define EXT_SUB		5
+#define EXT_XOR		6
+
+#define EXT_SHL		4		// group 2 extensions
+#define EXT_SHR		5
+
+#define CC_Z		0x4		// condition codes
+#define CC_NZ		0x5
+#define CC_GE		0xD
+
+// Z80 flags
+#define FLAG_S		Z80_S_FLAG
+#define FLAG_Z		Z80_Z_FLAG
+#define FLAG_Y		Z80_Y_FLAG
+#define FLAG_H		Z80_H_FLAG
+#define FLAG_X		Z80_X_FLAG
+#define FLAG_PV		Z80_PV_FLAG
+#define FLAG_N		Z80_N_FLAG
+#define FLAG_C		Z80_C_FLAG
+#define FLAGS_SZ	(FLAG_S | FLAG_Z)
+#define FLAGS_YX	(FLAG_Y | FLAG_X)
+#define FLAGS_SZPV	(FLAG_S | FLAG_Z | FLAG_PV)
+#define FLAGS_ALL	0xFF
+
+#define OPCODE_Y(op)	(((op) >> 3) & 7)
+#define OPCODE_Z(op)	((op) & 7)
+#define OPCODE_P(op)	(((op) >> 4) & 3)
+
+#define CONTEXT(member)	((s32) offsetof (TJITContext, member))
+
+static const u8 s_ConditionFlag[8] =		// NZ, Z, NC, C, PO, PE, P, M
+{
+	FLAG_Z, FLAG_Z, FLAG_C, FLAG_C, FLAG_PV, FLAG_PV, FLAG_S, FLAG_S
+};
+
+static const unsigned s_PairReg[4] = {REG_BC, REG_DE, REG_HL, REG_SP};
+
+typedef void TEnterFunction (TJITContext *pContext, const u8 *pEntry);
+
+CZ80JIT::CZ80JIT (Z80_CONTEXT *pZ80Context)
+:	m_pZ80Context (pZ80Context),
+	m_pMemory (pZ80Context->memory),
+	m_pCodeMap (pZ80Context->code_map),
+	m_pContext (0),
+	m_pCode (0),
+	m_pCodeEnd (0),
+	m_pCodePtr (0),
+	m_pTranslationStart (0),
+	m_pEpilogue (0),
+	m_pDynamicMiss (0),
+	m_pWriteHit (0),
+	m_ppEntry (0),
+	m_pCounter (0),
+	m_pInvalidations (0),
+	m_pBlock (0),
+	m_nBlocks (0),
+	m_pPendingSite (0),
+	m_usPendingTarget (0),
+	m_pCurrentBlock (0),
+	m_pStub (0),
+	m_nStubs (0),
+	m_nTranslatedBlocks (0),
+	m_nInvalidatedBlocks (0),
+	m_nFlushes (0)
+{
+	m_pZ80Context->jit = this;
+}
+
+CZ80JIT::~CZ80JIT (void)
+{
+	delete [] m_pStub;
+	m_pStub = 0;
+
+	delete [] m_pBlock;
+	m_pBlock = 0;
+
+	delete [] m_pInvalidations;
+	m_pInvalidations = 0;
+
+	delete [] m_pCounter;
+	m_pCounter = 0;
+
+	delete [] m_ppEntry;
+	m_ppEntry = 0;
+
+	if (m_pCode != 0)
+	{
+		munmap (m_pCode, CODE_SIZE);
+		m_pCode = 0;
+	}
+
+	delete m_pContext;
+	m_pContext = 0;
+
+	m_pZ80Context = 0;
+}
+
+boolean CZ80JIT::Initialize (void)
+{
+	void *pCode = mmap (0, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+			    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (pCode == MAP_FAILED)
+	{
+		fprintf (stderr, "Cannot allocate memory for translated code\n");
+
+		return FALSE;
+	}
+
+	m_pCode = (u8 *) pCode;
+	m_pCodeEnd = m_pCode + CODE_SIZE;
+	m_pCodePtr = m_pCode;
+
+	m_ppEntry = new u8 *[Z80_RAM_SIZE];
+	m_pCounter = new u8[Z80_RAM_SIZE];
+	m_pInvalidations = new u8[Z80_RAM_SIZE];
+	m_pBlock = new TJITBlock[MAX_BLOCKS];
+	m_pStub = new TStub[MAX_STUBS];
+	m_pContext = new TJITContext;
+
+	memset (m_ppEntry, 0, Z80_RAM_SIZE * sizeof (u8 *));
+	memset (m_pCounter, 0, Z80_RAM_SIZE);
+	memset (m_pInvalidations, 0, Z80_RAM_SIZE);
+	memset (m_PageHead, 0, sizeof m_PageHead);
+	memset (m_pCodeMap, 0, Z80_RAM_SIZE);
+
+	TJITContext *pContext = m_pContext;
+	memset (pContext, 0, sizeof *pContext);
+
+	for (unsigned i = 0; i < 256; i++)
+	{
+		u8 ucFlags = i & (FLAG_S | FLAGS_YX);
+		if (i == 0)
+		{
+			ucFlags |= FLAG_Z;
+		}
+
+		pContext->SZYXFlags[i] = ucFlags;
+
+		unsigned nBits = 0;
+		for (unsigned j = i; j != 0; j >>= 1)
+		{
+			nBits += j & 1;
+		}
+
+		pContext->SZYXPFlags[i] = ucFlags | (nBits & 1 ? 0 : FLAG_PV);
+	}
+
+	pContext->Overflow[1] = FLAG_PV;
+	pContext->Overflow[2] = FLAG_PV;
+
+	// same algorithm as in z80emu.c
+	for (unsigned nIndex = 0; nIndex < 2048; nIndex++)
+	{
+		unsigned nA = nIndex & 0xFF;
+		unsigned nF =   (nIndex & 0x100 ? FLAG_C : 0)
+			      | (nIndex & 0x200 ? FLAG_H : 0)
+			      | (nIndex & 0x400 ? FLAG_N : 0);
+
+		unsigned c, d;
+		if (nA > 0x99 || (nF & FLAG_C))
+		{
+			c = FLAG_C;
+			d = 0x60;
+		}
+		else
+		{
+			c = d = 0;
+		}
+
+		if ((nA & 0x0F) > 0x09 || (nF & FLAG_H))
+		{
+			d += 0x06;
+		}
+
+		unsigned nResult = (nF & FLAG_N ? nA - d : nA + d) & 0xFF;
+		nF =   pContext->SZYXPFlags[nResult]
+		     | ((nResult ^ nA) & FLAG_H)
+		     | (nF & FLAG_N)
+		     | c;
+
+		pContext->DAAResult[nIndex] = nResult << 8 | nF;
+	}
+
+	pContext->pMemory = m_pMemory;
+	pContext->pCodeMap = m_pCodeMap;
+	pContext->ppEntry = m_ppEntry;
+	pContext->pThis = this;
+
+	GenerateEnterExit ();
+
+	m_pTranslationStart = m_pCodePtr;
+
+	return TRUE;
+}
+
+int CZ80JIT::Emulate (Z80_STATE *pState, int nCycles)
+{
+	TJITContext *pContext = m_pContext;
+	assert (pContext != 0);
+
+	pContext->pState = pState;
+	pContext->nElapsed = 0;
+	pContext->nBudget = nCycles;
+
+	pState->status = 0;
+
+	int nInstructions = 0;
+
+	while (   pContext->nElapsed < nCycles
+	       && !m_pZ80Context->port_stop_request)	// see Z80_INPUT_BYTE () in z80emu.h
+	{
+		unsigned nPC = pState->pc & 0xFFFF;
+
+		u8 *pEntry = m_ppEntry[nPC];
+		if (   pEntry == 0
+		    && m_pInvalidations[nPC] < MAX_INVALIDATIONS
+		    && ++m_pCounter[nPC] >= HOT_THRESHOLD)
+		{
+			m_pCounter[nPC] = 0;
+
+			pEntry = Translate (nPC);
+		}
+
+		if (m_pPendingSite != 0)
+		{
+			// chain the last exit directly to this block
+			if (   pEntry != 0
+			    && nPC == m_usPendingTarget)
+			{
+				Patch (m_pPendingSite, pEntry);
+			}
+
+			m_pPendingSite = 0;
+		}
+
+		if (pEntry != 0)
+		{
+			pContext->nInstructions = 0;
+			pContext->pExitSite = 0;
+
+			(*(TEnterFunction *) m_pCode) (pContext, pEntry);
+
+			pState->pc = pContext->nExitPC;
+			pState->r = (pState->r & 0x80) | ((pState->r + pContext->nInstructions) & 0x7F);
+			nInstructions += pContext->nInstructions;
+
+			if (pContext->pExitSite != 0)
+			{
+				m_pPendingSite = pContext->pExitSite;
+				m_usPendingTarget = pContext->nExitPC;
+			}
+		}
+		else
+		{
+			int nBudget = 4;				// one instruction
+
+			// A repeated block instruction (LDIR, CPIR, INIR, OTIR and the
+			// decrementing ones) gets the cycles of all its iterations, but
+			// not more than the rest of the budget, so that it is executed at
+			// once like without the translator.
+			if (   m_pMemory[nPC] == 0xED
+			    && (m_pMemory[(nPC + 1) & 0xFFFF] & 0xF4) == 0xB0)
+			{
+				unsigned nIterations;
+				if (m_pMemory[(nPC + 1) & 0xFFFF] & 0x02)	// INIR, OTIR, INDR, OTDR
+				{
+					nIterations = pState->registers.byte[Z80_B];
+					if (nIterations == 0)
+					{
+						nIterations = 0x100;
+					}
+				}
+				else
+				{
+					nIterations = pState->registers.word[Z80_BC];
+					if (nIterations == 0)
+					{
+						nIterations = 0x10000;
+					}
+				}
+
+				nBudget = nCycles - pContext->nElapsed;
+				if ((unsigned) nBudget > 21 * nIterations - 5)
+				{
+					nBudget = 21 * nIterations - 5;
+				}
+			}
+
+			pContext->nElapsed += Z80Emulate (pState, nBudget);
+			nInstructions += pState->instructions;
+		}
+	}
+
+	pState->instructions = nInstructions;
+
+	return pContext->nElapsed;
+}
+
+void CZ80JIT::CodeWritten (u16 usAddress)
+{
+	unsigned nPage = usAddress >> 8;
+
+	unsigned nIndex = m_PageHead[nPage];
+	while (nIndex != 0)
+	{
+		TJITBlock *pBlock = &m_pBlock[nIndex-1];
+		assert (pBlock->bValid);
+
+		nIndex = pBlock->nNext[nPage == pBlock->usStart >> 8 ? 0 : 1];
+
+		if (   pBlock->usStart <= usAddress
+		    && usAddress < pBlock->nEnd)
+		{
+			Invalidate (pBlock);
+		}
+	}
+}
+
+unsigned CZ80JIT::GetTranslatedBlocks (void) const
+{
+	return m_nTranslatedBlocks;
+}
+
+unsigned CZ80JIT::GetInvalidatedBlocks (void) const
+{
+	return m_nInvalidatedBlocks;
+}
+
+unsigned CZ80JIT::GetFlushes (void) const
+{
+	return m_nFlushes;
+}
+
+u8 *CZ80JIT::Translate (u16 usPC)
+{
+	if (   m_pCodeEnd - m_pCodePtr < CODE_RESERVE
+	    || m_nBlocks == MAX_BLOCKS)
+	{
+		Flush ();
+	}
+
+	TJITInstruction Instructions[MAX_BLOCK_INSTRUCTIONS];
+	unsigned nCount = 0;
+
+	unsigned nAddress = usPC;
+	while (   nCount < MAX_BLOCK_INSTRUCTIONS
+	       && nAddress < Z80_RAM_SIZE
+	       && Decode (nAddress, &Instructions[nCount]))
+	{
+		nAddress += Instructions[nCount].ucLength;
+
+		if (Instructions[nCount++].bEndsBlock)
+		{
+			break;
+		}
+	}
+
+	if (nCount == 0)
+	{
+		return 0;
+	}
+
+	// Flags, which are overwritten later in the block, need not be computed.
+	// All flags are live at block exits, including the early exit after
+	// writing translated code.
+	u8 ucLive = FLAGS_ALL;
+	for (unsigned i = nCount; i-- > 0;)
+	{
+		TJITInstruction *pInstruction = &Instructions[i];
+
+		if (pInstruction->bWritesMemory)
+		{
+			ucLive = FLAGS_ALL;
+		}
+
+		pInstruction->bFlags =    !pInstruction->bFlagsOptional
+				       || (ucLive & pInstruction->ucFlagsWritten);
+		if (pInstruction->bFlags)
+		{
+			ucLive &= ~pInstruction->ucFlagsWritten;
+		}
+
+		ucLive |= pInstruction->ucFlagsRead;
+	}
+
+	TJITBlock *pBlock = &m_pBlock[m_nBlocks];
+	pBlock->usStart = usPC;
+	pBlock->nEnd = nAddress;
+	pBlock->pEntry = m_pCodePtr;
+
+	m_pCurrentBlock = pBlock;
+	m_nStubs = 0;
+
+	AluRR (OP_CMP, REG_ELAPSED, REG_BUDGET);
+	TStub *pStub = &m_pStub[m_nStubs++];
+	pStub->pPatch = Jcc (CC_GE);
+	pStub->nType = StubBudget;
+	pStub->nTarget = usPC;
+
+	m_nCyclesBefore = 0;
+	m_nInstructionsBefore = 0;
+
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		EmitInstruction (&Instructions[i]);
+
+		m_nCyclesBefore += Instructions[i].ucCycles;
+		m_nInstructionsBefore++;
+	}
+
+	if (!Instructions[nCount-1].bEndsBlock)
+	{
+		EmitExit (nAddress & 0xFFFF, m_nCyclesBefore, m_nInstructionsBefore);
+	}
+
+	EmitStubs ();
+
+	assert (m_pCodePtr < m_pCodeEnd);
+
+	for (nAddress = pBlock->usStart; nAddress < pBlock->nEnd; nAddress++)
+	{
+		if (m_pCodeMap[nAddress] < 0xFF)
+		{
+			m_pCodeMap[nAddress]++;
+		}
+	}
+
+	unsigned nIndex = m_nBlocks++;
+	unsigned nFirstPage = pBlock->usStart >> 8;
+	unsigned nLastPage = (pBlock->nEnd-1) >> 8;
+	pBlock->nNext[0] = m_PageHead[nFirstPage];
+	m_PageHead[nFirstPage] = nIndex+1;
+	if (nLastPage != nFirstPage)
+	{
+		pBlock->nNext[1] = m_PageHead[nLastPage];
+		m_PageHead[nLastPage] = nIndex+1;
+	}
+
+	pBlock->bValid = TRUE;
+	m_ppEntry[usPC] = pBlock->pEntry;
+
+	m_nTranslatedBlocks++;
+
+	return pBlock->pEntry;
+}
+
+boolean CZ80JIT::Decode (u16 usPC, TJITInstruction *pInstruction) const
+{
+	u8 ucOpcode = m_pMemory[usPC];
+	unsigned nY = OPCODE_Y (ucOpcode);
+	unsigned nZ = OPCODE_Z (ucOpcode);
+
+	pInstruction->usPC = usPC;
+	pInstruction->ucOpcode = ucOpcode;
+	pInstruction->ucLength = 1;
+	pInstruction->usOperand = 0;
+	pInstruction->ucCycles = 4;
+	pInstruction->ucCyclesTaken = 0;
+	pInstruction->ucFlagsWritten = 0;
+	pInstruction->ucFlagsRead = 0;
+	pInstruction->bFlagsOptional = FALSE;
+	pInstruction->bWritesMemory = FALSE;
+	pInstruction->bEndsBlock = FALSE;
+
+	if (ucOpcode < 0x40)
+	{
+		switch (nZ)
+		{
+		case 0:
+			switch (nY)
+			{
+			case 0:				// NOP
+				break;
+
+			case 1:				// EX AF,AF'
+				return FALSE;
+
+			case 2:				// DJNZ e
+				pInstruction->ucLength = 2;
+				pInstruction->ucCycles = 8;
+				pInstruction->ucCyclesTaken = 13;
+				pInstruction->bEndsBlock = TRUE;
+				break;
+
+			case 3:				// JR e
+				pInstruction->ucLength = 2;
+				pInstruction->ucCycles = 12;
+				pInstruction->bEndsBlock = TRUE;
+				break;
+
+			default:			// JR cc,e
+				pInstruction->ucLength = 2;
+				pInstruction->ucCycles = 7;
+				pInstruction->ucCyclesTaken = 12;
+				pInstruction->ucFlagsRead = s_ConditionFlag[nY-4];
+				pInstruction->bEndsBlock = TRUE;
+				break;
+			}
+			break;
+
+		case 1:
+			if (!(nY & 1))			// LD rr,nn
+			{
+				pInstruction->ucLength = 3;
+				pInstruction->ucCycles = 10;
+			}
+			else				// ADD HL,rr
+			{
+				pInstruction->ucCycles = 11;
+				pInstruction->ucFlagsWritten = ~FLAGS_SZPV & 0xFF;
+				pInstruction->bFlagsOptional = TRUE;
+			}
+			break;
+
+		case 2:
+			if (nY < 4)			// LD (BC),A etc.
+			{
+				pInstruction->ucCycles = 7;
+				pInstruction->bWritesMemory = !(nY & 1);
+			}
+			else				// LD (nn),HL etc.
+			{
+				pInstruction->ucLength = 3;
+				pInstruction->ucCycles = nY < 6 ? 16 : 13;
+				pInstruction->bWritesMemory = !(nY & 1);
+			}
+			break;
+
+		case 3:					// INC rr, DEC rr
+			pInstruction->ucCycles = 6;
+			break;
+
+		case 4:					// INC r
+		case 5:					// DEC r
+			if (nY == 6)
+			{
+				pInstruction->ucCycles = 11;
+				pInstruction->bWritesMemory = TRUE;
+			}
+			pInstruction->ucFlagsWritten = ~FLAG_C & 0xFF;
+			pInstruction->bFlagsOptional = TRUE;
+			break;
+
+		case 6:					// LD r,n
+			pInstruction->ucLength = 2;
+			pInstruction->ucCycles = 7;
+			if (nY == 6)
+			{
+				pInstruction->ucCycles = 10;
+				pInstruction->bWritesMemory = TRUE;
+			}
+			break;
+
+		case 7:
+			switch (nY)
+			{
+			case 0:				// RLCA
+			case 1:				// RRCA
+			case 6:				// SCF
+				pInstruction->ucFlagsWritten = ~FLAGS_SZPV & 0xFF;
+				pInstruction->bFlagsOptional = TRUE;
+				break;
+
+			case 2:				// RLA
+			case 3:				// RRA
+			case 7:				// CCF
+				pInstruction->ucFlagsWritten = ~FLAGS_SZPV & 0xFF;
+				pInstruction->ucFlagsRead = FLAG_C;
+				pInstruction->bFlagsOptional = TRUE;
+				break;
+
+			case 4:				// DAA
+				pInstruction->ucFlagsWritten = FLAGS_ALL;
+				pInstruction->ucFlagsRead = FLAG_C | FLAG_H | FLAG_N;
+				break;
+
+			case 5:				// CPL
+				pInstruction->ucFlagsWritten = FLAGS_YX | FLAG_H | FLAG_N;
+				pInstruction->bFlagsOptional = TRUE;
+				break;
+			}
+			break;
+		}
+	}
+	else if (ucOpcode < 0x80)			// LD r,r'
+	{
+		if (ucOpcode == 0x76)			// HALT
+		{
+			return FALSE;
+		}
+
+		if (nY == 6 || nZ == 6)
+		{
+			pInstruction->ucCycles = 7;
+			pInstruction->bWritesMemory = nY == 6;
+		}
+	}
+	else if (ucOpcode < 0xC0)			// ALU A,r
+	{
+		if (nZ == 6)
+		{
+			pInstruction->ucCycles = 7;
+		}
+
+		pInstruction->ucFlagsWritten = FLAGS_ALL;
+		pInstruction->ucFlagsRead = nY == 1 || nY == 3 ? FLAG_C : 0;	// ADC, SBC
+		pInstruction->bFlagsOptional = TRUE;
+	}
+	else
+	{
+		switch (nZ)
+		{
+		case 0:					// RET cc
+			pInstruction->ucCycles = 5;
+			pInstruction->ucCyclesTaken = 11;
+			pInstruction->ucFlagsRead = s_ConditionFlag[nY];
+			pInstruction->bEndsBlock = TRUE;
+			break;
+
+		case 1:
+			switch (nY)
+			{
+			case 1:				// RET
+				pInstruction->ucCycles = 10;
+				pInstruction->bEndsBlock = TRUE;
+				break;
+
+			case 3:				// EXX
+				return FALSE;
+
+			case 5:				// JP (HL)
+				pInstruction->bEndsBlock = TRUE;
+				break;
+
+			case 7:				// LD SP,HL
+				pInstruction->ucCycles = 6;
+				break;
+
+			case 6:				// POP AF
+				pInstruction->ucFlagsWritten = FLAGS_ALL;
+				// fall through
+
+			default:			// POP rr
+				pInstruction->ucCycles = 10;
+				break;
+			}
+			break;
+
+		case 2:					// JP cc,nn
+			pInstruction->ucLength = 3;
+			pInstruction->ucCycles = 10;
+			pInstruction->ucCyclesTaken = 10;
+			pInstruction->ucFlagsRead = s_ConditionFlag[nY];
+			pInstruction->bEndsBlock = TRUE;
+			break;
+
+		case 3:
+			switch (nY)
+			{
+			case 0:				// JP nn
+				pInstruction->ucLength = 3;
+				pInstruction->ucCycles = 10;
+				pInstruction->bEndsBlock = TRUE;
+				break;
+
+			case 2:				// OUT (n),A
+				pInstruction->ucLength = 2;
+				pInstruction->ucCycles = 11;
+				pInstruction->bEndsBlock = TRUE;
+				break;
+
+			case 3:				// IN A,(n)
+				pInstruction->ucLength = 2;
+				pInstruction->ucCycles = 11;
+				break;
+
+			case 4:				// EX (SP),HL
+				pInstruction->ucCycles = 19;
+				pInstruction->bWritesMemory = TRUE;
+				break;
+
+			case 5:				// EX DE,HL
+				break;
+
+			default:			// CB prefix, DI, EI
+				return FALSE;
+			}
+			break;
+
+		case 4:					// CALL cc,nn
+			pInstruction->ucLength = 3;
+			pInstruction->ucCycles = 10;
+			pInstruction->ucCyclesTaken = 17;
+			pInstruction->ucFlagsRead = s_ConditionFlag[nY];
+			pInstruction->bWritesMemory = TRUE;
+			pInstruction->bEndsBlock = TRUE;
+			break;
+
+		case 5:
+			if (!(nY & 1))			// PUSH rr
+			{
+				pInstruction->ucCycles = 11;
+				pInstruction->ucFlagsRead = nY == 6 ? FLAGS_ALL : 0;
+				pInstruction->bWritesMemory = TRUE;
+			}
+			else if (nY == 1)		// CALL nn
+			{
+				pInstruction->ucLength = 3;
+				pInstruction->ucCycles = 17;
+				pInstruction->bWritesMemory = TRUE;
+				pInstruction->bEndsBlock = TRUE;
+			}
+			else				// DD, ED and FD prefixes
+			{
+				return FALSE;
+			}
+			break;
+
+		case 6:					// ALU A,n
+			pInstruction->ucLength = 2;
+			pInstruction->ucCycles = 7;
+			pInstruction->ucFlagsWritten = FLAGS_ALL;
+			pInstruction->ucFlagsRead = nY == 1 || nY == 3 ? FLAG_C : 0;
+			pInstruction->bFlagsOptional = TRUE;
+			break;
+
+		case 7:					// RST p
+			pInstruction->ucCycles = 11;
+			pInstruction->bWritesMemory = TRUE;
+			pInstruction->bEndsBlock = TRUE;
+			break;
+		}
+	}
+
+	if (pInstruction->ucLength > 1)
+	{
+		if (usPC + pInstruction->ucLength > Z80_RAM_SIZE)
+		{
+			return FALSE;
+		}
+
+		pInstruction->usOperand = m_pMemory[usPC+1];
+		if (pInstruction->ucLength > 2)
+		{
+			pInstruction->usOperand |= m_pMemory[usPC+2] << 8;
+		}
+	}
+
+	return TRUE;
+}
+
+void CZ80JIT::EmitInstruction (TJITInstruction *pInstruction)
+{
+	u8 ucOpcode = pInstruction->ucOpcode;
+	unsigned nY = OPCODE_Y (ucOpcode);
+	unsigned nZ = OPCODE_Z (ucOpcode);
+	unsigned nP = OPCODE_P (ucOpcode);
+	u16 usOperand = pInstruction->usOperand;
+	u16 usNext = (pInstruction->usPC + pInstruction->ucLength) & 0xFFFF;
+	boolean bFlags = pInstruction->bFlags;
+
+	unsigned nCycles = m_nCyclesBefore + pInstruction->ucCycles;
+	unsigned nCyclesTaken = m_nCyclesBefore + pInstruction->ucCyclesTaken;
+	unsigned nInstructions = m_nInstructionsBefore + 1;
+
+	u8 *pNotTaken;
+
+	if (ucOpcode >= 0x40 && ucOpcode < 0x80)		// LD r,r'
+	{
+		if (nZ == 6)
+		{
+			MovzxM8 (T0, REG_MEMORY, REG_HL, 0);
+		}
+		else if (nY == nZ)
+		{
+			return;
+		}
+		else
+		{
+			LoadReg8 (T0, nZ);
+		}
+
+		if (nY == 6)
+		{
+			WriteMemory8 (REG_HL, T0);
+		}
+		else
+		{
+			StoreReg8 (nY, T0);
+		}
+	}
+	else if (ucOpcode >= 0x80 && ucOpcode < 0xC0)		// ALU A,r
+	{
+		if (nZ == 6)
+		{
+			MovzxM8 (T0, REG_MEMORY, REG_HL, 0);
+		}
+		else
+		{
+			LoadReg8 (T0, nZ);
+		}
+
+		EmitALU (nY, bFlags);
+	}
+	else switch (ucOpcode)
+	{
+	case 0x00:						// NOP
+		break;
+
+	case 0x01: case 0x11: case 0x21: case 0x31:		// LD rr,nn
+		MovRI (s_PairReg[nP], usOperand);
+		break;
+
+	case 0x02: case 0x12:					// LD (BC),A, LD (DE),A
+		WriteMemory8 (s_PairReg[nP], REG_A);
+		break;
+
+	case 0x0A: case 0x1A:					// LD A,(BC), LD A,(DE)
+		MovzxM8 (REG_A, REG_MEMORY, s_PairReg[nP], 0);
+		break;
+
+	case 0x03: case 0x13: case 0x23: case 0x33:		// INC rr
+	case 0x0B: case 0x1B: case 0x2B: case 0x3B:		// DEC rr
+		AluRI (nY & 1 ? EXT_SUB : EXT_ADD, s_PairReg[nP], 1);
+		MovzxR16 (s_PairReg[nP], s_PairReg[nP]);
+		break;
+
+	case 0x04: case 0x0C: case 0x14: case 0x1C:		// INC r
+	case 0x24: case 0x2C: case 0x34: case 0x3C:
+	case 0x05: case 0x0D: case 0x15: case 0x1D:		// DEC r
+	case 0x25: case 0x2D: case 0x35: case 0x3D:
+		if (nY == 6)
+		{
+			MovzxM8 (T0, REG_MEMORY, REG_HL, 0);
+			EmitIncDec (nZ == 5, bFlags);
+			WriteMemory8 (REG_HL, T0);
+		}
+		else
+		{
+			LoadReg8 (T0, nY);
+			EmitIncDec (nZ == 5, bFlags);
+			StoreReg8 (nY, T0);
+		}
+		break;
+
+	case 0x06: case 0x0E: case 0x16: case 0x1E:		// LD r,n
+	case 0x26: case 0x2E: case 0x36: case 0x3E:
+		MovRI (T0, usOperand);
+		if (nY == 6)
+		{
+			WriteMemory8 (REG_HL, T0);
+		}
+		else
+		{
+			StoreReg8 (nY, T0);
+		}
+		break;
+
+	case 0x07:						// RLCA
+		AluRR (OP_MOV, T0, REG_A);
+		ShiftRI (EXT_SHR, T0, 7);
+		ShiftRI (EXT_SHL, REG_A, 1);
+		AluRR (OP_OR, REG_A, T0);
+		MovzxR8 (REG_A, REG_A);
+		if (bFlags)
+		{
+			AluRI (EXT_AND, REG_F, FLAGS_SZPV);
+			AluRR (OP_MOV, T0, REG_A);
+			AluRI (EXT_AND, T0, FLAGS_YX | FLAG_C);
+			AluRR (OP_OR, REG_F, T0);
+		}
+		break;
+
+	case 0x0F:						// RRCA
+	case 0x1F:						// RRA
+		AluRR (OP_MOV, T1, REG_A);
+		AluRI (EXT_AND, T1, 1);
+		if (ucOpcode == 0x0F)
+		{
+			AluRR (OP_MOV, T0, REG_A);
+			ShiftRI (EXT_SHL, T0, 7);
+		}
+		else
+		{
+			AluRR (OP_MOV, T0, REG_F);
+			AluRI (EXT_AND, T0, FLAG_C);
+			ShiftRI (EXT_SHL, T0, 7);
+		}
+		ShiftRI (EXT_SHR, REG_A, 1);
+		AluRR (OP_OR, REG_A, T0);
+		MovzxR8 (REG_A, REG_A);
+		if (bFlags)
+		{
+			AluRI (EXT_AND, REG_F, FLAGS_SZPV);
+			AluRR (OP_MOV, T0, REG_A);
+			AluRI (EXT_AND, T0, FLAGS_YX);
+			AluRR (OP_OR, REG_F, T0);
+			AluRR (OP_OR, REG_F, T1);
+		}
+		break;
+
+	case 0x17:						// RLA
+		AluRR (OP_MOV, T0, REG_A);
+		ShiftRI (EXT_SHL, T0, 1);
+		AluRR (OP_MOV, T1, REG_A);
+		ShiftRI (EXT_SHR, T1, 7);
+		AluRR (OP_MOV, T2, REG_F);
+		AluRI (EXT_AND, T2, FLAG_C);
+		AluRR (OP_MOV, REG_A, T0);
+		AluRR (OP_OR, REG_A, T2);
+		MovzxR8 (REG_A, REG_A);
+		if (bFlags)
+		{
+			AluRI (EXT_AND, REG_F, FLAGS_SZPV);
+			AluRI (EXT_AND, T0, FLAGS_YX);
+			AluRR (OP_OR, REG_F, T0);
+			AluRR (OP_OR, REG_F, T1);
+		}
+		break;
+
+	case 0x09: case 0x19: case 0x29: case 0x39:		// ADD HL,rr
+		EmitAddHL (s_PairReg[nP], bFlags);
+		break;
+
+	case 0x10:						// DJNZ e
+		AluRI (EXT_SUB, REG_BC, 0x100);
+		MovzxR16 (REG_BC, REG_BC);
+		EmitOpReg (0xF7, FALSE, 0, REG_BC);		// TEST ebx,0xFF00
+		Emit32 (0xFF00);
+		pNotTaken = Jcc (CC_Z);
+		EmitExit ((usNext + (s8) usOperand) & 0xFFFF, nCyclesTaken, nInstructions);
+		Patch (pNotTaken, m_pCodePtr);
+		EmitExit (usNext, nCycles, nInstructions);
+		break;
+
+	case 0x18:						// JR e
+		EmitExit ((usNext + (s8) usOperand) & 0xFFFF, nCycles, nInstructions);
+		break;
+
+	case 0x20: case 0x28: case 0x30: case 0x38:		// JR cc,e
+		pNotTaken = EmitCondition (nY-4, FALSE);
+		EmitExit ((usNext + (s8) usOperand) & 0xFFFF, nCyclesTaken, nInstructions);
+		Patch (pNotTaken, m_pCodePtr);
+		EmitExit (usNext, nCycles, nInstructions);
+		break;
+
+	case 0x22:						// LD (nn),HL
+		WriteMemory8Static (usOperand, REG_HL);
+		AluRR (OP_MOV, T0, REG_HL);
+		ShiftRI (EXT_SHR, T0, 8);
+		WriteMemory8Static (usOperand+1, T0);
+		break;
+
+	case 0x2A:						// LD HL,(nn)
+		MovzxM8 (T2, REG_MEMORY, NOREG, (usOperand+1) & 0xFFFF);
+		ShiftRI (EXT_SHL, T2, 8);
+		MovzxM8 (REG_HL, REG_MEMORY, NOREG, usOperand);
+		AluRR (OP_OR, REG_HL, T2);
+		break;
+
+	case 0x27:						// DAA
+		AluRR (OP_MOV, T0, REG_A);
+		AluRR (OP_MOV, T1, REG_F);
+		AluRI (EXT_AND, T1, FLAG_C);
+		ShiftRI (EXT_SHL, T1, 8);
+		AluRR (OP_OR, T0, T1);
+		AluRR (OP_MOV, T1, REG_F);
+		AluRI (EXT_AND, T1, FLAG_H);
+		ShiftRI (EXT_SHL, T1, 5);
+		AluRR (OP_OR, T0, T1);
+		AluRR (OP_MOV, T1, REG_F);
+		AluRI (EXT_AND, T1, FLAG_N);
+		ShiftRI (EXT_SHL, T1, 9);
+		AluRR (OP_OR, T0, T1);
+		EmitOpMem (0x0FB7, FALSE, T0, REG_CONTEXT, T0, 1, CONTEXT (DAAResult));
+		MovzxR8 (REG_F, T0);
+		AluRR (OP_MOV, REG_A, T0);
+		ShiftRI (EXT_SHR, REG_A, 8);
+		break;
+
+	case 0x2F:						// CPL
+		AluRI (EXT_XOR, REG_A, 0xFF);
+		if (bFlags)
+		{
+			AluRI (EXT_AND, REG_F, FLAGS_SZPV | FLAG_C);
+			AluRR (OP_MOV, T0, REG_A);
+			AluRI (EXT_AND, T0, FLAGS_YX);
+			AluRR (OP_OR, REG_F, T0);
+			AluRI (EXT_OR, REG_F, FLAG_H | FLAG_N);
+		}
+		break;
+
+	case 0x37:						// SCF
+		if (bFlags)
+		{
+			AluRI (EXT_AND, REG_F, FLAGS_SZPV);
+			AluRR (OP_MOV, T0, REG_A);
+			AluRI (EXT_AND, T0, FLAGS_YX);
+			AluRR (OP_OR, REG_F, T0);
+			AluRI (EXT_OR, REG_F, FLAG_C);
+		}
+		break;
+
+	case 0x3F:						// CCF
+		if (bFlags)
+		{
+			AluRR (OP_MOV, T1, REG_F);
+			AluRI (EXT_AND, T1, FLAG_C);
+			AluRI (EXT_AND, REG_F, FLAGS_SZPV);
+			AluRR (OP_MOV, T0, T1);
+			ShiftRI (EXT_SHL, T0, Z80_H_FLAG_SHIFT);
+			AluRR (OP_OR, REG_F, T0);
+			AluRR (OP_MOV, T0, REG_A);
+			AluRI (EXT_AND, T0, FLAGS_YX);
+			AluRR (OP_OR, REG_F, T0);
+			AluRI (EXT_XOR, T1, FLAG_C);
+			AluRR (OP_OR, REG_F, T1);
+		}
+		break;
+
+	case 0x32:						// LD (nn),A
+		WriteMemory8Static (usOperand, REG_A);
+		break;
+
+	case 0x3A:						// LD A,(nn)
+		MovzxM8 (REG_A, REG_MEMORY, NOREG, usOperand);
+		break;
+
+	case 0xC0: case 0xC8: case 0xD0: case 0xD8:		// RET cc
+	case 0xE0: case 0xE8: case 0xF0: case 0xF8:
+		pNotTaken = EmitCondition (nY, FALSE);
+		Pop16 (T0);
+		EmitDynamicExit (nCyclesTaken, nInstructions);
+		Patch (pNotTaken, m_pCodePtr);
+		EmitExit (usNext, nCycles, nInstructions);
+		break;
+
+	case 0xC1: case 0xD1: case 0xE1:			// POP rr
+		Pop16 (s_PairReg[nP]);
+		break;
+
+	case 0xF1:						// POP AF
+		Pop16 (T0);
+		MovzxR8 (REG_F, T0);
+		AluRR (OP_MOV, REG_A, T0);
+		ShiftRI (EXT_SHR, REG_A, 8);
+		break;
+
+	case 0xC2: case 0xCA: case 0xD2: case 0xDA:		// JP cc,nn
+	case 0xE2: case 0xEA: case 0xF2: case 0xFA:
+		pNotTaken = EmitCondition (nY, FALSE);
+		EmitExit (usOperand, nCyclesTaken, nInstructions);
+		Patch (pNotTaken, m_pCodePtr);
+		EmitExit (usNext, nCycles, nInstructions);
+		break;
+
+	case 0xC3:						// JP nn
+		EmitExit (usOperand, nCycles, nInstructions);
+		break;
+
+	case 0xC4: case 0xCC: case 0xD4: case 0xDC:		// CALL cc,nn
+	case 0xE4: case 0xEC: case 0xF4: case 0xFC:
+		pNotTaken = EmitCondition (nY, FALSE);
+		MovRI (T0, usNext);
+		Push16 (T0);
+		EmitCodeWrittenCheck (usOperand, nCyclesTaken, nInstructions);
+		EmitExit (usOperand, nCyclesTaken, nInstructions);
+		Patch (pNotTaken, m_pCodePtr);
+		EmitExit (usNext, nCycles, nInstructions);
+		break;
+
+	case 0xC5: case 0xD5: case 0xE5:			// PUSH rr
+		Push16 (s_PairReg[nP]);
+		break;
+
+	case 0xF5:						// PUSH AF
+		AluRR (OP_MOV, T0, REG_A);
+		ShiftRI (EXT_SHL, T0, 8);
+		AluRR (OP_OR, T0, REG_F);
+		Push16 (T0);
+		break;
+
+	case 0xC6: case 0xCE: case 0xD6: case 0xDE:		// ALU A,n
+	case 0xE6: case 0xEE: case 0xF6: case 0xFE:
+		MovRI (T0, usOperand);
+		EmitALU (nY, bFlags);
+		break;
+
+	case 0xC7: case 0xCF: case 0xD7: case 0xDF:		// RST p
+	case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+		MovRI (T0, usNext);
+		Push16 (T0);
+		EmitCodeWrittenCheck (nY << 3, nCycles, nInstructions);
+		EmitExit (nY << 3, nCycles, nInstructions);
+		break;
+
+	case 0xC9:						// RET
+		Pop16 (T0);
+		EmitDynamicExit (nCycles, nInstructions);
+		break;
+
+	case 0xCD:						// CALL nn
+		MovRI (T0, usNext);
+		Push16 (T0);
+		EmitCodeWrittenCheck (usOperand, nCycles, nInstructions);
+		EmitExit (usOperand, nCycles, nInstructions);
+		break;
+
+	case 0xD3:						// OUT (n),A
+		EmitPortCall (TRUE, usOperand);
+		EmitExit (usNext, nCycles, nInstructions);
+		break;
+
+	case 0xDB:						// IN A,(n)
+		EmitPortCall (FALSE, usOperand);
+		EmitStopRequestCheck (usNext, nCycles, nInstructions);
+		break;
+
+	case 0xE3:						// EX (SP),HL
+		ReadMemory16 (T0, REG_SP);
+		WriteMemory16 (REG_SP, REG_HL);
+		AluRR (OP_MOV, REG_HL, T0);
+		break;
+
+	case 0xE9:						// JP (HL)
+		AluRR (OP_MOV, T0, REG_HL);
+		EmitDynamicExit (nCycles, nInstructions);
+		break;
+
+	case 0xEB:						// EX DE,HL
+		AluRR (OP_MOV, T0, REG_HL);
+		AluRR (OP_MOV, REG_HL, REG_DE);
+		AluRR (OP_MOV, REG_DE, T0);
+		break;
+
+	case 0xF9:						// LD SP,HL
+		AluRR (OP_MOV, REG_SP, REG_HL);
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	if (   pInstruction->bWritesMemory
+	    && !pInstruction->bEndsBlock)
+	{
+		EmitCodeWrittenCheck (usNext, nCycles, nInstructions);
+	}
+}
+
+void CZ80JIT::Invalidate (TJITBlock *pBlock)
+{
+	assert (pBlock->bValid);
+	pBlock->bValid = FALSE;
+
+	// the entry may be reached from chained blocks, leave to the dispatcher there
+	pBlock->pEntry[0] = 0xE9;				// JMP rel32
+	Patch (pBlock->pEntry+1, pBlock->pBudgetStub);
+
+	assert (m_ppEntry[pBlock->usStart] == pBlock->pEntry);
+	m_ppEntry[pBlock->usStart] = 0;
+
+	for (unsigned nAddress = pBlock->usStart; nAddress < pBlock->nEnd; nAddress++)
+	{
+		if (m_pCodeMap[nAddress] < 0xFF)
+		{
+			assert (m_pCodeMap[nAddress] > 0);
+			m_pCodeMap[nAddress]--;
+		}
+	}
+
+	unsigned nIndex = pBlock - m_pBlock + 1;
+	unsigned nFirstPage = pBlock->usStart >> 8;
+	unsigned nLastPage = (pBlock->nEnd-1) >> 8;
+	for (unsigned nPage = nFirstPage; nPage <= nLastPage; nPage++)
+	{
+		unsigned *pLink = &m_PageHead[nPage];
+		while (*pLink != nIndex)
+		{
+			assert (*pLink != 0);
+			TJITBlock *pPrevious = &m_pBlock[*pLink-1];
+			pLink = &pPrevious->nNext[nPage == pPrevious->usStart >> 8 ? 0 : 1];
+		}
+
+		*pLink = pBlock->nNext[nPage == nFirstPage ? 0 : 1];
+	}
+
+	if (m_pInvalidations[pBlock->usStart] < 0xFF)
+	{
+		m_pInvalidations[pBlock->usStart]++;
+	}
+
+	m_nInvalidatedBlocks++;
+}
+
+void CZ80JIT::Flush (void)
+{
+	memset (m_ppEntry, 0, Z80_RAM_SIZE * sizeof (u8 *));
+	memset (m_PageHead, 0, sizeof m_PageHead);
+	memset (m_pCodeMap, 0, Z80_RAM_SIZE);
+
+	m_nBlocks = 0;
+	m_pCodePtr = m_pTranslationStart;
+	m_pPendingSite = 0;
+
+	m_nFlushes++;
+}
+
+void CZ80JIT::LoadReg8 (unsigned nTemp, unsigned nZ80Reg)
+{
+	assert (nZ80Reg != 6);
+	if (nZ80Reg == 7)
+	{
+		AluRR (OP_MOV, nTemp, REG_A);
+
+		return;
+	}
+
+	unsigned nPairReg = s_PairReg[nZ80Reg >> 1];
+	if (nZ80Reg & 1)
+	{
+		MovzxR8 (nTemp, nPairReg);
+	}
+	else if (nTemp < R8)
+	{
+		MovzxH8 (nTemp, nPairReg);
+	}
+	else
+	{
+		AluRR (OP_MOV, nTemp, nPairReg);
+		ShiftRI (EXT_SHR, nTemp, 8);
+	}
+}
+
+void CZ80JIT::StoreReg8 (unsigned nZ80Reg, unsigned nTemp)
+{
+	assert (nZ80Reg != 6);
+	if (nZ80Reg == 7)
+	{
+		AluRR (OP_MOV, REG_A, nTemp);
+
+		return;
+	}
+
+	unsigned nPairReg = s_PairReg[nZ80Reg >> 1];
+	if (nZ80Reg & 1)
+	{
+		AluRI (EXT_AND, nPairReg, 0xFF00);
+	}
+	else
+	{
+		AluRI (EXT_AND, nPairReg, 0x00FF);
+		ShiftRI (EXT_SHL, nTemp, 8);
+	}
+
+	AluRR (OP_OR, nPairReg, nTemp);
+}
+
+void CZ80JIT::ReadMemory16 (unsigned nDest, unsigned nAddress)
+{
+	assert (nDest != T2);
+
+	EmitOpMem (0x8D, FALSE, T2, nAddress, NOREG, 0, 1);		// LEA
+	MovzxR16 (T2, T2);
+	MovzxM8 (T2, REG_MEMORY, T2, 0);
+	ShiftRI (EXT_SHL, T2, 8);
+	MovzxM8 (nDest, REG_MEMORY, nAddress, 0);
+	AluRR (OP_OR, nDest, T2);
+}
+
+void CZ80JIT::WriteMemory8 (unsigned nAddress, unsigned nValue)
+{
+	MovM8R (REG_MEMORY, nAddress, 0, nValue);
+
+	CmpM8I (REG_CODEMAP, nAddress, 0, 0);
+	TStub *pStub = &m_pStub[m_nStubs++];
+	pStub->pPatch = Jcc (CC_NZ);
+	pStub->nType = StubWriteHit;
+	pStub->nRegister = nAddress;
+	pStub->pReturn = m_pCodePtr;
+}
+
+void CZ80JIT::WriteMemory8Static (u16 usAddress, unsigned nValue)
+{
+	MovM8R (REG_MEMORY, NOREG, usAddress, nValue);
+
+	CmpM8I (REG_CODEMAP, NOREG, usAddress, 0);
+	TStub *pStub = &m_pStub[m_nStubs++];
+	pStub->pPatch = Jcc (CC_NZ);
+	pStub->nType = StubWriteHit;
+	pStub->nRegister = NOREG;
+	pStub->nTarget = usAddress;
+	pStub->pReturn = m_pCodePtr;
+}
+
+void CZ80JIT::WriteMemory16 (unsigned nAddress, unsigned nValue)
+{
+	assert (nAddress != T2);
+	assert (nValue != T1 && nValue != T2);
+
+	WriteMemory8 (nAddress, nValue);
+
+	EmitOpMem (0x8D, FALSE, T2, nAddress, NOREG, 0, 1);		// LEA
+	MovzxR16 (T2, T2);
+	AluRR (OP_MOV, T1, nValue);
+	ShiftRI (EXT_SHR, T1, 8);
+	WriteMemory8 (T2, T1);
+}
+
+void CZ80JIT::Push16 (unsigned nValue)
+{
+	AluRI (EXT_SUB, REG_SP, 2);
+	MovzxR16 (REG_SP, REG_SP);
+	WriteMemory16 (REG_SP, nValue);
+}
+
+void CZ80JIT::Pop16 (unsigned nDest)
+{
+	ReadMemory16 (nDest, REG_SP);
+	AluRI (EXT_ADD, REG_SP, 2);
+	MovzxR16 (REG_SP, REG_SP);
+}
+
+// operand in T0, same calculation as in macros.h
+void CZ80JIT::EmitALU (unsigned nOperation, boolean bFlags)
+{
+	switch (nOperation)
+	{
+	case 0:							// ADD
+	case 1:							// ADC
+		AluRR (OP_MOV, T2, REG_A);
+		AluRR (OP_ADD, REG_A, T0);
+		if (nOperation == 1)
+		{
+			AluRR (OP_MOV, T1, REG_F);
+			AluRI (EXT_AND, T1, FLAG_C);
+			AluRR (OP_ADD, REG_A, T1);
+		}
+
+		if (bFlags)
+		{
+			AluRR (OP_MOV, T1, T2);
+			AluRR (OP_XOR, T1, T0);
+			AluRR (OP_XOR, T1, REG_A);
+			AluRR (OP_MOV, REG_F, T1);
+			AluRI (EXT_AND, REG_F, FLAG_H);
+			MovzxR8 (T2, REG_A);
+			MovzxM8 (T2, REG_CONTEXT, T2, CONTEXT (SZYXFlags));
+			AluRR (OP_OR, REG_F, T2);
+			ShiftRI (EXT_SHR, T1, 7);
+			MovzxM8 (T1, REG_CONTEXT, T1, CONTEXT (Overflow));
+			AluRR (OP_OR, REG_F, T1);
+			AluRR (OP_MOV, T2, REG_A);
+			ShiftRI (EXT_SHR, T2, 8);
+			AluRR (OP_OR, REG_F, T2);
+		}
+
+		MovzxR8 (REG_A, REG_A);
+		break;
+
+	case 2:							// SUB
+	case 3:							// SBC
+	case 7:							// CP
+		if (   nOperation == 7
+		    && !bFlags)
+		{
+			break;
+		}
+
+		AluRR (OP_MOV, T3, REG_A);
+		AluRR (OP_SUB, T3, T0);
+		if (nOperation == 3)
+		{
+			AluRR (OP_MOV, T1, REG_F);
+			AluRI (EXT_AND, T1, FLAG_C);
+			AluRR (OP_SUB, T3, T1);
+		}
+
+		if (bFlags)
+		{
+			AluRR (OP_MOV, T1, REG_A);
+			AluRR (OP_XOR, T1, T0);
+			AluRR (OP_XOR, T1, T3);
+			AluRR (OP_MOV, REG_F, T1);
+			AluRI (EXT_AND, REG_F, FLAG_H);
+			AluRI (EXT_OR, REG_F, FLAG_N);
+			MovzxR8 (T2, T3);
+			MovzxM8 (T2, REG_CONTEXT, T2, CONTEXT (SZYXFlags));
+			if (nOperation == 7)
+			{
+				AluRI (EXT_AND, T2, FLAGS_SZ);
+				AluRR (OP_OR, REG_F, T2);
+				AluRR (OP_MOV, T2, T0);
+				AluRI (EXT_AND, T2, FLAGS_YX);
+			}
+			AluRR (OP_OR, REG_F, T2);
+			AluRI (EXT_AND, T1, 0x180);
+			AluRR (OP_MOV, T2, T1);
+			ShiftRI (EXT_SHR, T2, 7);
+			MovzxM8 (T2, REG_CONTEXT, T2, CONTEXT (Overflow));
+			AluRR (OP_OR, REG_F, T2);
+			ShiftRI (EXT_SHR, T1, 8);
+			AluRR (OP_OR, REG_F, T1);
+		}
+
+		if (nOperation != 7)
+		{
+			MovzxR8 (REG_A, T3);
+		}
+		break;
+
+	case 4:							// AND
+		AluRR (OP_AND, REG_A, T0);
+		if (bFlags)
+		{
+			MovzxM8 (REG_F, REG_CONTEXT, REG_A, CONTEXT (SZYXPFlags));
+			AluRI (EXT_OR, REG_F, FLAG_H);
+		}
+		break;
+
+	case 5:							// XOR
+	case 6:							// OR
+		AluRR (nOperation == 5 ? OP_XOR : OP_OR, REG_A, T0);
+		if (bFlags)
+		{
+			MovzxM8 (REG_F, REG_CONTEXT, REG_A, CONTEXT (SZYXPFlags));
+		}
+		break;
+	}
+}
+
+// operand and result in T0
+void CZ80JIT::EmitIncDec (boolean bDecrement, boolean bFlags)
+{
+	AluRR (OP_MOV, T3, T0);
+	AluRI (bDecrement ? EXT_SUB : EXT_ADD, T3, 1);
+
+	if (bFlags)
+	{
+		AluRR (OP_MOV, T1, T0);
+		AluRR (OP_XOR, T1, T3);
+		AluRI (EXT_AND, REG_F, FLAG_C);
+		if (bDecrement)
+		{
+			AluRI (EXT_OR, REG_F, FLAG_N);
+		}
+		AluRR (OP_MOV, T2, T1);
+		AluRI (EXT_AND, T2, FLAG_H);
+		AluRR (OP_OR, REG_F, T2);
+		MovzxR8 (T2, T3);
+		MovzxM8 (T2, REG_CONTEXT, T2, CONTEXT (SZYXFlags));
+		AluRR (OP_OR, REG_F, T2);
+		ShiftRI (EXT_SHR, T1, 7);
+		AluRI (EXT_AND, T1, 3);
+		MovzxM8 (T1, REG_CONTEXT, T1, CONTEXT (Overflow));
+		AluRR (OP_OR, REG_F, T1);
+	}
+
+	MovzxR8 (T0, T3);
+}
+
+void CZ80JIT::EmitAddHL (unsigned nOperand, boolean bFlags)
+{
+	AluRR (OP_MOV, T3, REG_HL);
+	AluRR (OP_ADD, T3, nOperand);
+
+	if (bFlags)
+	{
+		AluRR (OP_MOV, T1, REG_HL);
+		AluRR (OP_XOR, T1, nOperand);
+		AluRR (OP_XOR, T1, T3);
+		AluRI (EXT_AND, REG_F, FLAGS_SZPV);
+		AluRR (OP_MOV, T2, T3);
+		ShiftRI (EXT_SHR, T2, 8);
+		AluRI (EXT_AND, T2, FLAGS_YX);
+		AluRR (OP_OR, REG_F, T2);
+		AluRR (OP_MOV, T2, T1);
+		ShiftRI (EXT_SHR, T2, 8);
+		AluRI (EXT_AND, T2, FLAG_H);
+		AluRR (OP_OR, REG_F, T2);
+		ShiftRI (EXT_SHR, T1, 16);
+		AluRR (OP_OR, REG_F, T1);
+	}
+
+	MovzxR16 (REG_HL, T3);
+}
+
+// returns the rel32 to be patched with the jump target
+u8 *CZ80JIT::EmitCondition (unsigned nCondition, boolean bJumpIfTrue)
+{
+	EmitOpReg (0xF6, FALSE, 0, REG_F);			// TEST r9b,imm8
+	Emit8 (s_ConditionFlag[nCondition]);
+
+	boolean bSetIsTrue = nCondition & 1;
+
+	return Jcc (bSetIsTrue == bJumpIfTrue ? CC_NZ : CC_Z);
+}
+
+void CZ80JIT::EmitPortCall (boolean bOutput, u8 ucPort)
+{
+	static const unsigned Saved[] = {RAX, RCX, RDX, RSI, R9, R10};	// keeps alignment
+	const unsigned nSaved = sizeof Saved / sizeof Saved[0];
+
+	for (unsigned i = 0; i < nSaved; i++)
+	{
+		Push (Saved[i]);
+	}
+
+	MovRI64 (RDI, (u64) (void *) m_pZ80Context);
+	MovRI (RSI, ucPort);
+	if (bOutput)
+	{
+		AluRR (OP_MOV, RDX, REG_A);
+		MovRI64 (R11, (u64) (void *) PortOutput);
+	}
+	else
+	{
+		MovRI64 (R11, (u64) (void *) PortInput);
+	}
+
+	EmitOpReg (0xFF, FALSE, 2, R11);			// CALL r11
+
+	if (!bOutput)
+	{
+		MovzxR8 (T0, RAX);
+	}
+
+	for (unsigned i = nSaved; i-- > 0;)
+	{
+		Pop (Saved[i]);
+	}
+
+	if (!bOutput)
+	{
+		AluRR (OP_MOV, REG_A, T0);
+	}
+}
+
+void CZ80JIT::EmitCount (unsigned nCycles, unsigned nInstructions)
+{
+	AluRI (EXT_ADD, REG_ELAPSED, nCycles);
+
+	EmitOpMem (0x83, FALSE, EXT_ADD, REG_CONTEXT, NOREG, 0, CONTEXT (nInstructions));
+	Emit8 (nInstructions);
+}
+
+void CZ80JIT::EmitExit (u16 usTarget, unsigned nCycles, unsigned nInstructions)
+{
+	EmitCount (nCycles, nInstructions);
+
+	u8 *pTarget = m_ppEntry[usTarget];
+	if (usTarget == m_pCurrentBlock->usStart)
+	{
+		pTarget = m_pCurrentBlock->pEntry;
+	}
+
+	u8 *pRel32 = Jmp ();
+	if (pTarget != 0)
+	{
+		Patch (pRel32, pTarget);
+	}
+	else
+	{
+		TStub *pStub = &m_pStub[m_nStubs++];
+		pStub->pPatch = pRel32;
+		pStub->nType = StubExit;
+		pStub->nTarget = usTarget;
+	}
+}
+
+// target address in T0
+void CZ80JIT::EmitDynamicExit (unsigned nCycles, unsigned nInstructions)
+{
+	EmitCount (nCycles, nInstructions);
+
+	EmitOpMem (0x8B, TRUE, R11, REG_CONTEXT, NOREG, 0, CONTEXT (ppEntry));
+	EmitOpMem (0x8B, TRUE, R11, R11, T0, 3, 0);		// MOV r11,[r11+rdi*8]
+	EmitOpReg (OP_TEST, TRUE, R11, R11);
+	Patch (Jcc (CC_Z), m_pDynamicMiss);
+	EmitOpReg (0xFF, FALSE, 4, R11);			// JMP r11
+}
+
+// leave the block, if WriteHit () has been called for the current instruction
+void CZ80JIT::EmitCodeWrittenCheck (u16 usNextPC, unsigned nCycles, unsigned nInstructions)
+{
+	CmpM8I (REG_CONTEXT, NOREG, CONTEXT (bCodeWritten), 0);
+
+	TStub *pStub = &m_pStub[m_nStubs++];
+	pStub->pPatch = Jcc (CC_NZ);
+	pStub->nType = StubCodeWritten;
+	pStub->nTarget = usNextPC;
+	pStub->nCycles = nCycles;
+	pStub->nInstructions = nInstructions;
+}
+
+// leave the block, if PortInput () has set port_stop_request
+void CZ80JIT::EmitStopRequestCheck (u16 usNextPC, unsigned nCycles, unsigned nInstructions)
+{
+	MovRI64 (R11, (u64) (void *) &m_pZ80Context->port_stop_request);
+	CmpM8I (R11, NOREG, 0, 0);
+
+	TStub *pStub = &m_pStub[m_nStubs++];
+	pStub->pPatch = Jcc (CC_NZ);
+	pStub->nType = StubStopRequest;
+	pStub->nTarget = usNextPC;
+	pStub->nCycles = nCycles;
+	pStub->nInstructions = nInstructions;
+}
+
+void CZ80JIT::EmitStubs (void)
+{
+	assert (m_nStubs <= MAX_STUBS);
+
+	for (unsigned i = 0; i < m_nStubs; i++)
+	{
+		TStub *pStub = &m_pStub[i];
+
+		Patch (pStub->pPatch, m_pCodePtr);
+
+		switch (pStub->nType)
+		{
+		case StubExit:
+			EmitOpMem (0xC7, FALSE, 0, REG_CONTEXT, NOREG, 0, CONTEXT (nExitPC));
+			Emit32 (pStub->nTarget);
+			MovRI64 (R11, (u64) pStub->pPatch);
+			EmitOpMem (OP_MOV, TRUE, R11, REG_CONTEXT, NOREG, 0, CONTEXT (pExitSite));
+			Patch (Jmp (), m_pEpilogue);
+			break;
+
+		case StubBudget:
+			m_pCurrentBlock->pBudgetStub = m_pCodePtr;
+			EmitOpMem (0xC7, FALSE, 0, REG_CONTEXT, NOREG, 0, CONTEXT (nExitPC));
+			Emit32 (pStub->nTarget);
+			Patch (Jmp (), m_pEpilogue);
+			break;
+
+		case StubWriteHit:
+			Push (RDI);
+			if (pStub->nRegister == NOREG)
+			{
+				MovRI (RDI, pStub->nTarget);
+			}
+			else if (pStub->nRegister != RDI)
+			{
+				AluRR (OP_MOV, RDI, pStub->nRegister);
+			}
+			Emit8 (0xE8);					// CALL rel32
+			Emit32 (0);
+			Patch (m_pCodePtr-4, m_pWriteHit);
+			Pop (RDI);
+			Patch (Jmp (), pStub->pReturn);
+			break;
+
+		case StubCodeWritten:
+			EmitOpMem (0xC6, FALSE, 0, REG_CONTEXT, NOREG, 0, CONTEXT (bCodeWritten));
+			Emit8 (0);
+			EmitCount (pStub->nCycles, pStub->nInstructions);
+			EmitOpMem (0xC7, FALSE, 0, REG_CONTEXT, NOREG, 0, CONTEXT (nExitPC));
+			Emit32 (pStub->nTarget);
+			Patch (Jmp (), m_pEpilogue);
+			break;
+
+		case StubStopRequest:
+			EmitCount (pStub->nCycles, pStub->nInstructions);
+			EmitOpMem (0xC7, FALSE, 0, REG_CONTEXT, NOREG, 0, CONTEXT (nExitPC));
+			Emit32 (pStub->nTarget);
+			Patch (Jmp (), m_pEpilogue);
+			break;
+
+		default:
+			assert (0);
+			break;
+		}
+	}
+}
+
+// The enter function is called with RDI = context and RSI = block entry. It
+// saves the callee-saved registers, loads the Z80 registers and jumps to the
+// block. The epilogue stores the Z80 registers and returns to the caller.
+void CZ80JIT::GenerateEnterExit (void)
+{
+	static const unsigned Saved[] = {RBX, RBP, R12, R13, R14, R15};
+	const unsigned nSaved = sizeof Saved / sizeof Saved[0];
+
+	assert (m_pCodePtr == m_pCode);
+	for (unsigned i = 0; i < nSaved; i++)
+	{
+		Push (Saved[i]);
+	}
+	EmitOpReg (0x83, TRUE, EXT_SUB, RSP);			// align stack to 16 bytes
+	Emit8 (8);
+
+	EmitOpReg (OP_MOV, TRUE, RDI, REG_CONTEXT);
+	EmitOpReg (OP_MOV, TRUE, RSI, R11);
+	EmitOpMem (0x8B, TRUE, R8, REG_CONTEXT, NOREG, 0, CONTEXT (pState));
+
+	s32 nRegisters = (s32) offsetof (Z80_STATE, registers);
+	EmitOpMem (0x0FB7, FALSE, REG_A, R8, NOREG, 0, nRegisters + 2*Z80_AF);
+	MovzxR8 (REG_F, REG_A);
+	ShiftRI (EXT_SHR, REG_A, 8);
+	EmitOpMem (0x0FB7, FALSE, REG_BC, R8, NOREG, 0, nRegisters + 2*Z80_BC);
+	EmitOpMem (0x0FB7, FALSE, REG_DE, R8, NOREG, 0, nRegisters + 2*Z80_DE);
+	EmitOpMem (0x0FB7, FALSE, REG_HL, R8, NOREG, 0, nRegisters + 2*Z80_HL);
+	EmitOpMem (0x0FB7, FALSE, REG_SP, R8, NOREG, 0, nRegisters + 2*Z80_SP);
+
+	EmitOpMem (0x8B, TRUE, REG_MEMORY, REG_CONTEXT, NOREG, 0, CONTEXT (pMemory));
+	EmitOpMem (0x8B, TRUE, REG_CODEMAP, REG_CONTEXT, NOREG, 0, CONTEXT (pCodeMap));
+	EmitOpMem (0x8B, FALSE, REG_ELAPSED, REG_CONTEXT, NOREG, 0, CONTEXT (nElapsed));
+	EmitOpMem (0x8B, FALSE, REG_BUDGET, REG_CONTEXT, NOREG, 0, CONTEXT (nBudget));
+
+	EmitOpReg (0xFF, FALSE, 4, R11);			// JMP r11
+
+	// target PC of a dynamic exit in T0 has not been translated
+	m_pDynamicMiss = m_pCodePtr;
+	EmitOpMem (OP_MOV, FALSE, T0, REG_CONTEXT, NOREG, 0, CONTEXT (nExitPC));
+
+	m_pEpilogue = m_pCodePtr;
+	EmitOpMem (0x8B, TRUE, R8, REG_CONTEXT, NOREG, 0, CONTEXT (pState));
+
+	AluRR (OP_MOV, T0, REG_A);
+	ShiftRI (EXT_SHL, T0, 8);
+	AluRR (OP_OR, T0, REG_F);
+	Emit8 (0x66);
+	EmitOpMem (OP_MOV, FALSE, T0, R8, NOREG, 0, nRegisters + 2*Z80_AF);
+	Emit8 (0x66);
+	EmitOpMem (OP_MOV, FALSE, REG_BC, R8, NOREG, 0, nRegisters + 2*Z80_BC);
+	Emit8 (0x66);
+	EmitOpMem (OP_MOV, FALSE, REG_DE, R8, NOREG, 0, nRegisters + 2*Z80_DE);
+	Emit8 (0x66);
+	EmitOpMem (OP_MOV, FALSE, REG_HL, R8, NOREG, 0, nRegisters + 2*Z80_HL);
+	Emit8 (0x66);
+	EmitOpMem (OP_MOV, FALSE, REG_SP, R8, NOREG, 0, nRegisters + 2*Z80_SP);
+
+	EmitOpMem (OP_MOV, FALSE, REG_ELAPSED, REG_CONTEXT, NOREG, 0, CONTEXT (nElapsed));
+
+	EmitOpReg (0x83, TRUE, EXT_ADD, RSP);
+	Emit8 (8);
+	for (unsigned i = nSaved; i-- > 0;)
+	{
+		Pop (Saved[i]);
+	}
+	Emit8 (0xC3);						// RET
+
+	// Called from a write hit stub with the address in RDI (saved by the
+	// stub). Saves the remaining caller-saved registers and calls WriteHit ().
+	m_pWriteHit = m_pCodePtr;
+
+	static const unsigned WriteHitSaved[] = {RAX, RCX, RDX, RSI, R8, R9, R10, R11};
+	const unsigned nWriteHitSaved = sizeof WriteHitSaved / sizeof WriteHitSaved[0];
+	for (unsigned i = 0; i < nWriteHitSaved; i++)
+	{
+		Push (WriteHitSaved[i]);
+	}
+
+	AluRR (OP_MOV, RSI, RDI);
+	EmitOpReg (OP_MOV, TRUE, REG_CONTEXT, RDI);
+	MovRI64 (RAX, (u64) (void *) WriteHit);
+	EmitOpReg (0xFF, FALSE, 2, RAX);			// CALL rax
+
+	for (unsigned i = nWriteHitSaved; i-- > 0;)
+	{
+		Pop (WriteHitSaved[i]);
+	}
+	Emit8 (0xC3);						// RET
+}
+
+void CZ80JIT::WriteHit (TJITContext *pContext, unsigned nAddress)
+{
+	pContext->bCodeWritten = 1;
+
+	pContext->pThis->CodeWritten (nAddress);
+}
+
+void CZ80JIT::Emit8 (u8 ucByte)
+{
+	*m_pCodePtr++ = ucByte;
+}
+
+void CZ80JIT::Emit32 (u32 nValue)
+{
+	memcpy (m_pCodePtr, &nValue, sizeof nValue);
+	m_pCodePtr += sizeof nValue;
+}
+
+void CZ80JIT::Emit64 (u64 nValue)
+{
+	memcpy (m_pCodePtr, &nValue, sizeof nValue);
+	m_pCodePtr += sizeof nValue;
+}
+
+// bByteReg: 8-bit register operand 4..7 means SPL..DIL, not AH..BH
+void CZ80JIT::EmitREX (boolean bWide, unsigned nReg, unsigned nIndex, unsigned nBase, boolean bByteReg)
+{
+	u8 ucREX = 0x40;
+	if (bWide)
+	{
+		ucREX |= 8;
+	}
+	if (nReg != NOREG && (nReg & 8))
+	{
+		ucREX |= 4;
+	}
+	if (nIndex != NOREG && (nIndex & 8))
+	{
+		ucREX |= 2;
+	}
+	if (nBase != NOREG && (nBase & 8))
+	{
+		ucREX |= 1;
+	}
+
+	if (   ucREX != 0x40
+	    || bByteReg)
+	{
+		Emit8 (ucREX);
+	}
+}
+
+// [base + index << scale + disp32]
+void CZ80JIT::EmitMem (unsigned nReg, unsigned nBase, unsigned nIndex, unsigned nScale, s32 nDisp)
+{
+	if (nIndex == NOREG)
+	{
+		Emit8 (0x80 | (nReg & 7) << 3 | (nBase & 7));
+		if ((nBase & 7) == RSP)
+		{
+			Emit8 (0x24);				// SIB without index
+		}
+	}
+	else
+	{
+		assert (nIndex != RSP);
+		Emit8 (0x80 | (nReg & 7) << 3 | 4);
+		Emit8 (nScale << 6 | (nIndex & 7) << 3 | (nBase & 7));
+	}
+
+	Emit32 (nDisp);
+}
+
+void CZ80JIT::EmitOpMem (unsigned nOpcode, boolean bWide, unsigned nReg,
+			 unsigned nBase, unsigned nIndex, unsigned nScale, s32 nDisp,
+			 boolean bByteReg)
+{
+	EmitREX (bWide, nReg, nIndex, nBase, bByteReg);
+	if (nOpcode > 0xFF)
+	{
+		Emit8 (nOpcode >> 8);
+	}
+	Emit8 (nOpcode & 0xFF);
+	EmitMem (nReg, nBase, nIndex, nScale, nDisp);
+}
+
+void CZ80JIT::EmitOpReg (unsigned nOpcode, boolean bWide, unsigned nReg, unsigned nRM,
+			 boolean bByteReg)
+{
+	EmitREX (bWide, nReg, NOREG, nRM, bByteReg);
+	if (nOpcode > 0xFF)
+	{
+		Emit8 (nOpcode >> 8);
+	}
+	Emit8 (nOpcode & 0xFF);
+	Emit8 (0xC0 | (nReg & 7) << 3 | (nRM & 7));
+}
+
+void CZ80JIT::AluRR (u8 ucOpcode, unsigned nDest, unsigned nSource)
+{
+	EmitOpReg (ucOpcode, FALSE, nSource, nDest);
+}
+
+void CZ80JIT::AluRI (unsigned nExtension, unsigned nDest, s32 nImmediate)
+{
+	if (-128 <= nImmediate && nImmediate <= 127)
+	{
+		EmitOpReg (0x83, FALSE, nExtension, nDest);
+		Emit8 (nImmediate);
+	}
+	else
+	{
+		EmitOpReg (0x81, FALSE, nExtension, nDest);
+		Emit32 (nImmediate);
+	}
+}
+
+void CZ80JIT::MovRI (unsigned nDest, u32 nImmediate)
+{
+	EmitREX (FALSE, NOREG, NOREG, nDest, FALSE);
+	Emit8 (0xB8 + (nDest & 7));
+	Emit32 (nImmediate);
+}
+
+void CZ80JIT::MovRI64 (unsigned nDest, u64 nImmediate)
+{
+	EmitREX (TRUE, NOREG, NOREG, nDest, FALSE);
+	Emit8 (0xB8 + (nDest & 7));
+	Emit64 (nImmediate);
+}
+
+void CZ80JIT::ShiftRI (unsigned nExtension, unsigned nDest, u8 ucCount)
+{
+	EmitOpReg (0xC1, FALSE, nExtension, nDest);
+	Emit8 (ucCount);
+}
+
+// low byte of source
+void CZ80JIT::MovzxR8 (unsigned nDest, unsigned nSource)
+{
+	EmitOpReg (0x0FB6, FALSE, nDest, nSource, RSP <= nSource && nSource <= RDI);
+}
+
+// bits 8-15 of RAX, RCX, RDX or RBX (AH..BH cannot be used with REX)
+void CZ80JIT::MovzxH8 (unsigned nDest, unsigned nSource)
+{
+	assert (nDest < R8 && nSource <= RBX);
+	Emit8 (0x0F);
+	Emit8 (0xB6);
+	Emit8 (0xC0 | nDest << 3 | (nSource + 4));
+}
+
+void CZ80JIT::MovzxR16 (unsigned nDest, unsigned nSource)
+{
+	EmitOpReg (0x0FB7, FALSE, nDest, nSource);
+}
+
+void CZ80JIT::MovzxM8 (unsigned nDest, unsigned nBase, unsigned nIndex, s32 nDisp)
+{
+	EmitOpMem (0x0FB6, FALSE, nDest, nBase, nIndex, 0, nDisp);
+}
+
+void CZ80JIT::MovM8R (unsigned nBase, unsigned nIndex, s32 nDisp, unsigned nSource)
+{
+	EmitOpMem (0x88, FALSE, nSource, nBase, nIndex, 0, nDisp,
+		   RSP <= nSource && nSource <= RDI);
+}
+
+void CZ80JIT::CmpM8I (unsigned nBase, unsigned nIndex, s32 nDisp, u8 ucImmediate)
+{
+	EmitOpMem (0x80, FALSE, 7, nBase, nIndex, 0, nDisp);
+	Emit8 (ucImmediate);
+}
+
+void CZ80JIT::Push (unsigned nReg)
+{
+	EmitREX (FALSE, NOREG, NOREG, nReg, FALSE);
+	Emit8 (0x50 + (nReg & 7));
+}
+
+void CZ80JIT::Pop (unsigned nReg)
+{
+	EmitREX (FALSE, NOREG, NOREG, nReg, FALSE);
+	Emit8 (0x58 + (nReg & 7));
+}
+
+// returns the rel32 to be patched with the jump target
+u8 *CZ80JIT::Jcc (unsigned nCondition)
+{
+	Emit8 (0x0F);
+	Emit8 (0x80 | nCondition);
+	Emit32 (0);
+
+	return m_pCodePtr - 4;
+}
+
+u8 *CZ80JIT::Jmp (void)
+{
+	Emit8 (0xE9);
+	Emit32 (0);
+
+	return m_pCodePtr - 4;
+}
+
+void CZ80JIT::Patch (u8 *pRel32, const u8 *pTarget)
+{
+	s32 nRel32 = (s32) (pTarget - (pRel32 + 4));
+	memcpy (pRel32, &nRel32, sizeof nRel32);
+}
+
+void CodeWritten (Z80_CONTEXT *pContext, unsigned short usAddress)
+{
+	CZ80JIT *pThis = (CZ80JIT *) pContext->jit;
+	assert (pThis != 0);
+	pThis->CodeWritten (usAddress);
+}
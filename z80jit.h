@@ -0,0 +1,176 @@
+//
+// z80jit.h
+//
+// Dynamic binary translator for the Z80 (x86-64 hosts only)
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef _z80jit_h
+#define _z80jit_h
+
+#include "z80emu.h"
+#include "z80stub.h"
+#include "types.h"
+
+// Basic blocks of unprefixed Z80 instructions, which have been executed often
+// enough, are translated into x86-64 code. A, F, BC, DE, HL and SP are held in
+// host registers and translated blocks jump directly into each other. All
+// other instructions are executed by the interpreter (Z80Emulate ()).
+// Translated code is protected by a byte map (code_map[] in Z80_CONTEXT),
+// which is checked on each write to the Z80 memory. Writing translated code
+// drops the affected blocks.
+
+struct TJITContext;		// data used by the generated code, see z80jit.cpp
+struct TJITBlock;
+struct TJITInstruction;
+
+class CZ80JIT
+{
+public:
+	CZ80JIT (Z80_CONTEXT *pZ80Context);
+	~CZ80JIT (void);
+
+	boolean Initialize (void);
+
+	// same as Z80Emulate ()
+	int Emulate (Z80_STATE *pState, int nCycles);
+
+	// a byte of translated code has been written
+	void CodeWritten (u16 usAddress);
+
+	unsigned GetTranslatedBlocks (void) const;
+	unsigned GetInvalidatedBlocks (void) const;
+	unsigned GetFlushes (void) const;
+
+private:
+	u8 *Translate (u16 usPC);
+	boolean Decode (u16 usPC, TJITInstruction *pInstruction) const;
+	void EmitInstruction (TJITInstruction *pInstruction);
+
+	void Invalidate (TJITBlock *pBlock);
+	void Flush (void);
+
+	// Z80 operands
+	void LoadReg8 (unsigned nTemp, unsigned nZ80Reg);
+	void StoreReg8 (unsigned nZ80Reg, unsigned nTemp);
+	void ReadMemory16 (unsigned nDest, unsigned nAddress);
+	void WriteMemory8 (unsigned nAddress, unsigned nValue);
+	void WriteMemory8Static (u16 usAddress, unsigned nValue);
+	void WriteMemory16 (unsigned nAddress, unsigned nValue);
+	void Push16 (unsigned nValue);
+	void Pop16 (unsigned nDest);
+
+	// Z80 operations
+	void EmitALU (unsigned nOperation, boolean bFlags);
+	void EmitIncDec (boolean bDecrement, boolean bFlags);
+	void EmitAddHL (unsigned nOperand, boolean bFlags);
+	u8 *EmitCondition (unsigned nCondition, boolean bJumpIfTrue);
+	void EmitPortCall (boolean bOutput, u8 ucPort);
+
+	// block exits
+	void EmitCount (unsigned nCycles, unsigned nInstructions);
+	void EmitExit (u16 usTarget, unsigned nCycles, unsigned nInstructions);
+	void EmitDynamicExit (unsigned nCycles, unsigned nInstructions);
+	void EmitCodeWrittenCheck (u16 usNextPC, unsigned nCycles, unsigned nInstructions);
+	void EmitStopRequestCheck (u16 usNextPC, unsigned nCycles, unsigned nInstructions);
+	void EmitStubs (void);
+
+	// x86-64 code emitter
+	void Emit8 (u8 ucByte);
+	void Emit32 (u32 nValue);
+	void Emit64 (u64 nValue);
+	void EmitREX (boolean bWide, unsigned nReg, unsigned nIndex, unsigned nBase, boolean bByteReg);
+	void EmitMem (unsigned nReg, unsigned nBase, unsigned nIndex, unsigned nScale, s32 nDisp);
+	void EmitOpMem (unsigned nOpcode, boolean bWide, unsigned nReg,
+			unsigned nBase, unsigned nIndex, unsigned nScale, s32 nDisp,
+			boolean bByteReg = FALSE);
+	void EmitOpReg (unsigned nOpcode, boolean bWide, unsigned nReg, unsigned nRM,
+			boolean bByteReg = FALSE);
+
+	void AluRR (u8 ucOpcode, unsigned nDest, unsigned nSource);
+	void AluRI (unsigned nExtension, unsigned nDest, s32 nImmediate);
+	void MovRI (unsigned nDest, u32 nImmediate);
+	void MovRI64 (unsigned nDest, u64 nImmediate);
+	void ShiftRI (unsigned nExtension, unsigned nDest, u8 ucCount);
+	void MovzxR8 (unsigned nDest, unsigned nSource);
+	void MovzxH8 (unsigned nDest, unsigned nSource);
+	void MovzxR16 (unsigned nDest, unsigned nSource);
+	void MovzxM8 (unsigned nDest, unsigned nBase, unsigned nIndex, s32 nDisp);
+	void MovM8R (unsigned nBase, unsigned nIndex, s32 nDisp, unsigned nSource);
+	void CmpM8I (unsigned nBase, unsigned nIndex, s32 nDisp, u8 ucImmediate);
+	void Push (unsigned nReg);
+	void Pop (unsigned nReg);
+	u8 *Jcc (unsigned nCondition);
+	u8 *Jmp (void);
+	void Patch (u8 *pRel32, const u8 *pTarget);
+
+	void GenerateEnterExit (void);
+
+	static void WriteHit (TJITContext *pContext, unsigned nAddress);
+
+private:
+	Z80_CONTEXT *m_pZ80Context;
+	u8 *m_pMemory;
+	u8 *m_pCodeMap;
+
+	TJITContext *m_pContext;
+
+	u8 *m_pCode;			// executable memory
+	u8 *m_pCodeEnd;
+	u8 *m_pCodePtr;			// next free byte
+	u8 *m_pTranslationStart;	// begin of translated blocks
+	u8 *m_pEpilogue;		// stores the Z80 registers and returns
+	u8 *m_pDynamicMiss;		// target of a dynamic exit has not been translated
+	u8 *m_pWriteHit;		// calls WriteHit ()
+
+	u8 **m_ppEntry;			// entry of translated block per address or 0
+	u8  *m_pCounter;		// execution counter per address
+	u8  *m_pInvalidations;		// number of invalidations per address
+
+	TJITBlock *m_pBlock;		// block pool
+	unsigned   m_nBlocks;
+	unsigned   m_PageHead[256];	// list of blocks per 256 byte page (block index + 1)
+
+	u8 *m_pPendingSite;		// exit, which can be chained to the next block
+	u16 m_usPendingTarget;
+
+	// per translated block
+	TJITBlock *m_pCurrentBlock;
+	unsigned m_nCyclesBefore;	// cycles of the instructions before the current one
+	unsigned m_nInstructionsBefore;
+	struct TStub
+	{
+		u8 *pPatch;		// rel32 to be patched with the stub address
+		unsigned nType;		// TStubType
+		unsigned nTarget;	// Z80 address
+		unsigned nRegister;	// holding the written address (or NOREG)
+		unsigned nCycles;
+		unsigned nInstructions;
+		u8 *pReturn;
+	}
+	*m_pStub;
+	unsigned m_nStubs;
+
+	unsigned m_nTranslatedBlocks;
+	unsigned m_nInvalidatedBlocks;
+	unsigned m_nFlushes;
+};
+
+#endif
@@ -21,6 +21,7 @@
 // CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 //
 #include "z80memory.h"
+#include "z80emu.h"
 #include "z80stub.h"
 #include "config.h"
 #include <assert.h>
@@ -29,25 +30,27 @@
 	#include <circle/logger.h>
 #else
 	#include <stdio.h>
+	#include <string.h>
 #endif
 
-unsigned char memory[Z80_RAM_SIZE];
-
 #ifdef __circle__
 static const char FromMemory[] = "z80mem";
 #endif
 
 #ifdef __circle__
-CZ80Memory::CZ80Memory (CFATFileSystem *pFileSystem)
-:	m_pFileSystem (pFileSystem)
+CZ80Memory::CZ80Memory (CFATFileSystem *pFileSystem, Z80_CONTEXT *pContext)
+:	m_pFileSystem (pFileSystem),
 #else
-CZ80Memory::CZ80Memory (void)
+CZ80Memory::CZ80Memory (Z80_CONTEXT *pContext)
+:
 #endif
+	m_pMemory (pContext->memory),
+	m_pContext (pContext)
 {
 	// poke jump to BIOS entry on reset address
-	memory[0] = 0xC3;			// opcode "JMP"
-	memory[1] = MEM_BIOS & 0xFF;
-	memory[2] = MEM_BIOS >> 8;
+	m_pMemory[0] = 0xC3;			// opcode "JMP"
+	m_pMemory[1] = MEM_BIOS & 0xFF;
+	m_pMemory[2] = MEM_BIOS >> 8;
 }
 
 CZ80Memory::~CZ80Memory (void)
@@ -55,6 +58,9 @@ CZ80Memory::~CZ80Memory (void)
 #ifdef __circle__
 	m_pFileSystem = 0;
 #endif
+
+	m_pMemory = 0;
+	m_pContext = 0;
 }
 
 boolean CZ80Memory::Initialize (void)
@@ -69,7 +75,7 @@ boolean CZ80Memory::Initialize (void)
 		return FALSE;
 	}
 
-	unsigned nResult = m_pFileSystem->FileRead (hFile, memory + MEM_CCP, SYSTEM_MAXSIZE);
+	unsigned nResult = m_pFileSystem->FileRead (hFile, m_pMemory + MEM_CCP, SYSTEM_MAXSIZE);
 	if (   nResult == FS_ERROR
 	    || nResult < SYSTEM_MINSIZE)
 	{
@@ -95,7 +101,7 @@ boolean CZ80Memory::Initialize (void)
 		return FALSE;
 	}
 
-	if (fread (memory + MEM_CCP, 1, SYSTEM_MAXSIZE, pFile) < SYSTEM_MINSIZE)
+	if (fread (m_pMemory + MEM_CCP, 1, SYSTEM_MAXSIZE, pFile) < SYSTEM_MINSIZE)
 	{
 		fprintf (stderr, "Error loading system\n");
 
@@ -112,10 +118,47 @@ boolean CZ80Memory::Initialize (void)
 
 void *CZ80Memory::GetDMAPointer (u16 usAddress, u16 usLength)
 {
-	if (usAddress + usLength < usAddress)		// address wraps
+	if ((unsigned) usAddress + usLength > Z80_RAM_SIZE)	// address wraps
 	{
 		return 0;
 	}
 
-	return memory + usAddress;
+	// the buffer may be written, cached code in it is not valid any more
+	Z80InvalidateCode (m_pContext, usAddress, usLength);
+
+	return m_pMemory + usAddress;
+}
+
+u8 CZ80Memory::ReadByte (u16 usAddress) const
+{
+	return m_pMemory[usAddress];
 }
+
+u64 CZ80Memory::GetChecksum (void) const
+{
+	// FNV-1a over 64-bit words
+	const u64 *pWord = (const u64 *) m_pMemory;
+	u64 nChecksum = 0xCBF29CE484222325ULL;
+	for (unsigned i = 0; i < Z80_RAM_SIZE / sizeof (u64); i++)
+	{
+		nChecksum ^= pWord[i];
+		nChecksum *= 0x100000001B3ULL;
+	}
+
+	return nChecksum;
+}
+
+#ifndef __circle__
+
+void CZ80Memory::Restore (const void *pImage)
+{
+	assert (pImage != 0);
+	memcpy (m_pMemory, pImage, Z80_RAM_SIZE);	// no code is cached yet
+}
+
+const u8 *CZ80Memory::GetImage (void) const
+{
+	return m_pMemory;
+}
+
+#endif
@@ -23,6 +23,7 @@
 #ifndef _z80memory_h
 #define _z80memory_h
 
+#include "z80emu.h"
 #include "types.h"
 
 #ifdef __circle__
@@ -33,20 +34,32 @@ class CZ80Memory
 {
 public:
 #ifdef __circle__
-	CZ80Memory (CFATFileSystem *pFileSystem);
+	CZ80Memory (CFATFileSystem *pFileSystem, Z80_CONTEXT *pContext);
 #else
-	CZ80Memory (void);
+	CZ80Memory (Z80_CONTEXT *pContext);
 #endif
 	~CZ80Memory (void);
 
 	boolean Initialize (void);
 
 	void *GetDMAPointer (u16 usAddress, u16 usLength);
+	u8 ReadByte (u16 usAddress) const;
+
+	u64 GetChecksum (void) const;		// of the whole memory
+
+#ifndef __circle__
+	// instead of Initialize () before the machine runs, copies Z80_RAM_SIZE
+	// bytes from pImage
+	void Restore (const void *pImage);
+	const u8 *GetImage (void) const;
+#endif
 
-#ifdef __circle__
 private:
+#ifdef __circle__
 	CFATFileSystem *m_pFileSystem;
 #endif
+	u8 *m_pMemory;		// in the Z80_CONTEXT of the machine
+	Z80_CONTEXT *m_pContext;
 };
 
 #endif
@@ -26,6 +26,12 @@
 #include "config.h"
 #include <assert.h>
 
+#ifdef __circle__
+	#include <circle/util.h>
+#else
+	#include <string.h>
+#endif
+
 enum TPortAddress
 {
 	// Console
@@ -34,56 +40,82 @@ enum TPortAddress
 #define PORT_CONSOLE_FULL	0x01
 	PortConsoleInput,		// In
 	PortConsoleOutput,		// Out
+	PortConsoleAddressLow,		// Out
+	PortConsoleAddressHigh,		// Out
+	PortConsoleString,		// Out
+#define PORT_CONSOLE_STRING_DOLLAR	0x00	// terminated with '$'
+#define PORT_CONSOLE_STRING_COUNTED	0x01	// first byte is the length
 
 	// Disk
-	PortDiskTrack	 = 0x10,	// Out
-	PortDiskSector,			// Out
+	PortDiskTrack	 = 0x10,	// Out, low byte (clears the high byte)
+	PortDiskSector,			// Out, incremented after each transfer
 	PortDiskDMALow,			// Out
 	PortDiskDMAHigh,		// Out
 	PortDiskOperation,		// Out
 #define PORT_DISK_READ		0x01
 #define PORT_DISK_WRITE		0x02
+#define PORT_DISK_SETUP		0x03	// DMA address points to the parameters, see SetupDisks ()
 	PortDiskStatus,			// In
 #define PORT_DISK_STATUS_OK	0x00
 #define PORT_DISK_STATUS_ERROR	0x01
 	PortDiskCount,			// In
 	PortDiskDrive,			// Out
+	PortDiskTrackHigh = 0x19,	// Out
 
 	// Control
-	PortControl	 = 0xE0		// Out
+	PortControl	 = 0xE0,	// Out
 #define PORT_CONTROL_SAVE	'S'
 #define PORT_CONTROL_QUIT	'Q'
+	PortControlStatus		// In
+#define PORT_CONTROL_STATUS_SAVING	0x01	// RAM disk is saved in the background
+#define PORT_CONTROL_STATUS_ERROR	0x02	// last save failed
 };
 
-CZ80Ports *CZ80Ports::s_pThis = 0;
+#define DPH_SIZE	16		// CP/M 2.2 disk parameter header
+#define DPB_SIZE	15		// CP/M 2.2 disk parameter block
 
-CZ80Ports::CZ80Ports (CZ80Computer *pComputer, CZ80Memory *pMemory, CConsole *pConsole,
-		      CRAMDisk *pRAMDisk0, CRAMDisk *pRAMDisk1)
+CZ80Ports::CZ80Ports (CZ80Computer *pComputer, Z80_CONTEXT *pContext, CZ80Memory *pMemory,
+		      CConsole *pConsole, CRAMDisk **ppRAMDisk)
 :	m_pComputer (pComputer),
+	m_pContext (pContext),
 	m_pMemory (pMemory),
 	m_pConsole (pConsole),
-	m_pRAMDisk0 (pRAMDisk0),
-	m_pRAMDisk1 (pRAMDisk1),
+	m_ppRAMDisk (ppRAMDisk),
 	m_ucDiskDriveCount (1),
 	m_ucDiskDrive (0),
-	m_ucDiskTrack (0),
+	m_usDiskTrack (0),
 	m_ucDiskSector (0),
 	m_usDMAAddress (0x80),
-	m_bDiskStatus (FALSE)
+	m_bDiskStatus (FALSE),
+	m_usConsoleAddress (0),
+	m_bConsolePolled (FALSE),
+	m_nAccessCount (0)
+#ifndef __circle__
+	, m_bBlockingInput (TRUE),
+	m_bInputRetry (FALSE),
+	m_bStopAtInput (FALSE)
+#endif
 {
-	assert (s_pThis == 0);
-	s_pThis = this;
+	assert (m_pContext != 0);
+	m_pContext->ports = this;
 }
 
 CZ80Ports::~CZ80Ports (void)
 {
-	s_pThis = 0;
+	m_pContext = 0;
 }
 
 boolean CZ80Ports::Initialize (void)
 {
-	assert (m_pRAMDisk1 != 0);
-	m_ucDiskDriveCount = m_pRAMDisk1->IsAvailable () ? 2 : 1;
+	assert (m_ppRAMDisk != 0);
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+		assert (m_ppRAMDisk[nDrive] != 0);
+		if (m_ppRAMDisk[nDrive]->IsAvailable ())
+		{
+			m_ucDiskDriveCount = nDrive + 1;
+		}
+	}
 
 	return TRUE;
 }
@@ -92,14 +124,41 @@ u8 CZ80Ports::PortInput (u16 usPort)
 {
 	usPort &= 0xFF;
 
+	if (usPort != PortConsoleStatus)
+	{
+		m_nAccessCount++;
+	}
+
 	switch (usPort)
 	{
 	case PortConsoleStatus:
 		assert (m_pConsole != 0);
-		return m_pConsole->GetStatus () ? PORT_CONSOLE_FULL : PORT_CONSOLE_EMPTY;
+		if (m_pConsole->GetStatus ())
+		{
+			m_nAccessCount++;
+
+			return PORT_CONSOLE_FULL;
+		}
+
+		// let CZ80Computer::Run () check, if the program is waiting for input
+		m_bConsolePolled = TRUE;
+		m_pContext->port_stop_request = 1;
+
+		return PORT_CONSOLE_EMPTY;
 
 	case PortConsoleInput:
 		assert (m_pConsole != 0);
+#ifndef __circle__
+		if (   m_bStopAtInput
+		    || (   !m_bBlockingInput
+			&& !m_pConsole->IsInputReady ()))
+		{
+			m_bInputRetry = TRUE;
+			m_pContext->port_stop_request = 1;
+
+			return 0;
+		}
+#endif
 		return m_pConsole->GetChar ();
 
 	case PortDiskStatus:
@@ -108,6 +167,25 @@ u8 CZ80Ports::PortInput (u16 usPort)
 	case PortDiskCount:
 		return m_ucDiskDriveCount;
 
+	case PortControlStatus: {
+		u8 ucStatus = 0;
+
+		for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+		{
+			if (m_ppRAMDisk[nDrive]->IsSaving ())
+			{
+				ucStatus |= PORT_CONTROL_STATUS_SAVING;
+			}
+
+			if (!m_ppRAMDisk[nDrive]->GetSaveStatus ())
+			{
+				ucStatus |= PORT_CONTROL_STATUS_ERROR;
+			}
+		}
+
+		return ucStatus;
+		}
+
 	default:
 		break;
 	}
@@ -119,6 +197,8 @@ void CZ80Ports::PortOutput (u16 usPort, u8 ucValue)
 {
 	usPort &= 0xFF;
 
+	m_nAccessCount++;
+
 	void *pDMABuffer;
 
 	switch (usPort)
@@ -128,8 +208,27 @@ void CZ80Ports::PortOutput (u16 usPort, u8 ucValue)
 		m_pConsole->PutChar (ucValue);
 		break;
 
+	case PortConsoleAddressLow:
+		m_usConsoleAddress &= 0xFF00;
+		m_usConsoleAddress |= ucValue;
+		break;
+
+	case PortConsoleAddressHigh:
+		m_usConsoleAddress &= 0x00FF;
+		m_usConsoleAddress |= ucValue << 8;
+		break;
+
+	case PortConsoleString:
+		PutString (m_usConsoleAddress, ucValue);
+		break;
+
 	case PortDiskTrack:
-		m_ucDiskTrack = ucValue;
+		m_usDiskTrack = ucValue;
+		break;
+
+	case PortDiskTrackHigh:
+		m_usDiskTrack &= 0x00FF;
+		m_usDiskTrack |= ucValue << 8;
 		break;
 
 	case PortDiskSector:
@@ -149,34 +248,48 @@ void CZ80Ports::PortOutput (u16 usPort, u8 ucValue)
 	case PortDiskOperation: {
 		m_bDiskStatus = FALSE;
 
-		if (m_ucDiskDrive >= m_ucDiskDriveCount)
+		if (ucValue == PORT_DISK_SETUP)
 		{
+			m_bDiskStatus = SetupDisks (m_usDMAAddress);
+
 			break;
 		}
 
-		assert (m_ucDiskDrive <= 1);
-		CRAMDisk *pRAMDisk = m_ucDiskDrive == 0 ? m_pRAMDisk0 : m_pRAMDisk1;
+		if (   m_ucDiskDrive >= DISK_DRIVES
+		    || !m_ppRAMDisk[m_ucDiskDrive]->IsAvailable ())
+		{
+			break;
+		}
+
+		CRAMDisk *pRAMDisk = m_ppRAMDisk[m_ucDiskDrive];
 		assert (pRAMDisk != 0);
 
 		assert (m_pMemory != 0);
 		pDMABuffer = m_pMemory->GetDMAPointer (m_usDMAAddress, SECTOR_SIZE);
 		if (pDMABuffer != 0)
 		{
-			unsigned nSector = SECTORS_PER_TRACK * m_ucDiskTrack + m_ucDiskSector;
+			// the sector may be beyond the track after the increment
+			unsigned nSector =   pRAMDisk->GetGeometry ()->nSectorsPerTrack * m_usDiskTrack
+					   + m_ucDiskSector;
 
 			switch (ucValue)
 			{
 			case PORT_DISK_READ:
-				m_bDiskStatus = pRAMDisk->Read (nSector, pDMABuffer);
+				m_bDiskStatus = pRAMDisk->Read (nSector, 1, pDMABuffer);
 				break;
 
 			case PORT_DISK_WRITE:
-				m_bDiskStatus = pRAMDisk->Write (nSector, pDMABuffer);
+				m_bDiskStatus = pRAMDisk->Write (nSector, 1, pDMABuffer);
 				break;
 
 			default:
 				break;
 			}
+
+			if (m_bDiskStatus)		// the BIOS does the same
+			{
+				m_ucDiskSector++;
+			}
 		}
 		} break;
 
@@ -185,21 +298,23 @@ void CZ80Ports::PortOutput (u16 usPort, u8 ucValue)
 		break;
 
 	case PortControl:
+		assert (m_pConsole != 0);
+		m_pConsole->Flush ();			// before any message of the host
+
 		switch (ucValue)
 		{
 		case PORT_CONTROL_SAVE:
-			assert (m_pRAMDisk0 != 0);
-			m_pRAMDisk0->Save ();
-
-			if (m_pRAMDisk1->IsAvailable ())
+			for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
 			{
-				m_pRAMDisk1->Save ();
+				if (m_ppRAMDisk[nDrive]->IsAvailable ())
+				{
+					m_ppRAMDisk[nDrive]->Save ();
+				}
 			}
 			break;
 
 		case PORT_CONTROL_QUIT:
-			assert (m_pComputer != 0);
-			m_pComputer->Shutdown ();
+			Quit ();
 			break;
 
 		default:
@@ -212,16 +327,285 @@ void CZ80Ports::PortOutput (u16 usPort, u8 ucValue)
 	}
 }
 
+void CZ80Ports::Quit (void)
+{
+	assert (m_pConsole != 0);
+	m_pConsole->Flush ();
+
+	assert (m_pComputer != 0);
+#ifdef Z80_PROFILER
+	m_pComputer->PrintProfile ();
+#endif
+	m_pComputer->Shutdown ();
+}
+
+void CZ80Ports::PutString (u16 usAddress, u8 ucFormat)
+{
+	assert (m_pConsole != 0);
+	assert (m_pMemory != 0);
+
+	switch (ucFormat)
+	{
+	case PORT_CONSOLE_STRING_DOLLAR:
+		for (unsigned i = 0; i < Z80_RAM_SIZE; i++)
+		{
+			u8 ucChar = m_pMemory->ReadByte (usAddress++);
+			if (ucChar == '$')
+			{
+				break;
+			}
+
+			m_pConsole->PutChar (ucChar);
+		}
+		break;
+
+	case PORT_CONSOLE_STRING_COUNTED:
+		for (unsigned nLength = m_pMemory->ReadByte (usAddress++); nLength > 0; nLength--)
+		{
+			m_pConsole->PutChar (m_pMemory->ReadByte (usAddress++));
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+// The BIOS passes the address of this block with PORT_DISK_SETUP on cold boot:
+//	dw	first free byte above the BIOS
+//	dw	BDOS entry for page 0 (set here, if the tables go below the CCP)
+//	ds	2*16	addresses of the DPHs of A: to P: (set here, 0 if no drive)
+// The disk parameter headers and blocks, the allocation vectors and the
+// directory buffer are generated from the geometry of the disk images. They
+// are stored above the BIOS, if they fit there. Otherwise they are stored below
+// the CCP, which is protected by a jump to the BDOS in front of them.
+boolean CZ80Ports::SetupDisks (u16 usAddress)
+{
+	assert (m_pMemory != 0);
+	u8 *pParam = (u8 *) m_pMemory->GetDMAPointer (usAddress, 4 + 2*DISK_DRIVES);
+	if (pParam == 0)
+	{
+		return FALSE;
+	}
+
+	// generate the DPBs, drives with the same geometry share one
+	u8 DPB[DISK_DRIVES][DPB_SIZE];
+	unsigned nDPBs = 0;
+	unsigned nDPBIndex[DISK_DRIVES];
+	unsigned nVectorSize[DISK_DRIVES];
+
+	unsigned nSize = SECTOR_SIZE;				// directory buffer
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+		if (!m_ppRAMDisk[nDrive]->IsAvailable ())
+		{
+			continue;
+		}
+
+		u8 Block[DPB_SIZE];
+		unsigned nBlocks = GetParameterBlock (m_ppRAMDisk[nDrive]->GetGeometry (), Block);
+
+		unsigned i;
+		for (i = 0; i < nDPBs; i++)
+		{
+			if (memcmp (DPB[i], Block, DPB_SIZE) == 0)
+			{
+				break;
+			}
+		}
+
+		if (i == nDPBs)
+		{
+			memcpy (DPB[nDPBs++], Block, DPB_SIZE);
+			nSize += DPB_SIZE;
+		}
+
+		nDPBIndex[nDrive] = i;
+		nVectorSize[nDrive] = (nBlocks-1) / 8 + 1;	// one bit per block
+		nSize += DPH_SIZE + nVectorSize[nDrive];
+	}
+
+	unsigned nBase = GetWord (pParam);
+	if (nBase + nSize > Z80_RAM_SIZE)
+	{
+		unsigned nPage = (MEM_CCP - nSize - 9) & 0xFF00;
+		if (nPage < MEM_CCP / 2)
+		{
+			return FALSE;
+		}
+
+		u8 *pEntry = (u8 *) m_pMemory->GetDMAPointer (nPage + 6, 3);
+		assert (pEntry != 0);
+		pEntry[0] = 0xC3;					// JMP bdos+6
+		PutWord (pEntry+1, MEM_BDOS + 6);
+
+		PutWord (pParam+2, nPage + 6);
+
+		nBase = nPage + 9;
+	}
+
+	u8 *pTables = (u8 *) m_pMemory->GetDMAPointer (nBase, nSize);
+	assert (pTables != 0);
+	memset (pTables, 0, nSize);
+
+	u16 usDirBuffer = nBase;
+	unsigned nOffset = SECTOR_SIZE;
+
+	u16 usDPB[DISK_DRIVES];
+	for (unsigned i = 0; i < nDPBs; i++)
+	{
+		memcpy (pTables + nOffset, DPB[i], DPB_SIZE);
+		usDPB[i] = nBase + nOffset;
+		nOffset += DPB_SIZE;
+	}
+
+	for (unsigned nDrive = 0; nDrive < DISK_DRIVES; nDrive++)
+	{
+		if (!m_ppRAMDisk[nDrive]->IsAvailable ())
+		{
+			PutWord (pParam + 4 + 2*nDrive, 0);
+
+			continue;
+		}
+
+		u8 *pDPH = pTables + nOffset;			// no translation, fixed disk
+		PutWord (pDPH+8, usDirBuffer);
+		PutWord (pDPH+10, usDPB[nDPBIndex[nDrive]]);
+		PutWord (pDPH+14, nBase + nOffset + DPH_SIZE);
+
+		PutWord (pParam + 4 + 2*nDrive, nBase + nOffset);
+
+		nOffset += DPH_SIZE + nVectorSize[nDrive];
+	}
+	assert (nOffset == nSize);
+
+	return TRUE;
+}
+
+// returns the number of blocks
+unsigned CZ80Ports::GetParameterBlock (const TDiskGeometry *pGeometry, u8 *pDPB)
+{
+	assert (pGeometry != 0);
+	assert (pDPB != 0);
+
+	unsigned nBlocks =   (pGeometry->nTracks - pGeometry->nReservedTracks)
+			   * pGeometry->nSectorsPerTrack * SECTOR_SIZE
+			   / pGeometry->nBlockSize;
+
+	unsigned nBlockShift = 0;
+	while (((unsigned) SECTOR_SIZE << nBlockShift) < pGeometry->nBlockSize)
+	{
+		nBlockShift++;
+	}
+
+	// a directory entry has 16 byte or 8 word block numbers
+	unsigned nExtentMask = pGeometry->nBlockSize / (nBlocks <= 256 ? 1024 : 2048) - 1;
+
+	unsigned nDirectoryBlocks =   (pGeometry->nDirectoryEntries * 32 + pGeometry->nBlockSize-1)
+				    / pGeometry->nBlockSize;
+	u16 usDirectoryMask = 0xFFFF << (16 - nDirectoryBlocks);
+
+	PutWord (pDPB, pGeometry->nSectorsPerTrack);		// SPT
+	pDPB[2] = nBlockShift;					// BSH
+	pDPB[3] = (1 << nBlockShift) - 1;			// BLM
+	pDPB[4] = nExtentMask;					// EXM
+	PutWord (pDPB+5, nBlocks-1);				// DSM
+	PutWord (pDPB+7, pGeometry->nDirectoryEntries-1);	// DRM
+	pDPB[9] = usDirectoryMask >> 8;				// AL0
+	pDPB[10] = usDirectoryMask & 0xFF;			// AL1
+	PutWord (pDPB+11, 0);					// CKS, fixed disk
+	PutWord (pDPB+13, pGeometry->nReservedTracks);		// OFF
+
+	return nBlocks;
+}
+
+u16 CZ80Ports::GetWord (const u8 *pBuffer)
+{
+	return pBuffer[0] | pBuffer[1] << 8;
+}
+
+void CZ80Ports::PutWord (u8 *pBuffer, u16 usValue)
+{
+	pBuffer[0] = usValue & 0xFF;
+	pBuffer[1] = usValue >> 8;
+}
+
+boolean CZ80Ports::IsConsolePolled (void)
+{
+	boolean bResult = m_bConsolePolled;
+	m_bConsolePolled = FALSE;
+
+	return bResult;
+}
+
+unsigned CZ80Ports::GetAccessCount (void) const
+{
+	return m_nAccessCount;
+}
+
+#ifndef __circle__
+
+void CZ80Ports::SetBlockingInput (boolean bBlock)
+{
+	m_bBlockingInput = bBlock;
+}
+
+boolean CZ80Ports::IsInputRetry (void)
+{
+	boolean bResult = m_bInputRetry;
+	m_bInputRetry = FALSE;
+
+	return bResult;
+}
+
+void CZ80Ports::SetStopAtInput (boolean bStop)
+{
+	m_bStopAtInput = bStop;
+}
+
+void CZ80Ports::GetState (TPortsState *pState) const
+{
+	assert (pState != 0);
+	memset (pState, 0, sizeof *pState);
+
+	pState->ucDiskDriveCount  = m_ucDiskDriveCount;
+	pState->ucDiskDrive	  = m_ucDiskDrive;
+	pState->usDiskTrack	  = m_usDiskTrack;
+	pState->ucDiskSector	  = m_ucDiskSector;
+	pState->bDiskStatus	  = m_bDiskStatus ? 1 : 0;
+	pState->usDMAAddress	  = m_usDMAAddress;
+	pState->usConsoleAddress  = m_usConsoleAddress;
+}
+
+void CZ80Ports::SetState (const TPortsState *pState)
+{
+	assert (pState != 0);
+
+	// the available drives are checked by the caller
+	assert (pState->ucDiskDriveCount == m_ucDiskDriveCount);
+
+	m_ucDiskDrive	   = pState->ucDiskDrive;
+	m_usDiskTrack	   = pState->usDiskTrack;
+	m_ucDiskSector	   = pState->ucDiskSector;
+	m_bDiskStatus	   = pState->bDiskStatus ? TRUE : FALSE;
+	m_usDMAAddress	   = pState->usDMAAddress;
+	m_usConsoleAddress = pState->usConsoleAddress;
+}
+
+#endif
+
 // Stubs:
 
-unsigned char PortInput (unsigned short usPort)
+unsigned char PortInput (Z80_CONTEXT *pContext, unsigned short usPort)
 {
-	assert (CZ80Ports::s_pThis != 0);
-	return CZ80Ports::s_pThis->PortInput (usPort);
+	CZ80Ports *pThis = (CZ80Ports *) pContext->ports;
+	assert (pThis != 0);
+	return pThis->PortInput (usPort);
 }
 
-void PortOutput (unsigned short usPort, unsigned char ucValue)
+void PortOutput (Z80_CONTEXT *pContext, unsigned short usPort, unsigned char ucValue)
 {
-	assert (CZ80Ports::s_pThis != 0);
-	CZ80Ports::s_pThis->PortOutput (usPort, ucValue);
+	CZ80Ports *pThis = (CZ80Ports *) pContext->ports;
+	assert (pThis != 0);
+	pThis->PortOutput (usPort, ucValue);
 }
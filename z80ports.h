@@ -24,17 +24,33 @@
 #define _z80ports_h
 
 #include "z80memory.h"
+#include "z80emu.h"
 #include "console.h"
 #include "ramdisk.h"
 #include "types.h"
 
 class CZ80Computer;
 
+#ifndef __circle__
+
+struct TPortsState		// the registers of the disk and console ports
+{
+	u8	ucDiskDriveCount;
+	u8	ucDiskDrive;
+	u16	usDiskTrack;
+	u8	ucDiskSector;
+	u8	bDiskStatus;
+	u16	usDMAAddress;
+	u16	usConsoleAddress;
+};
+
+#endif
+
 class CZ80Ports
 {
 public:
-	CZ80Ports (CZ80Computer *pComputer, CZ80Memory *pMemory, CConsole *pConsole,
-		   CRAMDisk *pRAMDisk0, CRAMDisk *pRAMDisk1);
+	CZ80Ports (CZ80Computer *pComputer, Z80_CONTEXT *pContext, CZ80Memory *pMemory,
+		   CConsole *pConsole, CRAMDisk **ppRAMDisk);	// DISK_DRIVES entries
 	~CZ80Ports (void);
 
 	boolean Initialize (void);
@@ -42,22 +58,61 @@ public:
 	u8 PortInput (u16 usPort);
 	void PortOutput (u16 usPort, u8 ucValue);
 
-public:
-	static CZ80Ports *s_pThis;
+	// leave the emulator without saving the RAM disks (like PORT_CONTROL_QUIT)
+	void Quit (void);
+
+	// an empty console status has been read since the last call
+	boolean IsConsolePolled (void);
+	// number of port accesses other than reading an empty console status
+	unsigned GetAccessCount (void) const;
+
+#ifndef __circle__
+	// With bBlock == FALSE reading the console input port does not wait for
+	// input, but stops the emulation and IsInputRetry () returns TRUE once.
+	// The caller has to execute the IN instruction again later then.
+	void SetBlockingInput (boolean bBlock);
+	boolean IsInputRetry (void);
+
+	// reading the console input port stops the emulation like above, even
+	// if input is available (to take a snapshot of the machine there)
+	void SetStopAtInput (boolean bStop);
+
+	void GetState (TPortsState *pState) const;
+	void SetState (const TPortsState *pState);	// after Initialize ()
+#endif
+
+private:
+	void PutString (u16 usAddress, u8 ucFormat);
+
+	boolean SetupDisks (u16 usAddress);
+	static unsigned GetParameterBlock (const TDiskGeometry *pGeometry, u8 *pDPB);
+
+	static u16 GetWord (const u8 *pBuffer);
+	static void PutWord (u8 *pBuffer, u16 usValue);
 
 private:
 	CZ80Computer *m_pComputer;
+	Z80_CONTEXT  *m_pContext;
 	CZ80Memory   *m_pMemory;
 	CConsole     *m_pConsole;
-	CRAMDisk     *m_pRAMDisk0;
-	CRAMDisk     *m_pRAMDisk1;
+	CRAMDisk    **m_ppRAMDisk;
 
 	u8	m_ucDiskDriveCount;
 	u8	m_ucDiskDrive;
-	u8      m_ucDiskTrack;
+	u16     m_usDiskTrack;
 	u8      m_ucDiskSector;
 	u16     m_usDMAAddress;
 	boolean m_bDiskStatus;
+
+	u16	m_usConsoleAddress;
+
+	boolean  m_bConsolePolled;
+	unsigned m_nAccessCount;
+#ifndef __circle__
+	boolean  m_bBlockingInput;
+	boolean  m_bInputRetry;
+	boolean  m_bStopAtInput;
+#endif
 };
 
 #endif
@@ -0,0 +1,179 @@
+//
+// z80profiler.cpp
+//
+// Hot-spot profiler for the Z80 code
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "z80profiler.h"
+#include "z80stub.h"
+#include "config.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#define HOT_SPOTS	32			// number of addresses in the report
+
+const Z80_PROFILE *CZ80Profiler::s_pSortProfile = 0;
+
+CZ80Profiler::CZ80Profiler (void)
+:	m_pProfile (0)
+{
+}
+
+CZ80Profiler::~CZ80Profiler (void)
+{
+	delete m_pProfile;
+	m_pProfile = 0;
+}
+
+boolean CZ80Profiler::Initialize (void)
+{
+	m_pProfile = new Z80_PROFILE;
+	memset (m_pProfile, 0, sizeof *m_pProfile);
+
+	return TRUE;
+}
+
+void CZ80Profiler::Attach (Z80_STATE *pState)
+{
+	assert (pState != 0);
+	assert (m_pProfile != 0);
+	pState->profile = m_pProfile;
+}
+
+void CZ80Profiler::PrintReport (boolean bRegions) const
+{
+	assert (m_pProfile != 0);
+
+	u64 nInstructions = 0;
+	u64 nCycles = 0;
+	unsigned nAddresses = 0;
+	unsigned *pAddress = new unsigned[Z80_RAM_SIZE];
+	for (unsigned nAddress = 0; nAddress < Z80_RAM_SIZE; nAddress++)
+	{
+		nInstructions += m_pProfile->instructions[nAddress];
+		nCycles += m_pProfile->cycles[nAddress];
+
+		if (m_pProfile->cycles[nAddress] != 0)
+		{
+			pAddress[nAddresses++] = nAddress;
+		}
+	}
+
+	if (nCycles == 0)
+	{
+		delete [] pAddress;
+
+		return;
+	}
+
+	s_pSortProfile = m_pProfile;
+	qsort (pAddress, nAddresses, sizeof *pAddress, CompareCycles);
+	s_pSortProfile = 0;
+
+	fprintf (stderr, "Hot spots:\n");
+	fprintf (stderr, "Address %s Instructions          Cycles      %%\n",
+		 bRegions ? "Region " : "");
+	for (unsigned i = 0; i < nAddresses && i < HOT_SPOTS; i++)
+	{
+		unsigned nAddress = pAddress[i];
+
+		fprintf (stderr, "%04X    ", nAddress);
+		if (bRegions)
+		{
+			fprintf (stderr, "%-7s ", GetRegion (nAddress));
+		}
+		fprintf (stderr, "%12llu %15llu %6.2f\n",
+			 m_pProfile->instructions[nAddress], m_pProfile->cycles[nAddress],
+			 100.0 * m_pProfile->cycles[nAddress] / nCycles);
+	}
+
+	delete [] pAddress;
+
+	if (!bRegions)
+	{
+		return;
+	}
+
+	fprintf (stderr, "Regions:\n");
+	fprintf (stderr, "Region     Instructions          Cycles      %%\n");
+
+	static const char *Regions[] = {"Page 0", "TPA", "CCP", "BDOS", "BIOS"};
+	for (unsigned i = 0; i < sizeof Regions / sizeof Regions[0]; i++)
+	{
+		u64 nRegionInstructions = 0;
+		u64 nRegionCycles = 0;
+		for (unsigned nAddress = 0; nAddress < Z80_RAM_SIZE; nAddress++)
+		{
+			if (GetRegion (nAddress) == Regions[i])
+			{
+				nRegionInstructions += m_pProfile->instructions[nAddress];
+				nRegionCycles += m_pProfile->cycles[nAddress];
+			}
+		}
+
+		fprintf (stderr, "%-7s %15llu %15llu %6.2f\n", Regions[i],
+			 nRegionInstructions, nRegionCycles, 100.0 * nRegionCycles / nCycles);
+	}
+
+	fprintf (stderr, "Total   %15llu %15llu\n", nInstructions, nCycles);
+}
+
+const char *CZ80Profiler::GetRegion (unsigned nAddress)
+{
+	if (nAddress < 0x100)
+	{
+		return "Page 0";
+	}
+	else if (nAddress < MEM_CCP)
+	{
+		return "TPA";
+	}
+	else if (nAddress < MEM_BDOS)
+	{
+		return "CCP";
+	}
+	else if (nAddress < MEM_BIOS)
+	{
+		return "BDOS";
+	}
+
+	return "BIOS";
+}
+
+int CZ80Profiler::CompareCycles (const void *pAddress1, const void *pAddress2)
+{
+	assert (s_pSortProfile != 0);
+	u64 nCycles1 = s_pSortProfile->cycles[*(const unsigned *) pAddress1];
+	u64 nCycles2 = s_pSortProfile->cycles[*(const unsigned *) pAddress2];
+
+	if (nCycles1 > nCycles2)
+	{
+		return -1;
+	}
+	else if (nCycles1 < nCycles2)
+	{
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,60 @@
+//
+// z80profiler.h
+//
+// Hot-spot profiler for the Z80 code
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef _z80profiler_h
+#define _z80profiler_h
+
+#include "z80emu.h"
+#include "types.h"
+
+// The Z80 core counts the executed instructions and their cycles per address
+// into a Z80_PROFILE (see Z80_PROFILER in z80emu.h). The report lists the
+// addresses with the most cycles and optionally the totals of the CP/M
+// memory regions (page 0, TPA, CCP, BDOS and BIOS, see config.h).
+
+class CZ80Profiler
+{
+public:
+	CZ80Profiler (void);
+	~CZ80Profiler (void);
+
+	boolean Initialize (void);
+
+	// count the instructions emulated with this state
+	void Attach (Z80_STATE *pState);
+
+	void PrintReport (boolean bRegions) const;
+
+private:
+	static const char *GetRegion (unsigned nAddress);
+
+	static int CompareCycles (const void *pAddress1, const void *pAddress2);
+
+private:
+	Z80_PROFILE *m_pProfile;
+
+	static const Z80_PROFILE *s_pSortProfile;	// used by CompareCycles ()
+};
+
+#endif
@@ -29,10 +29,35 @@ extern "C" {
 
 #define Z80_RAM_SIZE	0x10000
 
-extern unsigned char memory[Z80_RAM_SIZE];
+// Everything the memory and I/O macros in z80emu.h work on. Each machine has
+// its own context, which is reachable from its Z80_STATE, so that several
+// machines can run in one process.
+typedef struct Z80_CONTEXT
+{
+	unsigned char memory[Z80_RAM_SIZE];
 
-unsigned char PortInput (unsigned short usPort);
-void PortOutput (unsigned short usPort, unsigned char ucValue);
+	void *ports;			// CZ80Ports
+	int port_stop_request;		// PortInput () stops the emulation after the instruction
+
+#ifdef Z80_JIT
+	unsigned char code_map[Z80_RAM_SIZE];	// non-zero for translated code
+	void *jit;			// CZ80JIT
+#endif
+
+#ifdef Z80_DECODE_CACHE
+	Z80_DECODED_INSTRUCTION decode_cache[Z80_RAM_SIZE];
+	unsigned char code_pages[0x100];	// see z80emu.c
+	const void *decode_handler, *prefixed_handler;
+#endif
+}
+Z80_CONTEXT;
+
+unsigned char PortInput (Z80_CONTEXT *pContext, unsigned short usPort);
+void PortOutput (Z80_CONTEXT *pContext, unsigned short usPort, unsigned char ucValue);
+
+#ifdef Z80_JIT
+void CodeWritten (Z80_CONTEXT *pContext, unsigned short usAddress);
+#endif
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,315 @@
+//
+// zygote.cpp
+//
+// Runs batch jobs in child processes forked from one booted machine (Linux only)
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#include "zygote.h"
+#include <assert.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+CZygote::CZygote (unsigned nMaxChildren)
+:	m_pComputer (0),
+	m_nBootInstructions (0),
+	m_pChild (0),
+	m_nMaxChildren (nMaxChildren),
+	m_nChildren (0),
+	m_ppName (0),
+	m_nJobs (0),
+	m_nInstructions (0),
+	m_nBootTime (0),
+	m_nRunTime (0)
+{
+	if (m_nMaxChildren == 0)
+	{
+		long nCPUs = sysconf (_SC_NPROCESSORS_ONLN);
+		m_nMaxChildren = nCPUs > 0 ? (unsigned) nCPUs : 1;
+	}
+}
+
+CZygote::~CZygote (void)
+{
+	assert (m_nChildren == 0);
+
+	delete [] m_pChild;
+	m_pChild = 0;
+
+	m_pComputer = 0;
+}
+
+boolean CZygote::Boot (CZ80Computer *pComputer)
+{
+	assert (m_pComputer == 0);
+	m_pComputer = pComputer;
+	assert (m_pComputer != 0);
+
+	u64 nStartTime = GetTime ();
+
+	// the output of the boot stays in the console buffer and is written to
+	// the output file of each job, the input is not read before the stop
+	int nInputFile = open ("/dev/null", O_RDONLY);
+	int nOutputFile = open ("/dev/null", O_WRONLY);
+	if (   nInputFile < 0
+	    || nOutputFile < 0)
+	{
+		fprintf (stderr, "Cannot open: /dev/null\n");
+
+		return FALSE;
+	}
+
+	m_pComputer->SetConsoleFiles (nInputFile, nOutputFile);
+	m_pComputer->SetStopAtInput (TRUE);
+
+	if (!m_pComputer->Initialize ())
+	{
+		return FALSE;
+	}
+
+	m_pComputer->Start ();
+
+	while (m_pComputer->RunSlice (TRUE) != RunStatusStopped)
+	{
+		// just run
+	}
+
+	if (!m_pComputer->IsStoppedAtInput ())
+	{
+		fprintf (stderr, "The machine has quit before reading console input\n");
+
+		return FALSE;
+	}
+
+	m_nBootInstructions = m_pComputer->GetInstructions ();
+	m_nBootTime = GetTime () - nStartTime;
+
+	return TRUE;
+}
+
+int CZygote::Run (CBatchJob *pJob, unsigned nJobs, const char * const *ppName)
+{
+	assert (m_pComputer != 0);
+	assert (pJob != 0);
+	assert (ppName != 0);
+
+	m_ppName = ppName;
+	m_nJobs = nJobs;
+
+	if (m_nMaxChildren > m_nJobs)
+	{
+		m_nMaxChildren = m_nJobs;
+	}
+
+	assert (m_pChild == 0);
+	m_pChild = new TChild[m_nMaxChildren];
+	assert (m_pChild != 0);
+
+	for (unsigned i = 0; i < m_nMaxChildren; i++)
+	{
+		m_pChild[i].nPID = 0;
+	}
+
+	u64 nStartTime = GetTime ();
+
+	int nResult = JOB_STATUS_OK;
+	for (unsigned nJob = 0; nJob < m_nJobs; nJob++)
+	{
+		if (m_nChildren == m_nMaxChildren)
+		{
+			int nStatus = WaitForChild ();
+			if (nStatus > nResult)
+			{
+				nResult = nStatus;
+			}
+		}
+
+		unsigned nSlot;
+		for (nSlot = 0; m_pChild[nSlot].nPID != 0; nSlot++)
+		{
+			assert (nSlot < m_nMaxChildren);
+		}
+		TChild *pChild = &m_pChild[nSlot];
+
+		int Pipe[2];
+		if (pipe (Pipe) < 0)
+		{
+			fprintf (stderr, "Cannot create pipe\n");
+
+			nResult = JOB_STATUS_ERROR;
+
+			break;
+		}
+
+		fflush (stdout);
+		fflush (stderr);
+
+		pid_t nPID = fork ();
+		if (nPID < 0)
+		{
+			fprintf (stderr, "Cannot fork: %s\n", m_ppName[nJob]);
+
+			close (Pipe[0]);
+			close (Pipe[1]);
+
+			nResult = JOB_STATUS_ERROR;
+
+			break;
+		}
+
+		if (nPID == 0)
+		{
+			close (Pipe[0]);
+
+			// the pipes of the other children belong to the parent
+			for (unsigned i = 0; i < m_nMaxChildren; i++)
+			{
+				if (m_pChild[i].nPID != 0)
+				{
+					close (m_pChild[i].nResultPipe);
+				}
+			}
+
+			RunChild (&pJob[nJob], Pipe[1]);
+		}
+
+		close (Pipe[1]);
+
+		pChild->nPID = nPID;
+		pChild->nResultPipe = Pipe[0];
+		pChild->nJob = nJob;
+		m_nChildren++;
+	}
+
+	while (m_nChildren > 0)
+	{
+		int nStatus = WaitForChild ();
+		if (nStatus > nResult)
+		{
+			nResult = nStatus;
+		}
+	}
+
+	m_nRunTime = GetTime () - nStartTime;
+
+	return nResult;
+}
+
+void CZygote::PrintStatistics (void) const
+{
+	fprintf (stderr, "Zygote:       booted in %.3f ms, %llu instructions\n",
+		 m_nBootTime / 1000000.0, m_nBootInstructions);
+	fprintf (stderr, "Processes:    %u jobs, max. %u at once\n", m_nJobs, m_nMaxChildren);
+	fprintf (stderr, "Run time:     %.3f s\n", m_nRunTime / 1000000000.0);
+
+	if (m_nRunTime > 0)
+	{
+		fprintf (stderr, "Speed:        %.2f MIPS (aggregate)\n",
+			 m_nInstructions * 1000.0 / m_nRunTime);
+	}
+}
+
+void CZygote::RunChild (CBatchJob *pJob, int nResultPipe)
+{
+	assert (pJob != 0);
+	assert (m_pComputer != 0);
+
+	TResult Result;
+	Result.nStatus = JOB_STATUS_ERROR;
+	Result.nInstructions = 0;
+
+	if (pJob->Attach (m_pComputer))
+	{
+		while (m_pComputer->RunSlice (TRUE) != RunStatusStopped)
+		{
+			// just run
+		}
+
+		m_pComputer->Finish ();
+
+		Result.nStatus = pJob->Complete (m_pComputer);
+		Result.nInstructions = m_pComputer->GetInstructions () - m_nBootInstructions;
+	}
+
+	// the pipe cannot be full with this one message
+	if (write (nResultPipe, &Result, sizeof Result) != (ssize_t) sizeof Result)
+	{
+		Result.nStatus = JOB_STATUS_ERROR;
+	}
+
+	// the destructors of the parent's objects must not run here
+	_exit (Result.nStatus);
+}
+
+int CZygote::WaitForChild (void)
+{
+	assert (m_nChildren > 0);
+
+	int nWaitStatus;
+	pid_t nPID;
+	while ((nPID = waitpid (-1, &nWaitStatus, 0)) < 0)
+	{
+		assert (errno == EINTR);
+	}
+
+	unsigned nSlot;
+	for (nSlot = 0; m_pChild[nSlot].nPID != nPID; nSlot++)
+	{
+		assert (nSlot < m_nMaxChildren);
+	}
+	TChild *pChild = &m_pChild[nSlot];
+
+	TResult Result;
+	ssize_t nBytesRead;
+	while (   (nBytesRead = read (pChild->nResultPipe, &Result, sizeof Result)) < 0
+	       && errno == EINTR)
+	{
+		// try again
+	}
+
+	if (   nBytesRead != (ssize_t) sizeof Result
+	    || !WIFEXITED (nWaitStatus))
+	{
+		fprintf (stderr, "Job terminated abnormally: %s\n", m_ppName[pChild->nJob]);
+
+		Result.nStatus = JOB_STATUS_ERROR;
+		Result.nInstructions = 0;
+	}
+
+	m_nInstructions += Result.nInstructions;
+
+	close (pChild->nResultPipe);
+	pChild->nPID = 0;
+	m_nChildren--;
+
+	return Result.nStatus;
+}
+
+u64 CZygote::GetTime (void)
+{
+	struct timespec Time;
+	clock_gettime (CLOCK_MONOTONIC, &Time);
+
+	return (u64) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
@@ -0,0 +1,87 @@
+//
+// zygote.h
+//
+// Runs batch jobs in child processes forked from one booted machine (Linux only)
+//
+// Copyright (C) 2016-2018  R. Stange <rsta2@o2online.de>
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to
+// use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+// subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+// FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+// COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+// IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+// CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+//
+#ifndef _zygote_h
+#define _zygote_h
+
+#include "z80computer.h"
+#include "batchjob.h"
+#include "types.h"
+#include <sys/types.h>
+
+// The zygote machine is booted once, until it reads console input (normally at
+// the CCP prompt). Then a child process is forked for each job, which shares
+// the memory and the disks of the machine copy-on-write with the others,
+// attaches the job to it and continues it. The result of a job is reported
+// back through a pipe and the exit status of the child.
+
+class CZygote
+{
+public:
+	CZygote (unsigned nMaxChildren);	// nMaxChildren = 0: one per CPU
+	~CZygote (void);
+
+	// the machine has been created, but not initialized
+	boolean Boot (CZ80Computer *pComputer);
+
+	// returns the highest JOB_STATUS_* of all jobs
+	int Run (CBatchJob *pJob, unsigned nJobs, const char * const *ppName);
+
+	void PrintStatistics (void) const;
+
+private:
+	struct TResult			// sent from the child to the parent
+	{
+		s32	nStatus;
+		u64	nInstructions;	// since the zygote has been booted
+	};
+
+	struct TChild
+	{
+		pid_t	 nPID;		// 0 if the slot is free
+		int	 nResultPipe;
+		unsigned nJob;
+	};
+
+	void RunChild (CBatchJob *pJob, int nResultPipe);	// does not return
+	int WaitForChild (void);	// returns the JOB_STATUS_* of a terminated child
+
+	static u64 GetTime (void);			// ns
+
+private:
+	CZ80Computer *m_pComputer;
+	u64 m_nBootInstructions;
+
+	TChild  *m_pChild;
+	unsigned m_nMaxChildren;
+	unsigned m_nChildren;		// running
+
+	const char * const *m_ppName;
+	unsigned m_nJobs;
+	u64 m_nInstructions;		// of all jobs
+	u64 m_nBootTime;		// ns
+	u64 m_nRunTime;			// ns of Run ()
+};
+
+#endif